@@ -15,6 +15,7 @@
  */
 
 #include <media-io/audio-io.h>
+#include <media-io/video-frame.h>
 #include <util/platform.h>
 
 #include "media-playback.h"
@@ -77,9 +78,12 @@ static inline bool mp_cache_sleep(mp_cache_t *c)
 		c->next_ns = os_gettime_ns();
 	} else {
 		const uint64_t t = os_gettime_ns();
-		if (c->next_ns > t) {
+		const uint64_t wake_ns =
+			c->render_clock ? c->next_ns - MP_RENDER_CLOCK_AHEAD_NS
+					  : c->next_ns;
+		if (wake_ns > t) {
 			const uint32_t delta_ms =
-				(uint32_t)((c->next_ns - t + 500000) / 1000000);
+				(uint32_t)((wake_ns - t + 500000) / 1000000);
 			if (delta_ms > 0) {
 				static const uint32_t timeout_ms = 200;
 				timeout = delta_ms > timeout_ms;
@@ -136,6 +140,20 @@ bool mp_cache_decode(mp_cache_t *c)
 	if (c->start_time == AV_NOPTS_VALUE)
 		c->start_time = 0;
 
+	if (c->video_frames.num) {
+		size_t unique = 0;
+		for (size_t i = 0; i < c->video_frame_info.num; i++) {
+			if (!c->video_frame_info.array[i].shared)
+				unique++;
+		}
+
+		blog(LOG_INFO,
+		     "MP: Cached %zu frames (%zu unique, %.1f MB) of '%s'",
+		     c->video_frames.num, unique,
+		     (double)c->video_data_size / (1024.0 * 1024.0),
+		     c->path ? c->path : "");
+	}
+
 fail:
 	mp_media_free(m);
 	return success;
@@ -252,8 +270,12 @@ static void mp_cache_next_video(mp_cache_t *c, bool preload)
 	struct obs_source_frame *frame = &c->video_frames.array[c->next_v_idx];
 	struct obs_source_frame dup = *frame;
 
-	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
-			c->play_sys_ts - base_sys_ts;
+	if (c->render_clock && !preload)
+		dup.timestamp = mp_render_clock_ts(c->next_ns, c->next_pts_ns,
+						   (int64_t)dup.timestamp);
+	else
+		dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
+				c->play_sys_ts - base_sys_ts;
 
 	if (!preload) {
 		if (!mp_media_can_play_video(c))
@@ -291,8 +313,12 @@ static void mp_cache_next_audio(mp_cache_t *c)
 		&c->audio_segments.array[c->next_a_idx];
 	struct obs_source_audio dup = *audio;
 
-	dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
-			c->play_sys_ts - base_sys_ts;
+	if (c->render_clock)
+		dup.timestamp = mp_render_clock_ts(c->next_ns, c->next_pts_ns,
+						   (int64_t)dup.timestamp);
+	else
+		dup.timestamp = c->base_ts + dup.timestamp - c->start_ts +
+				c->play_sys_ts - base_sys_ts;
 	if (c->a_cb)
 		c->a_cb(c->opaque, &dup);
 
@@ -478,19 +504,103 @@ static void *mp_cache_thread_start(void *opaque)
 	return NULL;
 }
 
+static size_t frame_plane_size(const struct obs_source_frame *frame,
+			       const uint32_t heights[MAX_AV_PLANES], size_t i)
+{
+	return (size_t)frame->linesize[i] * (size_t)heights[i];
+}
+
+static uint64_t hash_frame(const struct obs_source_frame *frame,
+			   const uint32_t heights[MAX_AV_PLANES])
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		const uint8_t *data = frame->data[i];
+		size_t size = frame_plane_size(frame, heights, i);
+		size_t pos = 0;
+
+		if (!data)
+			continue;
+
+		for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+			uint64_t val;
+			memcpy(&val, data + pos, sizeof(val));
+			hash = (hash ^ val) * 0x100000001b3ULL;
+		}
+		for (; pos < size; pos++)
+			hash = (hash ^ data[pos]) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static bool frames_equal(const struct obs_source_frame *a,
+			 const struct obs_source_frame *b,
+			 const uint32_t heights[MAX_AV_PLANES])
+{
+	if (a->format != b->format || a->width != b->width ||
+	    a->height != b->height)
+		return false;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		size_t size = frame_plane_size(a, heights, i);
+
+		if (!a->data[i])
+			continue;
+		if (a->linesize[i] != b->linesize[i] ||
+		    memcmp(a->data[i], b->data[i], size) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/* Stingers usually start and end with runs of fully transparent frames, and
+ * often hold frames, so frames that are identical to an earlier one share
+ * its data instead of being stored again.  Playback is unaffected. */
+static void share_identical_frame(mp_cache_t *c, struct obs_source_frame *dup,
+				  struct mp_cache_frame_info *info)
+{
+	uint32_t heights[MAX_AV_PLANES] = {0};
+
+	video_frame_get_plane_heights(heights, dup->format, dup->height);
+	info->hash = hash_frame(dup, heights);
+
+	for (size_t i = 0; i < c->video_frame_info.num; i++) {
+		struct obs_source_frame *prev = &c->video_frames.array[i];
+
+		if (c->video_frame_info.array[i].shared ||
+		    c->video_frame_info.array[i].hash != info->hash ||
+		    !frames_equal(dup, prev, heights))
+			continue;
+
+		bfree(dup->data[0]);
+		memcpy(dup->data, prev->data, sizeof(dup->data));
+		info->shared = true;
+		return;
+	}
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		c->video_data_size += frame_plane_size(dup, heights, i);
+}
+
 static void fill_video(void *data, struct obs_source_frame *frame)
 {
 	mp_cache_t *c = data;
+	struct mp_cache_frame_info info = {0};
 	struct obs_source_frame dup;
 
 	obs_source_frame_init(&dup, frame->format, frame->width, frame->height);
 	obs_source_frame_copy(&dup, frame);
+	share_identical_frame(c, &dup, &info);
 
 	dup.timestamp = frame->timestamp;
 
 	c->final_v_duration = c->m.v.last_duration;
 
 	da_push_back(c->video_frames, &dup);
+	da_push_back(c->video_frame_info, &info);
 }
 
 static void fill_audio(void *data, struct obs_source_audio *audio)
@@ -553,6 +663,7 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 
 	info2.opaque = c;
 	info2.v_cb = fill_video;
+	info2.v_dmabuf_cb = NULL;
 	info2.a_cb = fill_audio;
 	info2.v_preload_cb = NULL;
 	info2.v_seek_cb = NULL;
@@ -580,6 +691,7 @@ bool mp_cache_init(mp_cache_t *c, const struct mp_media_info *info)
 	c->v_seek_cb = info->v_seek_cb;
 	c->v_preload_cb = info->v_preload_cb;
 	c->request_preload = info->request_preload;
+	c->render_clock = info->render_clock;
 	c->speed = info->speed;
 	c->media_duration = m->fmt->duration;
 
@@ -622,13 +734,15 @@ void mp_cache_free(mp_cache_t *c)
 
 	for (size_t i = 0; i < c->video_frames.num; i++) {
 		struct obs_source_frame *f = &c->video_frames.array[i];
-		obs_source_frame_free(f);
+		if (!c->video_frame_info.array[i].shared)
+			obs_source_frame_free(f);
 	}
 	for (size_t i = 0; i < c->audio_segments.num; i++) {
 		struct obs_source_audio *a = &c->audio_segments.array[i];
 		bfree((void *)a->data[0]);
 	}
 	da_free(c->video_frames);
+	da_free(c->video_frame_info);
 	da_free(c->audio_segments);
 
 	bfree(c->path);
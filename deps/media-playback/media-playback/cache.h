@@ -22,6 +22,12 @@
 
 #include "media.h"
 
+/* identical frames share the data of the first one */
+struct mp_cache_frame_info {
+	uint64_t hash;
+	bool shared;
+};
+
 struct mp_cache {
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
@@ -30,6 +36,7 @@ struct mp_cache {
 	mp_audio_cb a_cb;
 	void *opaque;
 	bool request_preload;
+	bool render_clock;
 	bool has_video;
 	bool has_audio;
 
@@ -52,6 +59,8 @@ struct mp_cache {
 	pthread_t thread;
 
 	DARRAY(struct obs_source_frame) video_frames;
+	DARRAY(struct mp_cache_frame_info) video_frame_info;
+	size_t video_data_size;
 	DARRAY(struct obs_source_audio) audio_segments;
 
 	size_t cur_v_idx;
@@ -19,6 +19,7 @@
 #include "media-playback.h"
 #include "media.h"
 #include <libavutil/mastering_display_metadata.h>
+#include <libavutil/hwcontext.h>
 
 enum AVHWDeviceType hw_priority[] = {
 	AV_HWDEVICE_TYPE_CUDA,         AV_HWDEVICE_TYPE_D3D11VA,
@@ -67,6 +68,13 @@ static void init_hw_decoder(struct mp_decode *d, AVCodecContext *c)
 		c->opaque = d;
 		d->hw_ctx = hw_ctx;
 		d->hw = true;
+
+		/* VAAPI frames can be handed to libobs as DMA-BUF planes, which
+		 * holds on to the surfaces until they're rendered */
+		if (d->hw_format == AV_PIX_FMT_VAAPI && d->m->dmabuf_frames) {
+			c->extra_hw_frames = MP_DMABUF_MAX_FRAMES;
+			d->dmabuf = true;
+		}
 	}
 }
 
@@ -337,22 +345,18 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 			return ret;
 		}
 
-		/* does not check for color format or other parameter changes which would require frame buffer realloc */
-		if (d->sw_frame->data[0] &&
-		    (d->sw_frame->width != d->hw_frame->width ||
-		     d->sw_frame->height != d->hw_frame->height)) {
-			blog(LOG_DEBUG,
-			     "MP: hardware frame size changed from %dx%d to %dx%d. reallocating frame",
-			     d->sw_frame->width, d->sw_frame->height,
-			     d->hw_frame->width, d->hw_frame->height);
-			av_frame_unref(d->sw_frame);
-		}
+		/* frames that can be imported stay in GPU memory until they're
+		 * output, see mp_media_next_video() */
+		if (d->dmabuf) {
+			d->frame = d->hw_frame;
 
-		int err = av_hwframe_transfer_data(d->sw_frame, d->hw_frame, 0);
-		if (err == 0) {
-			err = av_frame_copy_props(d->sw_frame, d->hw_frame);
+			enum AVPixelFormat format = mp_decode_frame_format(d);
+			if (format == AV_PIX_FMT_NV12 ||
+			    format == AV_PIX_FMT_P010LE)
+				return ret;
 		}
-		if (err) {
+
+		if (!mp_decode_download_frame(d)) {
 			ret = 0;
 			*got_frame = false;
 		}
@@ -362,6 +366,41 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 	return ret;
 }
 
+bool mp_decode_download_frame(struct mp_decode *d)
+{
+	/* does not check for color format or other parameter changes which would require frame buffer realloc */
+	if (d->sw_frame->data[0] &&
+	    (d->sw_frame->width != d->hw_frame->width ||
+	     d->sw_frame->height != d->hw_frame->height)) {
+		blog(LOG_DEBUG,
+		     "MP: hardware frame size changed from %dx%d to %dx%d. reallocating frame",
+		     d->sw_frame->width, d->sw_frame->height,
+		     d->hw_frame->width, d->hw_frame->height);
+		av_frame_unref(d->sw_frame);
+	}
+
+	int err = av_hwframe_transfer_data(d->sw_frame, d->hw_frame, 0);
+	if (err == 0) {
+		err = av_frame_copy_props(d->sw_frame, d->hw_frame);
+	}
+
+	d->frame = d->sw_frame;
+	return err == 0;
+}
+
+enum AVPixelFormat mp_decode_frame_format(const struct mp_decode *d)
+{
+	const AVFrame *f = d->frame;
+
+	if (d->hw && f->format == d->hw_format && f->hw_frames_ctx) {
+		const AVHWFramesContext *frames_ctx =
+			(const AVHWFramesContext *)f->hw_frames_ctx->data;
+		return frames_ctx->sw_format;
+	}
+
+	return f->format;
+}
+
 bool mp_decode_next(struct mp_decode *d)
 {
 	bool eof = d->m->eof;
@@ -60,6 +60,7 @@ struct mp_decode {
 	AVFrame *hw_frame;
 	AVFrame *frame;
 	enum AVPixelFormat hw_format;
+	bool dmabuf;
 	bool got_first_keyframe;
 	bool frame_ready;
 	bool eof;
@@ -82,6 +83,9 @@ extern void mp_decode_push_packet(struct mp_decode *decode, AVPacket *pkt);
 extern bool mp_decode_next(struct mp_decode *decode);
 extern void mp_decode_flush(struct mp_decode *decode);
 
+extern bool mp_decode_download_frame(struct mp_decode *decode);
+extern enum AVPixelFormat mp_decode_frame_format(const struct mp_decode *d);
+
 #ifdef __cplusplus
 }
 #endif
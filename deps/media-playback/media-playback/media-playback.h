@@ -22,6 +22,9 @@ struct media_playback;
 typedef struct media_playback media_playback_t;
 
 typedef void (*mp_video_cb)(void *opaque, struct obs_source_frame *frame);
+typedef bool (*mp_video_dmabuf_cb)(
+	void *opaque, struct obs_source_frame *frame,
+	const struct obs_source_frame_dmabuf *dmabuf);
 typedef void (*mp_audio_cb)(void *opaque, struct obs_source_audio *audio);
 typedef void (*mp_stop_cb)(void *opaque);
 
@@ -29,6 +32,7 @@ struct mp_media_info {
 	void *opaque;
 
 	mp_video_cb v_cb;
+	mp_video_dmabuf_cb v_dmabuf_cb;
 	mp_video_cb v_preload_cb;
 	mp_video_cb v_seek_cb;
 	mp_audio_cb a_cb;
@@ -46,6 +50,7 @@ struct mp_media_info {
 	bool reconnecting;
 	bool request_preload;
 	bool full_decode;
+	bool render_clock;
 };
 
 extern media_playback_t *
@@ -25,6 +25,12 @@
 #include <libavdevice/avdevice.h>
 #include <libavutil/imgutils.h>
 
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__DragonFly__)
+#include <libavutil/hwcontext.h>
+#include <libavutil/hwcontext_drm.h>
+#define MP_DMABUF_SUPPORTED 1
+#endif
+
 static int64_t base_sys_ts = 0;
 
 static inline enum video_format convert_pixel_format(int f)
@@ -308,8 +314,9 @@ bool mp_media_prepare_frames(mp_media_t *m)
 	}
 
 	if (m->has_video && m->v.frame_ready && !m->swscale) {
-		m->scale_format = closest_format(m->v.frame->format);
-		if (m->scale_format != m->v.frame->format) {
+		enum AVPixelFormat format = mp_decode_frame_format(&m->v);
+		m->scale_format = closest_format(format);
+		if (m->scale_format != format) {
 			if (!mp_media_init_scaling(m)) {
 				return false;
 			}
@@ -385,10 +392,14 @@ void mp_media_next_audio(mp_media_t *m)
 	audio.speakers = convert_speaker_layout(channels);
 	audio.format = convert_sample_format(f->format);
 	audio.frames = f->nb_samples;
-	audio.timestamp = m->full_decode
-				  ? d->frame_pts
-				  : m->base_ts + d->frame_pts - m->start_ts +
-					    m->play_sys_ts - base_sys_ts;
+	if (m->full_decode)
+		audio.timestamp = d->frame_pts;
+	else if (m->render_clock)
+		audio.timestamp = mp_render_clock_ts(m->next_ns, m->next_pts_ns,
+						     d->frame_pts);
+	else
+		audio.timestamp = m->base_ts + d->frame_pts - m->start_ts +
+				  m->play_sys_ts - base_sys_ts;
 
 	if (audio.format == AUDIO_FORMAT_UNKNOWN)
 		return;
@@ -396,6 +407,102 @@ void mp_media_next_audio(mp_media_t *m)
 	m->a_cb(m->opaque, &audio);
 }
 
+#ifdef MP_DMABUF_SUPPORTED
+struct mp_dmabuf_frame {
+	AVFrame *frame;
+	AVBufferRef *ref;
+};
+
+static void mp_dmabuf_frame_release(void *param)
+{
+	struct mp_dmabuf_frame *dmabuf_frame = param;
+
+	av_frame_free(&dmabuf_frame->frame);
+	av_buffer_unref(&dmabuf_frame->ref);
+	bfree(dmabuf_frame);
+}
+
+/* hands a VAAPI frame to libobs as DMA-BUF planes, without copying it */
+static bool mp_media_output_dmabuf(mp_media_t *m,
+				   struct obs_source_frame *frame, AVFrame *f)
+{
+	struct obs_source_frame_dmabuf dmabuf = {0};
+	struct mp_dmabuf_frame *dmabuf_frame;
+	const AVDRMFrameDescriptor *desc;
+	AVFrame *drm_frame;
+
+	/* the decoder only has so many extra surfaces */
+	if (av_buffer_get_ref_count(m->dmabuf_frames) > MP_DMABUF_MAX_FRAMES)
+		return false;
+
+	drm_frame = av_frame_alloc();
+	if (!drm_frame)
+		return false;
+
+	drm_frame->format = AV_PIX_FMT_DRM_PRIME;
+	if (av_hwframe_map(drm_frame, f, AV_HWFRAME_MAP_READ) < 0)
+		goto fail;
+
+	/* libobs imports each plane as its own texture */
+	desc = (const AVDRMFrameDescriptor *)drm_frame->data[0];
+	if (desc->nb_layers > MAX_AV_PLANES)
+		goto fail;
+
+	for (int i = 0; i < desc->nb_layers; i++) {
+		const AVDRMLayerDescriptor *layer = &desc->layers[i];
+		if (layer->nb_planes != 1)
+			goto fail;
+
+		const AVDRMPlaneDescriptor *plane = &layer->planes[0];
+		const AVDRMObjectDescriptor *object =
+			&desc->objects[plane->object_index];
+
+		dmabuf.fds[i] = object->fd;
+		dmabuf.drm_formats[i] = layer->format;
+		dmabuf.offsets[i] = (uint32_t)plane->offset;
+		dmabuf.strides[i] = (uint32_t)plane->pitch;
+		dmabuf.modifiers[i] = object->format_modifier;
+	}
+
+	dmabuf.num_planes = (uint32_t)desc->nb_layers;
+
+	dmabuf_frame = bmalloc(sizeof(*dmabuf_frame));
+	dmabuf_frame->frame = drm_frame;
+	dmabuf_frame->ref = av_buffer_ref(m->dmabuf_frames);
+	dmabuf.release = mp_dmabuf_frame_release;
+	dmabuf.param = dmabuf_frame;
+
+	if (!m->v_dmabuf_cb(m->opaque, frame, &dmabuf)) {
+		mp_dmabuf_frame_release(dmabuf_frame);
+		return false;
+	}
+
+	return true;
+
+fail:
+	av_frame_free(&drm_frame);
+	return false;
+}
+#else
+static bool mp_media_output_dmabuf(mp_media_t *m,
+				   struct obs_source_frame *frame, AVFrame *f)
+{
+	UNUSED_PARAMETER(m);
+	UNUSED_PARAMETER(frame);
+	UNUSED_PARAMETER(f);
+	return false;
+}
+#endif
+
+static inline void mp_media_set_frame_data(struct obs_source_frame *frame,
+					   const AVFrame *f)
+{
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i] = f->data[i];
+		frame->linesize[i] = abs(f->linesize[i]);
+	}
+}
+
 void mp_media_next_video(mp_media_t *m, bool preload)
 {
 	struct mp_decode *d = &m->v;
@@ -417,8 +524,25 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 		return;
 	}
 
+	/* the frame is still in GPU memory, preloaded frames are downloaded
+	 * because libobs keeps them in memory */
+	bool dmabuf = d->dmabuf && f == d->hw_frame &&
+		      f->format == d->hw_format;
+	if (dmabuf && preload) {
+		if (!mp_decode_download_frame(d))
+			return;
+		f = d->frame;
+		dmabuf = false;
+	}
+
 	bool flip = false;
-	if (m->swscale) {
+	if (dmabuf) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			frame->data[i] = NULL;
+			frame->linesize[i] = 0;
+		}
+
+	} else if (m->swscale) {
 		int ret = sws_scale(m->swscale, (const uint8_t *const *)f->data,
 				    f->linesize, 0, f->height, m->scale_pic,
 				    m->scale_linesizes);
@@ -433,11 +557,7 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 
 	} else {
 		flip = f->linesize[0] < 0 && f->linesize[1] == 0;
-
-		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-			frame->data[i] = f->data[i];
-			frame->linesize[i] = abs(f->linesize[i]);
-		}
+		mp_media_set_frame_data(frame, f);
 	}
 
 	if (flip)
@@ -474,10 +594,14 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 	if (frame->format == VIDEO_FORMAT_NONE)
 		return;
 
-	frame->timestamp = m->full_decode
-				   ? d->frame_pts
-				   : (m->base_ts + d->frame_pts - m->start_ts +
-				      m->play_sys_ts - base_sys_ts);
+	if (m->full_decode)
+		frame->timestamp = d->frame_pts;
+	else if (m->render_clock && !preload)
+		frame->timestamp = mp_render_clock_ts(
+			m->next_ns, m->next_pts_ns, d->frame_pts);
+	else
+		frame->timestamp = m->base_ts + d->frame_pts - m->start_ts +
+				   m->play_sys_ts - base_sys_ts;
 
 	frame->width = f->width;
 	frame->height = f->height;
@@ -521,8 +645,14 @@ void mp_media_next_video(mp_media_t *m, bool preload)
 		} else if (!m->request_preload) {
 			m->v_preload_cb(m->opaque, frame);
 		}
-	} else {
+	} else if (!dmabuf) {
 		m->v_cb(m->opaque, frame);
+	} else if (!mp_media_output_dmabuf(m, frame, f)) {
+		/* libobs can't use the frame in GPU memory right now */
+		if (mp_decode_download_frame(d)) {
+			mp_media_set_frame_data(frame, d->frame);
+			m->v_cb(m->opaque, frame);
+		}
 	}
 }
 
@@ -637,9 +767,12 @@ static inline bool mp_media_sleep(mp_media_t *m)
 		m->next_ns = os_gettime_ns();
 	} else {
 		const uint64_t t = os_gettime_ns();
-		if (m->next_ns > t) {
+		const uint64_t wake_ns =
+			m->render_clock ? m->next_ns - MP_RENDER_CLOCK_AHEAD_NS
+					  : m->next_ns;
+		if (wake_ns > t) {
 			const uint32_t delta_ms =
-				(uint32_t)((m->next_ns - t + 500000) / 1000000);
+				(uint32_t)((wake_ns - t + 500000) / 1000000);
 			if (delta_ms > 0) {
 				static const uint32_t timeout_ms = 200;
 				timeout = delta_ms > timeout_ms;
@@ -936,8 +1069,16 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	media->speed = info->speed;
 	media->request_preload = info->request_preload;
 	media->is_local_file = info->is_local_file;
+	media->render_clock = info->render_clock;
 	da_init(media->packet_pool);
 
+#ifdef MP_DMABUF_SUPPORTED
+	if (info->v_dmabuf_cb && info->hardware_decoding) {
+		media->v_dmabuf_cb = info->v_dmabuf_cb;
+		media->dmabuf_frames = av_buffer_allocz(1);
+	}
+#endif
+
 	if (!info->is_local_file || media->speed < 1 || media->speed > 200)
 		media->speed = 100;
 
@@ -988,6 +1129,7 @@ void mp_media_free(mp_media_t *media)
 	os_sem_destroy(media->sem);
 	sws_freeContext(media->swscale);
 	av_freep(&media->scale_pic[0]);
+	av_buffer_unref(&media->dmabuf_frames);
 	bfree(media->path);
 	bfree(media->format_name);
 	memset(media, 0, sizeof(*media));
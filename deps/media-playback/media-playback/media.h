@@ -45,9 +45,13 @@ struct mp_media {
 	mp_video_cb v_seek_cb;
 	mp_stop_cb stop_cb;
 	mp_video_cb v_cb;
+	mp_video_dmabuf_cb v_dmabuf_cb;
 	mp_audio_cb a_cb;
 	void *opaque;
 
+	/* one reference per frame handed to libobs as DMA-BUF planes */
+	AVBufferRef *dmabuf_frames;
+
 	char *path;
 	char *format_name;
 	char *ffmpeg_options;
@@ -83,6 +87,7 @@ struct mp_media {
 	int64_t start_ts;
 	int64_t base_ts;
 	bool full_decode;
+	bool render_clock;
 
 	uint64_t interrupt_poll_ts;
 
@@ -119,6 +124,28 @@ extern int64_t mp_media_get_frames(mp_media_t *m);
 extern int64_t mp_media_get_duration(mp_media_t *m);
 extern void mp_media_seek(mp_media_t *m, int64_t pos);
 
+/* maximum number of decoded frames libobs holds as DMA-BUF planes, the
+ * decoder allocates this many extra surfaces for them */
+#define MP_DMABUF_MAX_FRAMES 8
+
+/* In render clock mode frames are output ahead of time, timestamped with the
+ * system time they are due at, and libobs shows each one on the first render
+ * at or after its timestamp instead of pacing them a second time. */
+#define MP_RENDER_CLOCK_AHEAD_NS 50000000ULL
+
+static inline uint64_t mp_render_clock_ts(uint64_t next_ns, int64_t next_pts_ns,
+					  int64_t pts)
+{
+	/* decoded timestamps are already scaled by 100 / speed, so they
+	 * advance at the same rate as next_ns and must not be scaled again */
+	int64_t behind = next_pts_ns - pts;
+
+	/* frames after a timestamp jump are due right away */
+	if (behind < 0 || behind > 2000000000LL)
+		behind = 0;
+	return next_ns - (uint64_t)behind;
+}
+
 /* #define DETAILED_DEBUG_INFO */
 
 #ifdef __cplusplus
@@ -2912,6 +2912,27 @@ void gs_texture_unmap(gs_texture_t *tex)
 	tex2d->device->context->Unmap(tex2d->texture, 0);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+				 uint32_t linesize, uint32_t x, uint32_t y,
+				 uint32_t width, uint32_t height)
+{
+	if (tex->type != GS_TEXTURE_2D)
+		return false;
+
+	gs_texture_2d *tex2d = static_cast<gs_texture_2d *>(tex);
+
+	/* dynamic textures can only be written as a whole through Map */
+	if (tex2d->isDynamic || gs_is_compressed_format(tex2d->format))
+		return false;
+	if (x + width > tex2d->width || y + height > tex2d->height)
+		return false;
+
+	const D3D11_BOX box = {x, y, 0, x + width, y + height, 1};
+	tex2d->device->context->UpdateSubresource(tex2d->texture, 0, &box,
+						  data, linesize, 0);
+	return true;
+}
+
 void *gs_texture_get_obj(gs_texture_t *tex)
 {
 	if (tex->type != GS_TEXTURE_2D)
@@ -0,0 +1,932 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/platform.h>
+#include "null-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_OPENGL;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_OPENGL";
+}
+
+bool device_enum_adapters(gs_device_t *device,
+			  bool (*callback)(void *param, const char *name,
+					   uint32_t id),
+			  void *param)
+{
+	UNUSED_PARAMETER(device);
+
+	callback(param, "Null renderer", 0);
+	return true;
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing null renderer...");
+	blog(LOG_INFO, "Draw calls are not rasterized, render targets only "
+		       "receive clears and copies");
+
+	matrix4_identity(&device->cur_proj);
+	device->cur_cull_mode = GS_NEITHER;
+	device->cur_color_space = GS_CS_SRGB;
+
+	*p_device = device;
+	UNUSED_PARAMETER(adapter);
+	return GS_SUCCESS;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (!device)
+		return;
+
+	const struct null_stats *stats = &device->stats;
+
+	blog(LOG_INFO,
+	     "Null renderer: %llu frames, %llu draws, %llu vertices, "
+	     "%llu clears, %llu copies, %llu stages, %llu bytes uploaded",
+	     (unsigned long long)stats->frames,
+	     (unsigned long long)stats->draws,
+	     (unsigned long long)stats->vertices,
+	     (unsigned long long)stats->clears,
+	     (unsigned long long)stats->copies,
+	     (unsigned long long)stats->stages,
+	     (unsigned long long)stats->upload_bytes);
+
+	da_free(device->proj_stack);
+	bfree(device);
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void *device_get_device_obj(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+					const struct gs_init_data *data)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info = *data;
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		swapchain->device->cur_swap = NULL;
+
+	bfree(swapchain);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+void device_resize(gs_device_t *device, uint32_t x, uint32_t y)
+{
+	if (device->cur_swap) {
+		device->cur_swap->info.cx = x;
+		device->cur_swap->info.cy = y;
+	} else {
+		blog(LOG_WARNING, "device_resize (null): No active swap");
+	}
+}
+
+enum gs_color_space device_get_color_space(gs_device_t *device)
+{
+	return device->cur_color_space;
+}
+
+void device_update_color_space(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *x, uint32_t *y)
+{
+	if (device->cur_swap) {
+		*x = device->cur_swap->info.cx;
+		*y = device->cur_swap->info.cy;
+	} else {
+		*x = 0;
+		*y = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+bool device_is_present_ready(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return true;
+}
+
+void device_present(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+					    struct gs_vb_data *data,
+					    uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+
+	vb->device = device;
+	vb->data = data;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer)
+{
+	if (!vertbuffer)
+		return;
+
+	if (vertbuffer->device->cur_vertex_buffer == vertbuffer)
+		vertbuffer->device->cur_vertex_buffer = NULL;
+
+	gs_vbdata_destroy(vertbuffer->data);
+	bfree(vertbuffer);
+}
+
+static size_t vb_data_size(const struct gs_vb_data *data)
+{
+	size_t size = 0;
+
+	if (data->points)
+		size += sizeof(struct vec3);
+	if (data->normals)
+		size += sizeof(struct vec3);
+	if (data->tangents)
+		size += sizeof(struct vec3);
+	if (data->colors)
+		size += sizeof(uint32_t);
+	for (size_t i = 0; i < data->num_tex; i++)
+		size += data->tvarray[i].width * sizeof(float);
+
+	return size * data->num;
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vertbuffer,
+				  const struct gs_vb_data *data)
+{
+	if (!vertbuffer->dynamic) {
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (null): "
+				"vertex buffer is not dynamic");
+		return;
+	}
+
+	vertbuffer->device->stats.upload_bytes += vb_data_size(data);
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vertbuffer)
+{
+	gs_vertexbuffer_flush_direct(vertbuffer, vertbuffer->data);
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vertbuffer)
+{
+	return vertbuffer->data;
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+					    enum gs_index_type type,
+					    void *indices, size_t num,
+					    uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+
+	ib->device = device;
+	ib->type = type;
+	ib->indices = indices;
+	ib->num = num;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *indexbuffer)
+{
+	if (!indexbuffer)
+		return;
+
+	if (indexbuffer->device->cur_index_buffer == indexbuffer)
+		indexbuffer->device->cur_index_buffer = NULL;
+
+	bfree(indexbuffer->indices);
+	bfree(indexbuffer);
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *indexbuffer,
+				 const void *data)
+{
+	size_t width = indexbuffer->type == GS_UNSIGNED_LONG ? 4 : 2;
+
+	UNUSED_PARAMETER(data);
+	indexbuffer->device->stats.upload_bytes += width * indexbuffer->num;
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *indexbuffer)
+{
+	gs_indexbuffer_flush_direct(indexbuffer, indexbuffer->indices);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->indices;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *indexbuffer)
+{
+	return indexbuffer->type;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Timers measure the CPU time between their begin and end, which is the time
+ * the graphics thread spent recording the commands in between. */
+
+gs_timer_t *device_timer_create(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return bzalloc(sizeof(struct gs_timer));
+}
+
+gs_timer_range_t *device_timer_range_create(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+	return bzalloc(sizeof(struct gs_timer_range));
+}
+
+void gs_timer_destroy(gs_timer_t *timer)
+{
+	bfree(timer);
+}
+
+void gs_timer_begin(gs_timer_t *timer)
+{
+	timer->begin = os_gettime_ns();
+}
+
+void gs_timer_end(gs_timer_t *timer)
+{
+	timer->end = os_gettime_ns();
+}
+
+bool gs_timer_get_data(gs_timer_t *timer, uint64_t *ticks)
+{
+	if (timer->end < timer->begin)
+		return false;
+
+	*ticks = timer->end - timer->begin;
+	return true;
+}
+
+void gs_timer_range_destroy(gs_timer_range_t *range)
+{
+	bfree(range);
+}
+
+void gs_timer_range_begin(gs_timer_range_t *range)
+{
+	range->begin = os_gettime_ns();
+}
+
+void gs_timer_range_end(gs_timer_range_t *range)
+{
+	UNUSED_PARAMETER(range);
+}
+
+bool gs_timer_range_get_data(gs_timer_range_t *range, bool *disjoint,
+			     uint64_t *frequency)
+{
+	UNUSED_PARAMETER(range);
+
+	*disjoint = false;
+	*frequency = 1000000000;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vertbuffer)
+{
+	device->cur_vertex_buffer = vertbuffer;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *indexbuffer)
+{
+	device->cur_index_buffer = indexbuffer;
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_textures[unit] = tex;
+}
+
+void device_load_texture_srgb(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	device_load_texture(device, tex, unit);
+}
+
+void device_load_samplerstate(gs_device_t *device,
+			      gs_samplerstate_t *samplerstate, int unit)
+{
+	if (unit >= 0 && unit < GS_MAX_TEXTURES)
+		device->cur_samplers[unit] = samplerstate;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "device_load_vertexshader (null): "
+				"Specified shader is not a vertex shader");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "device_load_pixelshader (null): "
+				"Specified shader is not a pixel shader");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d, int unit)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(b_3d);
+	UNUSED_PARAMETER(unit);
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil;
+}
+
+void device_set_render_target_with_color_space(gs_device_t *device,
+					       gs_texture_t *tex,
+					       gs_zstencil_t *zstencil,
+					       enum gs_color_space space)
+{
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "device_set_render_target (null): "
+					"Texture is not a 2D texture");
+			return;
+		}
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "device_set_render_target (null): "
+					"Texture is not a render target");
+			return;
+		}
+	}
+
+	device->cur_render_target = tex;
+	device->cur_render_side = 0;
+	device->cur_zstencil = zstencil;
+	device->cur_color_space = space;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+			      gs_zstencil_t *zstencil)
+{
+	device_set_render_target_with_color_space(device, tex, zstencil,
+						  GS_CS_SRGB);
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+				   int side, gs_zstencil_t *zstencil)
+{
+	if (cubetex) {
+		if (cubetex->type != GS_TEXTURE_CUBE) {
+			blog(LOG_ERROR, "device_set_cube_render_target (null): "
+					"Texture is not a cube texture");
+			return;
+		}
+		if (!cubetex->is_render_target) {
+			blog(LOG_ERROR, "device_set_cube_render_target (null): "
+					"Texture is not a render target");
+			return;
+		}
+	}
+
+	device->cur_render_target = cubetex;
+	device->cur_render_side = side;
+	device->cur_zstencil = zstencil;
+	device->cur_color_space = GS_CS_SRGB;
+}
+
+void device_enable_framebuffer_srgb(gs_device_t *device, bool enable)
+{
+	device->framebuffer_srgb = enable;
+}
+
+bool device_framebuffer_srgb_enabled(gs_device_t *device)
+{
+	return device->framebuffer_srgb;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_begin_frame(gs_device_t *device)
+{
+	device->stats.frames++;
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+static inline bool can_render(const gs_device_t *device, uint32_t num_verts)
+{
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		return false;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	if (!device->cur_vertex_buffer && (num_verts == 0)) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		return false;
+	}
+
+	if (!device->cur_swap && !device->cur_render_target) {
+		blog(LOG_ERROR, "No active swap chain or render target");
+		return false;
+	}
+
+	return true;
+}
+
+static void update_viewproj_matrix(struct gs_device *device)
+{
+	struct gs_shader *vs = device->cur_vertex_shader;
+	struct matrix4 cur_view;
+	struct matrix4 viewproj;
+
+	gs_matrix_get(&cur_view);
+	matrix4_mul(&viewproj, &cur_view, &device->cur_proj);
+	matrix4_transpose(&viewproj, &viewproj);
+
+	if (vs->viewproj)
+		gs_shader_set_matrix4(vs->viewproj, &viewproj);
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		 uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_vertex_buffer *vb = device->cur_vertex_buffer;
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+	gs_effect_t *effect = gs_get_effect();
+
+	if (!can_render(device, num_verts)) {
+		blog(LOG_ERROR, "device_draw (null) failed");
+		return;
+	}
+
+	if (effect)
+		gs_effect_update_params(effect);
+
+	update_viewproj_matrix(device);
+
+	if (!num_verts) {
+		if (ib)
+			num_verts = (uint32_t)ib->num;
+		else if (vb && vb->data)
+			num_verts = (uint32_t)vb->data->num;
+	}
+
+	device->stats.draws++;
+	device->stats.vertices += num_verts;
+
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		  const struct vec4 *color, float depth, uint8_t stencil)
+{
+	gs_texture_t *target = device->cur_render_target;
+
+	if ((clear_flags & GS_CLEAR_COLOR) && target &&
+	    target->type == GS_TEXTURE_2D)
+		null_fill_texture(target,
+				  device->scissor_enabled ? &device->cur_scissor
+							  : NULL,
+				  color);
+
+	device->stats.clears++;
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green, bool blue,
+			 bool alpha)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(red);
+	UNUSED_PARAMETER(green);
+	UNUSED_PARAMETER(blue);
+	UNUSED_PARAMETER(alpha);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+			   enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+				    enum gs_blend_type src_c,
+				    enum gs_blend_type dest_c,
+				    enum gs_blend_type src_a,
+				    enum gs_blend_type dest_a)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src_c);
+	UNUSED_PARAMETER(dest_c);
+	UNUSED_PARAMETER(src_a);
+	UNUSED_PARAMETER(dest_a);
+}
+
+void device_blend_op(gs_device_t *device, enum gs_blend_op_type op)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(op);
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+			     enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		       enum gs_stencil_op_type fail,
+		       enum gs_stencil_op_type zfail,
+		       enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+			 int height)
+{
+	device->cur_viewport.x = x;
+	device->cur_viewport.y = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	device->scissor_enabled = rect != NULL;
+	if (rect)
+		device->cur_scissor = *rect;
+}
+
+void device_ortho(gs_device_t *device, float left, float right, float top,
+		  float bottom, float znear, float zfar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float bmt = bottom - top;
+	float fmn = zfar - znear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = 2.0f / rml;
+	dst->t.x = (left + right) / -rml;
+
+	dst->y.y = 2.0f / -bmt;
+	dst->t.y = (bottom + top) / bmt;
+
+	dst->z.z = -2.0f / fmn;
+	dst->t.z = (zfar + znear) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right, float top,
+		    float bottom, float znear, float zfar)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right - left;
+	float tmb = top - bottom;
+	float nmf = znear - zfar;
+	float nearx2 = 2.0f * znear;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x = nearx2 / rml;
+	dst->z.x = (left + right) / rml;
+
+	dst->y.y = nearx2 / tmb;
+	dst->z.y = (bottom + top) / tmb;
+
+	dst->z.z = (zfar + znear) / nmf;
+	dst->t.z = 2.0f * (znear * zfar) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+void device_debug_marker_begin(gs_device_t *device, const char *markername,
+			       const float color[4])
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(markername);
+	UNUSED_PARAMETER(color);
+}
+
+void device_debug_marker_end(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+bool device_is_monitor_hdr(gs_device_t *device, void *monitor)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(monitor);
+	return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* platform resources cannot be imported without a GPU */
+
+#ifdef __APPLE__
+bool device_shared_texture_available(void)
+{
+	return false;
+}
+
+gs_texture_t *device_texture_create_from_iosurface(gs_device_t *device,
+						   void *iosurf)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(iosurf);
+	return NULL;
+}
+
+gs_texture_t *device_texture_open_shared(gs_device_t *device, uint32_t handle)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(handle);
+	return NULL;
+}
+
+bool gs_texture_rebind_iosurface(gs_texture_t *texture, void *iosurf)
+{
+	UNUSED_PARAMETER(texture);
+	UNUSED_PARAMETER(iosurf);
+	return false;
+}
+
+#elif _WIN32
+bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+bool device_shared_texture_available(void)
+{
+	return false;
+}
+
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__DragonFly__)
+gs_texture_t *device_texture_create_from_dmabuf(
+	gs_device_t *device, unsigned int width, unsigned int height,
+	uint32_t drm_format, enum gs_color_format color_format,
+	uint32_t n_planes, const int *fds, const uint32_t *strides,
+	const uint32_t *offsets, const uint64_t *modifiers)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(drm_format);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(n_planes);
+	UNUSED_PARAMETER(fds);
+	UNUSED_PARAMETER(strides);
+	UNUSED_PARAMETER(offsets);
+	UNUSED_PARAMETER(modifiers);
+	return NULL;
+}
+
+bool device_query_dmabuf_capabilities(gs_device_t *device,
+				      enum gs_dmabuf_flags *dmabuf_flags,
+				      uint32_t **drm_formats, size_t *n_formats)
+{
+	UNUSED_PARAMETER(device);
+
+	*dmabuf_flags = GS_DMABUF_FLAG_NONE;
+	*drm_formats = NULL;
+	*n_formats = 0;
+	return false;
+}
+
+bool device_query_dmabuf_modifiers_for_format(gs_device_t *device,
+					      uint32_t drm_format,
+					      uint64_t **modifiers,
+					      size_t *n_modifiers)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(drm_format);
+
+	*modifiers = NULL;
+	*n_modifiers = 0;
+	return false;
+}
+
+gs_texture_t *device_texture_create_from_pixmap(
+	gs_device_t *device, uint32_t width, uint32_t height,
+	enum gs_color_format color_format, uint32_t target, void *pixmap)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(target);
+	UNUSED_PARAMETER(pixmap);
+	return NULL;
+}
+#endif
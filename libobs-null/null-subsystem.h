@@ -0,0 +1,176 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+/*
+ * Null renderer
+ *
+ * A graphics module that needs neither a GPU nor a display.  Resources live
+ * in system memory, clears and copies are carried out on the CPU, and draw
+ * calls are validated and counted but not rasterized.  Everything libobs and
+ * its sources do on the graphics thread still runs, so the render path can
+ * be profiled and tested on machines without a GPU, and the contents of
+ * render targets are deterministic.
+ *
+ * Towards libobs and effect files it presents itself as the OpenGL renderer,
+ * so the same effect code paths are parsed and set up.
+ */
+
+#include <util/darray.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+
+struct null_stats {
+	uint64_t frames;
+	uint64_t draws;
+	uint64_t vertices;
+	uint64_t clears;
+	uint64_t copies;
+	uint64_t stages;
+	uint64_t upload_bytes;
+};
+
+struct gs_texture {
+	gs_device_t *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth; /* slices of volume textures, faces of cube textures */
+	uint32_t levels;
+	uint32_t linesize;
+	bool is_dynamic;
+	bool is_render_target;
+
+	/* only the first mip level is kept */
+	uint8_t *data;
+};
+
+struct gs_stage_surface {
+	gs_device_t *device;
+	enum gs_color_format format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t linesize;
+	uint8_t *data;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t *device;
+	enum gs_zstencil_format format;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct gs_sampler_state {
+	gs_device_t *device;
+	struct gs_sampler_info info;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t *device;
+	struct gs_vb_data *data;
+	bool dynamic;
+};
+
+struct gs_index_buffer {
+	gs_device_t *device;
+	enum gs_index_type type;
+	void *indices;
+	size_t num;
+	bool dynamic;
+};
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char *name;
+	gs_shader_t *shader;
+	gs_samplerstate_t *next_sampler;
+	int array_count;
+
+	struct gs_texture *texture;
+
+	DARRAY(uint8_t) cur_value;
+	DARRAY(uint8_t) def_value;
+};
+
+struct gs_shader {
+	gs_device_t *device;
+	enum gs_shader_type type;
+
+	struct gs_shader_param *viewproj;
+	struct gs_shader_param *world;
+
+	DARRAY(struct gs_shader_param) params;
+	DARRAY(gs_samplerstate_t *) samplers;
+};
+
+struct gs_swap_chain {
+	gs_device_t *device;
+	struct gs_init_data info;
+};
+
+struct gs_timer {
+	uint64_t begin;
+	uint64_t end;
+};
+
+struct gs_timer_range {
+	uint64_t begin;
+};
+
+struct gs_device {
+	struct gs_swap_chain *cur_swap;
+
+	gs_texture_t *cur_render_target;
+	gs_zstencil_t *cur_zstencil;
+	enum gs_color_space cur_color_space;
+	int cur_render_side;
+	bool framebuffer_srgb;
+
+	gs_texture_t *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t *cur_vertex_buffer;
+	gs_indexbuffer_t *cur_index_buffer;
+	gs_shader_t *cur_vertex_shader;
+	gs_shader_t *cur_pixel_shader;
+
+	enum gs_cull_mode cur_cull_mode;
+	struct gs_rect cur_viewport;
+	struct gs_rect cur_scissor;
+	bool scissor_enabled;
+
+	struct matrix4 cur_proj;
+	DARRAY(struct matrix4) proj_stack;
+
+	struct null_stats stats;
+};
+
+static inline uint32_t null_linesize(enum gs_color_format format,
+				     uint32_t width)
+{
+	return (width * gs_get_format_bpp(format) + 7) / 8;
+}
+
+extern void null_fill_texture(gs_texture_t *tex, const struct gs_rect *rect,
+			      const struct vec4 *color);
+extern void null_copy_rect(uint8_t *dst, uint32_t dst_linesize,
+			   const uint8_t *src, uint32_t src_linesize,
+			   uint32_t row_size, uint32_t rows);
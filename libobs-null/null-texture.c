@@ -0,0 +1,570 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include "null-subsystem.h"
+
+void null_copy_rect(uint8_t *dst, uint32_t dst_linesize, const uint8_t *src,
+		    uint32_t src_linesize, uint32_t row_size, uint32_t rows)
+{
+	if (dst_linesize == src_linesize && row_size == src_linesize) {
+		memcpy(dst, src, (size_t)row_size * rows);
+		return;
+	}
+
+	for (uint32_t y = 0; y < rows; y++) {
+		memcpy(dst, src, row_size);
+		dst += dst_linesize;
+		src += src_linesize;
+	}
+}
+
+static inline float saturate(float val)
+{
+	return val < 0.0f ? 0.0f : (val > 1.0f ? 1.0f : val);
+}
+
+static inline uint8_t unorm8(float val)
+{
+	return (uint8_t)lrintf(saturate(val) * 255.0f);
+}
+
+static inline uint16_t unorm16(float val)
+{
+	return (uint16_t)lrintf(saturate(val) * 65535.0f);
+}
+
+static uint16_t half_from_float(float val)
+{
+	union {
+		float f;
+		uint32_t u;
+	} in = {val};
+
+	uint32_t sign = (in.u >> 16) & 0x8000;
+	int32_t exp = (int32_t)((in.u >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = in.u & 0x7fffff;
+
+	if (exp <= 0)
+		return (uint16_t)sign;
+	if (exp >= 31)
+		return (uint16_t)(sign | 0x7c00);
+
+	return (uint16_t)(sign | ((uint32_t)exp << 10) | (mantissa >> 13));
+}
+
+/* Converts a color to one pixel of the format, returns its size in bytes or
+ * 0 if the format is block compressed */
+static size_t pack_color(enum gs_color_format format, const struct vec4 *color,
+			 uint8_t *out)
+{
+	const float *c = color->ptr;
+	uint16_t *out16 = (uint16_t *)out;
+	uint32_t packed;
+
+	switch (format) {
+	case GS_A8:
+		out[0] = unorm8(c[3]);
+		return 1;
+	case GS_R8:
+		out[0] = unorm8(c[0]);
+		return 1;
+	case GS_R8G8:
+		out[0] = unorm8(c[0]);
+		out[1] = unorm8(c[1]);
+		return 2;
+	case GS_RGBA:
+	case GS_RGBA_UNORM:
+		for (size_t i = 0; i < 4; i++)
+			out[i] = unorm8(c[i]);
+		return 4;
+	case GS_BGRX:
+	case GS_BGRA:
+	case GS_BGRX_UNORM:
+	case GS_BGRA_UNORM:
+		out[0] = unorm8(c[2]);
+		out[1] = unorm8(c[1]);
+		out[2] = unorm8(c[0]);
+		out[3] = unorm8(c[3]);
+		return 4;
+	case GS_R10G10B10A2:
+		packed = (uint32_t)lrintf(saturate(c[0]) * 1023.0f) |
+			 ((uint32_t)lrintf(saturate(c[1]) * 1023.0f) << 10) |
+			 ((uint32_t)lrintf(saturate(c[2]) * 1023.0f) << 20) |
+			 ((uint32_t)lrintf(saturate(c[3]) * 3.0f) << 30);
+		memcpy(out, &packed, sizeof(packed));
+		return 4;
+	case GS_R16:
+		out16[0] = unorm16(c[0]);
+		return 2;
+	case GS_RG16:
+		out16[0] = unorm16(c[0]);
+		out16[1] = unorm16(c[1]);
+		return 4;
+	case GS_RGBA16:
+		for (size_t i = 0; i < 4; i++)
+			out16[i] = unorm16(c[i]);
+		return 8;
+	case GS_R16F:
+		out16[0] = half_from_float(c[0]);
+		return 2;
+	case GS_RG16F:
+		out16[0] = half_from_float(c[0]);
+		out16[1] = half_from_float(c[1]);
+		return 4;
+	case GS_RGBA16F:
+		for (size_t i = 0; i < 4; i++)
+			out16[i] = half_from_float(c[i]);
+		return 8;
+	case GS_R32F:
+		memcpy(out, c, sizeof(float));
+		return 4;
+	case GS_RG32F:
+		memcpy(out, c, sizeof(float) * 2);
+		return 8;
+	case GS_RGBA32F:
+		memcpy(out, c, sizeof(float) * 4);
+		return 16;
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		break;
+	}
+
+	return 0;
+}
+
+void null_fill_texture(gs_texture_t *tex, const struct gs_rect *rect,
+		       const struct vec4 *color)
+{
+	uint8_t pixel[16];
+	size_t pixel_size = pack_color(tex->format, color, pixel);
+	int x0 = rect ? rect->x : 0;
+	int y0 = rect ? rect->y : 0;
+	int x1 = rect ? rect->x + rect->cx : (int)tex->width;
+	int y1 = rect ? rect->y + rect->cy : (int)tex->height;
+
+	if (!pixel_size || !tex->data)
+		return;
+
+	if (x0 < 0)
+		x0 = 0;
+	if (y0 < 0)
+		y0 = 0;
+	if (x1 > (int)tex->width)
+		x1 = (int)tex->width;
+	if (y1 > (int)tex->height)
+		y1 = (int)tex->height;
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	uint8_t *first = tex->data + (size_t)y0 * tex->linesize +
+			 (size_t)x0 * pixel_size;
+	size_t row_size = (size_t)(x1 - x0) * pixel_size;
+
+	for (size_t pos = 0; pos < row_size; pos += pixel_size)
+		memcpy(first + pos, pixel, pixel_size);
+	for (int y = y0 + 1; y < y1; y++)
+		memcpy(first + (size_t)(y - y0) * tex->linesize, first,
+		       row_size);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static gs_texture_t *texture_create(gs_device_t *device,
+				    enum gs_texture_type type, uint32_t width,
+				    uint32_t height, uint32_t depth,
+				    enum gs_color_format color_format,
+				    uint32_t levels, const uint8_t *const *data,
+				    uint32_t flags)
+{
+	struct gs_texture *tex = bzalloc(sizeof(struct gs_texture));
+	size_t slice_size;
+
+	tex->device = device;
+	tex->type = type;
+	tex->format = color_format;
+	tex->width = width;
+	tex->height = height;
+	tex->depth = depth;
+	tex->levels = levels;
+	tex->linesize = null_linesize(color_format, width);
+	tex->is_dynamic = (flags & GS_DYNAMIC) != 0;
+	tex->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+
+	if (!tex->levels)
+		tex->levels = gs_get_total_levels(width, height, depth);
+
+	slice_size = (size_t)tex->linesize * height;
+	tex->data = bzalloc(slice_size * depth);
+
+	if (data && type == GS_TEXTURE_CUBE) {
+		/* the levels of each face follow each other */
+		for (uint32_t i = 0; i < depth; i++) {
+			const uint8_t *face = data[i * tex->levels];
+			if (face)
+				memcpy(tex->data + slice_size * i, face,
+				       slice_size);
+		}
+	} else if (data && data[0]) {
+		/* the first level of volume textures holds all slices */
+		memcpy(tex->data, data[0], slice_size * depth);
+	}
+
+	if (data)
+		device->stats.upload_bytes += slice_size * depth;
+
+	return tex;
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+				    uint32_t height,
+				    enum gs_color_format color_format,
+				    uint32_t levels, const uint8_t **data,
+				    uint32_t flags)
+{
+	return texture_create(device, GS_TEXTURE_2D, width, height, 1,
+			      color_format, levels, data, flags);
+}
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+					enum gs_color_format color_format,
+					uint32_t levels, const uint8_t **data,
+					uint32_t flags)
+{
+	return texture_create(device, GS_TEXTURE_CUBE, size, size, 6,
+			      color_format, levels, data, flags);
+}
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+				       uint32_t height, uint32_t depth,
+				       enum gs_color_format color_format,
+				       uint32_t levels,
+				       const uint8_t *const *data,
+				       uint32_t flags)
+{
+	return texture_create(device, GS_TEXTURE_3D, width, height, depth,
+			      color_format, levels, data, flags);
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	if (!tex)
+		return;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (tex->device->cur_textures[i] == tex)
+			tex->device->cur_textures[i] = NULL;
+	}
+	if (tex->device->cur_render_target == tex)
+		tex->device->cur_render_target = NULL;
+
+	bfree(tex->data);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	if (!tex->is_dynamic) {
+		blog(LOG_ERROR,
+		     "gs_texture_map (null): texture is not dynamic");
+		return false;
+	}
+
+	*ptr = tex->data;
+	*linesize = tex->linesize;
+	return true;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	tex->device->stats.upload_bytes += (size_t)tex->linesize * tex->height;
+}
+
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+				 uint32_t linesize, uint32_t x, uint32_t y,
+				 uint32_t width, uint32_t height)
+{
+	if (tex->type != GS_TEXTURE_2D || gs_is_compressed_format(tex->format))
+		return false;
+
+	if (x + width > tex->width || y + height > tex->height) {
+		blog(LOG_ERROR, "gs_texture_set_image_region (null): "
+				"region out of bounds");
+		return false;
+	}
+
+	uint32_t bpp = gs_get_format_bpp(tex->format);
+	uint32_t row_size = null_linesize(tex->format, width);
+
+	null_copy_rect(tex->data + (size_t)y * tex->linesize +
+			       (size_t)x * bpp / 8,
+		       tex->linesize, data, linesize, row_size, height);
+
+	tex->device->stats.upload_bytes += (size_t)row_size * height;
+	return true;
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	return tex->data;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *cubetex)
+{
+	gs_texture_destroy(cubetex);
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	return cubetex->width;
+}
+
+enum gs_color_format
+gs_cubetexture_get_color_format(const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	gs_texture_destroy(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	return voltex->width;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	return voltex->height;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	return voltex->depth;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	return voltex->format;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+					   uint32_t height,
+					   enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf = bzalloc(sizeof(*surf));
+
+	surf->device = device;
+	surf->format = color_format;
+	surf->width = width;
+	surf->height = height;
+	surf->linesize = null_linesize(color_format, width);
+	surf->data = bzalloc((size_t)surf->linesize * height);
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (stagesurf) {
+		bfree(stagesurf->data);
+		bfree(stagesurf);
+	}
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format
+gs_stagesurface_get_color_format(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+			 uint32_t *linesize)
+{
+	*data = stagesurf->data;
+	*linesize = stagesurf->linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void device_copy_texture_region(gs_device_t *device, gs_texture_t *dst,
+				uint32_t dst_x, uint32_t dst_y,
+				gs_texture_t *src, uint32_t src_x,
+				uint32_t src_y, uint32_t src_w, uint32_t src_h)
+{
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"NULL source or destination");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || dst->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"only 2D textures can be copied");
+		return;
+	}
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"source and destination formats do not match");
+		return;
+	}
+
+	uint32_t copy_w = src_w ? src_w : src->width - src_x;
+	uint32_t copy_h = src_h ? src_h : src->height - src_y;
+
+	if (src_x + copy_w > src->width || src_y + copy_h > src->height ||
+	    dst_x + copy_w > dst->width || dst_y + copy_h > dst->height) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+				"region out of bounds");
+		return;
+	}
+
+	uint32_t bpp = gs_get_format_bpp(src->format);
+
+	null_copy_rect(dst->data + (size_t)dst_y * dst->linesize +
+			       (size_t)dst_x * bpp / 8,
+		       dst->linesize,
+		       src->data + (size_t)src_y * src->linesize +
+			       (size_t)src_x * bpp / 8,
+		       src->linesize, null_linesize(src->format, copy_w),
+		       copy_h);
+
+	device->stats.copies++;
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+			 gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+			  gs_texture_t *src)
+{
+	if (!src || !dst) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+				"NULL source or destination");
+		return;
+	}
+	if (src->type != GS_TEXTURE_2D || src->format != dst->format ||
+	    src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+				"source and destination do not match");
+		return;
+	}
+
+	null_copy_rect(dst->data, dst->linesize, src->data, src->linesize,
+		       src->linesize, src->height);
+
+	device->stats.stages++;
+}
+
+/* ------------------------------------------------------------------------- */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+				      uint32_t height,
+				      enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs = bzalloc(sizeof(*zs));
+
+	zs->device = device;
+	zs->format = format;
+	zs->width = width;
+	zs->height = height;
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zstencil)
+{
+	if (!zstencil)
+		return;
+
+	if (zstencil->device->cur_zstencil == zstencil)
+		zstencil->device->cur_zstencil = NULL;
+
+	bfree(zstencil);
+}
+
+gs_samplerstate_t *
+device_samplerstate_create(gs_device_t *device,
+			   const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler = bzalloc(sizeof(*sampler));
+
+	sampler->device = device;
+	sampler->info = *info;
+	return sampler;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	if (!samplerstate)
+		return;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (samplerstate->device->cur_samplers[i] == samplerstate)
+			samplerstate->device->cur_samplers[i] = NULL;
+	}
+
+	bfree(samplerstate);
+}
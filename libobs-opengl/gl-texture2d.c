@@ -249,6 +249,42 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+				 uint32_t linesize, uint32_t x, uint32_t y,
+				 uint32_t width, uint32_t height)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d *)tex;
+	uint32_t pixel_size;
+	bool success;
+
+	if (!is_texture_2d(tex, "gs_texture_set_image_region"))
+		return false;
+	if (gs_is_compressed_format(tex->format))
+		return false;
+
+	pixel_size = gs_get_format_bpp(tex->format) / 8;
+	if (x + width > tex2d->width || y + height > tex2d->height ||
+	    linesize % pixel_size != 0)
+		return false;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0))
+		return false;
+	if (!gl_bind_texture(tex->gl_target, tex->texture))
+		return false;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / pixel_size);
+	glTexSubImage2D(tex->gl_target, 0, x, y, width, height, tex->gl_format,
+			tex->gl_type, data);
+	success = gl_success("glTexSubImage2D");
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	gl_bind_texture(tex->gl_target, 0);
+
+	if (!success)
+		blog(LOG_ERROR, "gs_texture_set_image_region (GL) failed");
+	return success;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	if (tex->type == GS_TEXTURE_3D)
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string.h>
+#include "util/bmem.h"
+#include "util/threading.h"
+#include "util/sse-intrin.h"
+
+/* Monitored audio is handed from the source's audio capture callback to the
+ * stream through a single producer, single consumer ring.  The ring holds
+ * whole audio frames only: it wraps at a multiple of the frame size, and
+ * one frame stays unused to tell a full ring from an empty one, so reads
+ * never split a sample at the wrap point. */
+struct monitor_ring {
+	uint8_t *data;
+	size_t capacity;
+	size_t frame_size;
+	volatile long read_pos;
+	volatile long write_pos;
+
+	size_t peak;
+	uint_fast32_t dropped;
+};
+
+static inline void mix_float(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 sum = _mm_add_ps(_mm_loadu_ps(dst + i),
+					_mm_loadu_ps(src + i));
+		_mm_storeu_ps(dst + i, sum);
+	}
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+static inline void ring_init(struct monitor_ring *ring, size_t frames,
+			     size_t frame_size)
+{
+	ring->capacity = (frames + 1) * frame_size;
+	ring->frame_size = frame_size;
+	ring->data = bmalloc(ring->capacity);
+	ring->read_pos = 0;
+	ring->write_pos = 0;
+	ring->peak = 0;
+	ring->dropped = 0;
+}
+
+static inline void ring_free(struct monitor_ring *ring)
+{
+	bfree(ring->data);
+	ring->data = NULL;
+}
+
+static inline size_t ring_size(struct monitor_ring *ring)
+{
+	size_t r = (size_t)os_atomic_load_long(&ring->read_pos);
+	size_t w = (size_t)os_atomic_load_long(&ring->write_pos);
+	return w >= r ? w - r : ring->capacity - r + w;
+}
+
+/* producer side, bytes must be a multiple of the frame size */
+static inline bool ring_write(struct monitor_ring *ring, const uint8_t *src,
+			      size_t bytes)
+{
+	size_t size = ring_size(ring);
+	if (size + bytes >= ring->capacity) {
+		ring->dropped++;
+		return false;
+	}
+
+	size_t w = (size_t)os_atomic_load_long(&ring->write_pos);
+	size_t first = ring->capacity - w;
+	if (first > bytes)
+		first = bytes;
+
+	memcpy(ring->data + w, src, first);
+	memcpy(ring->data, src + first, bytes - first);
+
+	w = (w + bytes) % ring->capacity;
+	os_atomic_set_long(&ring->write_pos, (long)w);
+
+	if (size + bytes > ring->peak)
+		ring->peak = size + bytes;
+	return true;
+}
+
+/* consumer side, copies out or mixes float samples into dst.  bytes must
+ * be a multiple of the frame size. */
+static inline void ring_read(struct monitor_ring *ring, uint8_t *dst,
+			     size_t bytes, bool mix)
+{
+	size_t r = (size_t)os_atomic_load_long(&ring->read_pos);
+	size_t first = ring->capacity - r;
+	if (first > bytes)
+		first = bytes;
+
+	if (mix) {
+		mix_float((float *)dst, (const float *)(ring->data + r),
+			  first / sizeof(float));
+		mix_float((float *)(dst + first), (const float *)ring->data,
+			  (bytes - first) / sizeof(float));
+	} else {
+		memcpy(dst, ring->data + r, first);
+		memcpy(dst + first, ring->data, bytes - first);
+	}
+
+	r = (r + bytes) % ring->capacity;
+	os_atomic_set_long(&ring->read_pos, (long)r);
+}
@@ -1,9 +1,15 @@
 #include "obs-internal.h"
+#include "util/util_uint64.h"
 #include "pulseaudio-wrapper.h"
+#include "monitor-ring.h"
 
 #define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
 
+/* The capture callback only fills the monitor's ring and wakes the writer
+ * thread, which drains the rings of all monitors into their streams with
+ * the pulse mainloop lock held, so the audio thread never waits on the
+ * mainloop. */
 struct audio_monitor {
 	obs_source_t *source;
 	pa_stream *stream;
@@ -18,13 +24,51 @@ struct audio_monitor {
 	uint_fast32_t packets;
 	uint_fast64_t frames;
 
-	struct deque new_data;
+	struct monitor_ring ring;
 	audio_resampler_t *resampler;
 
 	bool ignore;
+	bool on_bus;
+	bool writing;
 	pthread_mutex_t playback_mutex;
 };
 
+/* With the monitoring bus enabled, all monitors share one stream and their
+ * audio is mixed once before being written to it.  Protected by the pulse
+ * mainloop lock. */
+struct monitor_bus {
+	pa_stream *stream;
+	char *device;
+	pa_buffer_attr attr;
+	pa_sample_spec spec;
+	uint_fast32_t bytes_per_frame;
+	long refs;
+
+	DARRAY(struct audio_monitor *) monitors;
+	float *mix;
+	size_t mix_size;
+};
+
+static struct monitor_bus bus = {0};
+static pthread_mutex_t bus_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Writes the buffered audio of all monitors out to pulse.  The list of
+ * monitors is protected by the pulse mainloop lock, the thread itself by
+ * writer_mutex. */
+struct monitor_writer {
+	pthread_t thread;
+	os_event_t *event;
+	volatile bool stop;
+	long refs;
+
+	DARRAY(struct audio_monitor *) monitors;
+};
+
+static struct monitor_writer writer = {0};
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* ------------------------------------------------------------------------- */
+
 static enum speaker_layout
 pulseaudio_channels_to_obs_speakers(uint_fast32_t channels)
 {
@@ -135,6 +179,17 @@ static void process_s16(void *p, size_t frames, size_t channels, float vol)
 {
 	register int16_t *cur = (int16_t *)p;
 	register int16_t *end = cur + frames * channels;
+	const __m128 vol_ps = _mm_set1_ps(vol);
+
+	for (; cur + 8 <= end; cur += 8) {
+		__m128i in = _mm_loadu_si128((const __m128i *)cur);
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16);
+
+		lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), vol_ps));
+		hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), vol_ps));
+		_mm_storeu_si128((__m128i *)cur, _mm_packs_epi32(lo, hi));
+	}
 
 	while (cur < end)
 		*(cur++) *= vol;
@@ -153,6 +208,10 @@ static void process_float(void *p, size_t frames, size_t channels, float vol)
 {
 	register float *cur = (float *)p;
 	register float *end = cur + frames * channels;
+	const __m128 vol_ps = _mm_set1_ps(vol);
+
+	for (; cur + 4 <= end; cur += 4)
+		_mm_storeu_ps(cur, _mm_mul_ps(_mm_loadu_ps(cur), vol_ps));
 
 	while (cur < end)
 		*(cur++) *= vol;
@@ -184,56 +243,206 @@ void process_volume(const struct audio_monitor *monitor, float vol,
 	}
 }
 
-static void do_stream_write(void *param)
+/* called with the pulse mainloop lock held */
+static void stream_write(struct audio_monitor *data)
 {
-	PULSE_DATA(param);
 	uint8_t *buffer = NULL;
-
-	pulseaudio_lock();
-	pthread_mutex_lock(&data->playback_mutex);
+	size_t size = ring_size(&data->ring);
 
 	// If we have grown a large buffer internally, grow the pulse buffer to match so we can write our data out.
-	if (data->new_data.size > data->attr.tlength * 2) {
+	if (size > data->attr.tlength * 2) {
 		data->attr.fragsize = (uint32_t)-1;
 		data->attr.maxlength = (uint32_t)-1;
 		data->attr.prebuf = (uint32_t)-1;
 		data->attr.minreq = (uint32_t)-1;
-		data->attr.tlength = data->new_data.size;
+		data->attr.tlength = (uint32_t)size;
 		pa_stream_set_buffer_attr(data->stream, &data->attr, NULL,
 					  NULL);
 	}
 
 	// Buffer up enough data before we start playing.
 	if (pa_stream_is_corked(data->stream)) {
-		if (data->new_data.size >= data->attr.tlength) {
+		if (size >= data->attr.tlength) {
 			pa_stream_cork(data->stream, 0, NULL, NULL);
 		} else {
-			goto finish;
+			return;
 		}
 	}
 
-	while (data->new_data.size > 0) {
-		size_t bytesToFill = data->new_data.size;
+	while (size > 0) {
+		size_t bytesToFill = size;
 		if (pa_stream_begin_write(data->stream, (void **)&buffer,
 					  &bytesToFill))
-			goto finish;
+			return;
 
 		// PA may request we submit more or less data than we have.
 		// Wait for more data if we cannot perform a full write.
-		if (bytesToFill > data->new_data.size) {
+		if (bytesToFill > size) {
 			pa_stream_cancel_write(data->stream);
-			goto finish;
+			return;
 		}
 
-		deque_pop_front(&data->new_data, buffer, bytesToFill);
+		ring_read(&data->ring, buffer, bytesToFill, false);
+		size -= bytesToFill;
 
 		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL,
 				PA_SEEK_RELATIVE);
 	}
+}
 
-finish:
-	pthread_mutex_unlock(&data->playback_mutex);
-	pulseaudio_unlock();
+/* Frames a monitor may lag behind the fullest monitor on the bus and still
+ * hold up the mix.  Monitored sources all receive their audio within the
+ * same audio tick, so a monitor that lags by more than a tick is not
+ * producing audio right now and is mixed with what it has instead. */
+static size_t bus_slack_frames(void)
+{
+	uint32_t rate = audio_output_get_sample_rate(obs->audio.audio);
+	uint32_t tick = audio_output_get_tick_frames(obs->audio.audio);
+
+	if (!rate)
+		return tick;
+	return (size_t)util_mul_div64(tick, bus.spec.rate, rate) + 1;
+}
+
+/* Mixes what the monitors on the bus have buffered and writes it out.  Only
+ * as much as every monitor that keeps up has is mixed, so sources stay
+ * aligned without a stalled monitor adding latency to all the others.
+ * Called with the pulse mainloop lock held. */
+static void bus_write(void)
+{
+	size_t frames = SIZE_MAX;
+	size_t max_frames = 0;
+
+	if (!bus.stream)
+		return;
+
+	for (size_t i = 0; i < bus.monitors.num; i++) {
+		struct audio_monitor *monitor = bus.monitors.array[i];
+		if (os_atomic_load_long(&monitor->source->activate_refs) == 0)
+			continue;
+
+		size_t cur = ring_size(&monitor->ring) / bus.bytes_per_frame;
+		if (cur > max_frames)
+			max_frames = cur;
+	}
+
+	if (!max_frames)
+		return;
+
+	size_t slack = bus_slack_frames();
+
+	for (size_t i = 0; i < bus.monitors.num; i++) {
+		struct audio_monitor *monitor = bus.monitors.array[i];
+		if (os_atomic_load_long(&monitor->source->activate_refs) == 0)
+			continue;
+
+		size_t cur = ring_size(&monitor->ring) / bus.bytes_per_frame;
+		if (cur + slack >= max_frames && cur < frames)
+			frames = cur;
+	}
+
+	if (!frames || frames == SIZE_MAX)
+		return;
+
+	size_t bytes = frames * bus.bytes_per_frame;
+
+	if (pa_stream_is_corked(bus.stream)) {
+		if (bytes >= bus.attr.tlength)
+			pa_stream_cork(bus.stream, 0, NULL, NULL);
+		else
+			return;
+	}
+
+	if (bus.mix_size < bytes) {
+		bus.mix = brealloc(bus.mix, bytes);
+		bus.mix_size = bytes;
+	}
+	memset(bus.mix, 0, bytes);
+
+	for (size_t i = 0; i < bus.monitors.num; i++) {
+		struct audio_monitor *monitor = bus.monitors.array[i];
+		size_t size = ring_size(&monitor->ring);
+		size_t count = size < bytes ? size : bytes;
+
+		count -= count % bus.bytes_per_frame;
+		if (count)
+			ring_read(&monitor->ring, (uint8_t *)bus.mix, count,
+				  true);
+	}
+
+	pa_stream_write(bus.stream, bus.mix, bytes, NULL, 0LL,
+			PA_SEEK_RELATIVE);
+}
+
+static void *writer_thread(void *unused)
+{
+	os_set_thread_name("pulse-am: writer");
+
+	while (os_event_wait(writer.event) == 0) {
+		if (os_atomic_load_bool(&writer.stop))
+			break;
+
+		pulseaudio_lock();
+
+		for (size_t i = 0; i < writer.monitors.num; i++) {
+			struct audio_monitor *monitor =
+				writer.monitors.array[i];
+			if (!monitor->on_bus)
+				stream_write(monitor);
+		}
+		if (bus.monitors.num)
+			bus_write();
+
+		pulseaudio_unlock();
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static bool writer_ref(void)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&writer_mutex);
+
+	if (writer.refs == 0) {
+		os_atomic_set_bool(&writer.stop, false);
+
+		if (os_event_init(&writer.event, OS_EVENT_TYPE_AUTO) != 0) {
+			success = false;
+		} else if (pthread_create(&writer.thread, NULL, writer_thread,
+					  NULL) != 0) {
+			os_event_destroy(writer.event);
+			writer.event = NULL;
+			success = false;
+		}
+	}
+
+	if (success)
+		writer.refs++;
+	else
+		blog(LOG_ERROR, "Failed to start the monitoring writer thread");
+
+	pthread_mutex_unlock(&writer_mutex);
+	return success;
+}
+
+static void writer_unref(void)
+{
+	pthread_mutex_lock(&writer_mutex);
+
+	if (--writer.refs == 0) {
+		os_atomic_set_bool(&writer.stop, true);
+		os_event_signal(writer.event);
+		pthread_join(writer.thread, NULL);
+
+		os_event_destroy(writer.event);
+		writer.event = NULL;
+		da_free(writer.monitors);
+	}
+
+	pthread_mutex_unlock(&writer_mutex);
 }
 
 static void on_audio_playback(void *param, obs_source_t *source,
@@ -248,11 +457,8 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	uint64_t ts_offset;
 	bool success;
 
-	if (pthread_mutex_trylock(&monitor->playback_mutex) != 0)
-		return;
-
 	if (os_atomic_load_long(&source->activate_refs) == 0)
-		goto unlock;
+		return;
 
 	success = audio_resampler_resample(
 		monitor->resampler, resample_data, &resample_frames, &ts_offset,
@@ -260,7 +466,7 @@ static void on_audio_playback(void *param, obs_source_t *source,
 		(uint32_t)audio_data->frames);
 
 	if (!success)
-		goto unlock;
+		return;
 
 	bytes = monitor->bytes_per_frame * resample_frames;
 
@@ -273,13 +479,12 @@ static void on_audio_playback(void *param, obs_source_t *source,
 		}
 	}
 
-	deque_push_back(&monitor->new_data, resample_data[0], bytes);
-	monitor->packets++;
-	monitor->frames += resample_frames;
+	if (ring_write(&monitor->ring, resample_data[0], bytes)) {
+		monitor->packets++;
+		monitor->frames += resample_frames;
+	}
 
-unlock:
-	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
+	os_event_signal(writer.event);
 }
 
 static void pulseaudio_server_info(pa_context *c, const pa_server_info *i,
@@ -340,22 +545,136 @@ skip:
 	pulseaudio_signal(0);
 }
 
-static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+static void stop_stream(pa_stream *stream)
 {
-	if (monitor->stream) {
-		/* Stop the stream */
-		pulseaudio_lock();
-		pa_stream_disconnect(monitor->stream);
-		pulseaudio_unlock();
+	/* Stop the stream */
+	pulseaudio_lock();
+	pa_stream_disconnect(stream);
+	pulseaudio_unlock();
+
+	/* Remove the callbacks, to ensure we no longer try to do anything
+	 * with this stream object */
+	pulseaudio_write_callback(stream, NULL, NULL);
+
+	/* Unreference the stream and drop it. PA will free it when it can. */
+	pulseaudio_lock();
+	pa_stream_unref(stream);
+	pulseaudio_unlock();
+}
+
+static pa_stream *start_stream(const char *name, const char *device,
+			       const pa_sample_spec *spec,
+			       pa_buffer_attr *attr)
+{
+	enum speaker_layout speakers =
+		pulseaudio_channels_to_obs_speakers(spec->channels);
+	pa_channel_map channel_map = pulseaudio_channel_map(speakers);
+
+	pa_stream *stream = pulseaudio_stream_new(name, spec, &channel_map);
+	if (!stream) {
+		blog(LOG_ERROR, "Unable to create stream");
+		return NULL;
+	}
+
+	attr->fragsize = (uint32_t)-1;
+	attr->maxlength = (uint32_t)-1;
+	attr->minreq = (uint32_t)-1;
+	attr->prebuf = (uint32_t)-1;
+	attr->tlength = pa_usec_to_bytes(25000, spec);
+
+	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
+				  PA_STREAM_AUTO_TIMING_UPDATE |
+				  PA_STREAM_START_CORKED;
+
+	int_fast32_t ret =
+		pulseaudio_connect_playback(stream, device, attr, flags);
+	if (ret < 0) {
+		stop_stream(stream);
+		blog(LOG_ERROR, "Unable to connect to stream");
+		return NULL;
+	}
+
+	return stream;
+}
+
+static void stop_bus_stream(void)
+{
+	pa_stream *stream;
+
+	pulseaudio_lock();
+	stream = bus.stream;
+	bus.stream = NULL;
+	pulseaudio_unlock();
+
+	if (stream) {
+		stop_stream(stream);
+		blog(LOG_INFO, "Stopped monitoring bus in '%s'", bus.device);
+	}
+
+	bfree(bus.device);
+	bus.device = NULL;
+}
+
+static bool bus_ref(struct audio_monitor *monitor, const pa_sample_spec *spec)
+{
+	bool success = true;
+
+	pthread_mutex_lock(&bus_mutex);
+
+	/* the monitoring device changed, or the device's format did */
+	if (bus.stream && (strcmp(bus.device, monitor->device) != 0 ||
+			   !pa_sample_spec_equal(&bus.spec, spec)))
+		stop_bus_stream();
+
+	if (!bus.stream) {
+		pa_stream *stream = start_stream("OBS Monitoring",
+						 monitor->device, spec,
+						 &bus.attr);
+		if (stream) {
+			bus.spec = *spec;
+			bus.bytes_per_frame = pa_frame_size(spec);
+			bus.device = bstrdup(monitor->device);
+
+			pulseaudio_lock();
+			bus.stream = stream;
+			pulseaudio_unlock();
+
+			blog(LOG_INFO, "Started monitoring bus in '%s'",
+			     bus.device);
+		} else {
+			success = false;
+		}
+	}
+
+	if (success)
+		bus.refs++;
+
+	pthread_mutex_unlock(&bus_mutex);
+	return success;
+}
+
+static void bus_unref(void)
+{
+	pthread_mutex_lock(&bus_mutex);
 
-		/* Remove the callbacks, to ensure we no longer try to do anything
-		 * with this stream object */
-		pulseaudio_write_callback(monitor->stream, NULL, NULL);
+	if (--bus.refs == 0) {
+		stop_bus_stream();
 
-		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
-		pa_stream_unref(monitor->stream);
+		da_free(bus.monitors);
+		bfree(bus.mix);
+		bus.mix = NULL;
+		bus.mix_size = 0;
 		pulseaudio_unlock();
+	}
+
+	pthread_mutex_unlock(&bus_mutex);
+}
+
+static void pulseaudio_stop_playback(struct audio_monitor *monitor)
+{
+	if (monitor->stream) {
+		stop_stream(monitor->stream);
 		monitor->stream = NULL;
 	}
 
@@ -368,6 +687,21 @@ static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 	monitor->frames = 0;
 }
 
+static void log_ring_stats(struct audio_monitor *monitor)
+{
+	if (!monitor->ring.data || !monitor->bytes_per_frame ||
+	    !monitor->samples_per_sec)
+		return;
+
+	uint64_t peak_frames = monitor->ring.peak / monitor->bytes_per_frame;
+	blog(LOG_DEBUG,
+	     "'%s': peak monitoring buffer %" PRIu64 " ms, %" PRIuFAST32
+	     " packets dropped",
+	     obs_source_get_name(monitor->source),
+	     peak_frames * 1000 / monitor->samples_per_sec,
+	     monitor->ring.dropped);
+}
+
 static bool audio_monitor_init(struct audio_monitor *monitor,
 			       obs_source_t *source)
 {
@@ -420,6 +754,11 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 		return false;
 	}
 
+	/* the bus mixes in float regardless of the device's format */
+	bool use_bus = obs->audio.monitoring_bus;
+	if (use_bus)
+		monitor->format = PA_SAMPLE_FLOAT32LE;
+
 	pa_sample_spec spec;
 	spec.format = monitor->format;
 	spec.rate = (uint32_t)monitor->samples_per_sec;
@@ -452,32 +791,24 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
 	monitor->bytes_per_frame = pa_frame_size(&spec);
 
-	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
+	/* one second of audio */
+	ring_init(&monitor->ring, monitor->samples_per_sec,
+		  monitor->bytes_per_frame);
 
-	monitor->stream = pulseaudio_stream_new(
-		obs_source_get_name(monitor->source), &spec, &channel_map);
-	if (!monitor->stream) {
-		blog(LOG_ERROR, "Unable to create stream");
-		return false;
-	}
-
-	monitor->attr.fragsize = (uint32_t)-1;
-	monitor->attr.maxlength = (uint32_t)-1;
-	monitor->attr.minreq = (uint32_t)-1;
-	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
+	if (use_bus) {
+		if (!bus_ref(monitor, &spec))
+			return false;
 
-	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
-				  PA_STREAM_AUTO_TIMING_UPDATE |
-				  PA_STREAM_START_CORKED;
+		monitor->on_bus = true;
+		blog(LOG_INFO, "Started Monitoring '%s' on the monitoring bus",
+		     obs_source_get_name(source));
+		return true;
+	}
 
-	int_fast32_t ret = pulseaudio_connect_playback(
-		monitor->stream, monitor->device, &monitor->attr, flags);
-	if (ret < 0) {
-		pulseaudio_stop_playback(monitor);
-		blog(LOG_ERROR, "Unable to connect to stream");
+	monitor->stream = start_stream(obs_source_get_name(monitor->source),
+				       monitor->device, &spec, &monitor->attr);
+	if (!monitor->stream)
 		return false;
-	}
 
 	blog(LOG_INFO, "Started Monitoring in '%s'", monitor->device);
 	return true;
@@ -488,6 +819,17 @@ static void audio_monitor_init_final(struct audio_monitor *monitor)
 	if (monitor->ignore)
 		return;
 
+	if (!writer_ref())
+		return;
+
+	pulseaudio_lock();
+	da_push_back(writer.monitors, &monitor);
+	if (monitor->on_bus)
+		da_push_back(bus.monitors, &monitor);
+	pulseaudio_unlock();
+
+	monitor->writing = true;
+
 	obs_source_add_audio_capture_callback(monitor->source,
 					      on_audio_playback, monitor);
 }
@@ -501,13 +843,34 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
+	/* once removed from the writer, nothing reads the ring anymore */
+	if (monitor->writing) {
+		pulseaudio_lock();
+		da_erase_item(writer.monitors, &monitor);
+		da_erase_item(bus.monitors, &monitor);
+		pulseaudio_unlock();
+
+		writer_unref();
+		monitor->writing = false;
+	}
+
+	if (monitor->on_bus) {
+		bus_unref();
+		monitor->on_bus = false;
+	}
+
+	log_ring_stats(monitor);
+
 	audio_resampler_destroy(monitor->resampler);
-	deque_free(&monitor->new_data);
 
 	if (monitor->stream)
 		pulseaudio_stop_playback(monitor);
 	pulseaudio_unref();
 
+	/* freed after the stream is stopped, the last write may still
+	 * have been reading from it */
+	ring_free(&monitor->ring);
+
 	bfree(monitor->device);
 }
 
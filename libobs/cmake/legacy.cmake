@@ -68,6 +68,7 @@ target_sources(
           obs-source.c
           obs-source.h
           obs-source-deinterlace.c
+          obs-source-pacing.h
           obs-source-transition.c
           obs-video.c
           obs-video-gpu-encode.c
@@ -117,7 +118,11 @@ target_sources(
           graphics/effect.h
           graphics/effect-parser.c
           graphics/effect-parser.h
+          graphics/gif-decoder.c
+          graphics/gif-decoder.h
           graphics/half.h
+          graphics/image-cache.c
+          graphics/image-cache.h
           graphics/image-file.c
           graphics/image-file.h
           graphics/math-extra.c
@@ -191,6 +196,8 @@ target_sources(
           util/dstr.h
           util/file-serializer.c
           util/file-serializer.h
+          util/file-watch.c
+          util/file-watch.h
           util/lexer.c
           util/lexer.h
           util/platform.c
@@ -425,6 +432,7 @@ elseif(OS_POSIX)
       libobs
       PRIVATE audio-monitoring/pulse/pulseaudio-output.c audio-monitoring/pulse/pulseaudio-enum-devices.c
               audio-monitoring/pulse/pulseaudio-wrapper.c audio-monitoring/pulse/pulseaudio-wrapper.h
+              audio-monitoring/pulse/monitor-ring.h
               audio-monitoring/pulse/pulseaudio-monitoring-available.c)
 
     target_link_libraries(libobs PRIVATE ${PULSEAUDIO_LIBRARY})
@@ -52,6 +52,7 @@ if(ENABLE_PULSEAUDIO)
   target_sources(
     libobs
     PRIVATE # cmake-format: sortable
+            audio-monitoring/pulse/monitor-ring.h
             audio-monitoring/pulse/pulseaudio-enum-devices.c
             audio-monitoring/pulse/pulseaudio-monitoring-available.c
             audio-monitoring/pulse/pulseaudio-output.c
@@ -155,6 +155,13 @@ struct gs_effect {
 	bool cached;
 	char *effect_path, *effect_dir;
 
+	/* crc32 of the effect directory and source text, used to share
+	 * cached effects whose contents are identical.  the source is kept so
+	 * a hash match can be confirmed before an effect is shared */
+	uint32_t effect_hash;
+	size_t effect_size;
+	char *effect_source;
+
 	gs_effect_param_array_t params;
 	DARRAY(struct gs_effect_technique) techniques;
 
@@ -188,8 +195,10 @@ static inline void effect_free(gs_effect_t *effect)
 
 	bfree(effect->effect_path);
 	bfree(effect->effect_dir);
+	bfree(effect->effect_source);
 	effect->effect_path = NULL;
 	effect->effect_dir = NULL;
+	effect->effect_source = NULL;
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,590 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <sys/stat.h>
+
+#include "gif-decoder.h"
+#include "libnsgif/libnsgif.h"
+#include "srgb.h"
+#include "../util/base.h"
+#include "../util/bmem.h"
+#include "../util/darray.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+
+#define blog(level, format, ...) \
+	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
+
+#define DEFAULT_PREFETCH_FRAMES 4
+#define DEFAULT_MAX_BYTES (128ULL * 1024ULL * 1024ULL)
+
+struct cached_frame {
+	uint8_t *data;
+	uint64_t last_used;
+};
+
+struct gif_decoder {
+	struct gif_decoder *next;
+	struct gif_decoder **prev_next;
+
+	char *path;
+	enum gs_image_alpha_mode alpha_mode;
+	int64_t file_size;
+	time_t file_time;
+
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t frame_count;
+	int loop_count;
+	uint64_t *frame_times;
+	size_t frame_size;
+	uint32_t prefetch_frames;
+	uint64_t max_bytes;
+	uint64_t mem_usage;
+
+	/* only used by the decode thread once it runs */
+	gif_animation gif;
+	gif_bitmap_callback_vt bitmap_callbacks;
+	uint8_t *gif_data;
+	int decoded_frame;
+	bool decode_failed;
+
+	pthread_t thread;
+	bool thread_created;
+	os_event_t *event;
+	volatile bool stop;
+
+	pthread_mutex_t mutex;
+	struct cached_frame *frames;
+	uint64_t cached_bytes;
+	uint64_t use_counter;
+	DARRAY(struct gif_reader *) readers;
+};
+
+static pthread_mutex_t decoders_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct gif_decoder *first_decoder = NULL;
+static uint32_t prefetch_frames = DEFAULT_PREFETCH_FRAMES;
+static uint64_t max_bytes = DEFAULT_MAX_BYTES;
+
+static void *bi_def_bitmap_create(int width, int height)
+{
+	return bmalloc((size_t)4 * width * height);
+}
+
+static void bi_def_bitmap_set_opaque(void *bitmap, bool opaque)
+{
+	UNUSED_PARAMETER(bitmap);
+	UNUSED_PARAMETER(opaque);
+}
+
+static bool bi_def_bitmap_test_opaque(void *bitmap)
+{
+	UNUSED_PARAMETER(bitmap);
+	return false;
+}
+
+static unsigned char *bi_def_bitmap_get_buffer(void *bitmap)
+{
+	return (unsigned char *)bitmap;
+}
+
+static void bi_def_bitmap_destroy(void *bitmap)
+{
+	bfree(bitmap);
+}
+
+static void bi_def_bitmap_modified(void *bitmap)
+{
+	UNUSED_PARAMETER(bitmap);
+}
+
+/* ------------------------------------------------------------------------- */
+/* frame cache, requires the decoder mutex */
+
+static bool frame_wanted(struct gif_decoder *dec, uint32_t frame)
+{
+	/* the first frame is kept for restarts and loops */
+	if (frame == 0)
+		return true;
+
+	for (size_t i = 0; i < dec->readers.num; i++) {
+		const struct gif_reader *reader = dec->readers.array[i];
+		uint32_t offset = (frame + dec->frame_count -
+				   (uint32_t)reader->position) %
+				  dec->frame_count;
+
+		if (reader->pinned_frame == (int)frame ||
+		    offset < dec->prefetch_frames)
+			return true;
+	}
+
+	return false;
+}
+
+/* returns the missing frame that takes the fewest frames to decode */
+static int next_missing_frame(struct gif_decoder *dec)
+{
+	int best = -1;
+	int best_cost = 0;
+
+	for (size_t i = 0; i < dec->readers.num; i++) {
+		const struct gif_reader *reader = dec->readers.array[i];
+
+		for (uint32_t j = 0; j < dec->prefetch_frames; j++) {
+			int frame = (int)(((uint32_t)reader->position + j) %
+					  dec->frame_count);
+			int cost = frame > dec->decoded_frame
+					   ? frame - dec->decoded_frame
+					   : frame + 1;
+
+			if (dec->frames[frame].data)
+				continue;
+			if (best == -1 || cost < best_cost) {
+				best = frame;
+				best_cost = cost;
+			}
+			break;
+		}
+	}
+
+	return best;
+}
+
+/* drops the least recently used frames to make room for another one */
+static void evict_frames(struct gif_decoder *dec)
+{
+	while (dec->cached_bytes + dec->frame_size > dec->max_bytes) {
+		int lru = -1;
+
+		for (uint32_t i = 1; i < dec->frame_count; i++) {
+			const struct cached_frame *frame = &dec->frames[i];
+			if (!frame->data || frame_wanted(dec, i))
+				continue;
+			if (lru == -1 ||
+			    frame->last_used < dec->frames[lru].last_used)
+				lru = (int)i;
+		}
+
+		if (lru == -1)
+			break;
+
+		bfree(dec->frames[lru].data);
+		dec->frames[lru].data = NULL;
+		dec->cached_bytes -= dec->frame_size;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* decoding */
+
+static void cache_frame(struct gif_decoder *dec, uint32_t frame, bool required)
+{
+	const size_t area = (size_t)dec->cx * dec->cy;
+	const uint8_t *src = dec->gif.frame_image;
+	uint8_t *data;
+	bool needed;
+
+	pthread_mutex_lock(&dec->mutex);
+	needed = !dec->frames[frame].data &&
+		 (required || frame_wanted(dec, frame));
+	pthread_mutex_unlock(&dec->mutex);
+
+	if (!needed)
+		return;
+
+	/* the decoded image is the base of the next frame, so it cannot be
+	 * premultiplied in place */
+	data = bmalloc(dec->frame_size);
+	if (dec->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY_SRGB)
+		gs_premultiply_xyza_srgb_loop_restrict(data, src, area);
+	else if (dec->alpha_mode == GS_IMAGE_ALPHA_PREMULTIPLY)
+		gs_premultiply_xyza_loop_restrict(data, src, area);
+	else
+		memcpy(data, src, dec->frame_size);
+
+	pthread_mutex_lock(&dec->mutex);
+	evict_frames(dec);
+	dec->frames[frame].data = data;
+	dec->frames[frame].last_used = ++dec->use_counter;
+	dec->cached_bytes += dec->frame_size;
+	pthread_mutex_unlock(&dec->mutex);
+}
+
+/* gif frames are drawn on top of the frames before them, so they have to
+ * be decoded in order, starting over from the first frame if needed */
+static void decode_frame(struct gif_decoder *dec, int frame)
+{
+	int first = frame > dec->decoded_frame ? dec->decoded_frame + 1 : 0;
+
+	for (int i = first; i <= frame; i++) {
+		if (os_atomic_load_bool(&dec->stop))
+			return;
+
+		if (gif_decode_frame(&dec->gif, (unsigned int)i) != GIF_OK &&
+		    !dec->decode_failed) {
+			blog(LOG_WARNING, "Couldn't decode frame %d of '%s'", i,
+			     dec->path);
+			dec->decode_failed = true;
+		}
+
+		dec->decoded_frame = i;
+		cache_frame(dec, (uint32_t)i, i == frame);
+	}
+}
+
+static void *gif_decode_thread(void *param)
+{
+	struct gif_decoder *dec = param;
+
+	os_set_thread_name("libobs: gif decode thread");
+
+	while (!os_atomic_load_bool(&dec->stop)) {
+		pthread_mutex_lock(&dec->mutex);
+		int frame = next_missing_frame(dec);
+		pthread_mutex_unlock(&dec->mutex);
+
+		if (frame == -1)
+			os_event_wait(dec->event);
+		else
+			decode_frame(dec, frame);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* decoders */
+
+static void gif_decoder_free(struct gif_decoder *dec)
+{
+	if (dec->thread_created) {
+		os_atomic_set_bool(&dec->stop, true);
+		os_event_signal(dec->event);
+		pthread_join(dec->thread, NULL);
+	}
+
+	if (dec->frames) {
+		for (uint32_t i = 0; i < dec->frame_count; i++)
+			bfree(dec->frames[i].data);
+		bfree(dec->frames);
+	}
+
+	gif_finalise(&dec->gif);
+	os_event_destroy(dec->event);
+	pthread_mutex_destroy(&dec->mutex);
+	da_free(dec->readers);
+	bfree(dec->frame_times);
+	bfree(dec->gif_data);
+	bfree(dec->path);
+	bfree(dec);
+}
+
+static bool gif_decoder_load(struct gif_decoder *dec, bool *animated)
+{
+	gif_result result;
+	size_t size, size_read;
+	FILE *file;
+
+	file = os_fopen(dec->path, "rb");
+	if (!file) {
+		blog(LOG_WARNING, "Failed to open file '%s'", dec->path);
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = (size_t)os_ftelli64(file);
+	fseek(file, 0, SEEK_SET);
+
+	dec->gif_data = bmalloc(size);
+	size_read = fread(dec->gif_data, 1, size, file);
+	fclose(file);
+
+	if (size_read != size) {
+		blog(LOG_WARNING, "Failed to fully read gif file '%s'.",
+		     dec->path);
+		return false;
+	}
+
+	do {
+		result = gif_initialise(&dec->gif, size, dec->gif_data);
+		if (result < 0) {
+			blog(LOG_WARNING,
+			     "Failed to initialize gif '%s', "
+			     "possible file corruption",
+			     dec->path);
+			return false;
+		}
+	} while (result != GIF_OK);
+
+	if (dec->gif.width > 4096 || dec->gif.height > 4096) {
+		blog(LOG_WARNING, "Bad texture dimensions (%dx%d) in '%s'",
+		     dec->gif.width, dec->gif.height, dec->path);
+		return false;
+	}
+
+	if (dec->gif.frame_count <= 1) {
+		*animated = false;
+		return false;
+	}
+
+	dec->cx = (uint32_t)dec->gif.width;
+	dec->cy = (uint32_t)dec->gif.height;
+	dec->frame_count = dec->gif.frame_count;
+	dec->loop_count = dec->gif.loop_count;
+	dec->frame_size = (size_t)dec->cx * dec->cy * 4;
+
+	dec->frame_times = bmalloc(dec->frame_count * sizeof(uint64_t));
+	for (uint32_t i = 0; i < dec->frame_count; i++) {
+		uint64_t val = (uint64_t)dec->gif.frames[i].frame_delay *
+			       10000000ULL;
+		dec->frame_times[i] = val ? val : 100000000ULL;
+	}
+
+	/* an estimate: the cache plus the file and the decoder's image */
+	uint64_t cache_size = (uint64_t)dec->frame_size * dec->frame_count;
+	uint64_t min_size =
+		(uint64_t)dec->frame_size * (dec->prefetch_frames + 2);
+	if (cache_size > dec->max_bytes)
+		cache_size = dec->max_bytes > min_size ? dec->max_bytes
+						       : min_size;
+	dec->mem_usage = cache_size + dec->frame_size + size;
+
+	return true;
+}
+
+static struct gif_decoder *gif_decoder_open(const char *path,
+					    enum gs_image_alpha_mode alpha_mode,
+					    const struct stat *st,
+					    uint32_t prefetch,
+					    uint64_t max_size, bool *animated)
+{
+	struct gif_decoder *dec = bzalloc(sizeof(struct gif_decoder));
+
+	dec->path = bstrdup(path);
+	dec->alpha_mode = alpha_mode;
+	dec->file_size = (int64_t)st->st_size;
+	dec->file_time = st->st_mtime;
+	dec->decoded_frame = -1;
+	dec->prefetch_frames = prefetch;
+	dec->max_bytes = max_size;
+	pthread_mutex_init_value(&dec->mutex);
+
+	dec->bitmap_callbacks.bitmap_create = bi_def_bitmap_create;
+	dec->bitmap_callbacks.bitmap_destroy = bi_def_bitmap_destroy;
+	dec->bitmap_callbacks.bitmap_get_buffer = bi_def_bitmap_get_buffer;
+	dec->bitmap_callbacks.bitmap_modified = bi_def_bitmap_modified;
+	dec->bitmap_callbacks.bitmap_set_opaque = bi_def_bitmap_set_opaque;
+	dec->bitmap_callbacks.bitmap_test_opaque = bi_def_bitmap_test_opaque;
+
+	gif_create(&dec->gif, &dec->bitmap_callbacks);
+
+	if (!gif_decoder_load(dec, animated))
+		goto fail;
+
+	if (dec->prefetch_frames > dec->frame_count)
+		dec->prefetch_frames = dec->frame_count;
+
+	dec->frames = bzalloc(dec->frame_count * sizeof(struct cached_frame));
+
+	if (pthread_mutex_init(&dec->mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&dec->event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	/* the first frame is needed right away for the texture */
+	decode_frame(dec, 0);
+
+	if (pthread_create(&dec->thread, NULL, gif_decode_thread, dec) != 0)
+		goto fail;
+
+	dec->thread_created = true;
+	return dec;
+
+fail:
+	gif_decoder_free(dec);
+	return NULL;
+}
+
+static struct gif_decoder *find_decoder(const char *path,
+					enum gs_image_alpha_mode alpha_mode,
+					const struct stat *st)
+{
+	struct gif_decoder *dec = first_decoder;
+
+	while (dec) {
+		if (dec->alpha_mode == alpha_mode &&
+		    dec->file_size == (int64_t)st->st_size &&
+		    dec->file_time == st->st_mtime &&
+		    strcmp(dec->path, path) == 0)
+			return dec;
+
+		dec = dec->next;
+	}
+
+	return NULL;
+}
+
+void gif_decoder_set_limits(uint32_t prefetch, uint64_t max_size)
+{
+	pthread_mutex_lock(&decoders_mutex);
+	prefetch_frames = prefetch ? prefetch : 1;
+	max_bytes = max_size;
+	pthread_mutex_unlock(&decoders_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* readers */
+
+/* requires decoders_mutex, which keeps the decoder alive */
+static struct gif_reader *add_reader(struct gif_decoder *dec)
+{
+	struct gif_reader *reader = bzalloc(sizeof(struct gif_reader));
+
+	reader->decoder = dec;
+	reader->cx = dec->cx;
+	reader->cy = dec->cy;
+	reader->frame_count = dec->frame_count;
+	reader->loop_count = dec->loop_count;
+	reader->frame_times = dec->frame_times;
+	reader->mem_usage = dec->mem_usage;
+	reader->pinned_frame = -1;
+
+	pthread_mutex_lock(&dec->mutex);
+	da_push_back(dec->readers, &reader);
+	pthread_mutex_unlock(&dec->mutex);
+	return reader;
+}
+
+struct gif_reader *gif_reader_create(const char *path,
+				     enum gs_image_alpha_mode alpha_mode,
+				     bool *animated)
+{
+	struct gif_reader *reader = NULL;
+	struct gif_decoder *dec, *new_dec;
+	uint32_t prefetch;
+	uint64_t max_size;
+	struct stat st;
+
+	*animated = true;
+
+	if (os_stat(path, &st) != 0) {
+		blog(LOG_WARNING, "Failed to open file '%s'", path);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&decoders_mutex);
+	dec = find_decoder(path, alpha_mode, &st);
+	if (dec)
+		reader = add_reader(dec);
+	prefetch = prefetch_frames;
+	max_size = max_bytes;
+	pthread_mutex_unlock(&decoders_mutex);
+
+	if (reader)
+		return reader;
+
+	/* loading the file and decoding the first frame can take a while, so
+	 * it is not done under the lock, which every reader of every gif
+	 * needs to be created or destroyed */
+	new_dec = gif_decoder_open(path, alpha_mode, &st, prefetch, max_size,
+				   animated);
+	if (!new_dec)
+		return NULL;
+
+	/* another reader may have opened the same file meanwhile */
+	pthread_mutex_lock(&decoders_mutex);
+	dec = find_decoder(path, alpha_mode, &st);
+	if (!dec) {
+		dec = new_dec;
+		dec->next = first_decoder;
+		dec->prev_next = &first_decoder;
+		if (first_decoder)
+			first_decoder->prev_next = &dec->next;
+		first_decoder = dec;
+		new_dec = NULL;
+	}
+	reader = add_reader(dec);
+	pthread_mutex_unlock(&decoders_mutex);
+
+	if (new_dec)
+		gif_decoder_free(new_dec);
+	return reader;
+}
+
+void gif_reader_destroy(struct gif_reader *reader)
+{
+	struct gif_decoder *dec;
+	bool last;
+
+	if (!reader)
+		return;
+
+	dec = reader->decoder;
+
+	pthread_mutex_lock(&decoders_mutex);
+
+	pthread_mutex_lock(&dec->mutex);
+	da_erase_item(dec->readers, &reader);
+	last = !dec->readers.num;
+	pthread_mutex_unlock(&dec->mutex);
+
+	if (last) {
+		*dec->prev_next = dec->next;
+		if (dec->next)
+			dec->next->prev_next = dec->prev_next;
+	}
+
+	pthread_mutex_unlock(&decoders_mutex);
+
+	if (last)
+		gif_decoder_free(dec);
+	bfree(reader);
+}
+
+bool gif_reader_seek(struct gif_reader *reader, int frame)
+{
+	struct gif_decoder *dec = reader->decoder;
+	bool ready;
+
+	pthread_mutex_lock(&dec->mutex);
+	reader->position = frame;
+	ready = !!dec->frames[frame].data;
+	pthread_mutex_unlock(&dec->mutex);
+
+	/* decode the frame, or the frames after it */
+	os_event_signal(dec->event);
+	return ready;
+}
+
+const uint8_t *gif_reader_get_frame(struct gif_reader *reader, int frame)
+{
+	struct gif_decoder *dec = reader->decoder;
+	struct cached_frame *cached = &dec->frames[frame];
+	const uint8_t *data;
+
+	pthread_mutex_lock(&dec->mutex);
+	reader->position = frame;
+	data = cached->data;
+	if (data) {
+		cached->last_used = ++dec->use_counter;
+		reader->pinned_frame = frame;
+	}
+	pthread_mutex_unlock(&dec->mutex);
+
+	os_event_signal(dec->event);
+	return data;
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Animated gif decoding for the image file helper.
+ *
+ * Frames are decoded on a background thread a few frames ahead of where
+ * each reader currently is, and kept in a cache limited to a number of
+ * bytes, dropping the least recently used frames first.  Readers that
+ * open the same file with the same alpha mode share the decoder and its
+ * cache.
+ */
+
+struct gif_decoder;
+
+struct gif_reader {
+	struct gif_decoder *decoder;
+
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t frame_count;
+	int loop_count;
+	const uint64_t *frame_times; /* ns */
+	uint64_t mem_usage;
+
+	/* protected by the decoder */
+	int position;
+	int pinned_frame;
+};
+
+/* Returns NULL and sets *animated to false if the file is a still image */
+extern struct gif_reader *gif_reader_create(const char *path,
+					    enum gs_image_alpha_mode alpha_mode,
+					    bool *animated);
+extern void gif_reader_destroy(struct gif_reader *reader);
+
+/* Moves the reader to a frame, returns whether the frame is decoded.  If
+ * it is not, it is decoded in the background. */
+extern bool gif_reader_seek(struct gif_reader *reader, int frame);
+
+/* Moves the reader to a frame and returns it, or NULL if it is not decoded
+ * yet.  The data stays valid until the next call for this reader. */
+extern const uint8_t *gif_reader_get_frame(struct gif_reader *reader,
+					   int frame);
+
+extern void gif_decoder_set_limits(uint32_t prefetch_frames,
+				   uint64_t max_bytes);
+
+#ifdef __cplusplus
+}
+#endif
@@ -23,8 +23,45 @@ struct ffmpeg_image {
 
 	int cx, cy;
 	enum AVPixelFormat format;
+
+	/* decoded images larger than this are downscaled, 0 is unbounded */
+	uint32_t max_cx, max_cy;
 };
 
+/* scale that fits an image within the maximum size, at most 1.0 */
+static double get_fit_scale(int cx, int cy, uint32_t max_cx, uint32_t max_cy)
+{
+	double scale = 1.0;
+
+	if (max_cx && (uint32_t)cx > max_cx)
+		scale = (double)max_cx / (double)cx;
+	if (max_cy && (double)cy * scale > (double)max_cy)
+		scale = (double)max_cy / (double)cy;
+	return scale;
+}
+
+/* Decoders such as the JPEG decoder can decode at 1/2, 1/4 or 1/8 of the
+ * size, which is a lot faster than decoding the full image and scaling it
+ * down afterwards.  The orientation is only known after decoding, so the
+ * size is only reduced as far as the image stays larger than the maximum
+ * size either way. */
+static int ffmpeg_image_get_lowres(const struct ffmpeg_image *info,
+				   const AVCodec *decoder)
+{
+	const double scale1 = get_fit_scale(info->cx, info->cy, info->max_cx,
+					    info->max_cy);
+	const double scale2 = get_fit_scale(info->cx, info->cy, info->max_cy,
+					    info->max_cx);
+	const double scale = scale1 > scale2 ? scale1 : scale2;
+	int lowres = 0;
+
+	while (lowres < decoder->max_lowres &&
+	       scale <= 1.0 / (double)(2 << lowres))
+		lowres++;
+
+	return lowres;
+}
+
 static bool ffmpeg_image_open_decoder_context(struct ffmpeg_image *info)
 {
 	AVFormatContext *const fmt_ctx = info->fmt_ctx;
@@ -55,6 +92,9 @@ static bool ffmpeg_image_open_decoder_context(struct ffmpeg_image *info)
 	info->cy = codecpar->height;
 	info->format = codecpar->format;
 
+	if (info->max_cx || info->max_cy)
+		decoder_ctx->lowres = ffmpeg_image_get_lowres(info, decoder);
+
 	ret = avcodec_open2(decoder_ctx, decoder, NULL);
 	if (ret < 0) {
 		blog(LOG_WARNING,
@@ -73,7 +113,8 @@ static void ffmpeg_image_free(struct ffmpeg_image *info)
 	avformat_close_input(&info->fmt_ctx);
 }
 
-static bool ffmpeg_image_init(struct ffmpeg_image *info, const char *file)
+static bool ffmpeg_image_init(struct ffmpeg_image *info, const char *file,
+			      uint32_t max_cx, uint32_t max_cy)
 {
 	int ret;
 
@@ -82,6 +123,8 @@ static bool ffmpeg_image_init(struct ffmpeg_image *info, const char *file)
 
 	memset(info, 0, sizeof(struct ffmpeg_image));
 	info->file = file;
+	info->max_cx = max_cx;
+	info->max_cy = max_cy;
 
 	ret = avformat_open_input(&info->fmt_ctx, file, NULL, NULL);
 	if (ret < 0) {
@@ -347,6 +390,88 @@ static void *ffmpeg_image_orient(struct ffmpeg_image *info, void *in_data,
 	return data;
 }
 
+/* Returns whether the image has to be downscaled to fit the maximum size,
+ * and the size to scale it to before it is oriented */
+static bool ffmpeg_image_get_scaled_size(const struct ffmpeg_image *info,
+					 int orient, int *cx, int *cy)
+{
+	double scale;
+
+	if (orient >= 5 && orient < 9)
+		scale = get_fit_scale(info->cx, info->cy, info->max_cy,
+				      info->max_cx);
+	else
+		scale = get_fit_scale(info->cx, info->cy, info->max_cx,
+				      info->max_cy);
+	if (scale >= 1.0)
+		return false;
+
+	*cx = (int)((double)info->cx * scale + 0.5);
+	*cy = (int)((double)info->cy * scale + 0.5);
+	if (*cx < 1)
+		*cx = 1;
+	if (*cy < 1)
+		*cy = 1;
+	return true;
+}
+
+/* Averages each block of source pixels covered by a destination pixel.
+ * Works on any 8-bit four channel format. */
+static void *ffmpeg_image_downscale(struct ffmpeg_image *info, void *in_data,
+				    int cx, int cy)
+{
+	const size_t src_linesize = (size_t)info->cx * 4;
+	uint32_t *sums = bmalloc((size_t)cx * 4 * sizeof(uint32_t));
+	int *cols = bmalloc(((size_t)cx + 1) * sizeof(int));
+	uint8_t *data = bmalloc((size_t)cx * cy * 4);
+	uint8_t *dst = data;
+
+	for (int x = 0; x <= cx; x++)
+		cols[x] = (int)((int64_t)x * info->cx / cx);
+
+	for (int y = 0; y < cy; y++) {
+		const int y0 = (int)((int64_t)y * info->cy / cy);
+		const int y1 = (int)((int64_t)(y + 1) * info->cy / cy);
+
+		memset(sums, 0, (size_t)cx * 4 * sizeof(uint32_t));
+
+		for (int sy = y0; sy < y1; sy++) {
+			const uint8_t *src =
+				(const uint8_t *)in_data + sy * src_linesize;
+			uint32_t *sum = sums;
+
+			for (int x = 0; x < cx; x++) {
+				for (int sx = cols[x]; sx < cols[x + 1]; sx++) {
+					const uint8_t *p = src + sx * 4;
+					sum[0] += p[0];
+					sum[1] += p[1];
+					sum[2] += p[2];
+					sum[3] += p[3];
+				}
+				sum += 4;
+			}
+		}
+
+		for (int x = 0; x < cx; x++) {
+			const uint32_t count =
+				(uint32_t)((cols[x + 1] - cols[x]) * (y1 - y0));
+			const uint32_t *sum = sums + x * 4;
+
+			for (int c = 0; c < 4; c++)
+				*(dst++) = (uint8_t)((sum[c] + count / 2) /
+						     count);
+		}
+	}
+
+	bfree(cols);
+	bfree(sums);
+	bfree(in_data);
+
+	info->cx = cx;
+	info->cy = cy;
+	return data;
+}
+
 static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 					 AVFrame *frame,
 					 enum gs_image_alpha_mode alpha_mode)
@@ -368,6 +493,11 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 		}
 	}
 
+	int scaled_cx = info->cx;
+	int scaled_cy = info->cy;
+	const bool scale = ffmpeg_image_get_scaled_size(info, orient,
+							&scaled_cx, &scaled_cy);
+
 	if (info->format == AV_PIX_FMT_BGR0) {
 		data = ffmpeg_image_copy_data_straight(info, frame);
 	} else if (info->format == AV_PIX_FMT_RGBA ||
@@ -480,9 +610,12 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 	} else {
 		static const enum AVPixelFormat format = AV_PIX_FMT_BGRA;
 
+		/* scale while converting instead of converting the full
+		 * size image first */
 		sws_ctx = sws_getContext(info->cx, info->cy, info->format,
-					 info->cx, info->cy, format, SWS_POINT,
-					 NULL, NULL, NULL);
+					 scaled_cx, scaled_cy, format,
+					 scale ? SWS_AREA : SWS_POINT, NULL,
+					 NULL, NULL);
 		if (!sws_ctx) {
 			blog(LOG_WARNING,
 			     "Failed to create scale context "
@@ -493,7 +626,7 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 
 		uint8_t *pointers[4];
 		int linesizes[4];
-		ret = av_image_alloc(pointers, linesizes, info->cx, info->cy,
+		ret = av_image_alloc(pointers, linesizes, scaled_cx, scaled_cy,
 				     format, 32);
 		if (ret < 0) {
 			blog(LOG_WARNING, "av_image_alloc failed for '%s': %s",
@@ -514,6 +647,9 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 			goto fail;
 		}
 
+		info->cx = scaled_cx;
+		info->cy = scaled_cy;
+
 		const size_t linesize = (size_t)info->cx * 4;
 		data = bmalloc(info->cy * linesize);
 		const uint8_t *src = pointers[0];
@@ -537,6 +673,9 @@ static void *ffmpeg_image_reformat_frame(struct ffmpeg_image *info,
 		info->format = format;
 	}
 
+	if (data && (info->cx != scaled_cx || info->cy != scaled_cy))
+		data = ffmpeg_image_downscale(info, data, scaled_cx, scaled_cy);
+
 	data = ffmpeg_image_orient(info, data, orient);
 
 fail:
@@ -582,6 +721,10 @@ static void *ffmpeg_image_decode(struct ffmpeg_image *info,
 		}
 	}
 
+	/* smaller than the stream size when decoded at a lower resolution */
+	info->cx = frame->width;
+	info->cy = frame->height;
+
 	data = ffmpeg_image_reformat_frame(info, frame, alpha_mode);
 
 fail:
@@ -617,7 +760,7 @@ uint8_t *gs_create_texture_file_data(const char *file,
 	struct ffmpeg_image image;
 	uint8_t *data = NULL;
 
-	if (ffmpeg_image_init(&image, file)) {
+	if (ffmpeg_image_init(&image, file, 0, 0)) {
 		data = ffmpeg_image_decode(&image, GS_IMAGE_ALPHA_STRAIGHT);
 		if (data) {
 			*format = convert_format(image.format);
@@ -855,11 +998,22 @@ uint8_t *gs_create_texture_file_data3(const char *file,
 				      enum gs_color_format *format,
 				      uint32_t *cx_out, uint32_t *cy_out,
 				      enum gs_color_space *space)
+{
+	return gs_create_texture_file_data4(file, alpha_mode, 0, 0, format,
+					    cx_out, cy_out, space);
+}
+
+uint8_t *gs_create_texture_file_data4(const char *file,
+				      enum gs_image_alpha_mode alpha_mode,
+				      uint32_t max_cx, uint32_t max_cy,
+				      enum gs_color_format *format,
+				      uint32_t *cx_out, uint32_t *cy_out,
+				      enum gs_color_space *space)
 {
 	struct ffmpeg_image image;
 	uint8_t *data = NULL;
 
-	if (ffmpeg_image_init(&image, file)) {
+	if (ffmpeg_image_init(&image, file, max_cx, max_cy)) {
 		data = ffmpeg_image_decode(&image, alpha_mode);
 		if (data) {
 			*format = convert_format(image.format);
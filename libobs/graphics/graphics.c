@@ -20,6 +20,8 @@
 #include "../util/base.h"
 #include "../util/bmem.h"
 #include "../util/platform.h"
+#include "../util/profiler.h"
+#include "../util/crc32.h"
 #include "graphics-internal.h"
 #include "vec2.h"
 #include "vec3.h"
@@ -796,14 +798,77 @@ gs_effect_t *gs_get_effect(void)
 
 static inline struct gs_effect *find_cached_effect(const char *filename)
 {
-	struct gs_effect *effect = thread_graphics->first_effect;
+	struct gs_effect *effect;
 
+	pthread_mutex_lock(&thread_graphics->effect_mutex);
+
+	effect = thread_graphics->first_effect;
 	while (effect) {
 		if (strcmp(effect->effect_path, filename) == 0)
 			break;
 		effect = effect->next;
 	}
 
+	pthread_mutex_unlock(&thread_graphics->effect_mutex);
+	return effect;
+}
+
+static size_t get_effect_dir_len(const char *filename)
+{
+	const char *slash = strrchr(filename, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(filename, '\\');
+	if (backslash && (!slash || backslash > slash))
+		slash = backslash;
+#endif
+	return slash ? (size_t)(slash - filename) : 0;
+}
+
+static uint32_t calc_effect_hash(const char *effect_string, size_t size,
+				 const char *filename)
+{
+	/* include the directory in the hash, since relative #include
+	 * directives resolve differently for otherwise identical files */
+	size_t dir_len = get_effect_dir_len(filename);
+	uint32_t hash = calc_crc32(0, filename, dir_len);
+	return calc_crc32(hash, effect_string, size);
+}
+
+static inline bool effect_contents_equal(const struct gs_effect *effect,
+					 const char *effect_string, size_t size,
+					 const char *filename)
+{
+	size_t dir_len = get_effect_dir_len(filename);
+
+	if (!effect->effect_source || !effect->effect_path)
+		return false;
+	if (get_effect_dir_len(effect->effect_path) != dir_len)
+		return false;
+	if (strncmp(effect->effect_path, filename, dir_len) != 0)
+		return false;
+
+	return memcmp(effect->effect_source, effect_string, size) == 0;
+}
+
+static inline struct gs_effect *
+find_cached_effect_by_contents(const char *effect_string, size_t size,
+			       uint32_t hash, const char *filename)
+{
+	struct gs_effect *effect;
+
+	pthread_mutex_lock(&thread_graphics->effect_mutex);
+
+	effect = thread_graphics->first_effect;
+	while (effect) {
+		if (effect->effect_hash == hash &&
+		    effect->effect_size == size &&
+		    effect_contents_equal(effect, effect_string, size,
+					  filename))
+			break;
+		effect = effect->next;
+	}
+
+	pthread_mutex_unlock(&thread_graphics->effect_mutex);
 	return effect;
 }
 
@@ -831,21 +896,49 @@ gs_effect_t *gs_effect_create_from_file(const char *file, char **error_string)
 	return effect;
 }
 
+static const char *effect_create_name = "gs_effect_create";
+static const char *effect_parse_name = "ep_parse";
+
 gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 			      char **error_string)
 {
 	if (!gs_valid_p("gs_effect_create", effect_string))
 		return NULL;
 
-	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
+	struct gs_effect *effect;
 	struct effect_parser parser;
+	size_t size = strlen(effect_string);
+	uint32_t hash = 0;
 	bool success;
 
+	profile_start(effect_create_name);
+
+	/* effects created with a file name are cached for the lifetime of
+	 * the graphics subsystem, so identical sources (e.g. the same .effect
+	 * shipped by several plugins) can share a single parsed effect */
+	if (filename) {
+		hash = calc_effect_hash(effect_string, size, filename);
+		effect = find_cached_effect_by_contents(effect_string, size,
+							hash, filename);
+		if (effect) {
+			profile_end(effect_create_name);
+			return effect;
+		}
+	}
+
+	effect = bzalloc(sizeof(struct gs_effect));
 	effect->graphics = thread_graphics;
 	effect->effect_path = bstrdup(filename);
+	effect->effect_hash = hash;
+	effect->effect_size = size;
+	if (filename)
+		effect->effect_source = bstrdup_n(effect_string, size);
 
+	profile_start(effect_parse_name);
 	ep_init(&parser);
 	success = ep_parse(&parser, effect, effect_string, filename);
+	profile_end(effect_parse_name);
+
 	if (!success) {
 		if (error_string)
 			*error_string =
@@ -867,6 +960,7 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 	}
 
 	ep_free(&parser);
+	profile_end(effect_create_name);
 	return effect;
 }
 
@@ -1192,6 +1286,25 @@ void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 	gs_texture_unmap(tex);
 }
 
+bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+				 uint32_t linesize, uint32_t x, uint32_t y,
+				 uint32_t width, uint32_t height)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_region", tex, data))
+		return false;
+
+	if (!width || !height)
+		return true;
+
+	if (graphics->exports.gs_texture_set_image_region)
+		return graphics->exports.gs_texture_set_image_region(
+			tex, data, linesize, x, y, width, height);
+	else
+		return false;
+}
+
 void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 			      const void *data, uint32_t linesize, bool invert)
 {
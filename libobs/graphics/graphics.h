@@ -599,6 +599,10 @@ gs_create_texture_file_data3(const char *file,
 			     enum gs_image_alpha_mode alpha_mode,
 			     enum gs_color_format *format, uint32_t *cx,
 			     uint32_t *cy, enum gs_color_space *space);
+EXPORT uint8_t *gs_create_texture_file_data4(
+	const char *file, enum gs_image_alpha_mode alpha_mode, uint32_t max_cx,
+	uint32_t max_cy, enum gs_color_format *format, uint32_t *cx,
+	uint32_t *cy, enum gs_color_space *space);
 
 #define GS_FLIP_U (1 << 0)
 #define GS_FLIP_V (1 << 1)
@@ -634,6 +638,10 @@ EXPORT void gs_viewport_pop(void);
 
 EXPORT void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
 				 uint32_t linesize, bool invert);
+EXPORT bool gs_texture_set_image_region(gs_texture_t *tex, const uint8_t *data,
+					uint32_t linesize, uint32_t x,
+					uint32_t y, uint32_t width,
+					uint32_t height);
 EXPORT void gs_cubetexture_set_image(gs_texture_t *cubetex, uint32_t side,
 				     const void *data, uint32_t linesize,
 				     bool invert);
@@ -0,0 +1,234 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <sys/stat.h>
+
+#include "image-cache.h"
+#include "../util/base.h"
+#include "../util/bmem.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+
+#define blog(level, format, ...) \
+	blog(level, "%s: " format, __FUNCTION__, __VA_ARGS__)
+
+struct image_cache_entry {
+	struct image_cache_entry *next;
+	struct image_cache_entry **prev_next;
+
+	char *path;
+	enum gs_image_alpha_mode alpha_mode;
+	uint32_t max_cx;
+	uint32_t max_cy;
+	int64_t file_size;
+	time_t file_time;
+
+	/* set once the image is decoded */
+	bool decoded;
+	bool failed;
+	enum gs_color_format format;
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_space space;
+
+	/* protected by the cache mutex */
+	long refs;
+	uint8_t *data;
+	gs_texture_t *texture;
+	bool creating_texture;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t decoded_cond = PTHREAD_COND_INITIALIZER;
+static struct image_cache_entry *first_entry = NULL;
+
+static struct image_cache_entry *
+find_entry(const char *path, enum gs_image_alpha_mode alpha_mode,
+	   uint32_t max_cx, uint32_t max_cy, const struct stat *st)
+{
+	struct image_cache_entry *entry = first_entry;
+
+	while (entry) {
+		if (entry->alpha_mode == alpha_mode &&
+		    entry->max_cx == max_cx && entry->max_cy == max_cy &&
+		    entry->file_size == (int64_t)st->st_size &&
+		    entry->file_time == st->st_mtime &&
+		    strcmp(entry->path, path) == 0)
+			return entry;
+
+		entry = entry->next;
+	}
+
+	return NULL;
+}
+
+static inline void remove_entry(struct image_cache_entry *entry)
+{
+	if (!entry->prev_next)
+		return;
+
+	*entry->prev_next = entry->next;
+	if (entry->next)
+		entry->next->prev_next = entry->prev_next;
+	entry->prev_next = NULL;
+}
+
+static void entry_free(struct image_cache_entry *entry)
+{
+	gs_texture_destroy(entry->texture);
+	bfree(entry->data);
+	bfree(entry->path);
+	bfree(entry);
+}
+
+struct image_cache_entry *image_cache_load(const char *path,
+					   enum gs_image_alpha_mode alpha_mode,
+					   uint32_t max_cx, uint32_t max_cy)
+{
+	struct image_cache_entry *entry;
+	struct stat st;
+
+	if (!path || !*path)
+		return NULL;
+
+	if (os_stat(path, &st) != 0) {
+		blog(LOG_WARNING, "Failed to open file '%s'", path);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache_mutex);
+
+	entry = find_entry(path, alpha_mode, max_cx, max_cy, &st);
+	if (entry) {
+		entry->refs++;
+
+		/* another helper may still be decoding it */
+		while (!entry->decoded)
+			pthread_cond_wait(&decoded_cond, &cache_mutex);
+		pthread_mutex_unlock(&cache_mutex);
+
+		if (!entry->failed)
+			return entry;
+
+		image_cache_release(entry);
+		return NULL;
+	}
+
+	entry = bzalloc(sizeof(*entry));
+	entry->path = bstrdup(path);
+	entry->alpha_mode = alpha_mode;
+	entry->max_cx = max_cx;
+	entry->max_cy = max_cy;
+	entry->file_size = (int64_t)st.st_size;
+	entry->file_time = st.st_mtime;
+	entry->refs = 1;
+
+	entry->next = first_entry;
+	entry->prev_next = &first_entry;
+	if (first_entry)
+		first_entry->prev_next = &entry->next;
+	first_entry = entry;
+
+	pthread_mutex_unlock(&cache_mutex);
+
+	/* decode outside of the lock, helpers loading other files are not
+	 * held up */
+	uint8_t *data = gs_create_texture_file_data4(
+		path, alpha_mode, max_cx, max_cy, &entry->format, &entry->cx,
+		&entry->cy, &entry->space);
+
+	pthread_mutex_lock(&cache_mutex);
+	entry->data = data;
+	entry->failed = !data;
+	entry->decoded = true;
+
+	/* a file that failed to load is tried again the next time */
+	if (entry->failed)
+		remove_entry(entry);
+
+	pthread_cond_broadcast(&decoded_cond);
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (!entry->failed)
+		return entry;
+
+	image_cache_release(entry);
+	return NULL;
+}
+
+void image_cache_release(struct image_cache_entry *entry)
+{
+	bool last;
+
+	if (!entry)
+		return;
+
+	pthread_mutex_lock(&cache_mutex);
+	last = --entry->refs == 0;
+	if (last)
+		remove_entry(entry);
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (last)
+		entry_free(entry);
+}
+
+void image_cache_get_info(const struct image_cache_entry *entry,
+			  enum gs_color_format *format, uint32_t *cx,
+			  uint32_t *cy, enum gs_color_space *space)
+{
+	*format = entry->format;
+	*cx = entry->cx;
+	*cy = entry->cy;
+	*space = entry->space;
+}
+
+gs_texture_t *image_cache_get_texture(struct image_cache_entry *entry)
+{
+	gs_texture_t *texture;
+	uint8_t *data = NULL;
+
+	pthread_mutex_lock(&cache_mutex);
+
+	while (entry->creating_texture)
+		pthread_cond_wait(&decoded_cond, &cache_mutex);
+
+	/* the pixels are taken over, so the texture is uploaded outside of
+	 * the lock without other helpers racing to create it */
+	if (!entry->texture && entry->data) {
+		data = entry->data;
+		entry->data = NULL;
+		entry->creating_texture = true;
+	}
+
+	texture = entry->texture;
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (!data)
+		return texture;
+
+	texture = gs_texture_create(entry->cx, entry->cy, entry->format, 1,
+				    (const uint8_t **)&data, 0);
+	bfree(data);
+
+	pthread_mutex_lock(&cache_mutex);
+	entry->texture = texture;
+	entry->creating_texture = false;
+	pthread_cond_broadcast(&decoded_cond);
+	pthread_mutex_unlock(&cache_mutex);
+	return texture;
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "graphics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decoded images and their textures, shared between the image file helpers
+ * that load the same file with the same alpha mode and maximum size.  An
+ * entry is decoded once, its pixels are released once the texture is
+ * created, and the texture is destroyed with the last reference.
+ */
+
+struct image_cache_entry;
+
+/* Returns a new reference to the image, decoding it if it is not cached
+ * yet, or NULL if the file could not be loaded. */
+extern struct image_cache_entry *
+image_cache_load(const char *path, enum gs_image_alpha_mode alpha_mode,
+		 uint32_t max_cx, uint32_t max_cy);
+
+/* Must be called within the graphics context if the entry has a texture */
+extern void image_cache_release(struct image_cache_entry *entry);
+
+extern void image_cache_get_info(const struct image_cache_entry *entry,
+				 enum gs_color_format *format, uint32_t *cx,
+				 uint32_t *cy, enum gs_color_space *space);
+
+/* Creates the shared texture if needed, within the graphics context */
+extern gs_texture_t *image_cache_get_texture(struct image_cache_entry *entry);
+
+#ifdef __cplusplus
+}
+#endif
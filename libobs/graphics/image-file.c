@@ -16,6 +16,8 @@
 ******************************************************************************/
 
 #include "image-file.h"
+#include "gif-decoder.h"
+#include "image-cache.h"
 #include "../util/base.h"
 #include "../util/platform.h"
 #include "../util/dstr.h"
@@ -191,13 +193,39 @@ not_animated:
 	return is_animated_gif;
 }
 
+static inline bool is_gif_file(const char *file)
+{
+	size_t len = strlen(file);
+	return len > 4 && astrcmpi(file + len - 4, ".gif") == 0;
+}
+
+static void load_still_image(gs_image_file_t *image, const char *file,
+			     uint64_t *mem_usage, enum gs_color_space *space,
+			     enum gs_image_alpha_mode alpha_mode,
+			     uint32_t max_cx, uint32_t max_cy)
+{
+	image->texture_data = gs_create_texture_file_data4(
+		file, alpha_mode, max_cx, max_cy, &image->format, &image->cx,
+		&image->cy, space);
+	image->loaded = !!image->texture_data;
+
+	if (mem_usage) {
+		*mem_usage += image->cx * image->cy *
+			      gs_get_format_bpp(image->format) / 8;
+	}
+
+	if (!image->loaded) {
+		blog(LOG_WARNING, "Failed to load file '%s'", file);
+		gs_image_file_free(image);
+	}
+}
+
 static void gs_image_file_init_internal(gs_image_file_t *image,
 					const char *file, uint64_t *mem_usage,
 					enum gs_color_space *space,
-					enum gs_image_alpha_mode alpha_mode)
+					enum gs_image_alpha_mode alpha_mode,
+					uint32_t max_cx, uint32_t max_cy)
 {
-	size_t len;
-
 	if (!image)
 		return;
 
@@ -206,35 +234,21 @@ static void gs_image_file_init_internal(gs_image_file_t *image,
 	if (!file)
 		return;
 
-	len = strlen(file);
-
-	if (len > 4 && astrcmpi(file + len - 4, ".gif") == 0) {
+	if (is_gif_file(file)) {
 		if (init_animated_gif(image, file, mem_usage, alpha_mode)) {
 			return;
 		}
 	}
 
-	image->texture_data =
-		gs_create_texture_file_data3(file, alpha_mode, &image->format,
-					     &image->cx, &image->cy, space);
-
-	if (mem_usage) {
-		*mem_usage += image->cx * image->cy *
-			      gs_get_format_bpp(image->format) / 8;
-	}
-
-	image->loaded = !!image->texture_data;
-	if (!image->loaded) {
-		blog(LOG_WARNING, "Failed to load file '%s'", file);
-		gs_image_file_free(image);
-	}
+	load_still_image(image, file, mem_usage, space, alpha_mode, max_cx,
+			 max_cy);
 }
 
 void gs_image_file_init(gs_image_file_t *image, const char *file)
 {
 	enum gs_color_space unused;
 	gs_image_file_init_internal(image, file, NULL, &unused,
-				    GS_IMAGE_ALPHA_STRAIGHT);
+				    GS_IMAGE_ALPHA_STRAIGHT, 0, 0);
 }
 
 void gs_image_file_free(gs_image_file_t *image)
@@ -261,7 +275,7 @@ void gs_image_file2_init(gs_image_file2_t *if2, const char *file)
 {
 	enum gs_color_space unused;
 	gs_image_file_init_internal(&if2->image, file, &if2->mem_usage, &unused,
-				    GS_IMAGE_ALPHA_STRAIGHT);
+				    GS_IMAGE_ALPHA_STRAIGHT, 0, 0);
 }
 
 void gs_image_file3_init(gs_image_file3_t *if3, const char *file,
@@ -270,7 +284,7 @@ void gs_image_file3_init(gs_image_file3_t *if3, const char *file,
 	enum gs_color_space unused;
 	gs_image_file_init_internal(&if3->image2.image, file,
 				    &if3->image2.mem_usage, &unused,
-				    alpha_mode);
+				    alpha_mode, 0, 0);
 	if3->alpha_mode = alpha_mode;
 }
 
@@ -279,7 +293,17 @@ void gs_image_file4_init(gs_image_file4_t *if4, const char *file,
 {
 	gs_image_file_init_internal(&if4->image3.image2.image, file,
 				    &if4->image3.image2.mem_usage, &if4->space,
-				    alpha_mode);
+				    alpha_mode, 0, 0);
+	if4->image3.alpha_mode = alpha_mode;
+}
+
+void gs_image_file4_init_max_size(gs_image_file4_t *if4, const char *file,
+				  enum gs_image_alpha_mode alpha_mode,
+				  uint32_t max_cx, uint32_t max_cy)
+{
+	gs_image_file_init_internal(&if4->image3.image2.image, file,
+				    &if4->image3.image2.mem_usage, &if4->space,
+				    alpha_mode, max_cx, max_cy);
 	if4->image3.alpha_mode = alpha_mode;
 }
 
@@ -302,8 +326,12 @@ void gs_image_file_init_texture(gs_image_file_t *image)
 	}
 }
 
-static inline uint64_t get_time(gs_image_file_t *image, int i)
+static inline uint64_t get_time(gs_image_file_t *image,
+				const struct gif_reader *gif, int i)
 {
+	if (gif)
+		return gif->frame_times[i];
+
 	uint64_t val = (uint64_t)image->gif.frames[i].frame_delay * 10000000ULL;
 	if (!val)
 		val = 100000000;
@@ -311,18 +339,21 @@ static inline uint64_t get_time(gs_image_file_t *image, int i)
 }
 
 static inline int calculate_new_frame(gs_image_file_t *image,
+				      const struct gif_reader *gif,
 				      uint64_t elapsed_time_ns, int loops)
 {
+	const unsigned int frame_count = gif ? gif->frame_count
+					     : image->gif.frame_count;
 	int new_frame = image->cur_frame;
 
 	image->cur_time += elapsed_time_ns;
 	for (;;) {
-		uint64_t t = get_time(image, new_frame);
+		uint64_t t = get_time(image, gif, new_frame);
 		if (image->cur_time <= t)
 			break;
 
 		image->cur_time -= t;
-		if ((unsigned int)++new_frame == image->gif.frame_count) {
+		if ((unsigned int)++new_frame == frame_count) {
 			if (!loops || ++image->cur_loop < loops) {
 				new_frame = 0;
 			} else if (image->cur_loop == loops) {
@@ -392,8 +423,8 @@ static bool gs_image_file_tick_internal(gs_image_file_t *image,
 		loops = 0;
 
 	if (!loops || image->cur_loop < loops) {
-		int new_frame =
-			calculate_new_frame(image, elapsed_time_ns, loops);
+		int new_frame = calculate_new_frame(image, NULL,
+						    elapsed_time_ns, loops);
 
 		if (new_frame != image->cur_frame) {
 			decode_new_frame(image, new_frame, alpha_mode);
@@ -463,3 +494,194 @@ void gs_image_file4_update_texture(gs_image_file4_t *if4)
 	gs_image_file_update_texture_internal(&if4->image3.image2.image,
 					      if4->image3.alpha_mode);
 }
+
+/* ------------------------------------------------------------------------- */
+/* gs_image_file5: animated gifs decoded in the background */
+
+static inline gs_image_file_t *if5_image(gs_image_file5_t *if5)
+{
+	return &if5->image4.image3.image2.image;
+}
+
+static bool init_gif_reader(gs_image_file5_t *if5, const char *path,
+			    enum gs_image_alpha_mode alpha_mode)
+{
+	gs_image_file_t *image = if5_image(if5);
+	bool is_animated_gif;
+
+	if5->gif = gif_reader_create(path, alpha_mode, &is_animated_gif);
+	if (!if5->gif)
+		return is_animated_gif;
+
+	image->is_animated_gif = true;
+	image->cx = if5->gif->cx;
+	image->cy = if5->gif->cy;
+	image->format = GS_RGBA;
+	image->loaded = true;
+
+	if5->image4.image3.image2.mem_usage += if5->gif->mem_usage;
+	return true;
+}
+
+static bool init_shared_image(gs_image_file5_t *if5, const char *file,
+			      enum gs_image_alpha_mode alpha_mode,
+			      uint32_t max_cx, uint32_t max_cy)
+{
+	gs_image_file_t *image = if5_image(if5);
+
+	if5->cached = image_cache_load(file, alpha_mode, max_cx, max_cy);
+	if (!if5->cached) {
+		blog(LOG_WARNING, "Failed to load file '%s'", file);
+		return false;
+	}
+
+	image_cache_get_info(if5->cached, &image->format, &image->cx,
+			     &image->cy, &if5->image4.space);
+	image->loaded = true;
+
+	if5->image4.image3.image2.mem_usage +=
+		image->cx * image->cy * gs_get_format_bpp(image->format) / 8;
+	return true;
+}
+
+static void gs_image_file5_init_internal(gs_image_file5_t *if5,
+					 const char *file,
+					 enum gs_image_alpha_mode alpha_mode,
+					 uint32_t max_cx, uint32_t max_cy,
+					 bool shared)
+{
+	if (!if5)
+		return;
+
+	memset(if5, 0, sizeof(*if5));
+	if5->image4.image3.alpha_mode = alpha_mode;
+
+	if (!file)
+		return;
+
+	/* a gif that fails to load is not loaded again as a still image */
+	if (is_gif_file(file) && init_gif_reader(if5, file, alpha_mode))
+		return;
+
+	if (shared) {
+		init_shared_image(if5, file, alpha_mode, max_cx, max_cy);
+		return;
+	}
+
+	load_still_image(if5_image(if5), file,
+			 &if5->image4.image3.image2.mem_usage,
+			 &if5->image4.space, alpha_mode, max_cx, max_cy);
+}
+
+void gs_image_file5_init_max_size(gs_image_file5_t *if5, const char *file,
+				  enum gs_image_alpha_mode alpha_mode,
+				  uint32_t max_cx, uint32_t max_cy)
+{
+	gs_image_file5_init_internal(if5, file, alpha_mode, max_cx, max_cy,
+				     false);
+}
+
+void gs_image_file5_init_shared(gs_image_file5_t *if5, const char *file,
+				enum gs_image_alpha_mode alpha_mode,
+				uint32_t max_cx, uint32_t max_cy)
+{
+	gs_image_file5_init_internal(if5, file, alpha_mode, max_cx, max_cy,
+				     true);
+}
+
+void gs_image_file5_init(gs_image_file5_t *if5, const char *file,
+			 enum gs_image_alpha_mode alpha_mode)
+{
+	gs_image_file5_init_max_size(if5, file, alpha_mode, 0, 0);
+}
+
+void gs_image_file5_free(gs_image_file5_t *if5)
+{
+	if (!if5)
+		return;
+
+	if (if5->gif) {
+		gif_reader_destroy(if5->gif);
+		gs_texture_destroy(if5_image(if5)->texture);
+		memset(if5, 0, sizeof(*if5));
+		return;
+	}
+
+	/* the texture of a shared image belongs to the cache */
+	if (if5->cached) {
+		image_cache_release(if5->cached);
+		memset(if5, 0, sizeof(*if5));
+		return;
+	}
+
+	gs_image_file4_free(&if5->image4);
+	memset(if5, 0, sizeof(*if5));
+}
+
+void gs_image_file5_init_texture(gs_image_file5_t *if5)
+{
+	gs_image_file_t *image = if5_image(if5);
+	const uint8_t *frame;
+
+	if (if5->cached) {
+		image->texture = image_cache_get_texture(if5->cached);
+		return;
+	}
+
+	if (!if5->gif) {
+		gs_image_file4_init_texture(&if5->image4);
+		return;
+	}
+
+	frame = gif_reader_get_frame(if5->gif, image->cur_frame);
+	image->texture = gs_texture_create(image->cx, image->cy, image->format,
+					   1, frame ? &frame : NULL,
+					   GS_DYNAMIC);
+	if5->texture_frame = frame ? image->cur_frame : -1;
+}
+
+bool gs_image_file5_tick(gs_image_file5_t *if5, uint64_t elapsed_time_ns)
+{
+	gs_image_file_t *image = if5_image(if5);
+	int loops;
+
+	if (!if5->gif)
+		return false;
+
+	loops = if5->gif->loop_count;
+	if (loops >= 0xFFFF)
+		loops = 0;
+
+	if (!loops || image->cur_loop < loops)
+		image->cur_frame = calculate_new_frame(image, if5->gif,
+						       elapsed_time_ns, loops);
+
+	/* frames are decoded in the background, a frame that is not ready
+	 * yet is shown on a later tick instead of stalling this one */
+	if (image->cur_frame == if5->texture_frame)
+		return false;
+
+	return gif_reader_seek(if5->gif, image->cur_frame);
+}
+
+void gs_image_file5_update_texture(gs_image_file5_t *if5)
+{
+	gs_image_file_t *image = if5_image(if5);
+	const uint8_t *frame;
+
+	if (!if5->gif || image->cur_frame == if5->texture_frame)
+		return;
+
+	frame = gif_reader_get_frame(if5->gif, image->cur_frame);
+	if (!frame)
+		return;
+
+	gs_texture_set_image(image->texture, frame, image->cx * 4, false);
+	if5->texture_frame = image->cur_frame;
+}
+
+void gs_image_file_set_gif_cache_limits(uint32_t prefetch_frames,
+					uint64_t max_bytes)
+{
+	gif_decoder_set_limits(prefetch_frames, max_bytes);
+}
@@ -61,10 +61,21 @@ struct gs_image_file4 {
 	enum gs_color_space space;
 };
 
+/* Animated gifs are decoded in the background into a bounded frame cache
+ * instead of all at once.  The gif state of the embedded gs_image_file is
+ * unused, so only the gs_image_file5 functions may be used on it. */
+struct gs_image_file5 {
+	struct gs_image_file4 image4;
+	struct gif_reader *gif;
+	int texture_frame;
+	struct image_cache_entry *cached;
+};
+
 typedef struct gs_image_file gs_image_file_t;
 typedef struct gs_image_file2 gs_image_file2_t;
 typedef struct gs_image_file3 gs_image_file3_t;
 typedef struct gs_image_file4 gs_image_file4_t;
+typedef struct gs_image_file5 gs_image_file5_t;
 
 EXPORT void gs_image_file_init(gs_image_file_t *image, const char *file);
 EXPORT void gs_image_file_free(gs_image_file_t *image);
@@ -89,11 +100,35 @@ EXPORT void gs_image_file3_update_texture(gs_image_file3_t *if3);
 
 EXPORT void gs_image_file4_init(gs_image_file4_t *if4, const char *file,
 				enum gs_image_alpha_mode alpha_mode);
+EXPORT void gs_image_file4_init_max_size(gs_image_file4_t *if4,
+					 const char *file,
+					 enum gs_image_alpha_mode alpha_mode,
+					 uint32_t max_cx, uint32_t max_cy);
 
 EXPORT bool gs_image_file4_tick(gs_image_file4_t *if4,
 				uint64_t elapsed_time_ns);
 EXPORT void gs_image_file4_update_texture(gs_image_file4_t *if4);
 
+EXPORT void gs_image_file5_init(gs_image_file5_t *if5, const char *file,
+				enum gs_image_alpha_mode alpha_mode);
+EXPORT void gs_image_file5_init_max_size(gs_image_file5_t *if5,
+					 const char *file,
+					 enum gs_image_alpha_mode alpha_mode,
+					 uint32_t max_cx, uint32_t max_cy);
+EXPORT void gs_image_file5_init_shared(gs_image_file5_t *if5,
+				       const char *file,
+				       enum gs_image_alpha_mode alpha_mode,
+				       uint32_t max_cx, uint32_t max_cy);
+EXPORT void gs_image_file5_free(gs_image_file5_t *if5);
+
+EXPORT void gs_image_file5_init_texture(gs_image_file5_t *if5);
+EXPORT bool gs_image_file5_tick(gs_image_file5_t *if5,
+				uint64_t elapsed_time_ns);
+EXPORT void gs_image_file5_update_texture(gs_image_file5_t *if5);
+
+EXPORT void gs_image_file_set_gif_cache_limits(uint32_t prefetch_frames,
+					       uint64_t max_bytes);
+
 static void gs_image_file2_free(gs_image_file2_t *if2)
 {
 	gs_image_file_free(&if2->image);
@@ -43,21 +43,31 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 		int invalid = 0; \
 	} while (0)
 
-struct audio_input {
+/* A conversion of a mix to a specific format, shared by every input of that
+ * mix requesting the same format, sample rate, speaker layout and clipping
+ * behavior.  It runs at most once per tick. */
+struct audio_converter {
 	struct audio_convert_info conversion;
 	audio_resampler_t *resampler;
+	long refs;
+
+	/* result of the current tick */
+	bool done;
+	bool success;
+	struct audio_data data;
+};
+
+struct audio_input {
+	struct audio_convert_info conversion;
+	struct audio_converter *converter;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
-
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct audio_converter *) converters;
 	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 	float buffer_unclamped[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
@@ -67,6 +77,8 @@ struct audio_output {
 	size_t block_size;
 	size_t channels;
 	size_t planes;
+	uint32_t tick_frames;
+	bool low_latency;
 
 	pthread_t thread;
 	os_event_t *stop_event;
@@ -77,33 +89,46 @@ struct audio_output {
 	void *input_param;
 	pthread_mutex_t input_mutex;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
+
+	/* conversions skipped because another input shared their result */
+	uint64_t conversions_saved;
 };
 
 /* ------------------------------------------------------------------------- */
 
-static bool resample_audio_output(struct audio_input *input,
-				  struct audio_data *data)
+static void run_converter(struct audio_output *audio, struct audio_mix *mix,
+			  struct audio_converter *converter,
+			  uint64_t timestamp, uint32_t frames)
 {
-	bool success = true;
+	struct audio_data *data = &converter->data;
+
+	float(*buf)[AUDIO_OUTPUT_FRAMES] = converter->conversion.allow_clipping
+						   ? mix->buffer_unclamped
+						   : mix->buffer;
+
+	memset(data, 0, sizeof(*data));
+	for (size_t i = 0; i < audio->planes; i++)
+		data->data[i] = (uint8_t *)buf[i];
+
+	data->frames = frames;
+	data->timestamp = timestamp;
+	converter->success = true;
+	converter->done = true;
 
-	if (input->resampler) {
+	if (converter->resampler) {
 		uint8_t *output[MAX_AV_PLANES];
-		uint32_t frames;
 		uint64_t offset;
 
 		memset(output, 0, sizeof(output));
 
-		success = audio_resampler_resample(
-			input->resampler, output, &frames, &offset,
-			(const uint8_t *const *)data->data, data->frames);
+		converter->success = audio_resampler_resample(
+			converter->resampler, output, &data->frames, &offset,
+			(const uint8_t *const *)data->data, frames);
 
 		for (size_t i = 0; i < MAX_AV_PLANES; i++)
 			data->data[i] = output[i];
-		data->frames = frames;
 		data->timestamp -= offset;
 	}
-
-	return success;
 }
 
 static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
@@ -114,19 +139,22 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 
 	pthread_mutex_lock(&audio->input_mutex);
 
+	for (size_t i = 0; i < mix->converters.num; i++)
+		mix->converters.array[i]->done = false;
+
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array + (i - 1);
+		struct audio_converter *converter = input->converter;
 
-		float(*buf)[AUDIO_OUTPUT_FRAMES] =
-			input->conversion.allow_clipping ? mix->buffer_unclamped
-							 : mix->buffer;
-		for (size_t i = 0; i < audio->planes; i++)
-			data.data[i] = (uint8_t *)buf[i];
+		if (converter->done)
+			audio->conversions_saved++;
+		else
+			run_converter(audio, mix, converter, timestamp, frames);
 
-		data.frames = frames;
-		data.timestamp = timestamp;
+		/* each callback gets its own copy of the plane pointers */
+		data = converter->data;
 
-		if (resample_audio_output(input, &data))
+		if (converter->success)
 			input->callback(input->param, mix_idx, &data);
 	}
 
@@ -164,7 +192,7 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 			     uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
+	size_t bytes = audio->tick_frames * audio->block_size;
 	struct audio_output_data data[MAX_AUDIO_MIXES];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
@@ -206,7 +234,7 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 
 	/* output */
 	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+		do_audio_output(audio, i, new_ts, audio->tick_frames);
 }
 
 static void *audio_thread(void *param)
@@ -229,11 +257,16 @@ static void *audio_thread(void *param)
 				   "audio_thread(%s)", audio->info.name);
 
 	while (os_event_try(audio->stop_event) == EAGAIN) {
-		samples += AUDIO_OUTPUT_FRAMES;
+		samples += audio->tick_frames;
 		uint64_t audio_time =
 			start_time + audio_frames_to_ns(rate, samples);
 
-		os_sleepto_ns_fast(audio_time);
+		/* the coarse sleep can overshoot by about a millisecond,
+		 * which short ticks cannot absorb */
+		if (audio->low_latency)
+			os_sleepto_ns(audio_time);
+		else
+			os_sleepto_ns_fast(audio_time);
 
 		profile_start(audio_thread_name);
 
@@ -270,35 +303,82 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 	return DARRAY_INVALID;
 }
 
-static inline bool audio_input_init(struct audio_input *input,
-				    struct audio_output *audio)
+static inline bool conversion_equal(const struct audio_convert_info *a,
+				    const struct audio_convert_info *b)
+{
+	return a->format == b->format &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers == b->speakers &&
+	       a->allow_clipping == b->allow_clipping;
+}
+
+static struct audio_converter *
+audio_converter_create(struct audio_output *audio,
+		       const struct audio_convert_info *conversion)
 {
-	if (input->conversion.format != audio->info.format ||
-	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
-	    input->conversion.speakers != audio->info.speakers) {
+	struct audio_converter *converter = bzalloc(sizeof(*converter));
+	converter->conversion = *conversion;
+	converter->refs = 1;
+
+	if (conversion->format != audio->info.format ||
+	    conversion->samples_per_sec != audio->info.samples_per_sec ||
+	    conversion->speakers != audio->info.speakers) {
 		struct resample_info from = {
 			.format = audio->info.format,
 			.samples_per_sec = audio->info.samples_per_sec,
 			.speakers = audio->info.speakers};
 
 		struct resample_info to = {
-			.format = input->conversion.format,
-			.samples_per_sec = input->conversion.samples_per_sec,
-			.speakers = input->conversion.speakers};
+			.format = conversion->format,
+			.samples_per_sec = conversion->samples_per_sec,
+			.speakers = conversion->speakers};
 
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
+		converter->resampler = audio_resampler_create(&to, &from);
+		if (!converter->resampler) {
 			blog(LOG_ERROR, "audio_input_init: Failed to "
 					"create resampler");
-			return false;
+			bfree(converter);
+			return NULL;
+		}
+	}
+
+	return converter;
+}
+
+static inline bool audio_input_init(struct audio_input *input,
+				    struct audio_output *audio,
+				    struct audio_mix *mix)
+{
+	for (size_t i = 0; i < mix->converters.num; i++) {
+		struct audio_converter *converter = mix->converters.array[i];
+
+		if (conversion_equal(&converter->conversion,
+				     &input->conversion)) {
+			converter->refs++;
+			input->converter = converter;
+			return true;
 		}
-	} else {
-		input->resampler = NULL;
 	}
 
+	input->converter = audio_converter_create(audio, &input->conversion);
+	if (!input->converter)
+		return false;
+
+	da_push_back(mix->converters, &input->converter);
 	return true;
 }
 
+static void audio_input_free(struct audio_input *input, struct audio_mix *mix)
+{
+	struct audio_converter *converter = input->converter;
+
+	if (--converter->refs == 0) {
+		da_erase_item(mix->converters, &converter);
+		audio_resampler_destroy(converter->resampler);
+		bfree(converter);
+	}
+}
+
 bool audio_output_connect(audio_t *audio, size_t mi,
 			  const struct audio_convert_info *conversion,
 			  audio_output_callback_t callback, void *param)
@@ -333,7 +413,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		success = audio_input_init(&input, audio, mix);
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -354,7 +434,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array + idx);
+		audio_input_free(mix->inputs.array + idx, mix);
 		da_erase(mix->inputs, idx);
 	}
 
@@ -367,12 +447,24 @@ static inline bool valid_audio_params(const struct audio_output_info *info)
 	       info->speakers > 0;
 }
 
+static inline bool valid_tick_frames(uint32_t tick_frames)
+{
+	return !tick_frames || (tick_frames >= MIN_AUDIO_OUTPUT_FRAMES &&
+				tick_frames <= AUDIO_OUTPUT_FRAMES);
+}
+
 int audio_output_open(audio_t **audio, struct audio_output_info *info)
+{
+	return audio_output_open2(audio, info, 0);
+}
+
+int audio_output_open2(audio_t **audio, struct audio_output_info *info,
+		       uint32_t tick_frames)
 {
 	struct audio_output *out;
 	bool planar = is_audio_planar(info->format);
 
-	if (!valid_audio_params(info))
+	if (!valid_audio_params(info) || !valid_tick_frames(tick_frames))
 		return AUDIO_OUTPUT_INVALIDPARAM;
 
 	out = bzalloc(sizeof(struct audio_output));
@@ -386,6 +478,11 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 	out->input_param = info->input_param;
 	out->block_size = (planar ? 1 : out->channels) *
 			  get_audio_bytes_per_channel(info->format);
+	out->tick_frames = tick_frames ? tick_frames : AUDIO_OUTPUT_FRAMES;
+
+	/* ticks shorter than 10ms need precise wakeups */
+	out->low_latency = (uint64_t)out->tick_frames * 100 <
+			   info->samples_per_sec;
 
 	if (pthread_mutex_init_recursive(&out->input_mutex) != 0)
 		goto fail0;
@@ -425,10 +522,18 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array + i);
+			audio_input_free(mix->inputs.array + i, mix);
 
 		da_free(mix->inputs);
+		da_free(mix->converters);
 	}
+
+	if (audio->conversions_saved)
+		blog(LOG_INFO,
+		     "audio-io: %" PRIu64 " conversions saved by sharing "
+		     "converters between matching inputs",
+		     audio->conversions_saved);
+
 	bfree(audio);
 }
 
@@ -437,6 +542,24 @@ const struct audio_output_info *audio_output_get_info(const audio_t *audio)
 	return audio ? &audio->info : NULL;
 }
 
+uint32_t audio_output_get_tick_frames(const audio_t *audio)
+{
+	return audio ? audio->tick_frames : AUDIO_OUTPUT_FRAMES;
+}
+
+uint64_t audio_output_get_conversions_saved(const audio_t *audio)
+{
+	uint64_t saved;
+
+	if (!audio)
+		return 0;
+
+	pthread_mutex_lock((pthread_mutex_t *)&audio->input_mutex);
+	saved = audio->conversions_saved;
+	pthread_mutex_unlock((pthread_mutex_t *)&audio->input_mutex);
+	return saved;
+}
+
 bool audio_output_active(const audio_t *audio)
 {
 	if (!audio)
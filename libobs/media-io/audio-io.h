@@ -29,6 +29,7 @@ extern "C" {
 #define MAX_AUDIO_CHANNELS 8
 #define MAX_DEVICE_INPUT_CHANNELS 64
 #define AUDIO_OUTPUT_FRAMES 1024
+#define MIN_AUDIO_OUTPUT_FRAMES 64
 
 #define TOTAL_AUDIO_SIZE                                              \
 	(MAX_AUDIO_MIXES * MAX_AUDIO_CHANNELS * AUDIO_OUTPUT_FRAMES * \
@@ -218,6 +219,13 @@ static inline uint64_t ns_to_audio_frames(size_t sample_rate, uint64_t frames)
 #define AUDIO_OUTPUT_FAIL -2
 
 EXPORT int audio_output_open(audio_t **audio, struct audio_output_info *info);
+
+/* tick_frames is the number of frames per audio tick, between
+ * MIN_AUDIO_OUTPUT_FRAMES and AUDIO_OUTPUT_FRAMES, or 0 for the default of
+ * AUDIO_OUTPUT_FRAMES.  buffers are always sized for AUDIO_OUTPUT_FRAMES,
+ * this only shortens ticks */
+EXPORT int audio_output_open2(audio_t **audio, struct audio_output_info *info,
+			      uint32_t tick_frames);
 EXPORT void audio_output_close(audio_t *audio);
 
 typedef void (*audio_output_callback_t)(void *param, size_t mix_idx,
@@ -238,6 +246,8 @@ EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
+EXPORT uint32_t audio_output_get_tick_frames(const audio_t *audio);
+EXPORT uint64_t audio_output_get_conversions_saved(const audio_t *audio);
 
 #ifdef __cplusplus
 }
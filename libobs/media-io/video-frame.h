@@ -63,6 +63,11 @@ EXPORT void video_frame_copy(struct video_frame *dst,
 			     const struct video_frame *src,
 			     enum video_format format, uint32_t height);
 
+/* assumes already-zeroed array */
+EXPORT void video_frame_get_plane_heights(uint32_t heights[MAX_AV_PLANES],
+					  enum video_format format,
+					  uint32_t height);
+
 #ifdef __cplusplus
 }
 #endif
@@ -49,7 +49,7 @@ static inline void mix_audio(struct audio_output_data *mixes,
 			     obs_source_t *source, size_t channels,
 			     size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.tick_frames;
 	size_t start_point = 0;
 
 	if (source->audio_ts < ts->start || ts->end <= source->audio_ts)
@@ -58,7 +58,7 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES)
+		if (start_point == obs->audio.tick_frames)
 			return;
 
 		total_floats -= start_point;
@@ -192,16 +192,14 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
+#define MAX_AUDIO_SIZE (obs->audio.tick_frames * sizeof(float))
 
 static inline void discard_audio(struct obs_core_audio *audio,
 				 obs_source_t *source, size_t channels,
 				 size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = audio->tick_frames;
 	size_t size;
-	/* debug assert only */
-	UNUSED_PARAMETER(audio);
 
 #if DEBUG_AUDIO == 1
 	bool is_audio_source = source->info.output_flags & OBS_SOURCE_AUDIO;
@@ -252,7 +250,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == audio->tick_frames) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't discard, start point is "
@@ -313,7 +311,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 	ticks = audio->max_buffering_ticks - audio->total_buffering_ticks;
 	audio->total_buffering_ticks += ticks;
 
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	total_ms = audio->total_buffering_ticks * audio->tick_frames * 1000 /
 		   sample_rate;
 
 	blog(LOG_INFO,
@@ -324,7 +322,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 	new_ts.start =
 		audio->buffered_ts -
 		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+							audio->tick_frames);
 
 	while (ticks--) {
 		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
@@ -333,7 +331,7 @@ static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 		new_ts.start =
 			audio->buffered_ts -
 			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+					   cur_ticks * audio->tick_frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
@@ -366,7 +364,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + audio->tick_frames - 1) / audio->tick_frames);
 
 	audio->total_buffering_ticks += ticks;
 
@@ -377,8 +375,8 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * audio->tick_frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * audio->tick_frames * 1000 /
 		   sample_rate;
 
 	blog(LOG_INFO,
@@ -398,7 +396,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	new_ts.start =
 		audio->buffered_ts -
 		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+							audio->tick_frames);
 
 	while (ticks--) {
 		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
@@ -407,7 +405,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		new_ts.start =
 			audio->buffered_ts -
 			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+					   cur_ticks * audio->tick_frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
@@ -424,7 +422,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 static bool audio_buffer_insufficient(struct obs_source *source,
 				      size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.tick_frames;
 	size_t size;
 
 	if (source->info.audio_render || source->audio_pending ||
@@ -435,7 +433,7 @@ static bool audio_buffer_insufficient(struct obs_source *source,
 	if (source->audio_ts != min_ts && source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(
 			sample_rate, source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= obs->audio.tick_frames)
 			return false;
 
 		total_floats -= start_point;
@@ -498,6 +496,270 @@ static inline void release_audio_sources(struct obs_core_audio *audio)
 		obs_source_release(audio->render_order.array[i]);
 }
 
+static void render_audio_source(obs_source_t *source,
+				const struct obs_audio_dsp_tick *tick)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	uint64_t start = os_gettime_ns();
+
+	obs_source_audio_render(source, tick->mixers, tick->channels,
+				tick->sample_rate, tick->size);
+
+	/* if a source has gone backward in time and we can no
+	 * longer buffer, drop some or all of its audio */
+	if (audio_buffering_maxed(audio) && source->audio_ts != 0 &&
+	    source->audio_ts < tick->start_ts) {
+		if (source->info.audio_render) {
+			blog(LOG_DEBUG,
+			     "render audio source %s timestamp has "
+			     "gone backwards",
+			     obs_source_get_name(source));
+
+			/* just avoid further damage */
+			source->audio_pending = true;
+#if DEBUG_AUDIO == 1
+			/* this should really be fixed */
+			assert(false);
+#endif
+		} else {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			bool rerender = ignore_audio(source, tick->channels,
+						     tick->sample_rate,
+						     tick->start_ts);
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+
+			/* if we (potentially) recovered, re-render */
+			if (rerender)
+				obs_source_audio_render(source, tick->mixers,
+							tick->channels,
+							tick->sample_rate,
+							tick->size);
+		}
+	}
+
+	source->audio_dsp_time = os_gettime_ns() - start;
+}
+
+/* ------------------------------------------------------------------------- */
+/* DSP worker pool                                                           */
+
+/* claims and renders one job of the current batch; must be called with
+ * dsp_mutex held, which is released while the source renders */
+static bool run_dsp_job(struct obs_core_audio *audio)
+{
+	obs_source_t *source;
+
+	if (audio->dsp_next_job >= audio->dsp_jobs.num)
+		return false;
+
+	source = audio->dsp_jobs.array[audio->dsp_next_job++];
+	pthread_mutex_unlock(&audio->dsp_mutex);
+
+	render_audio_source(source, &audio->dsp_tick);
+
+	pthread_mutex_lock(&audio->dsp_mutex);
+	if (--audio->dsp_jobs_remaining == 0)
+		pthread_cond_signal(&audio->dsp_done_cond);
+	return true;
+}
+
+static void *audio_dsp_thread(void *param)
+{
+	struct obs_core_audio *audio = param;
+	uint64_t generation = 0;
+
+	os_set_thread_name("audio-io: dsp worker");
+
+	pthread_mutex_lock(&audio->dsp_mutex);
+
+	for (;;) {
+		/* wait for a batch that has not been seen yet; a worker that
+		 * wakes late finds the batch fully claimed and waits again */
+		while (!audio->dsp_stop && audio->dsp_generation == generation)
+			pthread_cond_wait(&audio->dsp_cond, &audio->dsp_mutex);
+		if (audio->dsp_stop)
+			break;
+
+		generation = audio->dsp_generation;
+
+		while (run_dsp_job(audio))
+			;
+	}
+
+	pthread_mutex_unlock(&audio->dsp_mutex);
+	return NULL;
+}
+
+bool obs_audio_dsp_init(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	int cores = os_get_physical_cores();
+
+	pthread_mutex_init_value(&audio->dsp_mutex);
+	if (pthread_mutex_init(&audio->dsp_mutex, NULL) != 0)
+		return false;
+	if (pthread_cond_init(&audio->dsp_cond, NULL) != 0) {
+		pthread_mutex_destroy(&audio->dsp_mutex);
+		return false;
+	}
+	if (pthread_cond_init(&audio->dsp_done_cond, NULL) != 0) {
+		pthread_cond_destroy(&audio->dsp_cond);
+		pthread_mutex_destroy(&audio->dsp_mutex);
+		return false;
+	}
+
+	audio->dsp_initialized = true;
+
+	/* the audio thread takes part in rendering itself, so leave a core
+	 * for it and keep the pool small; most ticks only have a handful
+	 * of sources */
+	size_t count = cores > 1 ? (size_t)cores - 1 : 0;
+	if (count > 4)
+		count = 4;
+
+	audio->dsp_threads = bzalloc(sizeof(pthread_t) * (count ? count : 1));
+	for (size_t i = 0; i < count; i++) {
+		if (pthread_create(&audio->dsp_threads[i], NULL,
+				   audio_dsp_thread, audio) != 0) {
+			blog(LOG_WARNING, "Failed to create audio DSP thread");
+			break;
+		}
+		audio->dsp_thread_count++;
+	}
+
+	return true;
+}
+
+void obs_audio_dsp_free(void)
+{
+	struct obs_core_audio *audio = &obs->audio;
+
+	if (!audio->dsp_initialized)
+		return;
+
+	pthread_mutex_lock(&audio->dsp_mutex);
+	audio->dsp_stop = true;
+	pthread_cond_broadcast(&audio->dsp_cond);
+	pthread_mutex_unlock(&audio->dsp_mutex);
+
+	for (size_t i = 0; i < audio->dsp_thread_count; i++)
+		pthread_join(audio->dsp_threads[i], NULL);
+
+	bfree(audio->dsp_threads);
+	da_free(audio->dsp_pending);
+	da_free(audio->dsp_serial);
+	da_free(audio->dsp_jobs);
+	pthread_cond_destroy(&audio->dsp_done_cond);
+	pthread_cond_destroy(&audio->dsp_cond);
+	pthread_mutex_destroy(&audio->dsp_mutex);
+	audio->dsp_initialized = false;
+}
+
+/* renders dsp_pending on the pool and dsp_serial on the audio thread, and
+ * returns once every job has finished */
+static void run_dsp_jobs(struct obs_core_audio *audio)
+{
+	size_t num = audio->dsp_pending.num;
+
+	if (num <= 1 || !audio->dsp_thread_count) {
+		for (size_t i = 0; i < num; i++)
+			render_audio_source(audio->dsp_pending.array[i],
+					    &audio->dsp_tick);
+		for (size_t i = 0; i < audio->dsp_serial.num; i++)
+			render_audio_source(audio->dsp_serial.array[i],
+					    &audio->dsp_tick);
+		return;
+	}
+
+	/* publish the batch; workers only read the job list under the
+	 * mutex, so swapping the arrays never races with a late worker */
+	pthread_mutex_lock(&audio->dsp_mutex);
+	da_move(audio->dsp_jobs, audio->dsp_pending);
+	audio->dsp_next_job = 0;
+	audio->dsp_jobs_remaining = num;
+	audio->dsp_generation++;
+	pthread_cond_broadcast(&audio->dsp_cond);
+	pthread_mutex_unlock(&audio->dsp_mutex);
+
+	/* sources with their own audio_render or audio_mix callback stay on
+	 * the audio thread, as third party callbacks may expect to run there */
+	for (size_t i = 0; i < audio->dsp_serial.num; i++)
+		render_audio_source(audio->dsp_serial.array[i],
+				    &audio->dsp_tick);
+
+	pthread_mutex_lock(&audio->dsp_mutex);
+	while (run_dsp_job(audio))
+		;
+	while (audio->dsp_jobs_remaining)
+		pthread_cond_wait(&audio->dsp_done_cond, &audio->dsp_mutex);
+
+	/* keep the job array's allocation around for the next batch */
+	da_move(audio->dsp_pending, audio->dsp_jobs);
+	pthread_mutex_unlock(&audio->dsp_mutex);
+}
+
+static void get_child_level(obs_source_t *parent, obs_source_t *child,
+			    void *param)
+{
+	int *level = param;
+
+	if (child->audio_render_level >= *level)
+		*level = child->audio_render_level + 1;
+
+	UNUSED_PARAMETER(parent);
+}
+
+/* Sources that render their own audio (scenes, transitions) read the
+ * output of their children, everything else only touches its own buffers.
+ * Each source gets a level one above its deepest child, and all sources
+ * of a level are rendered before moving on to the next.  The render order
+ * lists children before their parents, so a single pass is enough to
+ * assign the levels.
+ *
+ * Only the copy, volume and mixer routing of plain sources runs on the
+ * pool.  Their filters already ran on the thread that output the audio,
+ * and sources with audio_render or audio_mix callbacks are rendered on
+ * the audio thread while the pool works through the rest of the level. */
+static void render_audio_sources(struct obs_core_audio *audio,
+				 const struct obs_audio_dsp_tick *tick)
+{
+	int max_level = 0;
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		int level = 0;
+
+		if (source->info.audio_render)
+			obs_source_enum_active_sources(source, get_child_level,
+						       &level);
+
+		source->audio_render_level = level;
+		if (level > max_level)
+			max_level = level;
+	}
+
+	audio->dsp_tick = *tick;
+
+	for (int level = 0; level <= max_level; level++) {
+		da_resize(audio->dsp_pending, 0);
+		da_resize(audio->dsp_serial, 0);
+
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+			if (source->audio_render_level != level)
+				continue;
+
+			if (source->info.audio_render ||
+			    source->info.audio_mix)
+				da_push_back(audio->dsp_serial, &source);
+			else
+				da_push_back(audio->dsp_pending, &source);
+		}
+
+		run_dsp_jobs(audio);
+	}
+}
+
 static inline void execute_audio_tasks(void)
 {
 	struct obs_core_audio *audio = &obs->audio;
@@ -535,7 +797,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	deque_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	audio_size = audio->tick_frames * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
@@ -583,43 +845,14 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-
-		/* if a source has gone backward in time and we can no
-		 * longer buffer, drop some or all of its audio */
-		if (audio_buffering_maxed(audio) && source->audio_ts != 0 &&
-		    source->audio_ts < ts.start) {
-			if (source->info.audio_render) {
-				blog(LOG_DEBUG,
-				     "render audio source %s timestamp has "
-				     "gone backwards",
-				     obs_source_get_name(source));
-
-				/* just avoid further damage */
-				source->audio_pending = true;
-#if DEBUG_AUDIO == 1
-				/* this should really be fixed */
-				assert(false);
-#endif
-			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
-				bool rerender = ignore_audio(source, channels,
-							     sample_rate,
-							     ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
-
-				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers,
-								channels,
-								sample_rate,
-								audio_size);
-			}
-		}
-	}
+	struct obs_audio_dsp_tick tick = {
+		.mixers = mixers,
+		.channels = channels,
+		.sample_rate = sample_rate,
+		.size = audio_size,
+		.start_ts = ts.start,
+	};
+	render_audio_sources(audio, &tick);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -147,6 +147,9 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static bool start_audio_encode_thread(struct obs_encoder *encoder);
+static void stop_audio_encode_thread(struct obs_encoder *encoder);
+static void free_audio_encode_queue(struct obs_encoder *encoder);
 
 static inline void get_audio_info(const struct obs_encoder *encoder,
 				  struct audio_convert_info *info)
@@ -309,6 +312,9 @@ static void add_connection(struct obs_encoder *encoder)
 		struct audio_convert_info audio_info = {0};
 		get_audio_info(encoder, &audio_info);
 
+		if (!start_audio_encode_thread(encoder))
+			return;
+
 		audio_output_connect(encoder->media, encoder->mixer_idx,
 				     &audio_info, receive_audio, encoder);
 	} else {
@@ -343,6 +349,7 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		audio_output_disconnect(encoder->media, encoder->mixer_idx,
 					receive_audio, encoder);
+		stop_audio_encode_thread(encoder);
 	} else {
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
@@ -412,6 +419,8 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 			}
 		}
 
+		stop_audio_encode_thread(encoder);
+		free_audio_encode_queue(encoder);
 		free_audio_buffers(encoder);
 
 		if (encoder->context.data)
@@ -423,6 +432,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
 		pthread_mutex_destroy(&encoder->roi_mutex);
+		os_sem_destroy(encoder->audio_encode_sem);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
@@ -1710,11 +1720,10 @@ bool audio_pause_check(struct pause_data *pause, struct audio_data *data,
 }
 
 static const char *receive_audio_name = "receive_audio";
-static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
+static void encode_audio(struct obs_encoder *encoder, struct audio_data *in)
 {
 	profile_start(receive_audio_name);
 
-	struct obs_encoder *encoder = param;
 	struct audio_data audio = *in;
 
 	if (!encoder->first_received) {
@@ -1736,12 +1745,319 @@ static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
 		}
 	}
 
-	UNUSED_PARAMETER(mix_idx);
-
 end:
 	profile_end(receive_audio_name);
 }
 
+/* at most this much audio is queued for an encoder; audio that arrives
+ * while a stalled encoder has this much queued is replaced by silence */
+#define AUDIO_ENCODE_QUEUE_MAX_SEC 2
+
+/* queue depth buckets, recorded as profiler scopes around each encode so
+ * the profiler shows how far behind the encoder thread runs */
+static const char *audio_encode_depth_names[] = {
+	"queue depth 1",
+	"queue depth 2-3",
+	"queue depth 4-7",
+	"queue depth 8+",
+};
+
+static inline const char *get_depth_name(size_t depth)
+{
+	size_t bucket = depth >= 8 ? 3 : depth >= 4 ? 2 : depth >= 2 ? 1 : 0;
+	return audio_encode_depth_names[bucket];
+}
+
+static inline size_t ring_used(volatile long *read, volatile long *write,
+			       size_t size)
+{
+	size_t r = (size_t)os_atomic_load_long(read);
+	size_t w = (size_t)os_atomic_load_long(write);
+	return w >= r ? w - r : size - r + w;
+}
+
+static void encode_audio_silence(struct obs_encoder *encoder,
+				 uint64_t timestamp, size_t frames)
+{
+	struct audio_encode_queue *queue = &encoder->audio_encode_queue;
+	struct audio_data audio = {0};
+	size_t done = 0;
+
+	for (size_t i = 0; i < encoder->planes; i++)
+		audio.data[i] = queue->silence;
+
+	while (done < frames) {
+		size_t count = frames - done;
+		if (count > queue->silence_frames)
+			count = queue->silence_frames;
+
+		audio.frames = (uint32_t)count;
+		audio.timestamp = timestamp +
+				  util_mul_div64(done, 1000000000ULL,
+						 encoder->samplerate);
+		encode_audio(encoder, &audio);
+		done += count;
+	}
+}
+
+static void encode_audio_block(struct obs_encoder *encoder,
+			       const struct audio_encode_block *block)
+{
+	struct audio_encode_queue *queue = &encoder->audio_encode_queue;
+	struct audio_data audio = {0};
+	size_t first = queue->frames - block->offset;
+
+	if (first > block->frames)
+		first = block->frames;
+
+	for (size_t i = 0; i < encoder->planes; i++)
+		audio.data[i] =
+			queue->data[i] + block->offset * encoder->blocksize;
+	audio.frames = (uint32_t)first;
+	audio.timestamp = block->timestamp;
+	encode_audio(encoder, &audio);
+
+	/* the rest of a block that wraps around the end of the queue */
+	if (first < block->frames) {
+		for (size_t i = 0; i < encoder->planes; i++)
+			audio.data[i] = queue->data[i];
+		audio.frames = block->frames - (uint32_t)first;
+		audio.timestamp = block->timestamp +
+				  util_mul_div64(first, 1000000000ULL,
+						 encoder->samplerate);
+		encode_audio(encoder, &audio);
+	}
+}
+
+static void *audio_encode_thread(void *param)
+{
+	struct obs_encoder *encoder = param;
+	struct audio_encode_queue *queue = &encoder->audio_encode_queue;
+
+	os_set_thread_name("obs audio encode thread");
+
+	while (os_sem_wait(encoder->audio_encode_sem) == 0) {
+		size_t depth = ring_used(&queue->block_read,
+					 &queue->block_write,
+					 queue->num_blocks);
+
+		/* the queue is drained before stopping, so stopping yields
+		 * exactly the packets that encoding inline would have */
+		if (!depth) {
+			if (os_atomic_load_bool(&encoder->audio_encode_stop))
+				break;
+			continue;
+		}
+
+		size_t idx = (size_t)os_atomic_load_long(&queue->block_read);
+		struct audio_encode_block block = queue->blocks[idx];
+		const char *depth_name = get_depth_name(depth);
+
+		profile_start(encoder->profile_audio_encode_thread_name);
+		profile_start(depth_name);
+		if (block.gap_frames)
+			encode_audio_silence(encoder, block.gap_timestamp,
+					     block.gap_frames);
+		encode_audio_block(encoder, &block);
+		profile_end(depth_name);
+		profile_end(encoder->profile_audio_encode_thread_name);
+
+		os_atomic_set_long(&queue->frame_read,
+				   (long)((block.offset + block.frames) %
+					  queue->frames));
+		os_atomic_set_long(&queue->block_read,
+				   (long)((idx + 1) % queue->num_blocks));
+
+		if (encoder->audio_encode_abort)
+			break;
+	}
+
+	return NULL;
+}
+
+static void free_audio_encode_queue(struct obs_encoder *encoder)
+{
+	struct audio_encode_queue *queue = &encoder->audio_encode_queue;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		bfree(queue->data[i]);
+	bfree(queue->blocks);
+	bfree(queue->silence);
+	memset(queue, 0, sizeof(*queue));
+}
+
+static void alloc_audio_encode_queue(struct obs_encoder *encoder)
+{
+	struct audio_encode_queue *queue = &encoder->audio_encode_queue;
+	size_t tick_frames = audio_output_get_tick_frames(encoder->media);
+
+	free_audio_encode_queue(encoder);
+
+	/* one frame and one block stay unused to tell a full ring from an
+	 * empty one */
+	queue->frames =
+		(size_t)encoder->samplerate * AUDIO_ENCODE_QUEUE_MAX_SEC + 1;
+	queue->num_blocks = queue->frames / (tick_frames ? tick_frames : 1);
+	queue->num_blocks = queue->num_blocks * 2 + 2;
+	queue->silence_frames = tick_frames ? tick_frames : 1024;
+
+	for (size_t i = 0; i < encoder->planes; i++)
+		queue->data[i] = bmalloc(queue->frames * encoder->blocksize);
+	queue->blocks = bmalloc(queue->num_blocks * sizeof(*queue->blocks));
+	queue->silence = bzalloc(queue->silence_frames * encoder->blocksize);
+}
+
+static bool start_audio_encode_thread(struct obs_encoder *encoder)
+{
+	/* a previous thread that stopped itself after an encode error is
+	 * still waiting to be joined */
+	stop_audio_encode_thread(encoder);
+
+	if (!encoder->audio_encode_sem &&
+	    os_sem_init(&encoder->audio_encode_sem, 0) != 0) {
+		blog(LOG_ERROR, "Failed to create audio encode semaphore for "
+				"encoder '%s'",
+		     encoder->context.name);
+		return false;
+	}
+
+	if (!encoder->profile_audio_encode_thread_name)
+		encoder->profile_audio_encode_thread_name =
+			profile_store_name(obs_get_profiler_name_store(),
+					   "audio_encode_thread(%s)",
+					   encoder->context.name);
+
+	alloc_audio_encode_queue(encoder);
+	encoder->audio_encode_queue_peak = 0;
+	encoder->audio_encode_silence_frames = 0;
+	encoder->audio_encode_abort = false;
+	os_atomic_set_bool(&encoder->audio_encode_stop, false);
+
+	if (pthread_create(&encoder->audio_encode_thread, NULL,
+			   audio_encode_thread, encoder) != 0) {
+		blog(LOG_ERROR, "Failed to create audio encode thread for "
+				"encoder '%s'",
+		     encoder->context.name);
+		free_audio_encode_queue(encoder);
+		return false;
+	}
+
+	encoder->audio_encode_thread_initialized = true;
+	return true;
+}
+
+static void stop_audio_encode_thread(struct obs_encoder *encoder)
+{
+	if (!encoder->audio_encode_thread_initialized)
+		return;
+
+	os_atomic_set_bool(&encoder->audio_encode_stop, true);
+
+	/* encode errors stop the encoder from within its own thread; skip
+	 * what is left and let the thread exit.  the queue stays allocated
+	 * until the thread is joined on restart or destruction. */
+	if (pthread_equal(pthread_self(), encoder->audio_encode_thread)) {
+		encoder->audio_encode_abort = true;
+		return;
+	}
+
+	os_sem_post(encoder->audio_encode_sem);
+	pthread_join(encoder->audio_encode_thread, NULL);
+	encoder->audio_encode_thread_initialized = false;
+
+	free_audio_encode_queue(encoder);
+
+	blog(LOG_DEBUG, "encoder '%s': peak audio encode queue depth: %zu",
+	     encoder->context.name, encoder->audio_encode_queue_peak);
+
+	if (encoder->audio_encode_silence_frames)
+		blog(LOG_WARNING,
+		     "encoder '%s': replaced %zu audio frames with silence "
+		     "because the encoder could not keep up",
+		     encoder->context.name,
+		     encoder->audio_encode_silence_frames);
+}
+
+/* called on the audio thread; copies the data into the preallocated queue
+ * and hands it off to the encoder's thread so slow encoders do not hold up
+ * audio output.  audio that does not fit is accounted for as a gap that the
+ * encoder's thread fills with silence, which keeps the frame counted pts of
+ * the encoder in step with the audio timestamps. */
+static void receive_audio(void *param, size_t mix_idx, struct audio_data *in)
+{
+	struct obs_encoder *encoder = param;
+	struct audio_encode_queue *queue = &encoder->audio_encode_queue;
+	size_t frames_used;
+	size_t blocks_used;
+
+	if (!queue->frames || !in->frames)
+		return;
+
+	frames_used = ring_used(&queue->frame_read, &queue->frame_write,
+				queue->frames);
+	blocks_used = ring_used(&queue->block_read, &queue->block_write,
+				queue->num_blocks);
+
+	if (frames_used + in->frames >= queue->frames ||
+	    blocks_used + 1 >= queue->num_blocks) {
+		if (!queue->gap_frames) {
+			queue->gap_timestamp = in->timestamp;
+			blog(LOG_WARNING,
+			     "encoder '%s': audio encode queue is full "
+			     "(%d seconds), inserting silence",
+			     encoder->context.name,
+			     AUDIO_ENCODE_QUEUE_MAX_SEC);
+		}
+		queue->gap_frames += in->frames;
+		return;
+	}
+
+	size_t w = (size_t)os_atomic_load_long(&queue->frame_write);
+	size_t first = queue->frames - w;
+	if (first > in->frames)
+		first = in->frames;
+
+	size_t first_size = first * encoder->blocksize;
+	size_t rest_size = (in->frames - first) * encoder->blocksize;
+
+	for (size_t i = 0; i < encoder->planes; i++) {
+		uint8_t *dst = queue->data[i] + w * encoder->blocksize;
+
+		if (in->data[i]) {
+			memcpy(dst, in->data[i], first_size);
+			memcpy(queue->data[i], in->data[i] + first_size,
+			       rest_size);
+		} else {
+			memset(dst, 0, first_size);
+			memset(queue->data[i], 0, rest_size);
+		}
+	}
+
+	size_t idx = (size_t)os_atomic_load_long(&queue->block_write);
+	struct audio_encode_block *block = &queue->blocks[idx];
+
+	block->timestamp = in->timestamp;
+	block->frames = in->frames;
+	block->offset = w;
+	block->gap_timestamp = queue->gap_timestamp;
+	block->gap_frames = queue->gap_frames;
+
+	encoder->audio_encode_silence_frames += queue->gap_frames;
+	queue->gap_frames = 0;
+
+	os_atomic_set_long(&queue->frame_write,
+			   (long)((w + in->frames) % queue->frames));
+	os_atomic_set_long(&queue->block_write,
+			   (long)((idx + 1) % queue->num_blocks));
+
+	if (blocks_used + 1 > encoder->audio_encode_queue_peak)
+		encoder->audio_encode_queue_peak = blocks_used + 1;
+
+	os_sem_post(encoder->audio_encode_sem);
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
 void obs_encoder_add_output(struct obs_encoder *encoder,
 			    struct obs_output *output)
 {
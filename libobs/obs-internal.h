@@ -277,6 +277,11 @@ struct obs_core_video_mix {
 	gs_texture_t *output_texture;
 	enum gs_color_space render_space;
 	bool texture_rendered;
+	bool output_texture_rendered;
+
+	/* earlier mix whose canvas this mix shares for the current frame
+	 * instead of rendering its own render_texture, or NULL */
+	struct obs_core_video_mix *canvas_mix;
 	bool textures_copied[NUM_TEXTURES];
 	bool texture_converted;
 	bool using_nv12_tex;
@@ -367,18 +372,32 @@ struct obs_core_video {
 	pthread_mutex_t mixes_mutex;
 	DARRAY(struct obs_core_video_mix *) mixes;
 	struct obs_core_video_mix *main_mix;
+
+	/* base size of the mix currently being rendered on the graphics
+	 * thread (0 when not rendering a mix), used for scene culling */
+	uint32_t render_mix_cx;
+	uint32_t render_mix_cy;
 };
 
 extern void add_ready_encoder_group(obs_encoder_t *encoder);
 
 struct audio_monitor;
 
+struct obs_audio_dsp_tick {
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t size;
+	uint64_t start_ts;
+};
+
 struct obs_core_audio {
 	audio_t *audio;
 
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
 
+	size_t tick_frames;
 	uint64_t buffered_ts;
 	struct deque buffered_timestamps;
 	uint64_t buffering_wait_ticks;
@@ -390,11 +409,35 @@ struct obs_core_audio {
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
+	bool monitoring_bus;
 
 	pthread_mutex_t task_mutex;
 	struct deque tasks;
+
+	/* worker pool that renders the buffers of independent plain sources
+	 * of a tick in parallel, see render_audio_sources.  a batch of jobs
+	 * is built in dsp_pending by the audio thread and published into
+	 * dsp_jobs under dsp_mutex, which also guards the job index, the
+	 * remaining count and the generation that wakes the workers */
+	pthread_t *dsp_threads;
+	size_t dsp_thread_count;
+	pthread_cond_t dsp_cond;
+	pthread_cond_t dsp_done_cond;
+	pthread_mutex_t dsp_mutex;
+	bool dsp_initialized;
+	bool dsp_stop;
+	DARRAY(struct obs_source *) dsp_pending;
+	DARRAY(struct obs_source *) dsp_serial;
+	DARRAY(struct obs_source *) dsp_jobs;
+	size_t dsp_next_job;
+	size_t dsp_jobs_remaining;
+	uint64_t dsp_generation;
+	struct obs_audio_dsp_tick dsp_tick;
 };
 
+extern bool obs_audio_dsp_init(void);
+extern void obs_audio_dsp_free(void);
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	/* Hash tables (uthash) */
@@ -660,6 +703,16 @@ struct async_frame {
 	struct obs_source_frame *frame;
 	long unused_count;
 	bool used;
+	bool dmabuf;
+};
+
+/* frames output with obs_source_output_video_dmabuf carry their planes
+ * instead of data */
+#define OBS_SOURCE_FRAME_DMABUF OBS_SOURCE_FRAME_RESERVED_7
+
+struct async_dmabuf_frame {
+	struct obs_source_frame frame;
+	struct obs_source_frame_dmabuf dmabuf;
 };
 
 enum audio_action_type {
@@ -752,6 +805,10 @@ struct obs_source {
 	/* hint to allow sources to render more quickly */
 	bool texcoords_centered;
 
+	/* incremented whenever the video of a static content source (or of
+	 * one of its filters) changes */
+	volatile long content_version;
+
 	/* timing (if video is present, is based upon video) */
 	volatile bool timing_set;
 	volatile uint64_t timing_adjust;
@@ -765,6 +822,8 @@ struct obs_source {
 	/* audio */
 	bool audio_failed;
 	bool audio_pending;
+	int audio_render_level;
+	uint64_t audio_dsp_time;
 	bool pending_stop;
 	bool audio_active;
 	bool user_muted;
@@ -813,6 +872,8 @@ struct obs_source {
 	bool async_update_texture;
 	bool async_unbuffered;
 	bool async_decoupled;
+	bool async_render_clock;
+	bool async_dmabuf_failed;
 	struct obs_source_frame *async_preload_frame;
 	DARRAY(struct async_frame) async_cache;
 	DARRAY(struct obs_source_frame *) async_frames;
@@ -931,6 +992,8 @@ obs_source_create_set_last_ver(const char *id, const char *name,
 			       obs_data_t *hotkey_data, uint32_t last_obs_ver,
 			       bool is_private);
 extern void obs_source_destroy(struct obs_source *source);
+extern bool obs_source_video_opaque(obs_source_t *source);
+extern void obs_source_video_render_culled(obs_source_t *source);
 
 enum view_type {
 	MAIN_VIEW,
@@ -1059,10 +1122,47 @@ enum delay_msg {
 	DELAY_MSG_STOP,
 };
 
+struct delay_segment;
+
 struct delay_data {
 	enum delay_msg msg;
 	uint64_t ts;
 	struct encoder_packet packet;
+
+	/* if set, the packet data was spilled to this segment file */
+	struct delay_segment *segment;
+	int64_t offset;
+};
+
+/* a packet being spilled to or read back from disk outside of
+ * delay_mutex */
+struct delay_io {
+	struct delay_segment *segment;
+	int64_t offset;
+	struct encoder_packet packet;
+};
+
+/* With a memory limit, the delay queue is split in three regions: the
+ * packets about to be sent (head) and the most recently received packets
+ * (tail) stay in memory, everything in between is spilled to append-only
+ * segment files and read back when it reaches the head.  Disk I/O runs
+ * without delay_mutex, by one thread at a time: the thread that set
+ * io_active owns the segments, and the claimed entries stay in place
+ * until it publishes them. */
+struct delay_spill {
+	DARRAY(struct delay_segment *) segments;
+	DARRAY(struct delay_io) loads;
+	DARRAY(struct delay_io) stores;
+	char *dir;
+	size_t head_count;
+	size_t spill_count;
+	size_t head_bytes;
+	size_t tail_bytes;
+	bool io_active;
+
+	size_t resident_peak;
+	uint64_t spilled_bytes;
+	bool failed;
 };
 
 typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
@@ -1192,6 +1292,10 @@ struct obs_output {
 	uint32_t delay_sec;
 	uint32_t delay_flags;
 	uint32_t delay_cur_flags;
+	size_t delay_mem_limit;
+	size_t delay_cur_mem_limit;
+	char *delay_spill_path;
+	struct delay_spill delay_spill;
 	volatile long delay_restart_refs;
 	volatile bool delay_active;
 	volatile bool delay_capturing;
@@ -1212,6 +1316,7 @@ static inline void do_output_signal(struct obs_output *output,
 
 extern void process_delay(void *data, struct encoder_packet *packet);
 extern void obs_output_cleanup_delay(obs_output_t *output);
+extern void obs_output_init_delay_spill(obs_output_t *output);
 extern bool obs_output_delay_start(obs_output_t *output);
 extern void obs_output_delay_stop(obs_output_t *output);
 extern bool obs_output_actual_start(obs_output_t *output);
@@ -1223,9 +1328,6 @@ extern const struct obs_output_info *find_output(const char *id);
 extern void obs_output_remove_encoder(struct obs_output *output,
 				      struct obs_encoder *encoder);
 
-extern void
-obs_encoder_packet_create_instance(struct encoder_packet *dst,
-				   const struct encoder_packet *src);
 void obs_output_destroy(obs_output_t *output);
 
 /* ------------------------------------------------------------------------- */
@@ -1249,6 +1351,40 @@ struct encoder_group {
 	uint64_t start_timestamp;
 };
 
+/* a block of audio waiting in an encoder's queue.  gap_frames of silence
+ * starting at gap_timestamp are encoded before the block itself, in place
+ * of audio that did not fit into the queue. */
+struct audio_encode_block {
+	uint64_t timestamp;
+	uint32_t frames;
+	size_t offset;
+
+	uint64_t gap_timestamp;
+	size_t gap_frames;
+};
+
+/* single producer (the audio thread), single consumer (the encoder's audio
+ * thread) queue.  everything is allocated when the encoder starts, so the
+ * audio thread only copies samples and moves positions. */
+struct audio_encode_queue {
+	uint8_t *data[MAX_AV_PLANES];
+	size_t frames;
+	volatile long frame_read;
+	volatile long frame_write;
+
+	struct audio_encode_block *blocks;
+	size_t num_blocks;
+	volatile long block_read;
+	volatile long block_write;
+
+	uint8_t *silence;
+	size_t silence_frames;
+
+	/* producer only: audio that did not fit and is yet to be replaced */
+	uint64_t gap_timestamp;
+	size_t gap_frames;
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1304,6 +1440,17 @@ struct obs_encoder {
 	struct deque audio_input_buffer[MAX_AV_PLANES];
 	uint8_t *audio_output_buffer[MAX_AV_PLANES];
 
+	/* audio encoders run on their own thread, fed by the audio thread */
+	pthread_t audio_encode_thread;
+	bool audio_encode_thread_initialized;
+	volatile bool audio_encode_stop;
+	bool audio_encode_abort;
+	os_sem_t *audio_encode_sem;
+	struct audio_encode_queue audio_encode_queue;
+	size_t audio_encode_queue_peak;
+	size_t audio_encode_silence_frames;
+	const char *profile_audio_encode_thread_name;
+
 	/* if a video encoder is paired with an audio encoder, make it start
 	 * up at the specific timestamp.  if this is the audio encoder,
 	 * it waits until it's ready to sync up with video */
@@ -18,6 +18,18 @@
 #include <inttypes.h>
 #include "obs-internal.h"
 
+/* size after which a new segment file is started, so the disk space of
+ * segments that were fully read back can be released */
+#define DELAY_SEGMENT_SIZE (64 * 1024 * 1024)
+
+struct delay_segment {
+	FILE *file;
+	FILE *read_file;
+	char *path;
+	int64_t size;
+	size_t pending;
+};
+
 static inline bool delay_active(const struct obs_output *output)
 {
 	return os_atomic_load_bool(&output->delay_active);
@@ -44,6 +56,396 @@ static inline bool log_flag_encoded(const struct obs_output *output,
 	return ret;
 }
 
+/* ------------------------------------------------------------------------- */
+/* spilling to disk */
+
+static inline size_t delay_data_size(const struct delay_data *dd)
+{
+	return dd->msg == DELAY_MSG_PACKET ? dd->packet.size : 0;
+}
+
+static inline size_t delay_data_count(const struct obs_output *output)
+{
+	return output->delay_data.size / sizeof(struct delay_data);
+}
+
+static inline struct delay_data *delay_data_at(struct obs_output *output,
+					       size_t idx)
+{
+	return deque_data(&output->delay_data, idx * sizeof(struct delay_data));
+}
+
+static FILE *open_segment_file(struct obs_output *output,
+				struct delay_segment *segment)
+{
+	struct delay_spill *spill = &output->delay_spill;
+	struct dstr path = {0};
+
+	if (!spill->dir || os_mkdirs(spill->dir) == MKDIR_ERROR)
+		return NULL;
+
+	dstr_printf(&path, "%s/delay-%p-%" PRIu64 ".tmp", spill->dir,
+		    (void *)output, os_gettime_ns());
+
+	segment->file = os_fopen(path.array, "wb");
+	if (segment->file)
+		segment->read_file = os_fopen(path.array, "rb");
+
+	if (!segment->read_file) {
+		if (segment->file) {
+			fclose(segment->file);
+			os_unlink(path.array);
+		}
+		dstr_free(&path);
+		return NULL;
+	}
+
+	/* the reader seeks to each packet and segments are rewritten once
+	 * they have been read back, so nothing may be buffered on this side */
+	setvbuf(segment->read_file, NULL, _IONBF, 0);
+
+#ifndef _WIN32
+	/* the open handles keep the data until the segment is closed */
+	os_unlink(path.array);
+#endif
+	segment->path = path.array;
+	return segment->file;
+}
+
+static struct delay_segment *get_write_segment(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+	struct delay_segment *segment =
+		spill->segments.num
+			? spill->segments.array[spill->segments.num - 1]
+			: NULL;
+
+	if (segment && segment->size < DELAY_SEGMENT_SIZE)
+		return segment;
+
+	segment = bzalloc(sizeof(*segment));
+	if (!open_segment_file(output, segment)) {
+		blog(LOG_WARNING,
+		     "Output '%s': Failed to create delay segment file in "
+		     "'%s', keeping delayed packets in memory",
+		     output->context.name,
+		     spill->dir ? spill->dir : "(no directory)");
+		bfree(segment);
+		return NULL;
+	}
+
+	da_push_back(spill->segments, &segment);
+	return segment;
+}
+
+static void free_segment(struct obs_output *output,
+			 struct delay_segment *segment)
+{
+	da_erase_item(output->delay_spill.segments, &segment);
+	fclose(segment->file);
+	fclose(segment->read_file);
+#ifdef _WIN32
+	os_unlink(segment->path);
+#endif
+	bfree(segment->path);
+	bfree(segment);
+}
+
+/* call with delay_mutex held.  Claims the oldest packets of the tail until
+ * the tail fits in its half of the limit.  Returns true if the caller has
+ * to write them to disk and publish them. */
+static bool claim_tail_data(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+	size_t tail_limit = output->delay_cur_mem_limit / 2;
+
+	if (!output->delay_cur_mem_limit || spill->io_active ||
+	    spill->tail_bytes <= tail_limit)
+		return false;
+
+	da_resize(spill->stores, 0);
+
+	while (spill->tail_bytes > tail_limit) {
+		size_t idx = spill->head_count + spill->spill_count +
+			     spill->stores.num;
+		struct delay_data *dd = delay_data_at(output, idx);
+		struct delay_io *store = da_push_back_new(spill->stores);
+
+		if (dd->msg == DELAY_MSG_PACKET)
+			store->packet = dd->packet;
+		spill->tail_bytes -= delay_data_size(dd);
+	}
+
+	/* after a write error everything stays in memory */
+	if (spill->failed) {
+		spill->spill_count += spill->stores.num;
+		da_resize(spill->stores, 0);
+		return false;
+	}
+
+	spill->io_active = true;
+	return true;
+}
+
+/* called without delay_mutex, only the thread that claimed the packets
+ * touches the segments and the stores */
+static void write_tail_data(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	for (size_t i = 0; i < spill->stores.num; i++) {
+		struct delay_io *store = &spill->stores.array[i];
+		struct delay_segment *segment;
+
+		if (!store->packet.data || spill->failed)
+			continue;
+
+		segment = get_write_segment(output);
+		if (!segment) {
+			spill->failed = true;
+			continue;
+		}
+
+		if (os_fseeki64(segment->file, segment->size, SEEK_SET) != 0 ||
+		    fwrite(store->packet.data, 1, store->packet.size,
+			   segment->file) != store->packet.size) {
+			blog(LOG_WARNING,
+			     "Output '%s': Failed to write delay segment file, "
+			     "keeping delayed packets in memory",
+			     output->context.name);
+			spill->failed = true;
+			continue;
+		}
+
+		store->segment = segment;
+		store->offset = segment->size;
+		segment->size += (int64_t)store->packet.size;
+		segment->pending++;
+	}
+}
+
+/* call with delay_mutex held.  Moves the written packets from the tail into
+ * the spilled region and releases their data; packets that could not be
+ * written keep it and are sent from memory. */
+static void publish_tail_data(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	for (size_t i = 0; i < spill->stores.num; i++) {
+		struct delay_io *store = &spill->stores.array[i];
+		size_t idx = spill->head_count + spill->spill_count;
+		struct delay_data *dd = delay_data_at(output, idx);
+
+		spill->spill_count++;
+
+		if (!store->segment)
+			continue;
+
+		struct encoder_packet packet = dd->packet;
+		obs_encoder_packet_release(&dd->packet);
+		dd->packet = packet;
+		dd->packet.data = NULL;
+
+		dd->segment = store->segment;
+		dd->offset = store->offset;
+		spill->spilled_bytes += packet.size;
+	}
+
+	da_resize(spill->stores, 0);
+	spill->io_active = false;
+}
+
+/* call with delay_mutex held.  Claims the spilled packets that fit in the
+ * head, always at least one so the head can never stay empty. */
+static void claim_spilled_data(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+	size_t head_limit = output->delay_cur_mem_limit / 2;
+	struct delay_segment *flushed = NULL;
+	size_t bytes = 0;
+
+	da_resize(spill->loads, 0);
+
+	while (spill->loads.num < spill->spill_count &&
+	       (bytes < head_limit || !spill->loads.num)) {
+		struct delay_data *dd = delay_data_at(output, spill->loads.num);
+		struct delay_io *load = da_push_back_new(spill->loads);
+
+		load->segment = dd->segment;
+		load->offset = dd->offset;
+		load->packet = dd->packet;
+		bytes += delay_data_size(dd);
+
+		if (dd->segment && dd->segment != flushed) {
+			fflush(dd->segment->file);
+			flushed = dd->segment;
+		}
+	}
+}
+
+/* called without delay_mutex, only the refilling thread touches the
+ * segments and the loads */
+static void read_spilled_data(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	for (size_t i = 0; i < spill->loads.num; i++) {
+		struct delay_io *load = &spill->loads.array[i];
+		struct delay_segment *segment = load->segment;
+		struct encoder_packet packet;
+
+		if (!segment)
+			continue;
+
+		packet = load->packet;
+		packet.data = bmalloc(packet.size);
+
+		if (os_fseeki64(segment->read_file, load->offset, SEEK_SET) ==
+			    0 &&
+		    fread(packet.data, 1, packet.size, segment->read_file) ==
+			    packet.size) {
+			obs_encoder_packet_create_instance(&load->packet,
+							   &packet);
+		} else {
+			/* dropped in process_delay_data */
+			blog(LOG_ERROR,
+			     "Output '%s': Failed to read delayed packet back "
+			     "from disk",
+			     output->context.name);
+		}
+
+		bfree(packet.data);
+	}
+}
+
+/* call with delay_mutex held */
+static void publish_spilled_data(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	for (size_t i = 0; i < spill->loads.num; i++) {
+		struct delay_io *load = &spill->loads.array[i];
+		struct delay_segment *segment = load->segment;
+		struct delay_data *dd = delay_data_at(output, spill->head_count);
+
+		spill->head_bytes += delay_data_size(dd);
+		spill->head_count++;
+		spill->spill_count--;
+
+		if (!segment)
+			continue;
+
+		dd->packet = load->packet;
+		dd->segment = NULL;
+
+		if (--segment->pending == 0) {
+			size_t last = spill->segments.num - 1;
+
+			/* the segment still being written to is reused */
+			if (spill->segments.array[last] == segment)
+				segment->size = 0;
+			else
+				free_segment(output, segment);
+		}
+	}
+
+	da_resize(spill->loads, 0);
+}
+
+/* call with delay_mutex held.  Moves spilled packets back into memory once
+ * the head runs empty.  The mutex is released while reading from disk so
+ * the encoders are not stalled on I/O, and no packet can be popped until
+ * the refill is done.  Returns false if the head is still empty, which
+ * includes while another thread is writing to disk; that thread pops the
+ * packets once it is done. */
+static bool refill_head(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	if (spill->head_count)
+		return true;
+	if (spill->io_active)
+		return false;
+
+	if (spill->spill_count) {
+		claim_spilled_data(output);
+		spill->io_active = true;
+
+		pthread_mutex_unlock(&output->delay_mutex);
+		read_spilled_data(output);
+		pthread_mutex_lock(&output->delay_mutex);
+
+		publish_spilled_data(output);
+		spill->io_active = false;
+	}
+
+	/* nothing left on disk, the tail joins the head */
+	if (!spill->spill_count) {
+		spill->head_count = delay_data_count(output);
+		spill->head_bytes += spill->tail_bytes;
+		spill->tail_bytes = 0;
+	}
+
+	return spill->head_count != 0;
+}
+
+/* call with delay_mutex held */
+static void push_delay_data(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_spill *spill = &output->delay_spill;
+	size_t limit = output->delay_cur_mem_limit;
+	size_t size = delay_data_size(dd);
+
+	dd->segment = NULL;
+	dd->offset = 0;
+	deque_push_back(&output->delay_data, dd, sizeof(*dd));
+
+	if (!limit || (spill->head_count == delay_data_count(output) - 1 &&
+		       spill->head_bytes + size <= limit / 2)) {
+		spill->head_count++;
+		spill->head_bytes += size;
+	} else {
+		spill->tail_bytes += size;
+	}
+
+	size_t resident = spill->head_bytes + spill->tail_bytes;
+	if (resident > spill->resident_peak)
+		spill->resident_peak = resident;
+}
+
+/* call with delay_mutex held */
+static void pop_delay_data(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	deque_pop_front(&output->delay_data, dd, sizeof(*dd));
+	spill->head_bytes -= delay_data_size(dd);
+	spill->head_count--;
+}
+
+static void free_delay_spill(struct obs_output *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	if (spill->spilled_bytes)
+		blog(LOG_INFO,
+		     "Output '%s': %" PRIu64 " MB of delayed packets spilled "
+		     "to disk, peak delay memory usage %" PRIu64 " MB",
+		     output->context.name, spill->spilled_bytes / 1048576,
+		     (uint64_t)spill->resident_peak / 1048576);
+
+	while (spill->segments.num)
+		free_segment(output, spill->segments.array[0]);
+	da_free(spill->segments);
+	da_free(spill->loads);
+	da_free(spill->stores);
+	bfree(spill->dir);
+
+	memset(spill, 0, sizeof(*spill));
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void push_packet(struct obs_output *output,
 			       struct encoder_packet *packet, uint64_t t)
 {
@@ -54,7 +456,18 @@ static inline void push_packet(struct obs_output *output,
 	obs_encoder_packet_create_instance(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
-	deque_push_back(&output->delay_data, &dd, sizeof(dd));
+	push_delay_data(output, &dd);
+
+	/* spill the oldest packets of the tail without holding the mutex, so
+	 * other encoders are not stalled on I/O */
+	if (claim_tail_data(output)) {
+		pthread_mutex_unlock(&output->delay_mutex);
+		write_tail_data(output);
+		pthread_mutex_lock(&output->delay_mutex);
+
+		publish_tail_data(output);
+	}
+
 	pthread_mutex_unlock(&output->delay_mutex);
 }
 
@@ -63,7 +476,8 @@ static inline void process_delay_data(struct obs_output *output,
 {
 	switch (dd->msg) {
 	case DELAY_MSG_PACKET:
-		if (!delay_active(output) || !delay_capturing(output))
+		if (!delay_active(output) || !delay_capturing(output) ||
+		    !dd->packet.data)
 			obs_encoder_packet_release(&dd->packet);
 		else
 			output->delay_callback(output, &dd->packet);
@@ -77,6 +491,25 @@ static inline void process_delay_data(struct obs_output *output,
 	}
 }
 
+void obs_output_init_delay_spill(obs_output_t *output)
+{
+	struct delay_spill *spill = &output->delay_spill;
+
+	bfree(spill->dir);
+	spill->dir = NULL;
+
+	if (!output->delay_cur_mem_limit)
+		return;
+
+	if (output->delay_spill_path && *output->delay_spill_path) {
+		spill->dir = bstrdup(output->delay_spill_path);
+	} else if (obs->module_config_path) {
+		struct dstr dir = {0};
+		dstr_printf(&dir, "%s/libobs/delay", obs->module_config_path);
+		spill->dir = dir.array;
+	}
+}
+
 void obs_output_cleanup_delay(obs_output_t *output)
 {
 	struct delay_data dd;
@@ -88,6 +521,8 @@ void obs_output_cleanup_delay(obs_output_t *output)
 		}
 	}
 
+	free_delay_spill(output);
+
 	output->active_delay_ns = 0;
 	os_atomic_set_long(&output->delay_restart_refs, 0);
 }
@@ -105,7 +540,7 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 
 	pthread_mutex_lock(&output->delay_mutex);
 
-	if (output->delay_data.size) {
+	if (output->delay_data.size && refill_head(output)) {
 		deque_peek_front(&output->delay_data, &dd, sizeof(dd));
 		elapsed_time = (t - dd.ts);
 
@@ -113,7 +548,7 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 			output->active_delay_ns = elapsed_time;
 
 		} else if (elapsed_time > output->active_delay_ns) {
-			deque_pop_front(&output->delay_data, NULL, sizeof(dd));
+			pop_delay_data(output, &dd);
 			popped = true;
 		}
 	}
@@ -164,7 +599,7 @@ bool obs_output_delay_start(obs_output_t *output)
 	}
 
 	pthread_mutex_lock(&output->delay_mutex);
-	deque_push_back(&output->delay_data, &dd, sizeof(dd));
+	push_delay_data(output, &dd);
 	pthread_mutex_unlock(&output->delay_mutex);
 
 	os_atomic_inc_long(&output->delay_restart_refs);
@@ -190,7 +625,7 @@ void obs_output_delay_stop(obs_output_t *output)
 	};
 
 	pthread_mutex_lock(&output->delay_mutex);
-	deque_push_back(&output->delay_data, &dd, sizeof(dd));
+	push_delay_data(output, &dd);
 	pthread_mutex_unlock(&output->delay_mutex);
 
 	do_output_signal(output, "stopping");
@@ -221,3 +656,38 @@ uint32_t obs_output_get_active_delay(const obs_output_t *output)
 		       ? (uint32_t)(output->active_delay_ns / 1000000000ULL)
 		       : 0;
 }
+
+void obs_output_set_delay_memory_limit(obs_output_t *output, size_t max_bytes)
+{
+	if (!obs_output_valid(output, "obs_output_set_delay_memory_limit"))
+		return;
+	if (!log_flag_encoded(output, __FUNCTION__, false))
+		return;
+
+	output->delay_mem_limit = max_bytes;
+}
+
+size_t obs_output_get_delay_memory_limit(const obs_output_t *output)
+{
+	return obs_output_valid(output, "obs_output_get_delay_memory_limit")
+		       ? output->delay_mem_limit
+		       : 0;
+}
+
+void obs_output_set_delay_spill_path(obs_output_t *output, const char *path)
+{
+	if (!obs_output_valid(output, "obs_output_set_delay_spill_path"))
+		return;
+	if (!log_flag_encoded(output, __FUNCTION__, false))
+		return;
+
+	bfree(output->delay_spill_path);
+	output->delay_spill_path = bstrdup(path);
+}
+
+const char *obs_output_get_delay_spill_path(const obs_output_t *output)
+{
+	return obs_output_valid(output, "obs_output_get_delay_spill_path")
+		       ? output->delay_spill_path
+		       : NULL;
+}
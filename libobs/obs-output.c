@@ -308,6 +308,8 @@ void obs_output_destroy(obs_output_t *output)
 
 		clear_raw_audio_buffers(output);
 
+		obs_output_cleanup_delay(output);
+
 		os_event_destroy(output->stopping_event);
 		pthread_mutex_destroy(&output->pause.mutex);
 		pthread_mutex_destroy(&output->interleaved_mutex);
@@ -315,6 +317,7 @@ void obs_output_destroy(obs_output_t *output)
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
 		deque_free(&output->delay_data);
+		bfree(output->delay_spill_path);
 		if (output->owns_info_id)
 			bfree((void *)output->info.id);
 		if (output->last_error_message)
@@ -2515,6 +2518,8 @@ static void hook_data_capture(struct obs_output *output)
 			output->active_delay_ns =
 				(uint64_t)output->delay_sec * 1000000000ULL;
 			output->delay_cur_flags = output->delay_flags;
+			output->delay_cur_mem_limit = output->delay_mem_limit;
+			obs_output_init_delay_spill(output);
 			output->delay_callback = encoded_callback;
 			encoded_callback = process_delay;
 			os_atomic_set_bool(&output->delay_active, true);
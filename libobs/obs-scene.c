@@ -32,6 +32,8 @@ static void get_ungrouped_transform(obs_sceneitem_t *group, struct vec2 *pos,
 				    struct vec2 *scale, float *rot);
 static inline bool crop_enabled(const struct obs_sceneitem_crop *crop);
 static inline bool item_texture_enabled(const struct obs_scene_item *item);
+static uint32_t scene_getwidth(void *data);
+static uint32_t scene_getheight(void *data);
 static void init_hotkeys(obs_scene_t *scene, obs_sceneitem_t *item,
 			 const char *name);
 
@@ -239,6 +241,7 @@ static void scene_destroy(void *data)
 
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
+	da_free(scene->occluders);
 	bfree(scene);
 }
 
@@ -544,6 +547,13 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	item->output_scale = scale;
 
+	struct bounds draw_bounds;
+	vec3_zero(&draw_bounds.min);
+	vec3_set(&draw_bounds.max, (float)calc_cx(item, item->last_width),
+		 (float)calc_cy(item, item->last_height), 0.0f);
+	bounds_transform(&item->render_bounds, &draw_bounds,
+			 &item->draw_transform);
+
 	/* ----------------------- */
 
 	if (item->bounds_type != OBS_BOUNDS_NONE) {
@@ -573,6 +583,8 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 	calldata_set_ptr(&params, "item", item);
 	signal_parent(item->parent, "item_transform", &params);
 
+	item->item_render_cached = false;
+
 	if (!update_tex)
 		return;
 
@@ -616,6 +628,45 @@ static inline bool item_texture_enabled(const struct obs_scene_item *item)
 	       (item_is_scene(item) && !item->is_group);
 }
 
+static bool source_content_static(obs_source_t *source, bool *has_filters)
+{
+	bool is_static = true;
+
+	if ((source->info.output_flags & OBS_SOURCE_STATIC_CONTENT) == 0)
+		return false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		if (filter->enabled &&
+		    (filter->info.output_flags & OBS_SOURCE_STATIC_CONTENT) ==
+			    0) {
+			is_static = false;
+			break;
+		}
+	}
+	*has_filters = source->filters.num > 0;
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return is_static;
+}
+
+/* Caching only pays off if the item either already renders to a texture or
+ * has a filter chain to skip; otherwise drawing the cached texture costs as
+ * much as drawing the source directly. */
+static inline bool item_cache_enabled(const struct obs_scene_item *item)
+{
+	bool has_filters = false;
+
+	if (transition_active(item->show_transition) ||
+	    transition_active(item->hide_transition))
+		return false;
+	if (!source_content_static(item->source, &has_filters))
+		return false;
+
+	return has_filters || item_texture_enabled(item);
+}
+
 static void render_item_texture(struct obs_scene_item *item,
 				enum gs_color_space current_space,
 				enum gs_color_space source_space)
@@ -792,7 +843,8 @@ static inline void render_item(struct obs_scene_item *item)
 	GS_DEBUG_MARKER_BEGIN_FORMAT(GS_DEBUG_COLOR_ITEM, "Item: %s",
 				     obs_source_get_name(item->source));
 
-	const bool use_texrender = item_texture_enabled(item);
+	const bool use_cache = item_cache_enabled(item);
+	const bool use_texrender = use_cache || item_texture_enabled(item);
 
 	obs_source_t *const source = item->source;
 	const enum gs_color_space current_space = gs_get_color_space();
@@ -810,6 +862,7 @@ static inline void render_item(struct obs_scene_item *item)
 
 	if (!item->item_render && use_texrender) {
 		item->item_render = gs_texrender_create(format, GS_ZS_NONE);
+		item->item_render_cached = false;
 	}
 
 	if (item->item_render) {
@@ -823,9 +876,22 @@ static inline void render_item(struct obs_scene_item *item)
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
 
-		if (cx && cy &&
-		    gs_texrender_begin_with_color_space(item->item_render, cx,
-							cy, source_space)) {
+		const long version =
+			os_atomic_load_long(&source->content_version);
+		gs_texture_t *cached_tex =
+			gs_texrender_get_texture(item->item_render);
+		const bool cached =
+			use_cache && item->item_render_cached && cached_tex &&
+			item->cached_content_version == version &&
+			item->cached_space == source_space &&
+			gs_texture_get_width(cached_tex) == cx &&
+			gs_texture_get_height(cached_tex) == cy;
+
+		if (cached) {
+			/* reuse the texture from a previous frame */
+		} else if (cx && cy &&
+			   gs_texrender_begin_with_color_space(
+				   item->item_render, cx, cy, source_space)) {
 			float cx_scale = (float)width / (float)cx;
 			float cy_scale = (float)height / (float)cy;
 			struct vec4 clear_color;
@@ -869,6 +935,10 @@ static inline void render_item(struct obs_scene_item *item)
 			}
 
 			gs_texrender_end(item->item_render);
+
+			item->item_render_cached = use_cache;
+			item->cached_content_version = version;
+			item->cached_space = source_space;
 		}
 	}
 
@@ -968,6 +1038,90 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
+static inline bool item_rendered(const struct obs_scene_item *item)
+{
+	return item->user_visible || transition_active(item->hide_transition);
+}
+
+static inline bool item_offscreen(const struct obs_scene_item *item, float cx,
+				  float cy)
+{
+	const struct bounds *b = &item->render_bounds;
+	return b->max.x <= 0.0f || b->max.y <= 0.0f || b->min.x >= cx ||
+	       b->min.y >= cy;
+}
+
+/* an item can hide the items below it if it is known to cover its whole
+ * axis-aligned area with opaque pixels */
+static inline bool item_occludes(const struct obs_scene_item *item)
+{
+	const struct bounds *b = &item->render_bounds;
+
+	return item->rot == 0.0f && default_blending_enabled(item) &&
+	       item->blend_method != OBS_BLEND_METHOD_SRGB_OFF &&
+	       b->max.x > b->min.x && b->max.y > b->min.y &&
+	       obs_source_video_opaque(item->source);
+}
+
+static inline bool item_occluded(const struct obs_scene *scene,
+				 const struct obs_scene_item *item)
+{
+	for (size_t i = 0; i < scene->occluders.num; i++) {
+		if (bounds_inside(&scene->occluders.array[i],
+				  &item->render_bounds))
+			return true;
+	}
+
+	return false;
+}
+
+/* assumes video lock */
+static void cull_items(struct obs_scene *scene)
+{
+	struct obs_scene_item *item = scene->first_item;
+	struct obs_scene_item *last = NULL;
+
+	/* items can only be culled against the canvas while a mix is being
+	 * rendered, since displays and other callers may use any projection */
+	const uint32_t mix_cx = obs->video.render_mix_cx;
+	const uint32_t mix_cy = obs->video.render_mix_cy;
+	const bool cull_offscreen = mix_cx && mix_cy;
+	const uint32_t scene_cx = scene_getwidth(scene);
+	const uint32_t scene_cy = scene_getheight(scene);
+	const float cx = (float)(scene_cx > mix_cx ? scene_cx : mix_cx);
+	const float cy = (float)(scene_cy > mix_cy ? scene_cy : mix_cy);
+
+	while (item) {
+		last = item;
+		item = item->next;
+	}
+
+	da_resize(scene->occluders, 0);
+
+	for (item = last; item; item = item->prev) {
+		item->culled = false;
+
+		if (!item_rendered(item) ||
+		    transition_active(item->show_transition) ||
+		    transition_active(item->hide_transition))
+			continue;
+
+		if (cull_offscreen && item_offscreen(item, cx, cy)) {
+			item->culled = true;
+			scene->culled_offscreen++;
+
+		} else if (item_occluded(scene, item)) {
+			item->culled = true;
+			scene->culled_occluded++;
+
+		} else if (item_occludes(item)) {
+			da_push_back(scene->occluders, &item->render_bounds);
+		}
+	}
+}
+
+static const char *update_scene_transforms_name = "update_scene_transforms";
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	obs_scene_item_ptr_array_t remove_items;
@@ -979,7 +1133,15 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 	video_lock(scene);
 
 	if (!scene->is_group) {
-		update_transforms_and_prune_sources(scene, &remove_items, NULL);
+		if (scene->last_update_time != obs->video.video_time) {
+			scene->last_update_time = obs->video.video_time;
+
+			profile_start(update_scene_transforms_name);
+			update_transforms_and_prune_sources(scene,
+							    &remove_items, NULL);
+			profile_end(update_scene_transforms_name);
+		}
+		cull_items(scene);
 	}
 
 	gs_blend_state_push();
@@ -987,8 +1149,9 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 
 	item = scene->first_item;
 	while (item) {
-		if (item->user_visible ||
-		    transition_active(item->hide_transition))
+		if (item->culled && !scene->is_group)
+			obs_source_video_render_culled(item->source);
+		else if (item_rendered(item))
 			render_item(item);
 
 		item = item->next;
@@ -1385,7 +1548,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = util_mul_div64(timestamp - ts, sample_rate,
 					       1000000000ULL);
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= obs->audio.tick_frames)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -1403,7 +1566,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < obs->audio.tick_frames; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -1432,7 +1595,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item, float *buf,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = util_mul_div64(AUDIO_OUTPUT_FRAMES,
+		uint64_t duration = util_mul_div64(obs->audio.tick_frames,
 						   1000000000ULL, sample_rate);
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -1555,12 +1718,12 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 						 source_ts - timestamp);
 
-		if (pos >= AUDIO_OUTPUT_FRAMES) {
+		if (pos >= obs->audio.tick_frames) {
 			item = item->next;
 			continue;
 		}
 
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		count = obs->audio.tick_frames - pos;
 
 		if (!apply_buf && !item->visible &&
 		    !transition_active(item->hide_transition)) {
@@ -1892,6 +2055,15 @@ obs_source_t *obs_scene_get_source(const obs_scene_t *scene)
 	return scene ? scene->source : NULL;
 }
 
+void obs_scene_get_culled_items(const obs_scene_t *scene, uint64_t *offscreen,
+				uint64_t *occluded)
+{
+	if (offscreen)
+		*offscreen = scene ? scene->culled_offscreen : 0;
+	if (occluded)
+		*occluded = scene ? scene->culled_occluded : 0;
+}
+
 obs_scene_t *obs_scene_from_source(const obs_source_t *source)
 {
 	if (!source || strcmp(source->info.id, scene_info.id) != 0)
@@ -19,6 +19,7 @@
 
 #include "obs.h"
 #include "graphics/matrix4.h"
+#include "graphics/bounds.h"
 
 /* how obs scene! */
 
@@ -50,6 +51,12 @@ struct obs_scene_item {
 	gs_texrender_t *item_render;
 	struct obs_sceneitem_crop crop;
 
+	/* item_render holds a still valid render of a static content source
+	 * as of cached_content_version */
+	bool item_render_cached;
+	long cached_content_version;
+	enum gs_color_space cached_space;
+
 	struct vec2 pos;
 	struct vec2 scale;
 	float rot;
@@ -70,6 +77,10 @@ struct obs_scene_item {
 	struct vec2 box_scale;
 	struct matrix4 draw_transform;
 
+	/* axis-aligned area the item draws to within its scene */
+	struct bounds render_bounds;
+	bool culled;
+
 	enum obs_bounds_type bounds_type;
 	uint32_t bounds_align;
 	struct vec2 bounds;
@@ -106,4 +117,13 @@ struct obs_scene {
 	pthread_mutex_t video_mutex;
 	pthread_mutex_t audio_mutex;
 	struct obs_scene_item *first_item;
+
+	/* video frame time of the last transform update, so that scenes
+	 * rendered by several mixes or displays only update once per frame */
+	uint64_t last_update_time;
+
+	/* culling */
+	DARRAY(struct bounds) occluders;
+	uint64_t culled_offscreen;
+	uint64_t culled_occluded;
 };
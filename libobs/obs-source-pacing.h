@@ -0,0 +1,51 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "obs.h"
+
+/*
+ * Frame selection for async sources that are paced by the render clock
+ *
+ * The source outputs its frames ahead of time, timestamped with the system
+ * time they are due at.  Each render shows the newest frame that is due, so
+ * frames are neither shown early nor held back by when they happened to
+ * arrive, and the only duplicates or drops are the ones the difference
+ * between the frame rates requires.
+ */
+
+/* frames this far ahead of the render time are treated as a timestamp jump */
+#define ASYNC_PACING_MAX_AHEAD 2000000000ULL
+
+/* Returns how many frames at the front of the queue are due at render_ts.
+ * The last of them is the one to show, the ones before it are dropped. */
+static inline size_t async_frames_due(struct obs_source_frame *const *frames,
+				      size_t num, uint64_t render_ts)
+{
+	size_t due = 0;
+
+	while (due < num) {
+		uint64_t ts = frames[due]->timestamp;
+
+		if (ts > render_ts && ts - render_ts < ASYNC_PACING_MAX_AHEAD)
+			break;
+		due++;
+	}
+
+	return due;
+}
@@ -30,6 +30,7 @@
 
 #include "obs.h"
 #include "obs-internal.h"
+#include "obs-source-pacing.h"
 
 #define get_weak(source) ((obs_weak_source_t *)source->context.control)
 
@@ -618,10 +619,32 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+static void release_frame_dmabuf(struct obs_source_frame *frame)
+{
+	struct async_dmabuf_frame *dmabuf_frame;
+
+	if ((frame->flags & OBS_SOURCE_FRAME_DMABUF) == 0)
+		return;
+
+	dmabuf_frame = (struct async_dmabuf_frame *)frame;
+	if (dmabuf_frame->dmabuf.release) {
+		dmabuf_frame->dmabuf.release(dmabuf_frame->dmabuf.param);
+		dmabuf_frame->dmabuf.release = NULL;
+	}
+}
+
+static inline void destroy_async_frame(struct obs_source_frame *frame)
+{
+	if (frame) {
+		release_frame_dmabuf(frame);
+		obs_source_frame_destroy(frame);
+	}
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		destroy_async_frame(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -982,6 +1005,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 				    source->context.settings);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
+		obs_source_mark_dirty(source);
 		obs_source_dosignal(source, "source_update", "update");
 	}
 }
@@ -1000,10 +1024,25 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				    source->context.settings);
+		obs_source_mark_dirty(source);
 		obs_source_dosignal(source, "source_update", "update");
 	}
 }
 
+void obs_source_mark_dirty(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_mark_dirty"))
+		return;
+
+	os_atomic_inc_long(&source->content_version);
+
+	/* filters render as part of their parent, so any cached render of
+	 * the parent is invalidated as well */
+	obs_source_t *parent = source->filter_parent;
+	if (parent)
+		os_atomic_inc_long(&parent->content_version);
+}
+
 void obs_source_reset_settings(obs_source_t *source, obs_data_t *settings)
 {
 	if (!obs_source_valid(source, "obs_source_reset_settings"))
@@ -1205,7 +1244,10 @@ static void filter_frame(obs_source_t *source,
 			 struct obs_source_frame **ref_frame)
 {
 	struct obs_source_frame *frame = *ref_frame;
-	if (frame) {
+
+	/* filters that were added after the frame was output can't read it
+	 * if it's in GPU memory */
+	if (frame && (frame->flags & OBS_SOURCE_FRAME_DMABUF) == 0) {
 		os_atomic_inc_long(&frame->refs);
 		frame = filter_async_video(source, frame);
 		if (frame)
@@ -2372,6 +2414,56 @@ static inline void set_eparami(gs_effect_t *effect, const char *name, int val)
 	gs_effect_set_int(param, val);
 }
 
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__DragonFly__)
+static bool import_frame_dmabuf(struct obs_source *source,
+				const struct obs_source_frame *frame,
+				gs_texture_t *tex[MAX_AV_PLANES])
+{
+	const struct async_dmabuf_frame *dmabuf_frame =
+		(const struct async_dmabuf_frame *)frame;
+	const struct obs_source_frame_dmabuf *dmabuf = &dmabuf_frame->dmabuf;
+
+	if (dmabuf->num_planes != (uint32_t)source->async_channel_count)
+		goto fail;
+
+	for (uint32_t c = 0; c < dmabuf->num_planes; c++) {
+		tex[c] = gs_texture_create_from_dmabuf(
+			source->async_convert_width[c],
+			source->async_convert_height[c],
+			dmabuf->drm_formats[c],
+			source->async_texture_formats[c], 1, &dmabuf->fds[c],
+			&dmabuf->strides[c], &dmabuf->offsets[c],
+			&dmabuf->modifiers[c]);
+		if (!tex[c])
+			goto fail;
+	}
+
+	return true;
+
+fail:
+	blog(LOG_WARNING,
+	     "Failed to import DMA-BUF frame of source '%s', "
+	     "falling back to frames in memory",
+	     source->context.name);
+	for (size_t c = 0; c < MAX_AV_PLANES; c++) {
+		gs_texture_destroy(tex[c]);
+		tex[c] = NULL;
+	}
+	source->async_dmabuf_failed = true;
+	return false;
+}
+#else
+static bool import_frame_dmabuf(struct obs_source *source,
+				const struct obs_source_frame *frame,
+				gs_texture_t *tex[MAX_AV_PLANES])
+{
+	UNUSED_PARAMETER(frame);
+	UNUSED_PARAMETER(tex);
+	source->async_dmabuf_failed = true;
+	return false;
+}
+#endif
+
 static bool update_async_texrender(struct obs_source *source,
 				   const struct obs_source_frame *frame,
 				   gs_texture_t *tex[MAX_AV_PLANES],
@@ -2379,9 +2471,17 @@ static bool update_async_texrender(struct obs_source *source,
 {
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_CONVERT_FORMAT, "Convert Format");
 
+	gs_texture_t *dmabuf_tex[MAX_AV_PLANES] = {0};
+
 	gs_texrender_reset(texrender);
 
-	upload_raw_frame(tex, frame);
+	if (frame->flags & OBS_SOURCE_FRAME_DMABUF) {
+		if (!import_frame_dmabuf(source, frame, dmabuf_tex))
+			return false;
+		tex = dmabuf_tex;
+	} else {
+		upload_raw_frame(tex, frame);
+	}
 
 	uint32_t cx = source->async_width;
 	uint32_t cy = source->async_height;
@@ -2479,6 +2579,9 @@ static bool update_async_texrender(struct obs_source *source,
 		gs_texrender_end(texrender);
 	}
 
+	for (size_t c = 0; c < MAX_AV_PLANES; c++)
+		gs_texture_destroy(dmabuf_tex[c]);
+
 	GS_DEBUG_MARKER_END();
 	return success;
 }
@@ -2505,6 +2608,8 @@ bool update_async_textures(struct obs_source *source,
 
 	if (source->async_gpu_conversion && texrender)
 		return update_async_texrender(source, frame, tex, texrender);
+	if (frame->flags & OBS_SOURCE_FRAME_DMABUF)
+		return false;
 
 	type = get_convert_type(frame->format, frame->full_range, frame->trc);
 	if (type == CONVERT_NONE) {
@@ -2577,8 +2682,9 @@ static void obs_source_update_async_video(obs_source_t *source)
 		if (frame) {
 			check_to_swap_bgrx_bgra(source, frame);
 
-			if (!source->async_decoupled ||
-			    !source->async_unbuffered) {
+			if (!source->async_render_clock &&
+			    (!source->async_decoupled ||
+			     !source->async_unbuffered)) {
 				source->timing_adjust = obs->video.video_time -
 							frame->timestamp;
 				source->timing_set = true;
@@ -2618,6 +2724,44 @@ static void rotate_async_video(obs_source_t *source, long rotation)
 	gs_matrix_rotaa4f(0.0f, 0.0f, -1.0f, RAD((float)rotation));
 }
 
+static inline bool video_format_has_alpha(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_I40A:
+	case VIDEO_FORMAT_I42A:
+	case VIDEO_FORMAT_YUVA:
+	case VIDEO_FORMAT_YA2L:
+	case VIDEO_FORMAT_AYUV:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* whether the source is known to fill its entire area with fully opaque
+ * pixels, i.e. an unfiltered async video source without alpha */
+bool obs_source_video_opaque(obs_source_t *source)
+{
+	bool opaque;
+
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC_VIDEO) !=
+	    OBS_SOURCE_ASYNC_VIDEO)
+		return false;
+	if (!source->enabled || !source->async_active ||
+	    !source->async_textures[0])
+		return false;
+	if (video_format_has_alpha(source->async_format))
+		return false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	opaque = source->filters.num == 0;
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return opaque;
+}
+
 static inline void obs_source_render_async_video(obs_source_t *source)
 {
 	if (source->async_textures[0] && source->async_active) {
@@ -3032,6 +3176,18 @@ static inline void render_video(obs_source_t *source)
 	GS_DEBUG_MARKER_END();
 }
 
+/* keeps async video current for sources that a scene chose not to render
+ * this frame, so their textures and timing are up to date once visible */
+void obs_source_video_render_culled(obs_source_t *source)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
+	    (source->info.output_flags & OBS_SOURCE_ASYNC) != 0) {
+		if (deinterlacing_enabled(source))
+			deinterlace_update_async_video(source);
+		obs_source_update_async_video(source);
+	}
+}
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_video_render"))
@@ -3214,6 +3370,8 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -3252,6 +3410,8 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_source_mark_dirty(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -3384,8 +3544,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_source_mark_dirty(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 int obs_source_filter_get_index(obs_source_t *source, obs_source_t *filter)
@@ -3431,8 +3593,10 @@ void obs_source_filter_set_index(obs_source_t *source, obs_source_t *filter,
 	success = set_filter_index(source, filter, index);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		obs_source_mark_dirty(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -3496,7 +3660,7 @@ static inline void copy_frame_data_plane(struct obs_source_frame *dst,
 	}
 }
 
-static void copy_frame_data(struct obs_source_frame *dst,
+static void copy_frame_info(struct obs_source_frame *dst,
 			    const struct obs_source_frame *src)
 {
 	dst->flip = src->flip;
@@ -3511,6 +3675,12 @@ static void copy_frame_data(struct obs_source_frame *dst,
 		memcpy(dst->color_range_min, src->color_range_min, size);
 		memcpy(dst->color_range_max, src->color_range_max, size);
 	}
+}
+
+static void copy_frame_data(struct obs_source_frame *dst,
+			    const struct obs_source_frame *src)
+{
+	copy_frame_info(dst, src);
 
 	switch (src->format) {
 	case VIDEO_FORMAT_I420:
@@ -3622,7 +3792,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				destroy_async_frame(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -3632,7 +3802,8 @@ static void clean_cache(obs_source_t *source)
 #define MAX_ASYNC_FRAMES 30
 //if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
 static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+cache_video(struct obs_source *source, const struct obs_source_frame *frame,
+	    const struct obs_source_frame_dmabuf *dmabuf)
 {
 	struct obs_source_frame *new_frame = NULL;
 
@@ -3658,7 +3829,7 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 
 	for (size_t i = 0; i < source->async_cache.num; i++) {
 		struct async_frame *af = &source->async_cache.array[i];
-		if (!af->used) {
+		if (!af->used && af->dmabuf == (dmabuf != NULL)) {
 			new_frame = af->frame;
 			new_frame->format = format;
 			af->used = true;
@@ -3672,11 +3843,22 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(format, frame->width,
-						    frame->height);
+		if (dmabuf) {
+			struct async_dmabuf_frame *dmabuf_frame =
+				bzalloc(sizeof(*dmabuf_frame));
+			new_frame = &dmabuf_frame->frame;
+			new_frame->format = format;
+			new_frame->width = frame->width;
+			new_frame->height = frame->height;
+		} else {
+			new_frame = obs_source_frame_create(
+				format, frame->width, frame->height);
+		}
+
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
+		new_af.dmabuf = dmabuf != NULL;
 		new_frame->refs = 1;
 
 		da_push_back(source->async_cache, &new_af);
@@ -3686,17 +3868,25 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 
 	pthread_mutex_unlock(&source->async_mutex);
 
-	copy_frame_data(new_frame, frame);
+	if (dmabuf) {
+		copy_frame_info(new_frame, frame);
+		new_frame->flags |= OBS_SOURCE_FRAME_DMABUF;
+		((struct async_dmabuf_frame *)new_frame)->dmabuf = *dmabuf;
+	} else {
+		copy_frame_data(new_frame, frame);
+		new_frame->flags &= ~OBS_SOURCE_FRAME_DMABUF;
+	}
 
 	return new_frame;
 }
 
-static void
+static bool
 obs_source_output_video_internal(obs_source_t *source,
-				 const struct obs_source_frame *frame)
+				 const struct obs_source_frame *frame,
+				 const struct obs_source_frame_dmabuf *dmabuf)
 {
 	if (!obs_source_valid(source, "obs_source_output_video"))
-		return;
+		return false;
 
 	if (!frame) {
 		pthread_mutex_lock(&source->async_mutex);
@@ -3704,23 +3894,23 @@ obs_source_output_video_internal(obs_source_t *source,
 		source->last_frame_ts = 0;
 		free_async_cache(source);
 		pthread_mutex_unlock(&source->async_mutex);
-		return;
+		return true;
 	}
 
-	struct obs_source_frame *output = cache_video(source, frame);
+	struct obs_source_frame *output = cache_video(source, frame, dmabuf);
+	if (!output)
+		return false;
 
 	/* ------------------------------------------- */
 	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
+	if (os_atomic_dec_long(&output->refs) == 0) {
+		destroy_async_frame(output);
+	} else {
+		da_push_back(source->async_frames, &output);
+		source->async_active = true;
 	}
 	pthread_mutex_unlock(&source->async_mutex);
+	return true;
 }
 
 void obs_source_output_video(obs_source_t *source,
@@ -3729,7 +3919,7 @@ void obs_source_output_video(obs_source_t *source,
 	if (destroying(source))
 		return;
 	if (!frame) {
-		obs_source_output_video_internal(source, NULL);
+		obs_source_output_video_internal(source, NULL, NULL);
 		return;
 	}
 
@@ -3737,7 +3927,7 @@ void obs_source_output_video(obs_source_t *source,
 	new_frame.full_range =
 		format_is_yuv(frame->format) ? new_frame.full_range : true;
 
-	obs_source_output_video_internal(source, &new_frame);
+	obs_source_output_video_internal(source, &new_frame, NULL);
 }
 
 void obs_source_output_video2(obs_source_t *source,
@@ -3746,7 +3936,7 @@ void obs_source_output_video2(obs_source_t *source,
 	if (destroying(source))
 		return;
 	if (!frame) {
-		obs_source_output_video_internal(source, NULL);
+		obs_source_output_video_internal(source, NULL, NULL);
 		return;
 	}
 
@@ -3776,8 +3966,68 @@ void obs_source_output_video2(obs_source_t *source,
 	memcpy(&new_frame.color_range_max, &frame->color_range_max,
 	       sizeof(frame->color_range_max));
 
-	obs_source_output_video_internal(source, &new_frame);
+	obs_source_output_video_internal(source, &new_frame, NULL);
+}
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__DragonFly__)
+static bool async_filters_active(obs_source_t *source)
+{
+	bool active = false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		struct obs_source *filter = source->filters.array[i];
+		if (filter->enabled && filter->info.filter_video) {
+			active = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return active;
+}
+
+bool obs_source_output_video_dmabuf(
+	obs_source_t *source, const struct obs_source_frame *frame,
+	const struct obs_source_frame_dmabuf *dmabuf)
+{
+	if (destroying(source))
+		return false;
+	if (!obs_ptr_valid(frame, "obs_source_output_video_dmabuf") ||
+	    !obs_ptr_valid(dmabuf, "obs_source_output_video_dmabuf"))
+		return false;
+
+	/* the planes are imported as the textures the format is converted
+	 * from, so only formats with one texture per plane can be used */
+	if (frame->format != VIDEO_FORMAT_NV12 &&
+	    frame->format != VIDEO_FORMAT_P010)
+		return false;
+	if (dmabuf->num_planes != 2)
+		return false;
+
+	if (source->async_dmabuf_failed || deinterlacing_enabled(source) ||
+	    async_filters_active(source))
+		return false;
+
+	struct obs_source_frame new_frame = *frame;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		new_frame.data[i] = NULL;
+		new_frame.linesize[i] = 0;
+	}
+
+	return obs_source_output_video_internal(source, &new_frame, dmabuf);
 }
+#else
+bool obs_source_output_video_dmabuf(
+	obs_source_t *source, const struct obs_source_frame *frame,
+	const struct obs_source_frame_dmabuf *dmabuf)
+{
+	UNUSED_PARAMETER(source);
+	UNUSED_PARAMETER(frame);
+	UNUSED_PARAMETER(dmabuf);
+	return false;
+}
+#endif
 
 void obs_source_set_async_rotation(obs_source_t *source, long rotation)
 {
@@ -4261,6 +4511,8 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 
 		if (f->frame == frame) {
 			f->used = false;
+			if (f->dmabuf)
+				release_frame_dmabuf(frame);
 			break;
 		}
 	}
@@ -4276,6 +4528,23 @@ static bool ready_async_frame(obs_source_t *source, uint64_t sys_time)
 	uint64_t frame_time = next_frame->timestamp;
 	uint64_t frame_offset = 0;
 
+	if (source->async_render_clock) {
+		size_t due = async_frames_due(source->async_frames.array,
+					      source->async_frames.num,
+					      sys_time);
+		if (!due)
+			return false;
+
+		while (--due) {
+			da_erase(source->async_frames, 0);
+			remove_async_frame(source, next_frame);
+			next_frame = source->async_frames.array[0];
+		}
+
+		source->last_frame_ts = next_frame->timestamp;
+		return true;
+	}
+
 	if (source->async_unbuffered) {
 		while (source->async_frames.num > 1) {
 			da_erase(source->async_frames, 0);
@@ -4365,7 +4634,8 @@ static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 	if (!source->async_frames.num)
 		return NULL;
 
-	if (!source->last_frame_ts || ready_async_frame(source, sys_time)) {
+	if ((!source->last_frame_ts && !source->async_render_clock) ||
+	    ready_async_frame(source, sys_time)) {
 		struct obs_source_frame *frame = source->async_frames.array[0];
 		da_erase(source->async_frames, 0);
 
@@ -4394,9 +4664,13 @@ struct obs_source_frame *obs_source_get_frame(obs_source_t *source)
 	pthread_mutex_lock(&source->async_mutex);
 
 	frame = source->cur_async_frame;
-	source->cur_async_frame = NULL;
 
-	if (frame) {
+	/* frames imported from DMA-BUFs have no data to hand out, they stay
+	 * with the source to be rendered */
+	if (frame && (frame->flags & OBS_SOURCE_FRAME_DMABUF) != 0) {
+		frame = NULL;
+	} else if (frame) {
+		source->cur_async_frame = NULL;
 		os_atomic_inc_long(&frame->refs);
 	}
 
@@ -4412,12 +4686,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		destroy_async_frame(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			destroy_async_frame(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -5289,6 +5563,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	obs_source_mark_dirty(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -5518,7 +5793,7 @@ static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 {
 	for (size_t ch = 0; ch < channels; ch++) {
 		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
+		register float *end = out + obs->audio.tick_frames;
 		register float *vol = vol_data;
 
 		while (out < end)
@@ -5550,6 +5825,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 {
 	float vol_data[AUDIO_OUTPUT_FRAMES];
 	float cur_vol = get_source_volume(source, source->audio_ts);
+	const size_t tick_frames = obs->audio.tick_frames;
 	size_t frame_num = 0;
 
 	pthread_mutex_lock(&source->audio_actions_mutex);
@@ -5565,7 +5841,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(
 			sample_rate, timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= tick_frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -5580,7 +5856,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < tick_frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
@@ -5607,8 +5883,8 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration =
-			conv_frames_to_time(sample_rate, AUDIO_OUTPUT_FRAMES);
+		uint64_t duration = conv_frames_to_time(
+			sample_rate, obs->audio.tick_frames);
 
 		if (action.timestamp < (source->audio_ts + duration)) {
 			apply_audio_actions(source, channels, sample_rate);
@@ -5703,7 +5979,7 @@ static void audio_submix(obs_source_t *source, size_t channels,
 		audio.data[i] = (const uint8_t *)audio_data.data[i];
 
 	audio.samples_per_sec = (uint32_t)sample_rate;
-	audio.frames = AUDIO_OUTPUT_FRAMES;
+	audio.frames = (uint32_t)obs->audio.tick_frames;
 	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	audio.speakers = (enum speaker_layout)channels;
 	audio.timestamp = ts;
@@ -5812,6 +6088,13 @@ uint64_t obs_source_get_audio_timestamp(const obs_source_t *source)
 		       : 0;
 }
 
+uint64_t obs_source_get_audio_dsp_time(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_audio_dsp_time")
+		       ? source->audio_dsp_time
+		       : 0;
+}
+
 void obs_source_get_audio_mix(const obs_source_t *source,
 			      struct obs_source_audio_mix *audio)
 {
@@ -5940,6 +6223,21 @@ bool obs_source_async_unbuffered(const obs_source_t *source)
 		       : false;
 }
 
+void obs_source_set_async_render_clock(obs_source_t *source, bool enable)
+{
+	if (!obs_source_valid(source, "obs_source_set_async_render_clock"))
+		return;
+
+	source->async_render_clock = enable;
+}
+
+bool obs_source_async_render_clock(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_async_render_clock")
+		       ? source->async_render_clock
+		       : false;
+}
+
 obs_data_t *obs_source_get_private_settings(obs_source_t *source)
 {
 	if (!obs_ptr_valid(source, "obs_source_get_private_settings"))
@@ -203,6 +203,16 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES (1 << 16)
 
+/**
+ * Source's video only changes when its settings are updated or when it
+ * calls obs_source_mark_dirty, which allows scenes to reuse a cached
+ * texture of the source and its filters between frames.
+ *
+ * Filters with this flag do not prevent their parent's output from being
+ * cached.
+ */
+#define OBS_SOURCE_STATIC_CONTENT (1 << 17)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -167,6 +167,43 @@ static inline void draw_mix_texture(const size_t mix_idx)
 	gs_enable_framebuffer_srgb(false);
 }
 
+/* A mix that matches an earlier mix's canvas can use that mix's texture
+ * directly as long as nothing else is drawn into it. The main mix always
+ * keeps its own texture since the UI and obs_get_main_texture use it. */
+static inline bool can_share_mix_canvas(const struct obs_core_video_mix *mix)
+{
+	bool no_draw_callbacks;
+
+	if (mix == obs->video.main_mix)
+		return false;
+
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+	no_draw_callbacks = obs->data.draw_callbacks.num == 0;
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+
+	return no_draw_callbacks;
+}
+
+static inline gs_texture_t *
+get_canvas_texture(const struct obs_core_video_mix *mix)
+{
+	return mix->canvas_mix ? mix->canvas_mix->render_texture
+			       : mix->render_texture;
+}
+
+static void call_rendered_callbacks(void)
+{
+	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
+
+	for (size_t i = 0; i < obs->data.rendered_callbacks.num; ++i) {
+		struct rendered_callback *const callback =
+			&obs->data.rendered_callbacks.array[i];
+		callback->rendered(callback->param);
+	}
+
+	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+}
+
 static const char *render_main_texture_name = "render_main_texture";
 static inline void render_main_texture(struct obs_core_video_mix *video)
 {
@@ -177,6 +214,17 @@ static inline void render_main_texture(struct obs_core_video_mix *video)
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_MAIN_TEXTURE,
 			      render_main_texture_name);
 
+	/* In some cases we can reuse a previous mix's texture and save re-rendering everything */
+	size_t reuse_idx;
+	const bool reuse = can_reuse_mix_texture(video, &reuse_idx);
+
+	video->canvas_mix = NULL;
+	if (reuse && can_share_mix_canvas(video)) {
+		video->canvas_mix = obs->video.mixes.array[reuse_idx];
+		call_rendered_callbacks();
+		goto end;
+	}
+
 	struct vec4 clear_color;
 	vec4_set(&clear_color, 0.0f, 0.0f, 0.0f, 0.0f);
 
@@ -196,25 +244,21 @@ static inline void render_main_texture(struct obs_core_video_mix *video)
 
 	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
 
-	/* In some cases we can reuse a previous mix's texture and save re-rendering everything */
-	size_t reuse_idx;
-	if (can_reuse_mix_texture(video, &reuse_idx))
+	if (reuse) {
 		draw_mix_texture(reuse_idx);
-	else
+	} else {
+		obs->video.render_mix_cx = base_width;
+		obs->video.render_mix_cy = base_height;
 		obs_view_render(video->view);
+		obs->video.render_mix_cx = 0;
+		obs->video.render_mix_cy = 0;
+	}
 
 	video->texture_rendered = true;
 
-	pthread_mutex_lock(&obs->data.draw_callbacks_mutex);
-
-	for (size_t i = 0; i < obs->data.rendered_callbacks.num; ++i) {
-		struct rendered_callback *const callback =
-			&obs->data.rendered_callbacks.array[i];
-		callback->rendered(callback->param);
-	}
-
-	pthread_mutex_unlock(&obs->data.draw_callbacks_mutex);
+	call_rendered_callbacks();
 
+end:
 	GS_DEBUG_MARKER_END();
 	profile_end(render_main_texture_name);
 }
@@ -281,13 +325,22 @@ static inline gs_texture_t *
 render_output_texture(struct obs_core_video_mix *mix)
 {
 	struct obs_video_info *const ovi = &mix->ovi;
-	gs_texture_t *texture = mix->render_texture;
+	gs_texture_t *texture = get_canvas_texture(mix);
 	gs_texture_t *target = mix->output_texture;
 	const uint32_t width = gs_texture_get_width(target);
 	const uint32_t height = gs_texture_get_height(target);
 	if ((width == ovi->base_width) && (height == ovi->base_height))
 		return texture;
 
+	/* the scaled output can be shared as well if the mix it shares its
+	 * canvas with already scaled it the same way this frame */
+	const struct obs_core_video_mix *canvas = mix->canvas_mix;
+	if (canvas && canvas->output_texture_rendered &&
+	    canvas->ovi.scale_type == ovi->scale_type &&
+	    gs_texture_get_width(canvas->output_texture) == width &&
+	    gs_texture_get_height(canvas->output_texture) == height)
+		return canvas->output_texture;
+
 	profile_start(render_output_texture_name);
 
 	gs_effect_t *effect = get_scale_effect(mix, width, height);
@@ -331,6 +384,8 @@ render_output_texture(struct obs_core_video_mix *mix)
 	gs_enable_blending(true);
 	gs_enable_framebuffer_srgb(false);
 
+	mix->output_texture_rendered = true;
+
 	profile_end(render_output_texture_name);
 
 	return target;
@@ -590,6 +645,7 @@ static inline void render_video(struct obs_core_video_mix *video,
 	gs_enable_depth_test(false);
 	gs_set_cull_mode(GS_NEITHER);
 
+	video->output_texture_rendered = false;
 	render_main_texture(video);
 
 	if (raw_active || gpu_active) {
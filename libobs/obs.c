@@ -932,7 +932,7 @@ static void obs_free_graphics(void)
 
 static void set_audio_thread(void *unused);
 
-static bool obs_init_audio(struct audio_output_info *ai)
+static bool obs_init_audio(struct audio_output_info *ai, uint32_t tick_frames)
 {
 	struct obs_core_audio *audio = &obs->audio;
 	int errorcode;
@@ -950,7 +950,10 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
-	errorcode = audio_output_open(&audio->audio, ai);
+	if (!obs_audio_dsp_init())
+		return false;
+
+	errorcode = audio_output_open2(&audio->audio, ai, tick_frames);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
 	else if (errorcode == AUDIO_OUTPUT_INVALIDPARAM)
@@ -977,6 +980,8 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_audio_dsp_free();
+
 	deque_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
@@ -1596,7 +1601,7 @@ int obs_reset_video(struct obs_video_info *ovi)
 #define SEC_TO_MSEC 1000
 #endif
 
-bool obs_reset_audio2(const struct obs_audio_info2 *oai)
+bool obs_reset_audio3(const struct obs_audio_info3 *oai)
 {
 	struct obs_core_audio *audio = &obs->audio;
 	struct audio_output_info ai;
@@ -1609,37 +1614,67 @@ bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 	if (!oai)
 		return true;
 
+	uint32_t tick_frames = oai->tick_frames ? oai->tick_frames
+						: AUDIO_OUTPUT_FRAMES;
+	if (tick_frames < MIN_AUDIO_OUTPUT_FRAMES ||
+	    tick_frames > AUDIO_OUTPUT_FRAMES) {
+		blog(LOG_ERROR, "Invalid audio tick size: %" PRIu32,
+		     tick_frames);
+		return false;
+	}
+	audio->tick_frames = tick_frames;
+
 	if (oai->max_buffering_ms) {
 		uint32_t max_frames = oai->max_buffering_ms *
 				      oai->samples_per_sec / SEC_TO_MSEC;
-		max_frames += (AUDIO_OUTPUT_FRAMES - 1);
-		audio->max_buffering_ticks = max_frames / AUDIO_OUTPUT_FRAMES;
+		max_frames += (tick_frames - 1);
+		audio->max_buffering_ticks = max_frames / tick_frames;
 	} else {
-		audio->max_buffering_ticks = 45;
+		/* 45 ticks of the default size, regardless of tick size */
+		audio->max_buffering_ticks =
+			45 * AUDIO_OUTPUT_FRAMES / tick_frames;
 	}
 	audio->fixed_buffer = oai->fixed_buffering;
 
-	int max_buffering_ms = audio->max_buffering_ticks *
-			       AUDIO_OUTPUT_FRAMES * SEC_TO_MSEC /
-			       (int)oai->samples_per_sec;
+	int max_buffering_ms = audio->max_buffering_ticks * (int)tick_frames *
+			       SEC_TO_MSEC / (int)oai->samples_per_sec;
 
 	ai.name = "Audio";
 	ai.samples_per_sec = oai->samples_per_sec;
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.input_callback = audio_callback;
+	ai.input_param = NULL;
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO,
 	     "audio settings reset:\n"
 	     "\tsamples per sec: %d\n"
 	     "\tspeakers:        %d\n"
+	     "\ttick size:       %d frames (%.2f milliseconds)\n"
 	     "\tmax buffering:   %d milliseconds\n"
 	     "\tbuffering type:  %s",
-	     (int)ai.samples_per_sec, (int)ai.speakers, max_buffering_ms,
+	     (int)ai.samples_per_sec, (int)ai.speakers, (int)tick_frames,
+	     (double)tick_frames * 1000.0 / (double)ai.samples_per_sec,
+	     max_buffering_ms,
 	     oai->fixed_buffering ? "fixed" : "dynamically increasing");
 
-	return obs_init_audio(&ai);
+	return obs_init_audio(&ai, tick_frames);
+}
+
+bool obs_reset_audio2(const struct obs_audio_info2 *oai)
+{
+	if (!oai)
+		return obs_reset_audio3(NULL);
+
+	struct obs_audio_info3 oai3 = {
+		.samples_per_sec = oai->samples_per_sec,
+		.speakers = oai->speakers,
+		.max_buffering_ms = oai->max_buffering_ms,
+		.fixed_buffering = oai->fixed_buffering,
+	};
+
+	return obs_reset_audio3(&oai3);
 }
 
 bool obs_reset_audio(const struct obs_audio_info *oai)
@@ -3025,6 +3060,26 @@ void obs_get_audio_monitoring_device(const char **name, const char **id)
 		*id = obs->audio.monitoring_device_id;
 }
 
+void obs_set_audio_monitoring_bus(bool enable)
+{
+	if (!obs_audio_monitoring_available())
+		return;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	if (obs->audio.monitoring_bus != enable) {
+		obs->audio.monitoring_bus = enable;
+		obs_reset_audio_monitoring();
+	}
+
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+}
+
+bool obs_audio_monitoring_bus_enabled(void)
+{
+	return obs->audio.monitoring_bus;
+}
+
 void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 			   void *param)
 {
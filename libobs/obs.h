@@ -214,6 +214,18 @@ struct obs_audio_info2 {
 	bool fixed_buffering;
 };
 
+struct obs_audio_info3 {
+	uint32_t samples_per_sec;
+	enum speaker_layout speakers;
+
+	uint32_t max_buffering_ms;
+	bool fixed_buffering;
+
+	/* frames per audio tick, 0 for the default of AUDIO_OUTPUT_FRAMES.
+	 * smaller values lower latency at the cost of more overhead */
+	uint32_t tick_frames;
+};
+
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
  * audio data
@@ -246,6 +258,8 @@ struct obs_source_cea_708 {
 };
 
 #define OBS_SOURCE_FRAME_LINEAR_ALPHA (1 << 0)
+/* reserved for use by libobs, must not be set on frames output by sources */
+#define OBS_SOURCE_FRAME_RESERVED_7 (1 << 7)
 
 /**
  * Source asynchronous video output structure.  Used with
@@ -282,6 +296,25 @@ struct obs_source_frame {
 	bool prev_frame;
 };
 
+/**
+ * Planes of an asynchronous video frame that is in GPU memory, shared as
+ * DMA-BUF file descriptors.  Used with obs_source_output_video_dmabuf.  There
+ * is one plane per texture the format is converted from, i.e. two for NV12
+ * and P010.
+ */
+struct obs_source_frame_dmabuf {
+	uint32_t num_planes;
+	int fds[MAX_AV_PLANES];
+	uint32_t drm_formats[MAX_AV_PLANES];
+	uint32_t offsets[MAX_AV_PLANES];
+	uint32_t strides[MAX_AV_PLANES];
+	uint64_t modifiers[MAX_AV_PLANES];
+
+	/* called from any thread once the planes are no longer used */
+	void (*release)(void *param);
+	void *param;
+};
+
 struct obs_source_frame2 {
 	uint8_t *data[MAX_AV_PLANES];
 	uint32_t linesize[MAX_AV_PLANES];
@@ -423,6 +456,7 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 EXPORT bool obs_reset_audio2(const struct obs_audio_info2 *oai);
+EXPORT bool obs_reset_audio3(const struct obs_audio_info3 *oai);
 
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
@@ -840,6 +874,13 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/**
+ * Mixes all monitored sources into a single stream instead of opening one
+ * stream per source.  Only used by backends that support it (PulseAudio).
+ */
+EXPORT void obs_set_audio_monitoring_bus(bool enable);
+EXPORT bool obs_audio_monitoring_bus_enabled(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
@@ -1441,6 +1482,22 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_video2(obs_source_t *source,
 				     const struct obs_source_frame2 *frame);
 
+/**
+ * Outputs asynchronous video that is in GPU memory.  The frame describes the
+ * video and its data pointers are ignored, the planes are imported as
+ * textures when the frame is rendered.
+ *
+ * Returns false if the source can't use the frame this way right now, for
+ * example because it has async video filters or deinterlacing enabled, or
+ * the planes failed to import before.  The frame should then be output with
+ * obs_source_output_video instead.  Otherwise the release callback is called
+ * once the planes are no longer used.
+ */
+EXPORT bool
+obs_source_output_video_dmabuf(obs_source_t *source,
+			       const struct obs_source_frame *frame,
+			       const struct obs_source_frame_dmabuf *dmabuf);
+
 EXPORT void obs_source_set_async_rotation(obs_source_t *source, long rotation);
 
 EXPORT void obs_source_output_cea708(obs_source_t *source,
@@ -1480,7 +1537,16 @@ EXPORT void obs_source_output_audio(obs_source_t *source,
 /** Signal an update to any currently used properties via 'update_properties' */
 EXPORT void obs_source_update_properties(obs_source_t *source);
 
-/** Gets the current async video frame */
+/**
+ * Signals that the video of a source with the OBS_SOURCE_STATIC_CONTENT
+ * flag has changed, invalidating cached renders of it
+ */
+EXPORT void obs_source_mark_dirty(obs_source_t *source);
+
+/**
+ * Gets the current async video frame, or NULL if it has no data in CPU
+ * memory because it was output with obs_source_output_video_dmabuf
+ */
 EXPORT struct obs_source_frame *obs_source_get_frame(obs_source_t *source);
 
 /** Releases the current async video frame */
@@ -1586,6 +1652,12 @@ EXPORT uint32_t obs_source_get_base_height(obs_source_t *source);
 
 EXPORT bool obs_source_audio_pending(const obs_source_t *source);
 EXPORT uint64_t obs_source_get_audio_timestamp(const obs_source_t *source);
+
+/**
+ * Gets the time in nanoseconds it took to render the source's audio on the
+ * last audio tick, including filters of sources that mix their own audio
+ */
+EXPORT uint64_t obs_source_get_audio_dsp_time(const obs_source_t *source);
 EXPORT void obs_source_get_audio_mix(const obs_source_t *source,
 				     struct obs_source_audio_mix *audio);
 
@@ -1599,6 +1671,13 @@ EXPORT bool obs_source_async_unbuffered(const obs_source_t *source);
 EXPORT void obs_source_set_async_decoupled(obs_source_t *source, bool decouple);
 EXPORT bool obs_source_async_decoupled(const obs_source_t *source);
 
+/** Used for sources that output their frames ahead of time, timestamped with
+ * the system time they are due at.  Each render shows the newest frame that
+ * is due instead of pacing the frames by when they arrived. */
+EXPORT void obs_source_set_async_render_clock(obs_source_t *source,
+					      bool enable);
+EXPORT bool obs_source_async_render_clock(const obs_source_t *source);
+
 EXPORT void obs_source_set_audio_active(obs_source_t *source, bool show);
 EXPORT bool obs_source_audio_active(const obs_source_t *source);
 
@@ -1756,6 +1835,13 @@ EXPORT obs_source_t *obs_scene_get_source(const obs_scene_t *scene);
 /** Gets the scene from its source, or NULL if not a scene */
 EXPORT obs_scene_t *obs_scene_from_source(const obs_source_t *source);
 
+/**
+ * Gets the total number of item renders skipped by the scene because the
+ * item was outside of the canvas or fully covered by an opaque item
+ */
+EXPORT void obs_scene_get_culled_items(const obs_scene_t *scene,
+				       uint64_t *offscreen, uint64_t *occluded);
+
 /** Determines whether a source is within a scene */
 EXPORT obs_sceneitem_t *obs_scene_find_source(obs_scene_t *scene,
 					      const char *name);
@@ -2094,6 +2180,30 @@ EXPORT uint32_t obs_output_get_delay(const obs_output_t *output);
 /** If delay is active, gets the currently active delay value, in seconds. */
 EXPORT uint32_t obs_output_get_active_delay(const obs_output_t *output);
 
+/**
+ * Sets the amount of memory delayed packets may use, in bytes.  Packets
+ * beyond the limit are spilled to files on disk.  0 (the default)
+ * keeps all delayed packets in memory.  Takes effect the next time the
+ * output is activated.
+ */
+EXPORT void obs_output_set_delay_memory_limit(obs_output_t *output,
+					      size_t max_bytes);
+
+/** Gets the memory limit for delayed packets, in bytes. */
+EXPORT size_t obs_output_get_delay_memory_limit(const obs_output_t *output);
+
+/**
+ * Sets the directory delayed packets are spilled to when the memory limit is
+ * exceeded.  NULL (the default) uses a directory in the module config path.
+ * Takes effect the next time the output is activated.
+ */
+EXPORT void obs_output_set_delay_spill_path(obs_output_t *output,
+					    const char *path);
+
+/** Gets the directory delayed packets are spilled to. */
+EXPORT const char *
+obs_output_get_delay_spill_path(const obs_output_t *output);
+
 /** Forces the output to stop.  Usually only used with delay. */
 EXPORT void obs_output_force_stop(obs_output_t *output);
 
@@ -2595,6 +2705,11 @@ EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 				   struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+/** Creates a new reference counted packet with a copy of the source data */
+EXPORT void
+obs_encoder_packet_create_instance(struct encoder_packet *dst,
+				   const struct encoder_packet *src);
+
 EXPORT void *obs_encoder_create_rerouted(obs_encoder_t *encoder,
 					 const char *reroute_id);
 
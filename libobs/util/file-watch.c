@@ -0,0 +1,454 @@
+#include <string.h>
+#include <sys/stat.h>
+
+#include "file-watch.h"
+#include "platform.h"
+#include "threading.h"
+#include "darray.h"
+#include "bmem.h"
+#include "base.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#define USE_INOTIFY
+#endif
+
+/* a change is reported once the file has been left alone for a moment, or
+ * after a while at the latest for files that are written continuously */
+#define DEBOUNCE_NS 250000000ULL
+#define MAX_DELAY_NS 1000000000ULL
+#define POLL_INTERVAL_NS 1000000000ULL
+
+#define INOTIFY_MASK                                                  \
+	(IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | \
+	 IN_MOVED_FROM | IN_MOVED_TO)
+
+struct os_file_watch {
+	char *path;
+	const char *name;
+	os_file_watch_cb callback;
+	void *param;
+
+	/* directory watch, or -1 if the file is polled */
+	int wd;
+
+	time_t mtime;
+	int64_t size;
+
+	uint64_t changed_ts;
+	uint64_t due_ts;
+};
+
+struct watch_thread {
+#ifdef USE_INOTIFY
+	int inotify_fd;
+	int wake_fd;
+#else
+	os_event_t *wake;
+#endif
+};
+
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t callback_cond = PTHREAD_COND_INITIALIZER;
+static DARRAY(struct os_file_watch *) watches;
+static struct watch_thread *cur_thread = NULL;
+static struct os_file_watch *dispatching = NULL;
+
+static THREAD_LOCAL bool in_callback = false;
+
+static void update_stat(struct os_file_watch *watch)
+{
+	struct stat st;
+
+	if (os_stat(watch->path, &st) == 0) {
+		watch->mtime = st.st_mtime;
+		watch->size = (int64_t)st.st_size;
+	} else {
+		watch->mtime = -1;
+		watch->size = -1;
+	}
+}
+
+static void mark_changed(struct os_file_watch *watch, uint64_t ts)
+{
+	if (!watch->due_ts)
+		watch->changed_ts = ts;
+
+	watch->due_ts = ts + DEBOUNCE_NS;
+	if (watch->due_ts > watch->changed_ts + MAX_DELAY_NS)
+		watch->due_ts = watch->changed_ts + MAX_DELAY_NS;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef USE_INOTIFY
+
+static void add_dir_watch(struct watch_thread *wt,
+			  struct os_file_watch *watch)
+{
+	const size_t dir_len = watch->name - watch->path;
+	char *dir;
+
+	if (dir_len == 0) {
+		dir = bstrdup(".");
+	} else {
+		/* keep the slash of the root directory */
+		dir = bstrdup_n(watch->path, dir_len > 1 ? dir_len - 1 : 1);
+	}
+
+	/* the directory is watched instead of the file, so that files
+	 * replaced by renaming another one over them keep being watched */
+	watch->wd = inotify_add_watch(wt->inotify_fd, dir,
+				      INOTIFY_MASK | IN_ONLYDIR);
+	bfree(dir);
+}
+
+static void remove_dir_watch(struct watch_thread *wt,
+			     struct os_file_watch *watch)
+{
+	if (watch->wd == -1)
+		return;
+
+	/* directories are only watched once, no matter how many files in
+	 * them are watched */
+	for (size_t i = 0; i < watches.num; i++) {
+		if (watches.array[i] != watch &&
+		    watches.array[i]->wd == watch->wd)
+			return;
+	}
+
+	inotify_rm_watch(wt->inotify_fd, watch->wd);
+}
+
+static void wake_thread(struct watch_thread *wt)
+{
+	uint64_t val = 1;
+	if (write(wt->wake_fd, &val, sizeof(val)) != sizeof(val))
+		blog(LOG_WARNING, "file-watch: Failed to wake the thread");
+}
+
+static void handle_event(const struct inotify_event *ev, uint64_t ts)
+{
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+
+		if (ev->mask & IN_Q_OVERFLOW) {
+			mark_changed(watch, ts);
+
+		} else if (watch->wd == ev->wd) {
+			if (ev->mask & IN_IGNORED) {
+				/* the directory is gone */
+				watch->wd = -1;
+				mark_changed(watch, ts);
+			} else if (ev->len && strcmp(ev->name, watch->name) == 0) {
+				mark_changed(watch, ts);
+			}
+		}
+	}
+}
+
+static void wait_for_events(struct watch_thread *wt, int timeout_ms)
+{
+	struct pollfd fds[2] = {
+		{.fd = wt->inotify_fd, .events = POLLIN},
+		{.fd = wt->wake_fd, .events = POLLIN},
+	};
+	char buf[4096]
+		__attribute__((aligned(__alignof__(struct inotify_event))));
+	uint64_t val;
+
+	if (poll(fds, 2, timeout_ms) <= 0)
+		return;
+
+	if (fds[1].revents & POLLIN) {
+		if (read(wt->wake_fd, &val, sizeof(val)) != sizeof(val))
+			blog(LOG_DEBUG, "file-watch: Failed to read wake fd");
+	}
+
+	if (!(fds[0].revents & POLLIN))
+		return;
+
+	for (;;) {
+		const ssize_t len = read(wt->inotify_fd, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+
+		const uint64_t ts = os_gettime_ns();
+		const struct inotify_event *ev;
+
+		pthread_mutex_lock(&watch_mutex);
+		for (char *ptr = buf; ptr < buf + len;
+		     ptr += sizeof(struct inotify_event) + ev->len) {
+			ev = (const struct inotify_event *)ptr;
+			handle_event(ev, ts);
+		}
+		pthread_mutex_unlock(&watch_mutex);
+	}
+}
+
+static struct watch_thread *watch_thread_create(void)
+{
+	struct watch_thread *wt = bzalloc(sizeof(*wt));
+
+	wt->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	wt->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (wt->inotify_fd == -1 || wt->wake_fd == -1)
+		blog(LOG_WARNING, "file-watch: Failed to initialize inotify, "
+				  "falling back to polling");
+
+	return wt;
+}
+
+static void watch_thread_free(struct watch_thread *wt)
+{
+	if (wt->inotify_fd != -1)
+		close(wt->inotify_fd);
+	if (wt->wake_fd != -1)
+		close(wt->wake_fd);
+	bfree(wt);
+}
+
+#else
+
+static void add_dir_watch(struct watch_thread *wt,
+			  struct os_file_watch *watch)
+{
+	UNUSED_PARAMETER(wt);
+	watch->wd = -1;
+}
+
+static void remove_dir_watch(struct watch_thread *wt,
+			     struct os_file_watch *watch)
+{
+	UNUSED_PARAMETER(wt);
+	UNUSED_PARAMETER(watch);
+}
+
+static void wake_thread(struct watch_thread *wt)
+{
+	os_event_signal(wt->wake);
+}
+
+static void wait_for_events(struct watch_thread *wt, int timeout_ms)
+{
+	if (timeout_ms < 0)
+		os_event_wait(wt->wake);
+	else
+		os_event_timedwait(wt->wake, (unsigned long)timeout_ms);
+}
+
+static struct watch_thread *watch_thread_create(void)
+{
+	struct watch_thread *wt = bzalloc(sizeof(*wt));
+	os_event_init(&wt->wake, OS_EVENT_TYPE_AUTO);
+	return wt;
+}
+
+static void watch_thread_free(struct watch_thread *wt)
+{
+	os_event_destroy(wt->wake);
+	bfree(wt);
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static void poll_files(struct watch_thread *wt, uint64_t ts)
+{
+	pthread_mutex_lock(&watch_mutex);
+
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+		const time_t mtime = watch->mtime;
+		const int64_t size = watch->size;
+
+		if (watch->wd != -1)
+			continue;
+
+		/* the directory may have been created again meanwhile */
+		add_dir_watch(wt, watch);
+
+		update_stat(watch);
+		if (watch->mtime != mtime || watch->size != size)
+			mark_changed(watch, ts);
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+}
+
+static void dispatch_changes(uint64_t ts)
+{
+	pthread_mutex_lock(&watch_mutex);
+
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+
+		if (!watch->due_ts || watch->due_ts > ts)
+			continue;
+
+		watch->due_ts = 0;
+		dispatching = watch;
+		pthread_mutex_unlock(&watch_mutex);
+
+		in_callback = true;
+		watch->callback(watch->param, watch->path);
+		in_callback = false;
+
+		pthread_mutex_lock(&watch_mutex);
+		dispatching = NULL;
+		pthread_cond_broadcast(&callback_cond);
+
+		/* watches may have been added or removed by the callback */
+		i = (size_t)-1;
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+}
+
+static int get_timeout_ms(uint64_t ts, uint64_t next_poll_ts)
+{
+	uint64_t wake_ts = UINT64_MAX;
+
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+
+		if (watch->due_ts && watch->due_ts < wake_ts)
+			wake_ts = watch->due_ts;
+		if (watch->wd == -1 && next_poll_ts < wake_ts)
+			wake_ts = next_poll_ts;
+	}
+
+	if (wake_ts == UINT64_MAX)
+		return -1;
+	if (wake_ts <= ts)
+		return 0;
+	return (int)((wake_ts - ts + 999999) / 1000000);
+}
+
+static void *watch_thread(void *data)
+{
+	struct watch_thread *wt = data;
+	uint64_t next_poll_ts = os_gettime_ns() + POLL_INTERVAL_NS;
+
+	os_set_thread_name("file-watch: watch thread");
+
+	for (;;) {
+		uint64_t ts = os_gettime_ns();
+		int timeout_ms;
+
+		pthread_mutex_lock(&watch_mutex);
+		if (!watches.num) {
+			/* a new thread is started with the next watch */
+			cur_thread = NULL;
+			pthread_mutex_unlock(&watch_mutex);
+			break;
+		}
+		timeout_ms = get_timeout_ms(ts, next_poll_ts);
+		pthread_mutex_unlock(&watch_mutex);
+
+		wait_for_events(wt, timeout_ms);
+
+		ts = os_gettime_ns();
+		if (ts >= next_poll_ts) {
+			poll_files(wt, ts);
+			next_poll_ts = ts + POLL_INTERVAL_NS;
+		}
+
+		dispatch_changes(ts);
+	}
+
+	watch_thread_free(wt);
+	return NULL;
+}
+
+os_file_watch_t *os_file_watch_create(const char *path,
+				      os_file_watch_cb callback, void *param)
+{
+	struct os_file_watch *watch;
+	const char *slash;
+
+	if (!path || !*path || !callback)
+		return NULL;
+
+	watch = bzalloc(sizeof(*watch));
+	watch->path = bstrdup(path);
+	watch->callback = callback;
+	watch->param = param;
+
+	slash = strrchr(watch->path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(watch->path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+#endif
+	watch->name = slash ? slash + 1 : watch->path;
+
+	update_stat(watch);
+
+	pthread_mutex_lock(&watch_mutex);
+
+	if (!cur_thread) {
+		pthread_t thread;
+
+		cur_thread = watch_thread_create();
+		if (pthread_create(&thread, NULL, watch_thread, cur_thread) !=
+		    0) {
+			blog(LOG_ERROR, "file-watch: Failed to create thread");
+			watch_thread_free(cur_thread);
+			cur_thread = NULL;
+			pthread_mutex_unlock(&watch_mutex);
+
+			bfree(watch->path);
+			bfree(watch);
+			return NULL;
+		}
+
+		pthread_detach(thread);
+	}
+
+	add_dir_watch(cur_thread, watch);
+	da_push_back(watches, &watch);
+
+#ifdef USE_INOTIFY
+	if (watch->wd == -1)
+		blog(LOG_DEBUG, "file-watch: Cannot watch the directory of "
+				"'%s', polling it",
+		     path);
+#endif
+
+	/* polled files change how long the thread waits */
+	if (watch->wd == -1)
+		wake_thread(cur_thread);
+
+	pthread_mutex_unlock(&watch_mutex);
+
+	return watch;
+}
+
+void os_file_watch_destroy(os_file_watch_t *watch)
+{
+	if (!watch)
+		return;
+
+	pthread_mutex_lock(&watch_mutex);
+
+	remove_dir_watch(cur_thread, watch);
+	da_erase_item(watches, &watch);
+
+	while (dispatching == watch && !in_callback)
+		pthread_cond_wait(&callback_cond, &watch_mutex);
+
+	if (!watches.num) {
+		da_free(watches);
+		wake_thread(cur_thread);
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+
+	bfree(watch->path);
+	bfree(watch);
+}
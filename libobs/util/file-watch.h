@@ -0,0 +1,33 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * File change notifications
+ *
+ * All watches are serviced by one background thread, using inotify on
+ * Linux and by checking the modification time and size of the files once a
+ * second elsewhere.  Changes are debounced, and the callback is called from
+ * the watch thread once a file stopped changing for a moment.
+ */
+
+struct os_file_watch;
+typedef struct os_file_watch os_file_watch_t;
+
+typedef void (*os_file_watch_cb)(void *param, const char *path);
+
+EXPORT os_file_watch_t *os_file_watch_create(const char *path,
+					     os_file_watch_cb callback,
+					     void *param);
+
+/* Waits for the callback to return if it is in progress, unless called from
+ * the callback itself */
+EXPORT void os_file_watch_destroy(os_file_watch_t *watch);
+
+#ifdef __cplusplus
+}
+#endif
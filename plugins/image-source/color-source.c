@@ -140,7 +140,7 @@ struct obs_source_info color_source_info_v1 = {
 	.id = "color_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			OBS_SOURCE_CAP_OBSOLETE,
+			OBS_SOURCE_CAP_OBSOLETE | OBS_SOURCE_STATIC_CONTENT,
 	.create = color_source_create,
 	.destroy = color_source_destroy,
 	.update = color_source_update,
@@ -158,7 +158,7 @@ struct obs_source_info color_source_info_v2 = {
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			OBS_SOURCE_CAP_OBSOLETE,
+			OBS_SOURCE_CAP_OBSOLETE | OBS_SOURCE_STATIC_CONTENT,
 	.create = color_source_create,
 	.destroy = color_source_destroy,
 	.update = color_source_update,
@@ -176,7 +176,7 @@ struct obs_source_info color_source_info_v3 = {
 	.version = 3,
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			OBS_SOURCE_SRGB,
+			OBS_SOURCE_SRGB | OBS_SOURCE_STATIC_CONTENT,
 	.create = color_source_create,
 	.destroy = color_source_destroy,
 	.update = color_source_update,
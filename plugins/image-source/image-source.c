@@ -2,8 +2,8 @@
 #include <graphics/image-file.h>
 #include <util/threading.h>
 #include <util/platform.h>
+#include <util/file-watch.h>
 #include <util/dstr.h>
-#include <sys/stat.h>
 
 #define blog(log_level, format, ...)                    \
 	blog(log_level, "[image_source: '%s'] " format, \
@@ -20,23 +20,32 @@ struct image_source {
 	bool persistent;
 	bool is_slide;
 	bool linear_alpha;
-	time_t file_timestamp;
-	float update_time_elapsed;
 	uint64_t last_time;
 	bool active;
 	bool restart_gif;
 	volatile bool file_decoded;
 	volatile bool texture_loaded;
 
-	gs_image_file4_t if4;
+	/* slides are decoded at most at the slideshow's size */
+	uint32_t max_cx;
+	uint32_t max_cy;
+
+	/* slides are unloaded by the slideshow's decode threads while the
+	 * tick may be animating them */
+	pthread_mutex_t image_mutex;
+	gs_image_file5_t if5;
+
+	/* images changed on disk are decoded by the file watch thread and
+	 * swapped in on the next tick */
+	os_file_watch_t *file_watch;
+	pthread_mutex_t reload_mutex;
+	gs_image_file5_t reload_if5;
+	volatile bool reload_ready;
 };
 
-static time_t get_modified_timestamp(const char *filename)
+static inline gs_image_file_t *source_image(struct image_source *context)
 {
-	struct stat stats;
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-	return stats.st_mtime;
+	return &context->if5.image4.image3.image2.image;
 }
 
 static const char *image_source_get_name(void *unused)
@@ -51,11 +60,11 @@ void image_source_preload_image(void *data)
 	if (os_atomic_load_bool(&context->file_decoded))
 		return;
 
-	context->file_timestamp = get_modified_timestamp(context->file);
-	gs_image_file4_init(&context->if4, context->file,
-			    context->linear_alpha
-				    ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
-				    : GS_IMAGE_ALPHA_PREMULTIPLY);
+	gs_image_file5_init_shared(&context->if5, context->file,
+				   context->linear_alpha
+					   ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
+					   : GS_IMAGE_ALPHA_PREMULTIPLY,
+				   context->max_cx, context->max_cy);
 	os_atomic_set_bool(&context->file_decoded, true);
 }
 
@@ -67,25 +76,41 @@ static void image_source_load_texture(void *data)
 
 	debug("loading texture '%s'", context->file);
 
+	/* slides can be unloaded by the slideshow from another thread,
+	 * which happens within the graphics context as well */
 	obs_enter_graphics();
-	gs_image_file4_init_texture(&context->if4);
+	if (!os_atomic_load_bool(&context->file_decoded)) {
+		obs_leave_graphics();
+		return;
+	}
+
+	gs_image_file5_init_texture(&context->if5);
+	os_atomic_set_bool(&context->texture_loaded, true);
 	obs_leave_graphics();
 
-	if (!context->if4.image3.image2.image.loaded)
+	if (!source_image(context)->loaded)
 		warn("failed to load texture '%s'", context->file);
-	context->update_time_elapsed = 0;
-	os_atomic_set_bool(&context->texture_loaded, true);
+	obs_source_mark_dirty(context->source);
 }
 
 static void image_source_unload(void *data)
 {
 	struct image_source *context = data;
-	os_atomic_set_bool(&context->file_decoded, false);
-	os_atomic_set_bool(&context->texture_loaded, false);
 
+	pthread_mutex_lock(&context->image_mutex);
 	obs_enter_graphics();
-	gs_image_file4_free(&context->if4);
+	os_atomic_set_bool(&context->file_decoded, false);
+	os_atomic_set_bool(&context->texture_loaded, false);
+	gs_image_file5_free(&context->if5);
 	obs_leave_graphics();
+	pthread_mutex_unlock(&context->image_mutex);
+
+	obs_source_mark_dirty(context->source);
+}
+
+void image_source_unload_image(void *data)
+{
+	image_source_unload(data);
 }
 
 static void image_source_load(struct image_source *context)
@@ -98,6 +123,64 @@ static void image_source_load(struct image_source *context)
 	}
 }
 
+static void image_source_set_reload(struct image_source *context,
+				    gs_image_file5_t *if5)
+{
+	pthread_mutex_lock(&context->reload_mutex);
+
+	if (os_atomic_load_bool(&context->reload_ready)) {
+		obs_enter_graphics();
+		gs_image_file5_free(&context->reload_if5);
+		obs_leave_graphics();
+	}
+
+	if (if5)
+		context->reload_if5 = *if5;
+	os_atomic_set_bool(&context->reload_ready, !!if5);
+
+	pthread_mutex_unlock(&context->reload_mutex);
+}
+
+static void image_source_apply_reload(struct image_source *context)
+{
+	pthread_mutex_lock(&context->reload_mutex);
+	obs_enter_graphics();
+
+	/* the image may have been unloaded meanwhile */
+	if (os_atomic_load_bool(&context->file_decoded)) {
+		gs_image_file5_free(&context->if5);
+		context->if5 = context->reload_if5;
+		gs_image_file5_init_texture(&context->if5);
+		os_atomic_set_bool(&context->texture_loaded, true);
+	} else {
+		gs_image_file5_free(&context->reload_if5);
+	}
+
+	os_atomic_set_bool(&context->reload_ready, false);
+
+	obs_leave_graphics();
+	pthread_mutex_unlock(&context->reload_mutex);
+
+	debug("reloaded '%s'", context->file);
+	obs_source_mark_dirty(context->source);
+}
+
+static void image_source_file_changed(void *data, const char *path)
+{
+	struct image_source *context = data;
+	gs_image_file5_t if5;
+
+	if (!os_atomic_load_bool(&context->file_decoded))
+		return;
+
+	gs_image_file5_init_shared(&if5, path,
+				   context->linear_alpha
+					   ? GS_IMAGE_ALPHA_PREMULTIPLY_SRGB
+					   : GS_IMAGE_ALPHA_PREMULTIPLY,
+				   context->max_cx, context->max_cy);
+	image_source_set_reload(context, &if5);
+}
+
 static void image_source_update(void *data, obs_data_t *settings)
 {
 	struct image_source *context = data;
@@ -105,6 +188,8 @@ static void image_source_update(void *data, obs_data_t *settings)
 	const bool unload = obs_data_get_bool(settings, "unload");
 	const bool linear_alpha = obs_data_get_bool(settings, "linear_alpha");
 	const bool is_slide = obs_data_get_bool(settings, "is_slide");
+	const uint32_t max_cx = (uint32_t)obs_data_get_int(settings, "max_cx");
+	const uint32_t max_cy = (uint32_t)obs_data_get_int(settings, "max_cy");
 
 	if (context->file)
 		bfree(context->file);
@@ -112,6 +197,14 @@ static void image_source_update(void *data, obs_data_t *settings)
 	context->persistent = !unload;
 	context->linear_alpha = linear_alpha;
 	context->is_slide = is_slide;
+	context->max_cx = is_slide ? max_cx : 0;
+	context->max_cy = is_slide ? max_cy : 0;
+
+	/* a pending reload may have been decoded with the old settings */
+	os_file_watch_destroy(context->file_watch);
+	image_source_set_reload(context, NULL);
+	context->file_watch = os_file_watch_create(
+		context->file, image_source_file_changed, context);
 
 	if (is_slide)
 		return;
@@ -149,15 +242,16 @@ static void restart_gif(void *data)
 {
 	struct image_source *context = data;
 
-	if (context->if4.image3.image2.image.is_animated_gif) {
-		context->if4.image3.image2.image.cur_frame = 0;
-		context->if4.image3.image2.image.cur_loop = 0;
-		context->if4.image3.image2.image.cur_time = 0;
+	if (source_image(context)->is_animated_gif) {
+		source_image(context)->cur_frame = 0;
+		source_image(context)->cur_loop = 0;
+		source_image(context)->cur_time = 0;
 
 		obs_enter_graphics();
-		gs_image_file4_update_texture(&context->if4);
+		gs_image_file5_update_texture(&context->if5);
 		obs_leave_graphics();
 
+		obs_source_mark_dirty(context->source);
 		context->restart_gif = false;
 	}
 }
@@ -172,6 +266,8 @@ static void *image_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct image_source *context = bzalloc(sizeof(struct image_source));
 	context->source = source;
+	pthread_mutex_init(&context->reload_mutex, NULL);
+	pthread_mutex_init(&context->image_mutex, NULL);
 
 	image_source_update(context, settings);
 	return context;
@@ -181,7 +277,12 @@ static void image_source_destroy(void *data)
 {
 	struct image_source *context = data;
 
+	os_file_watch_destroy(context->file_watch);
+	image_source_set_reload(context, NULL);
+	pthread_mutex_destroy(&context->reload_mutex);
+
 	image_source_unload(context);
+	pthread_mutex_destroy(&context->image_mutex);
 
 	if (context->file)
 		bfree(context->file);
@@ -191,13 +292,13 @@ static void image_source_destroy(void *data)
 static uint32_t image_source_getwidth(void *data)
 {
 	struct image_source *context = data;
-	return context->if4.image3.image2.image.cx;
+	return source_image(context)->cx;
 }
 
 static uint32_t image_source_getheight(void *data)
 {
 	struct image_source *context = data;
-	return context->if4.image3.image2.image.cy;
+	return source_image(context)->cy;
 }
 
 static void image_source_render(void *data, gs_effect_t *effect)
@@ -206,7 +307,7 @@ static void image_source_render(void *data, gs_effect_t *effect)
 	if (!os_atomic_load_bool(&context->texture_loaded))
 		return;
 
-	struct gs_image_file *const image = &context->if4.image3.image2.image;
+	struct gs_image_file *const image = source_image(context);
 	gs_texture_t *const texture = image->texture;
 	if (!texture)
 		return;
@@ -227,9 +328,8 @@ static void image_source_render(void *data, gs_effect_t *effect)
 	gs_enable_framebuffer_srgb(previous);
 }
 
-static void image_source_tick(void *data, float seconds)
+static void image_source_tick_image(struct image_source *context)
 {
-	struct image_source *context = data;
 	if (!os_atomic_load_bool(&context->texture_loaded)) {
 		if (os_atomic_load_bool(&context->file_decoded))
 			image_source_load_texture(context);
@@ -239,22 +339,9 @@ static void image_source_tick(void *data, float seconds)
 
 	uint64_t frame_time = obs_get_video_frame_time();
 
-	context->update_time_elapsed += seconds;
-
-	if (obs_source_showing(context->source)) {
-		if (context->update_time_elapsed >= 1.0f) {
-			time_t t = get_modified_timestamp(context->file);
-			context->update_time_elapsed = 0.0f;
-
-			if (context->file_timestamp != t) {
-				image_source_load(context);
-			}
-		}
-	}
-
 	if (obs_source_showing(context->source)) {
 		if (!context->active) {
-			if (context->if4.image3.image2.image.is_animated_gif)
+			if (source_image(context)->is_animated_gif)
 				context->last_time = frame_time;
 			context->active = true;
 		}
@@ -272,20 +359,36 @@ static void image_source_tick(void *data, float seconds)
 	}
 
 	if (context->last_time &&
-	    context->if4.image3.image2.image.is_animated_gif) {
+	    source_image(context)->is_animated_gif) {
 		uint64_t elapsed = frame_time - context->last_time;
-		bool updated = gs_image_file4_tick(&context->if4, elapsed);
+		bool updated = gs_image_file5_tick(&context->if5, elapsed);
 
 		if (updated) {
 			obs_enter_graphics();
-			gs_image_file4_update_texture(&context->if4);
+			gs_image_file5_update_texture(&context->if5);
 			obs_leave_graphics();
+
+			obs_source_mark_dirty(context->source);
 		}
 	}
 
 	context->last_time = frame_time;
 }
 
+static void image_source_tick(void *data, float seconds)
+{
+	struct image_source *context = data;
+
+	UNUSED_PARAMETER(seconds);
+
+	if (os_atomic_load_bool(&context->reload_ready))
+		image_source_apply_reload(context);
+
+	pthread_mutex_lock(&context->image_mutex);
+	image_source_tick_image(context);
+	pthread_mutex_unlock(&context->image_mutex);
+}
+
 static const char *image_filter =
 #ifdef _WIN32
 	"All formats (*.bmp *.tga *.png *.jpeg *.jpg *.jxr *.gif *.psd *.webp);;"
@@ -323,7 +426,7 @@ static obs_properties_t *image_source_properties(void *data)
 uint64_t image_source_get_memory_usage(void *data)
 {
 	struct image_source *s = data;
-	return s->if4.image3.image2.mem_usage;
+	return s->if5.image4.image3.image2.mem_usage;
 }
 
 static void missing_file_callback(void *src, const char *new_path, void *data)
@@ -365,14 +468,14 @@ image_source_get_color_space(void *data, size_t count,
 	UNUSED_PARAMETER(preferred_spaces);
 
 	struct image_source *const s = data;
-	gs_image_file4_t *const if4 = &s->if4;
-	return if4->image3.image2.image.texture ? if4->space : GS_CS_SRGB;
+	return source_image(s)->texture ? s->if5.image4.space : GS_CS_SRGB;
 }
 
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
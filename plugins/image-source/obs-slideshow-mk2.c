@@ -63,6 +63,8 @@ static const char *TR_SLIDE                  = "slide";
 /* clang-format on */
 
 extern void image_source_preload_image(void *data);
+extern void image_source_unload_image(void *data);
+extern uint64_t image_source_get_memory_usage(void *data);
 
 /* ------------------------------------------------------------------------- */
 
@@ -86,6 +88,15 @@ enum behavior {
 
 #define SLIDE_BUFFER_COUNT 5
 
+/* slides decoded ahead of the current one, as long as the decoded slides
+ * stay within the memory limit.  the current and the previous slide are
+ * always kept decoded, every other buffered slide is unloaded. */
+#define SLIDE_PREFETCH_COUNT 3
+#define MAX_DECODE_QUEUES 4
+
+#define BYTES_TO_MBYTES (1024 * 1024)
+#define MAX_MEM_USAGE (400 * BYTES_TO_MBYTES)
+
 struct active_slides {
 	struct deque prev;
 	struct deque next;
@@ -119,11 +130,16 @@ struct slideshow {
 	obs_source_t *source;
 
 	struct slideshow_data data;
-	os_task_queue_t *queue;
+	os_task_queue_t *queues[MAX_DECODE_QUEUES];
+	size_t queue_count;
 	obs_source_t *transition;
 	uint32_t cx;
 	uint32_t cy;
 
+	/* largest decoded slide so far, used as the estimate for slides that
+	 * are not decoded yet */
+	uint64_t slide_mem_estimate;
+
 	obs_hotkey_id play_pause_hotkey;
 	obs_hotkey_id restart_hotkey;
 	obs_hotkey_id stop_hotkey;
@@ -293,6 +309,31 @@ static void decode_image(void *data)
 	obs_weak_source_release(weak);
 }
 
+static void unload_image(void *data)
+{
+	obs_weak_source_t *weak = data;
+
+	obs_source_t *source = obs_weak_source_get_source(weak);
+	if (source) {
+		image_source_unload_image(obs_obj_get_data(source));
+		obs_source_release(source);
+	}
+
+	obs_weak_source_release(weak);
+}
+
+/* a slide is always decoded and unloaded on the same queue so that the two
+ * can never run at the same time.  unloading is serialized against the
+ * slide's own tick by the image source. */
+static inline void queue_slide_task(struct slideshow *ss,
+				    const struct source_data *sd,
+				    os_task_t task)
+{
+	os_task_queue_t *queue = ss->queues[sd->slide_idx % ss->queue_count];
+	os_task_queue_queue_task(queue, task,
+				 obs_source_get_weak_source(sd->source));
+}
+
 /* creates source from a file path. only used in get_new_source(). */
 static inline obs_source_t *create_source_from_file(struct slideshow *ss,
 						    const char *file, bool now)
@@ -303,14 +344,35 @@ static inline obs_source_t *create_source_from_file(struct slideshow *ss,
 	obs_data_set_string(settings, "file", file);
 	obs_data_set_bool(settings, "unload", false);
 	obs_data_set_bool(settings, "is_slide", !now);
+	obs_data_set_int(settings, "max_cx", ss->cx);
+	obs_data_set_int(settings, "max_cy", ss->cy);
 	source = obs_source_create_private("image_source", NULL, settings);
 
 	obs_data_release(settings);
+	return source;
+}
+
+/* slides are decoded at the size the slideshow had when they were created,
+ * so reused ones have to be decoded again if it has changed since */
+static void update_slide_size(struct slideshow *ss,
+			      const struct source_data *sd)
+{
+	obs_data_t *settings = obs_source_get_settings(sd->source);
+	const bool changed =
+		(uint32_t)obs_data_get_int(settings, "max_cx") != ss->cx ||
+		(uint32_t)obs_data_get_int(settings, "max_cy") != ss->cy;
+	obs_data_release(settings);
 
-	os_task_queue_queue_task(ss->queue, decode_image,
-				 obs_source_get_weak_source(source));
+	if (!changed)
+		return;
 
-	return source;
+	settings = obs_data_create();
+	obs_data_set_int(settings, "max_cx", ss->cx);
+	obs_data_set_int(settings, "max_cy", ss->cy);
+	obs_source_update(sd->source, settings);
+	obs_data_release(settings);
+
+	queue_slide_task(ss, sd, unload_image);
 }
 
 /* searches the active slides for the same slide so we can reuse existing *
@@ -350,6 +412,7 @@ static struct source_data get_new_source(struct slideshow *ss,
 		sd = *psd;
 		sd.source = obs_source_get_ref(sd.source);
 		if (sd.source) {
+			update_slide_size(ss, &sd);
 			return sd;
 		}
 	}
@@ -374,6 +437,78 @@ static struct source_data get_new_source(struct slideshow *ss,
 	return sd;
 }
 
+static inline uint64_t get_slide_mem_usage(struct slideshow *ss,
+					    const struct source_data *sd)
+{
+	uint64_t usage = image_source_get_memory_usage(
+		obs_obj_get_data(sd->source));
+	if (usage > ss->slide_mem_estimate)
+		ss->slide_mem_estimate = usage;
+	return usage ? usage : ss->slide_mem_estimate;
+}
+
+static inline bool is_decoded_slide(obs_source_t *const *decoded, size_t count,
+				    obs_source_t *source)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (decoded[i] == source)
+			return true;
+	}
+
+	return false;
+}
+
+/* decodes the slides around the current one in the background and unloads
+ * the rest of the buffered slides, keeping the memory used for decoded
+ * images below MAX_MEM_USAGE no matter how many files there are */
+static void update_decoded_slides(struct slideshow *ss)
+{
+	struct active_slides *slides = &ss->data.slides;
+	obs_source_t *decoded[SLIDE_PREFETCH_COUNT + 2];
+	size_t decoded_count = 0;
+	const size_t prev_count = slides->prev.size / sizeof(struct source_data);
+	const size_t next_count = slides->next.size / sizeof(struct source_data);
+	struct source_data *sd;
+	uint64_t mem_usage;
+
+	if (!slides->cur.source)
+		return;
+
+	queue_slide_task(ss, &slides->cur, decode_image);
+	decoded[decoded_count++] = slides->cur.source;
+	mem_usage = get_slide_mem_usage(ss, &slides->cur);
+
+	if (prev_count) {
+		sd = deque_data(&slides->prev,
+				(prev_count - 1) * sizeof(*sd));
+		queue_slide_task(ss, sd, decode_image);
+		decoded[decoded_count++] = sd->source;
+		mem_usage += get_slide_mem_usage(ss, sd);
+	}
+
+	for (size_t i = 0; i < next_count && i < SLIDE_PREFETCH_COUNT; i++) {
+		sd = deque_data(&slides->next, i * sizeof(*sd));
+		mem_usage += get_slide_mem_usage(ss, sd);
+		if (i > 0 && mem_usage > MAX_MEM_USAGE)
+			break;
+
+		queue_slide_task(ss, sd, decode_image);
+		decoded[decoded_count++] = sd->source;
+	}
+
+	for (size_t i = 0; i < prev_count; i++) {
+		sd = deque_data(&slides->prev, i * sizeof(*sd));
+		if (!is_decoded_slide(decoded, decoded_count, sd->source))
+			queue_slide_task(ss, sd, unload_image);
+	}
+
+	for (size_t i = 0; i < next_count; i++) {
+		sd = deque_data(&slides->next, i * sizeof(*sd));
+		if (!is_decoded_slide(decoded, decoded_count, sd->source))
+			queue_slide_task(ss, sd, unload_image);
+	}
+}
+
 static void restart_slides(struct slideshow *ss)
 {
 	struct slideshow_data *ssd = &ss->data;
@@ -408,6 +543,8 @@ static void restart_slides(struct slideshow *ss)
 
 	free_active_slides(&ssd->slides);
 	ssd->slides = new_slides;
+
+	update_decoded_slides(ss);
 }
 
 static void ss_update(void *data, obs_data_t *settings)
@@ -555,13 +692,16 @@ static void ss_update(void *data, obs_data_t *settings)
 	/* ------------------------------------- */
 	/* update files                          */
 
+	/* slides are decoded at most at the custom size */
+	ss->cx = cx;
+	ss->cy = cy;
+	ss->slide_mem_estimate = (uint64_t)cx * cy * 4;
+
 	restart_slides(ss);
 
 	/* ------------------------------------- */
 	/* restart transition                    */
 
-	ss->cx = cx;
-	ss->cy = cy;
 	obs_transition_set_size(ss->transition, cx, cy);
 	obs_transition_set_alignment(ss->transition, OBS_ALIGN_CENTER);
 	obs_transition_set_scale_type(ss->transition,
@@ -654,6 +794,7 @@ static void ss_next_slide(void *data)
 	deque_pop_front(&slides->prev, &sd, sizeof(sd));
 	free_source_data(&sd);
 
+	update_decoded_slides(ss);
 	do_transition(ss, false);
 }
 
@@ -684,6 +825,7 @@ static void ss_previous_slide(void *data)
 	deque_pop_back(&slides->next, &sd, sizeof(sd));
 	free_source_data(&sd);
 
+	update_decoded_slides(ss);
 	do_transition(ss, false);
 }
 
@@ -769,7 +911,8 @@ static void ss_destroy(void *data)
 {
 	struct slideshow *ss = data;
 
-	os_task_queue_destroy(ss->queue);
+	for (size_t i = 0; i < ss->queue_count; i++)
+		os_task_queue_destroy(ss->queues[i]);
 	obs_source_release(ss->transition);
 	free_slideshow_data(&ss->data);
 	bfree(ss);
@@ -786,7 +929,17 @@ static void *ss_create(obs_data_t *settings, obs_source_t *source)
 	ss->data.paused = false;
 	ss->data.stop = false;
 
-	ss->queue = os_task_queue_create();
+	/* a few decode threads so that the prefetched slides are decoded in
+	 * parallel */
+	int queues = os_get_logical_cores() / 2;
+	if (queues < 1)
+		queues = 1;
+	else if (queues > MAX_DECODE_QUEUES)
+		queues = MAX_DECODE_QUEUES;
+
+	ss->queue_count = (size_t)queues;
+	for (size_t i = 0; i < ss->queue_count; i++)
+		ss->queues[i] = os_task_queue_create();
 
 	ss->play_pause_hotkey = obs_hotkey_register_source(
 		source, "SlideShow.PlayPause",
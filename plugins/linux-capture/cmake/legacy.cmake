@@ -1,7 +1,7 @@
 project(linux-capture)
 
 find_package(X11 REQUIRED)
-find_package(XCB COMPONENTS XCB XFIXES RANDR SHM XINERAMA COMPOSITE)
+find_package(XCB COMPONENTS XCB DAMAGE XFIXES RANDR SHM XINERAMA COMPOSITE)
 if(NOT TARGET XCB::COMPOSITE)
   obs_status(FATAL_ERROR "xcb composite library not found")
 endif()
@@ -26,6 +26,7 @@ target_link_libraries(
           OBS::obsglad
           X11::X11
           XCB::XCB
+          XCB::DAMAGE
           XCB::XFIXES
           XCB::RANDR
           XCB::SHM
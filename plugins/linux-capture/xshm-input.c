@@ -18,13 +18,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <xcb/damage.h>
 #include <xcb/randr.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
 
 #include <obs-module.h>
+#include <util/darray.h>
 #include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -32,14 +36,65 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* more damaged rectangles than this are merged into their bounding box */
+#define XSHM_MAX_RECTS 32
+
+/**
+ * Part of the screen that has changed
+ */
+struct xshm_damage {
+	DARRAY(xcb_rectangle_t) rects;
+	bool full;
+};
+
+/**
+ * Rows of the screen that are fetched with a single request
+ */
+struct xshm_band {
+	uint32_t y;
+	uint32_t end;
+};
+
 struct xshm_data {
 	obs_source_t *source;
 
 	xcb_connection_t *xcb;
 	xcb_screen_t *xcb_screen;
-	xcb_shm_t *xshm;
+	xcb_shm_t *xshm[2];
 	xcb_xcursor_t *cursor;
 
+	/*
+	 * The capture thread copies the screen into one of the two shm
+	 * segments while the graphics thread uploads the other one.  Only
+	 * the damaged rows are copied, and only the damaged rectangles
+	 * are uploaded.
+	 */
+	pthread_t capture_thread;
+	bool capture_thread_active;
+	os_event_t *capture_event;
+	volatile bool stop_capture;
+
+	pthread_mutex_t frame_mutex;
+	int ready_buf;
+	int reading_buf;
+	bool new_frame;
+	struct xshm_damage upload;
+
+	/* capture thread only */
+	struct xshm_damage fresh;
+	struct xshm_damage pending[2];
+	struct xshm_damage unpublished;
+	DARRAY(struct xshm_band) bands;
+	DARRAY(xcb_shm_get_image_cookie_t) cookies;
+
+	/* graphics thread only */
+	struct xshm_damage uploading;
+	bool region_uploads;
+
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
+	bool use_damage;
+
 	char *server;
 	uint_fast32_t screen_id;
 	int_fast32_t x_org;
@@ -101,6 +156,349 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	return ok;
 }
 
+/**
+ * Mark the whole screen as changed
+ */
+static inline void xshm_damage_set_full(struct xshm_damage *damage)
+{
+	damage->full = true;
+	da_resize(damage->rects, 0);
+}
+
+static inline void xshm_damage_clear(struct xshm_damage *damage)
+{
+	damage->full = false;
+	da_resize(damage->rects, 0);
+}
+
+static void xshm_damage_add(struct xshm_damage *damage,
+			    const xcb_rectangle_t *rect)
+{
+	if (damage->full)
+		return;
+
+	if (damage->rects.num < XSHM_MAX_RECTS) {
+		da_push_back(damage->rects, rect);
+		return;
+	}
+
+	int32_t x1 = rect->x;
+	int32_t y1 = rect->y;
+	int32_t x2 = rect->x + rect->width;
+	int32_t y2 = rect->y + rect->height;
+
+	for (size_t i = 0; i < damage->rects.num; i++) {
+		const xcb_rectangle_t *r = damage->rects.array + i;
+		x1 = r->x < x1 ? r->x : x1;
+		y1 = r->y < y1 ? r->y : y1;
+		x2 = r->x + r->width > x2 ? r->x + r->width : x2;
+		y2 = r->y + r->height > y2 ? r->y + r->height : y2;
+	}
+
+	da_resize(damage->rects, 1);
+	damage->rects.array[0] = (xcb_rectangle_t){
+		(int16_t)x1, (int16_t)y1, (uint16_t)(x2 - x1),
+		(uint16_t)(y2 - y1)};
+}
+
+static void xshm_damage_merge(struct xshm_damage *dst,
+			      const struct xshm_damage *src)
+{
+	if (src->full) {
+		xshm_damage_set_full(dst);
+		return;
+	}
+
+	for (size_t i = 0; i < src->rects.num; i++)
+		xshm_damage_add(dst, src->rects.array + i);
+}
+
+static inline void xshm_damage_free(struct xshm_damage *damage)
+{
+	da_free(damage->rects);
+	damage->full = false;
+}
+
+/**
+ * Set up damage tracking for the root window
+ *
+ * Without it every frame is copied and uploaded in full.
+ */
+static bool xshm_init_damage(struct xshm_data *data)
+{
+	xcb_connection_t *xcb = data->xcb;
+
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present ||
+	    !xcb_get_extension_data(xcb, &xcb_xfixes_id)->present) {
+		blog(LOG_INFO, "Missing Damage extension, capturing full "
+			       "frames");
+		return false;
+	}
+
+	/* regions need xfixes 2.0, both versions have to be negotiated
+	 * before the extensions can be used */
+	xcb_xfixes_query_version_reply_t *xfixes_r =
+		xcb_xfixes_query_version_reply(
+			xcb, xcb_xfixes_query_version(xcb, 2, 0), NULL);
+	xcb_damage_query_version_reply_t *damage_r =
+		xcb_damage_query_version_reply(
+			xcb, xcb_damage_query_version(xcb, 1, 1), NULL);
+
+	bool ok = xfixes_r && xfixes_r->major_version >= 2 && damage_r;
+	free(xfixes_r);
+	free(damage_r);
+
+	if (!ok) {
+		blog(LOG_INFO, "Damage extension unusable, capturing full "
+			       "frames");
+		return false;
+	}
+
+	data->damage = xcb_generate_id(xcb);
+	xcb_generic_error_t *err = xcb_request_check(
+		xcb, xcb_damage_create_checked(
+			     xcb, data->damage, data->xcb_screen->root,
+			     XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY));
+	if (err) {
+		blog(LOG_INFO, "Failed to create damage object, capturing "
+			       "full frames");
+		free(err);
+		return false;
+	}
+
+	data->damage_region = xcb_generate_id(xcb);
+	xcb_xfixes_create_region(xcb, data->damage_region, 0, NULL);
+	return true;
+}
+
+/**
+ * Collect the rectangles that changed since the last call
+ */
+static void xshm_fetch_damage(struct xshm_data *data,
+			      struct xshm_damage *damage)
+{
+	xcb_xfixes_fetch_region_reply_t *region_r;
+
+	if (!data->use_damage) {
+		xshm_damage_set_full(damage);
+		return;
+	}
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			    data->damage_region);
+	region_r = xcb_xfixes_fetch_region_reply(
+		data->xcb,
+		xcb_xfixes_fetch_region(data->xcb, data->damage_region), NULL);
+	if (!region_r) {
+		xshm_damage_set_full(damage);
+		return;
+	}
+
+	const xcb_rectangle_t *rects =
+		xcb_xfixes_fetch_region_rectangles(region_r);
+	const int count = xcb_xfixes_fetch_region_rectangles_length(region_r);
+
+	/* clip to the captured area and make the rectangles relative to
+	 * it */
+	for (int i = 0; i < count; i++) {
+		int32_t x1 = rects[i].x - data->adj_x_org;
+		int32_t y1 = rects[i].y - data->adj_y_org;
+		int32_t x2 = x1 + rects[i].width;
+		int32_t y2 = y1 + rects[i].height;
+
+		x1 = x1 < 0 ? 0 : x1;
+		y1 = y1 < 0 ? 0 : y1;
+		x2 = x2 > data->adj_width ? (int32_t)data->adj_width : x2;
+		y2 = y2 > data->adj_height ? (int32_t)data->adj_height : y2;
+
+		if (x2 <= x1 || y2 <= y1)
+			continue;
+
+		xcb_rectangle_t rect = {(int16_t)x1, (int16_t)y1,
+					(uint16_t)(x2 - x1),
+					(uint16_t)(y2 - y1)};
+		xshm_damage_add(damage, &rect);
+	}
+
+	free(region_r);
+}
+
+static int xshm_band_cmp(const void *a, const void *b)
+{
+	const struct xshm_band *band_a = a;
+	const struct xshm_band *band_b = b;
+
+	return band_a->y < band_b->y ? -1 : (band_a->y > band_b->y ? 1 : 0);
+}
+
+/**
+ * Turn the damaged rectangles into full width bands of rows
+ *
+ * The server packs the image it writes into the shm segment at the width
+ * that was requested, so full rows are fetched to keep the pitch of the
+ * segment intact.
+ */
+static void xshm_build_bands(struct xshm_data *data,
+			     const struct xshm_damage *damage)
+{
+	size_t count = 0;
+
+	da_resize(data->bands, 0);
+
+	if (damage->full) {
+		struct xshm_band band = {0, (uint32_t)data->adj_height};
+		da_push_back(data->bands, &band);
+		return;
+	}
+
+	for (size_t i = 0; i < damage->rects.num; i++) {
+		const xcb_rectangle_t *r = damage->rects.array + i;
+		struct xshm_band band = {r->y, (uint32_t)r->y + r->height};
+		da_push_back(data->bands, &band);
+	}
+
+	qsort(data->bands.array, data->bands.num, sizeof(struct xshm_band),
+	      xshm_band_cmp);
+
+	for (size_t i = 0; i < data->bands.num; i++) {
+		struct xshm_band *band = data->bands.array + i;
+		struct xshm_band *last =
+			count ? data->bands.array + count - 1 : NULL;
+
+		if (last && band->y <= last->end) {
+			if (band->end > last->end)
+				last->end = band->end;
+		} else {
+			data->bands.array[count++] = *band;
+		}
+	}
+
+	da_resize(data->bands, count);
+}
+
+/**
+ * Copy the changed parts of the screen into a free shm segment
+ */
+static void xshm_capture_frame(struct xshm_data *data)
+{
+	xcb_generic_event_t *event;
+	struct xshm_damage *pending;
+	bool success = true;
+	bool busy;
+	int buf;
+
+	/* the damage notifications carry nothing the damage region does
+	 * not, they only have to be drained */
+	while ((event = xcb_poll_for_event(data->xcb)))
+		free(event);
+
+	xshm_fetch_damage(data, &data->fresh);
+	xshm_damage_merge(&data->pending[0], &data->fresh);
+	xshm_damage_merge(&data->pending[1], &data->fresh);
+	xshm_damage_merge(&data->unpublished, &data->fresh);
+	xshm_damage_clear(&data->fresh);
+
+	pthread_mutex_lock(&data->frame_mutex);
+	buf = data->ready_buf == 0 ? 1 : 0;
+	busy = data->reading_buf == buf;
+	pthread_mutex_unlock(&data->frame_mutex);
+
+	/* the segment is still being uploaded, try again next frame */
+	if (busy)
+		return;
+
+	pending = &data->pending[buf];
+	if (!pending->full && !pending->rects.num)
+		return;
+
+	xshm_build_bands(data, pending);
+
+	const uint32_t linesize = (uint32_t)data->adj_width * 4;
+	da_resize(data->cookies, 0);
+
+	for (size_t i = 0; i < data->bands.num; i++) {
+		const struct xshm_band *band = data->bands.array + i;
+		xcb_shm_get_image_cookie_t cookie = xcb_shm_get_image_unchecked(
+			data->xcb, data->xcb_screen->root, data->adj_x_org,
+			data->adj_y_org + band->y, data->adj_width,
+			band->end - band->y, ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
+			data->xshm[buf]->seg, band->y * linesize);
+		da_push_back(data->cookies, &cookie);
+	}
+
+	for (size_t i = 0; i < data->cookies.num; i++) {
+		xcb_shm_get_image_reply_t *img_r = xcb_shm_get_image_reply(
+			data->xcb, data->cookies.array[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	if (!success)
+		return;
+
+	xshm_damage_clear(pending);
+
+	pthread_mutex_lock(&data->frame_mutex);
+	xshm_damage_merge(&data->upload, &data->unpublished);
+	data->ready_buf = buf;
+	data->new_frame = true;
+	pthread_mutex_unlock(&data->frame_mutex);
+
+	xshm_damage_clear(&data->unpublished);
+}
+
+static void *xshm_capture_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+
+	os_set_thread_name("xshm-input: capture");
+
+	while (os_event_wait(data->capture_event) == 0) {
+		if (os_atomic_load_bool(&data->stop_capture))
+			break;
+
+		xshm_capture_frame(data);
+	}
+
+	return NULL;
+}
+
+/**
+ * Upload the changed parts of a captured frame to the texture
+ *
+ * @note requires to be called within the obs graphics context
+ */
+static void xshm_upload_frame(struct xshm_data *data, const uint8_t *frame)
+{
+	const uint32_t linesize = (uint32_t)data->adj_width * 4;
+	struct xshm_damage *damage = &data->uploading;
+	bool uploaded = false;
+
+	if (!damage->full && data->region_uploads) {
+		uploaded = true;
+
+		for (size_t i = 0; i < damage->rects.num && uploaded; i++) {
+			const xcb_rectangle_t *r = damage->rects.array + i;
+			uploaded = gs_texture_set_image_region(
+				data->texture,
+				frame + r->y * linesize + r->x * 4, linesize,
+				r->x, r->y, r->width, r->height);
+		}
+
+		if (!uploaded) {
+			blog(LOG_INFO, "Partial texture updates are not "
+				       "supported, uploading full frames");
+			data->region_uploads = false;
+		}
+	}
+
+	if (!uploaded)
+		gs_texture_set_image(data->texture, frame, linesize, false);
+
+	xshm_damage_clear(damage);
+}
+
 /**
  * Update the capture
  *
@@ -188,6 +586,13 @@ static const char *xshm_getname(void *unused)
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->capture_thread_active) {
+		os_atomic_set_bool(&data->stop_capture, true);
+		os_event_signal(data->capture_event);
+		pthread_join(data->capture_thread, NULL);
+		data->capture_thread_active = false;
+	}
+
 	obs_enter_graphics();
 
 	if (data->texture) {
@@ -201,11 +606,28 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
-	if (data->xshm) {
-		xshm_xcb_detach(data->xshm);
-		data->xshm = NULL;
+	if (data->use_damage) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+		data->use_damage = false;
 	}
 
+	for (size_t i = 0; i < 2; i++) {
+		if (data->xshm[i]) {
+			xshm_xcb_detach(data->xshm[i]);
+			data->xshm[i] = NULL;
+		}
+
+		xshm_damage_free(&data->pending[i]);
+	}
+
+	xshm_damage_free(&data->fresh);
+	xshm_damage_free(&data->unpublished);
+	xshm_damage_free(&data->upload);
+	xshm_damage_free(&data->uploading);
+	da_free(data->bands);
+	da_free(data->cookies);
+
 	if (data->xcb) {
 		xcb_disconnect(data->xcb);
 		data->xcb = NULL;
@@ -242,13 +664,17 @@ static void xshm_capture_start(struct xshm_data *data)
 		goto fail;
 	}
 
-	data->xshm =
-		xshm_xcb_attach(data->xcb, data->adj_width, data->adj_height);
-	if (!data->xshm) {
-		blog(LOG_ERROR, "failed to attach shm !");
-		goto fail;
+	for (size_t i = 0; i < 2; i++) {
+		data->xshm[i] = xshm_xcb_attach(data->xcb, data->adj_width,
+						data->adj_height);
+		if (!data->xshm[i]) {
+			blog(LOG_ERROR, "failed to attach shm !");
+			goto fail;
+		}
 	}
 
+	data->use_damage = xshm_init_damage(data);
+
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->adj_x_org, data->adj_y_org);
 
@@ -258,6 +684,26 @@ static void xshm_capture_start(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	/* neither the segments nor the texture hold anything yet */
+	xshm_damage_set_full(&data->pending[0]);
+	xshm_damage_set_full(&data->pending[1]);
+	xshm_damage_set_full(&data->unpublished);
+	data->ready_buf = -1;
+	data->reading_buf = -1;
+	data->new_frame = false;
+	data->region_uploads = true;
+	data->stop_capture = false;
+
+	if (pthread_create(&data->capture_thread, NULL, xshm_capture_thread,
+			   data) != 0) {
+		blog(LOG_ERROR, "failed to create capture thread !");
+		goto fail;
+	}
+
+	data->capture_thread_active = true;
+
+	/* have the first frame ready for the first tick */
+	os_event_signal(data->capture_event);
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -464,6 +910,8 @@ static void xshm_destroy(void *vptr)
 
 	xshm_capture_stop(data);
 
+	os_event_destroy(data->capture_event);
+	pthread_mutex_destroy(&data->frame_mutex);
 	bfree(data);
 }
 
@@ -475,6 +923,16 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
 
+	if (pthread_mutex_init(&data->frame_mutex, NULL) != 0) {
+		bfree(data);
+		return NULL;
+	}
+	if (os_event_init(&data->capture_event, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&data->frame_mutex);
+		bfree(data);
+		return NULL;
+	}
+
 	xshm_update(data, settings);
 
 	return data;
@@ -493,30 +951,37 @@ static void xshm_video_tick(void *vptr, float seconds)
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t img_c;
-	xcb_shm_get_image_reply_t *img_r;
+	int buf = -1;
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-					    data->adj_x_org, data->adj_y_org,
-					    data->adj_width, data->adj_height,
-					    ~0, XCB_IMAGE_FORMAT_Z_PIXMAP,
-					    data->xshm->seg, 0);
+	pthread_mutex_lock(&data->frame_mutex);
+	if (data->new_frame) {
+		struct xshm_damage upload = data->upload;
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-
-	if (!img_r)
-		goto exit;
+		buf = data->ready_buf;
+		data->reading_buf = buf;
+		data->new_frame = false;
+		data->upload = data->uploading;
+		data->uploading = upload;
+		xshm_damage_clear(&data->upload);
+	}
+	pthread_mutex_unlock(&data->frame_mutex);
 
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *)data->xshm->data,
-			     data->adj_width * 4, false);
+	if (buf != -1)
+		xshm_upload_frame(data, data->xshm[buf]->data);
 	xcb_xcursor_update(data->xcb, data->cursor);
 
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
+	if (buf != -1) {
+		pthread_mutex_lock(&data->frame_mutex);
+		data->reading_buf = -1;
+		pthread_mutex_unlock(&data->frame_mutex);
+	}
+
+	/* the frame grabbed now is uploaded on the next tick */
+	os_event_signal(data->capture_event);
 }
 
 /**
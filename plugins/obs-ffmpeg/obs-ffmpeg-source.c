@@ -48,6 +48,7 @@ struct ffmpeg_source {
 	bool is_local_file;
 	bool is_hw_decoding;
 	bool full_decode;
+	bool render_clock;
 	bool is_clear_on_media_end;
 	bool restart_on_activate;
 	bool close_when_inactive;
@@ -126,6 +127,7 @@ static void ffmpeg_source_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "clear_on_media_end", true);
 	obs_data_set_default_bool(settings, "restart_on_activate", true);
 	obs_data_set_default_bool(settings, "linear_alpha", false);
+	obs_data_set_default_bool(settings, "render_clock", false);
 	obs_data_set_default_int(settings, "reconnect_delay_sec", 10);
 	obs_data_set_default_int(settings, "buffering_mb", 2);
 	obs_data_set_default_int(settings, "speed_percent", 100);
@@ -215,6 +217,11 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 	obs_property_set_long_description(
 		prop, obs_module_text("CloseFileWhenInactive.ToolTip"));
 
+	prop = obs_properties_add_bool(props, "render_clock",
+				       obs_module_text("RenderClock"));
+	obs_property_set_long_description(
+		prop, obs_module_text("RenderClock.ToolTip"));
+
 	prop = obs_properties_add_int_slider(props, "speed_percent",
 					     obs_module_text("SpeedPercentage"),
 					     1, 200, 1);
@@ -262,6 +269,7 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		"\trestart_on_activate:     %s\n"
 		"\tclose_when_inactive:     %s\n"
 		"\tfull_decode:             %s\n"
+		"\trender_clock:            %s\n"
 		"\tffmpeg_options:          %s",
 		input ? input : "(null)",
 		input_format ? input_format : "(null)", s->speed_percent,
@@ -270,7 +278,8 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 		s->is_clear_on_media_end ? "yes" : "no",
 		s->restart_on_activate ? "yes" : "no",
 		s->close_when_inactive ? "yes" : "no",
-		s->full_decode ? "yes" : "no", s->ffmpeg_options);
+		s->full_decode ? "yes" : "no", s->render_clock ? "yes" : "no",
+		s->ffmpeg_options);
 }
 
 static void get_frame(void *opaque, struct obs_source_frame *f)
@@ -279,6 +288,13 @@ static void get_frame(void *opaque, struct obs_source_frame *f)
 	obs_source_output_video(s->source, f);
 }
 
+static bool get_frame_dmabuf(void *opaque, struct obs_source_frame *f,
+			     const struct obs_source_frame_dmabuf *dmabuf)
+{
+	struct ffmpeg_source *s = opaque;
+	return obs_source_output_video_dmabuf(s->source, f, dmabuf);
+}
+
 static void preload_frame(void *opaque, struct obs_source_frame *f)
 {
 	struct ffmpeg_source *s = opaque;
@@ -329,6 +345,7 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 		struct mp_media_info info = {
 			.opaque = s,
 			.v_cb = get_frame,
+			.v_dmabuf_cb = get_frame_dmabuf,
 			.v_preload_cb = preload_frame,
 			.v_seek_cb = seek_frame,
 			.a_cb = get_audio,
@@ -345,6 +362,7 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 			.reconnecting = s->reconnecting,
 			.request_preload = s->is_stinger,
 			.full_decode = s->full_decode,
+			.render_clock = s->render_clock,
 		};
 
 		s->media = media_playback_create(&info);
@@ -445,6 +463,7 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	bool is_hw_decoding;
 	enum video_range_type range;
 	bool is_linear_alpha;
+	bool render_clock;
 	int speed_percent;
 	bool is_looping;
 
@@ -477,10 +496,12 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	if (speed_percent < 1 || speed_percent > 200)
 		speed_percent = 100;
 	ffmpeg_options = obs_data_get_string(settings, "ffmpeg_options");
+	render_clock = obs_data_get_bool(settings, "render_clock");
 
 	/* Restart media source if these properties are changed */
 	if (s->is_hw_decoding != is_hw_decoding || s->range != range ||
 	    s->speed_percent != speed_percent ||
+	    s->render_clock != render_clock ||
 	    (s->ffmpeg_options &&
 	     strcmp(s->ffmpeg_options, ffmpeg_options) != 0))
 		should_restart_media = true;
@@ -503,6 +524,7 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->input_format = input_format ? bstrdup(input_format) : NULL;
 	s->is_hw_decoding = is_hw_decoding;
 	s->full_decode = obs_data_get_bool(settings, "full_decode");
+	s->render_clock = render_clock;
 	s->is_clear_on_media_end =
 		obs_data_get_bool(settings, "clear_on_media_end");
 	s->restart_on_activate =
@@ -529,6 +551,8 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 		s->media = NULL;
 	}
 
+	obs_source_set_async_render_clock(s->source, render_clock);
+
 	/* directly set options if media is playing */
 	if (s->media) {
 		media_playback_set_looping(s->media, is_looping);
@@ -563,7 +563,8 @@ chroma_key_get_color_space(void *data, size_t count,
 struct obs_source_info chroma_key_filter = {
 	.id = "chroma_key_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = chroma_key_name,
 	.create = chroma_key_create_v1,
 	.destroy = chroma_key_destroy_v1,
@@ -577,7 +578,8 @@ struct obs_source_info chroma_key_filter_v2 = {
 	.id = "chroma_key_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = chroma_key_name,
 	.create = chroma_key_create_v2,
 	.destroy = chroma_key_destroy_v2,
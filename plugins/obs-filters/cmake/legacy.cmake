@@ -129,6 +129,8 @@ target_sources(
           compressor-filter.c
           limiter-filter.c
           expander-filter.c
+          dynamics-dsp.c
+          dynamics-dsp.h
           luma-key-filter.c)
 
 if(NOT OS_MACOS)
@@ -760,7 +760,8 @@ static enum gs_color_space color_correction_filter_get_color_space(
 struct obs_source_info color_filter = {
 	.id = "color_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create_v1,
 	.destroy = color_correction_filter_destroy_v1,
@@ -774,7 +775,8 @@ struct obs_source_info color_filter_v2 = {
 	.id = "color_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create_v2,
 	.destroy = color_correction_filter_destroy_v2,
@@ -505,7 +505,8 @@ color_key_get_color_space(void *data, size_t count,
 struct obs_source_info color_key_filter = {
 	.id = "color_key_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = color_key_name,
 	.create = color_key_create_v1,
 	.destroy = color_key_destroy_v1,
@@ -519,7 +520,8 @@ struct obs_source_info color_key_filter_v2 = {
 	.id = "color_key_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = color_key_name,
 	.create = color_key_create_v2,
 	.destroy = color_key_destroy_v2,
@@ -311,7 +311,8 @@ crop_filter_get_color_space(void *data, size_t count,
 struct obs_source_info crop_filter = {
 	.id = "crop_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = crop_filter_get_name,
 	.create = crop_filter_create,
 	.destroy = crop_filter_destroy,
@@ -0,0 +1,180 @@
+#include <math.h>
+#include <util/sse-intrin.h>
+
+#include "dynamics-dsp.h"
+
+/* -------------------------------------------------------- */
+
+static inline __m128 abs_ps(__m128 x)
+{
+	return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+static inline __m128 fast_log2_ps(__m128 x)
+{
+	const __m128i bits = _mm_castps_si128(abs_ps(x));
+	const __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(
+		_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	const __m128 m = _mm_castsi128_ps(
+		_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+			     _mm_set1_epi32(0x3f800000)));
+	const __m128 t = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+
+	__m128 p = _mm_set1_ps(DYN_LOG2_C4);
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_LOG2_C3));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_LOG2_C2));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_LOG2_C1));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_LOG2_C0));
+	return _mm_add_ps(e, _mm_mul_ps(p, t));
+}
+
+static inline __m128 fast_exp2_ps(__m128 x)
+{
+	x = _mm_max_ps(x, _mm_set1_ps(DYN_EXP2_MIN));
+	x = _mm_min_ps(x, _mm_set1_ps(DYN_EXP2_MAX));
+
+	/* floor: truncate, then step down where truncation rounded up */
+	__m128i i = _mm_cvttps_epi32(x);
+	const __m128 above = _mm_cmpgt_ps(_mm_cvtepi32_ps(i), x);
+	i = _mm_add_epi32(i, _mm_castps_si128(above));
+	const __m128 t = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+
+	__m128 p = _mm_set1_ps(DYN_EXP2_C4);
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_EXP2_C3));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_EXP2_C2));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_EXP2_C1));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(DYN_EXP2_C0));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.0f));
+
+	const __m128i scale =
+		_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+/* -------------------------------------------------------- */
+
+void dyn_peak_envelope(float *env_buf, float *const *samples,
+		       size_t channels, size_t frames, float *envelope,
+		       float attack_gain, float release_gain)
+{
+	if (!frames)
+		return;
+
+	memset(env_buf, 0, frames * sizeof(env_buf[0]));
+
+	for (size_t c = 0; c < channels; c++) {
+		const float *data = samples[c];
+		float env = *envelope;
+
+		if (!data)
+			continue;
+
+		/* the recurrence is serial, but selecting the coefficient
+		 * instead of branching keeps the loop free of mispredicts
+		 * on noisy input */
+		for (size_t i = 0; i < frames; i++) {
+			const float in = fabsf(data[i]);
+			const float coef = env < in ? attack_gain
+						    : release_gain;
+			env = in + coef * (env - in);
+			env_buf[i] = fmaxf(env_buf[i], env);
+		}
+	}
+
+	*envelope = env_buf[frames - 1];
+}
+
+void dyn_peak_level(float *dst, float *const *samples, size_t channels,
+		    size_t frames)
+{
+	memset(dst, 0, frames * sizeof(dst[0]));
+
+	for (size_t c = 0; c < channels; c++) {
+		const float *data = samples[c];
+		size_t i = 0;
+
+		if (!data)
+			continue;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 level = abs_ps(_mm_loadu_ps(data + i));
+			level = _mm_max_ps(level, _mm_loadu_ps(dst + i));
+			_mm_storeu_ps(dst + i, level);
+		}
+		for (; i < frames; i++)
+			dst[i] = fmaxf(dst[i], fabsf(data[i]));
+	}
+}
+
+void dyn_mul_to_db(float *buf, size_t frames)
+{
+	const __m128 db_per_log2 = _mm_set1_ps(DYN_DB_PER_LOG2);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 x = fast_log2_ps(_mm_loadu_ps(buf + i));
+		_mm_storeu_ps(buf + i, _mm_mul_ps(x, db_per_log2));
+	}
+	for (; i < frames; i++)
+		buf[i] = dyn_fast_mul_to_db(buf[i]);
+}
+
+void dyn_db_to_mul(float *buf, size_t frames, float output_gain)
+{
+	const __m128 log2_per_db = _mm_set1_ps(DYN_LOG2_PER_DB);
+	const __m128 out = _mm_set1_ps(output_gain);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 x = _mm_mul_ps(_mm_loadu_ps(buf + i), log2_per_db);
+		_mm_storeu_ps(buf + i, _mm_mul_ps(fast_exp2_ps(x), out));
+	}
+	for (; i < frames; i++)
+		buf[i] = dyn_fast_db_to_mul(buf[i]) * output_gain;
+}
+
+void dyn_compress_gain(float *buf, size_t frames, float threshold_db,
+		       float slope, float output_gain)
+{
+	const __m128 db_per_log2 = _mm_set1_ps(DYN_DB_PER_LOG2);
+	const __m128 log2_per_db = _mm_set1_ps(DYN_LOG2_PER_DB);
+	const __m128 threshold = _mm_set1_ps(threshold_db);
+	const __m128 slope_ps = _mm_set1_ps(slope);
+	const __m128 out = _mm_set1_ps(output_gain);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 env_db = _mm_mul_ps(fast_log2_ps(_mm_loadu_ps(buf + i)),
+					   db_per_log2);
+		__m128 gain = _mm_mul_ps(slope_ps,
+					 _mm_sub_ps(threshold, env_db));
+		gain = _mm_mul_ps(_mm_min_ps(gain, zero), log2_per_db);
+		_mm_storeu_ps(buf + i, _mm_mul_ps(fast_exp2_ps(gain), out));
+	}
+	for (; i < frames; i++) {
+		const float env_db = dyn_fast_mul_to_db(buf[i]);
+		const float gain = fminf(0.0f, slope * (threshold_db - env_db));
+		buf[i] = dyn_fast_db_to_mul(gain) * output_gain;
+	}
+}
+
+void dyn_apply_gain(float *const *samples, size_t channels, const float *gain,
+		    size_t frames)
+{
+	for (size_t c = 0; c < channels; c++) {
+		float *data = samples[c];
+		size_t i = 0;
+
+		if (!data)
+			continue;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(data + i),
+					      _mm_loadu_ps(gain + i));
+			_mm_storeu_ps(data + i, x);
+		}
+		for (; i < frames; i++)
+			data[i] *= gain[i];
+	}
+}
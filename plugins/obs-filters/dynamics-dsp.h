@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <util/c99defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Shared DSP helpers for the dynamics filters (compressor, limiter,
+ * expander/upward compressor and noise gate).
+ *
+ * The dB conversions use fast log2/exp2 approximations instead of
+ * log10f/powf.  Within the float range used for audio levels, the log2
+ * approximation has a maximum absolute error of 2e-5 (about 1e-4 dB) and
+ * the exp2 approximation a maximum relative error of 3e-7.  The buffer
+ * versions process four samples at a time with SSE2 (or its SIMDe
+ * equivalent) and use the same polynomials in scalar form for the
+ * remainder.
+ */
+
+#define DYN_DB_PER_LOG2 6.02059991327962f  /* 20 * log10(2) */
+#define DYN_LOG2_PER_DB 0.166096404744368f /* log2(10) / 20 */
+
+/* clang-format off */
+#define DYN_LOG2_C0  1.44187990e+00f
+#define DYN_LOG2_C1 -7.08865217e-01f
+#define DYN_LOG2_C2  4.15245559e-01f
+#define DYN_LOG2_C3 -1.93516522e-01f
+#define DYN_LOG2_C4  4.52682917e-02f
+
+#define DYN_EXP2_C0  6.93152535e-01f
+#define DYN_EXP2_C1  2.40152445e-01f
+#define DYN_EXP2_C2  5.58365980e-02f
+#define DYN_EXP2_C3  8.97289928e-03f
+#define DYN_EXP2_C4  1.88540380e-03f
+/* clang-format on */
+
+/* lowest value passed to exp2, keeps the result a normal float */
+#define DYN_EXP2_MIN -126.0f
+#define DYN_EXP2_MAX 126.0f
+
+union dyn_float_bits {
+	float f;
+	int32_t i;
+};
+
+/* log2 of |x|, returns about -127 for 0 instead of -inf */
+static inline float dyn_fast_log2(float x)
+{
+	union dyn_float_bits bits = {.f = x};
+	bits.i &= 0x7fffffff;
+
+	const float e = (float)((bits.i >> 23) - 127);
+
+	bits.i = (bits.i & 0x007fffff) | 0x3f800000;
+	const float t = bits.f - 1.0f;
+
+	float p = DYN_LOG2_C4;
+	p = p * t + DYN_LOG2_C3;
+	p = p * t + DYN_LOG2_C2;
+	p = p * t + DYN_LOG2_C1;
+	p = p * t + DYN_LOG2_C0;
+	return e + p * t;
+}
+
+static inline float dyn_fast_exp2(float x)
+{
+	x = x < DYN_EXP2_MIN ? DYN_EXP2_MIN : x;
+	x = x > DYN_EXP2_MAX ? DYN_EXP2_MAX : x;
+
+	int32_t i = (int32_t)x;
+	i -= (float)i > x;
+	const float t = x - (float)i;
+
+	float p = DYN_EXP2_C4;
+	p = p * t + DYN_EXP2_C3;
+	p = p * t + DYN_EXP2_C2;
+	p = p * t + DYN_EXP2_C1;
+	p = p * t + DYN_EXP2_C0;
+
+	union dyn_float_bits bits = {.i = (i + 127) << 23};
+	return (p * t + 1.0f) * bits.f;
+}
+
+static inline float dyn_fast_mul_to_db(float mul)
+{
+	return DYN_DB_PER_LOG2 * dyn_fast_log2(mul);
+}
+
+static inline float dyn_fast_db_to_mul(float db)
+{
+	return dyn_fast_exp2(DYN_LOG2_PER_DB * db);
+}
+
+/* Peak envelope follower, one-pole attack/release per channel starting
+ * from *envelope.  env_buf receives the maximum across channels, and
+ * *envelope is updated to its last value. */
+extern void dyn_peak_envelope(float *env_buf, float *const *samples,
+			      size_t channels, size_t frames, float *envelope,
+			      float attack_gain, float release_gain);
+
+/* Maximum absolute level across channels for each frame. */
+extern void dyn_peak_level(float *dst, float *const *samples,
+			   size_t channels, size_t frames);
+
+/* In-place conversions between linear multipliers and dB. */
+extern void dyn_mul_to_db(float *buf, size_t frames);
+extern void dyn_db_to_mul(float *buf, size_t frames, float output_gain);
+
+/* Converts an envelope into downward compression gain in place:
+ * output_gain * db_to_mul(min(0, slope * (threshold_db - env_db))). */
+extern void dyn_compress_gain(float *buf, size_t frames, float threshold_db,
+			      float slope, float output_gain);
+
+/* Multiplies every channel with the per-frame gain. */
+extern void dyn_apply_gain(float *const *samples, size_t channels,
+			   const float *gain, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,8 @@
 #include <util/deque.h>
 #include <util/threading.h>
 
+#include "dynamics-dsp.h"
+
 /* -------------------------------------------------------- */
 
 #define do_log(level, format, ...)                                     \
@@ -319,21 +321,20 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 		float *env_in = cd->env_in;
 
 		if (cd->detector == RMS_DETECT) {
-			runave[0] =
-				rmscoef * cd->runave[chan] +
-				(1 - rmscoef) * powf(samples[chan][0], 2.0f);
+			const float *in = samples[chan];
+			runave[0] = rmscoef * cd->runave[chan] +
+				    (1 - rmscoef) * in[0] * in[0];
 			env_in[0] = sqrtf(fmaxf(runave[0], 0));
 			for (uint32_t i = 1; i < num_samples; ++i) {
-				runave[i] =
-					rmscoef * runave[i - 1] +
-					(1 - rmscoef) *
-						powf(samples[chan][i], 2.0f);
+				runave[i] = rmscoef * runave[i - 1] +
+					    (1 - rmscoef) * in[i] * in[i];
 				env_in[i] = sqrtf(runave[i]);
 			}
 		} else if (cd->detector == PEAK_DETECT) {
+			const float *in = samples[chan];
 			for (uint32_t i = 0; i < num_samples; ++i) {
-				runave[i] = powf(samples[chan][i], 2);
-				env_in[i] = fabsf(samples[chan][i]);
+				runave[i] = in[i] * in[i];
+				env_in[i] = fabsf(in[i]);
 			}
 		}
 
@@ -344,18 +345,17 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 	}
 }
 
-static inline void process_sample(size_t idx, float *samples, float *env_buf,
-				  float *gain_db, bool is_upwcomp,
-				  float channel_gain, float threshold,
-				  float slope, float attack_gain,
-				  float inv_attack_gain, float release_gain,
-				  float inv_release_gain, float output_gain,
-				  float knee)
+static inline float process_sample(size_t idx, const float *env_db_buf,
+				   const float *gain_db, bool is_upwcomp,
+				   float channel_gain, float threshold,
+				   float slope, float attack_gain,
+				   float inv_attack_gain, float release_gain,
+				   float inv_release_gain, float knee)
 {
 	/* --------------------------------- */
 	/* gain stage of expansion           */
 
-	float env_db = mul_to_db(env_buf[idx]);
+	float env_db = env_db_buf[idx];
 	float diff = threshold - env_db;
 
 	if (is_upwcomp && env_db <= (threshold - 60.0f) / 2)
@@ -377,7 +377,8 @@ static inline void process_sample(size_t idx, float *samples, float *env_buf,
 		// gain in knee:
 		if (env_db > threshold - knee / 2 &&
 		    threshold + knee / 2 > env_db)
-			gain = slope * powf(diff + knee / 2, 2) / (2.0f * knee);
+			gain = slope * (diff + knee / 2) * (diff + knee / 2) /
+			       (2.0f * knee);
 	} else {
 		prev_gain = idx > 0 ? gain_db[idx - 1] : channel_gain;
 		gain = diff > 0.0f ? fmaxf(slope * diff, -60.0f) : 0.0f;
@@ -386,22 +387,10 @@ static inline void process_sample(size_t idx, float *samples, float *env_buf,
 	/* --------------------------------- */
 	/* ballistics (attack/release)       */
 
-	if (gain > prev_gain)
-		gain_db[idx] = attack_gain * prev_gain + inv_attack_gain * gain;
-	else
-		gain_db[idx] =
-			release_gain * prev_gain + inv_release_gain * gain;
-
-	/* --------------------------------- */
-	/* output                            */
-
-	if (!is_upwcomp) {
-		gain = db_to_mul(fminf(0, gain_db[idx]));
-	} else {
-		gain = db_to_mul(gain_db[idx]);
-	}
-
-	samples[idx] *= gain * output_gain;
+	const bool attack = gain > prev_gain;
+	const float coef = attack ? attack_gain : release_gain;
+	const float inv_coef = attack ? inv_attack_gain : inv_release_gain;
+	return coef * prev_gain + inv_coef * gain;
 }
 
 // gain stage and ballistics in dB domain
@@ -421,24 +410,34 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 	if (cd->gain_db_len < num_samples)
 		resize_gain_db_buffer(cd, num_samples);
 
-	for (size_t i = 0; i < cd->num_channels; i++)
-		memset(cd->gain_db[i], 0,
-		       num_samples * sizeof(cd->gain_db[i][0]));
-
 	for (size_t chan = 0; chan < cd->num_channels; chan++) {
-		float *channel_samples = samples[chan];
-		float *env_buf = cd->envelope_buf[chan];
+		float *env_db = cd->envelope_buf[chan];
 		float *gain_db = cd->gain_db[chan];
 		float channel_gain = cd->gain_db_buf[chan];
 
+		/* the envelope has already been saved for the next block, so
+		 * its buffer is reused for the dB levels and the gain buffer
+		 * for the multipliers once the ballistics are done */
+		dyn_mul_to_db(env_db, num_samples);
+
 		for (size_t i = 0; i < num_samples; ++i) {
-			process_sample(i, channel_samples, env_buf, gain_db,
-				       is_upwcomp, channel_gain, threshold,
-				       slope, attack_gain, inv_attack_gain,
-				       release_gain, inv_release_gain,
-				       output_gain, knee);
+			gain_db[i] = process_sample(
+				i, env_db, gain_db, is_upwcomp, channel_gain,
+				threshold, slope, attack_gain, inv_attack_gain,
+				release_gain, inv_release_gain, knee);
 		}
 		cd->gain_db_buf[chan] = gain_db[num_samples - 1];
+
+		/* --------------------------------- */
+		/* output                            */
+
+		if (!is_upwcomp) {
+			for (size_t i = 0; i < num_samples; ++i)
+				gain_db[i] = fminf(0, gain_db[i]);
+		}
+
+		dyn_db_to_mul(gain_db, num_samples, output_gain);
+		dyn_apply_gain(&samples[chan], 1, gain_db, num_samples);
 	}
 }
 
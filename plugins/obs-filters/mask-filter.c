@@ -3,8 +3,9 @@
 #include <graphics/vec4.h>
 #include <graphics/image-file.h>
 #include <util/platform.h>
+#include <util/file-watch.h>
+#include <util/threading.h>
 #include <util/dstr.h>
-#include <sys/stat.h>
 
 /* clang-format off */
 
@@ -33,22 +34,18 @@ struct mask_filter_data {
 	gs_effect_t *effect;
 
 	char *image_file;
-	time_t image_file_timestamp;
-	float update_time_elapsed;
 
 	gs_texture_t *target;
 	gs_image_file_t image;
 	struct vec4 color;
 	bool lock_aspect;
-};
 
-static time_t get_modified_timestamp(const char *filename)
-{
-	struct stat stats;
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-	return stats.st_mtime;
-}
+	/* decoded by the file watch thread, swapped in on the next tick */
+	os_file_watch_t *file_watch;
+	pthread_mutex_t reload_mutex;
+	gs_image_file_t reload_image;
+	volatile bool reload_ready;
+};
 
 static const char *mask_filter_get_name(void *unused)
 {
@@ -70,9 +67,7 @@ static void mask_filter_image_load(struct mask_filter_data *filter)
 	char *path = filter->image_file;
 
 	if (path && *path) {
-		filter->image_file_timestamp = get_modified_timestamp(path);
 		gs_image_file_init(&filter->image, path);
-		filter->update_time_elapsed = 0;
 
 		obs_enter_graphics();
 		gs_image_file_init_texture(&filter->image);
@@ -82,6 +77,50 @@ static void mask_filter_image_load(struct mask_filter_data *filter)
 	filter->target = filter->image.texture;
 }
 
+static void mask_filter_set_reload(struct mask_filter_data *filter,
+				   gs_image_file_t *image)
+{
+	pthread_mutex_lock(&filter->reload_mutex);
+
+	if (os_atomic_load_bool(&filter->reload_ready)) {
+		obs_enter_graphics();
+		gs_image_file_free(&filter->reload_image);
+		obs_leave_graphics();
+	}
+
+	if (image)
+		filter->reload_image = *image;
+	os_atomic_set_bool(&filter->reload_ready, !!image);
+
+	pthread_mutex_unlock(&filter->reload_mutex);
+}
+
+static void mask_filter_apply_reload(struct mask_filter_data *filter)
+{
+	pthread_mutex_lock(&filter->reload_mutex);
+	obs_enter_graphics();
+
+	gs_image_file_free(&filter->image);
+	filter->image = filter->reload_image;
+	gs_image_file_init_texture(&filter->image);
+	filter->target = filter->image.texture;
+	filter->last_time = 0;
+
+	os_atomic_set_bool(&filter->reload_ready, false);
+
+	obs_leave_graphics();
+	pthread_mutex_unlock(&filter->reload_mutex);
+}
+
+static void mask_filter_file_changed(void *data, const char *path)
+{
+	struct mask_filter_data *filter = data;
+	gs_image_file_t image;
+
+	gs_image_file_init(&image, path);
+	mask_filter_set_reload(filter, &image);
+}
+
 static void mask_filter_update_internal(void *data, obs_data_t *settings,
 					float opacity, bool srgb)
 {
@@ -92,9 +131,14 @@ static void mask_filter_update_internal(void *data, obs_data_t *settings,
 	uint32_t color = (uint32_t)obs_data_get_int(settings, SETTING_COLOR);
 	char *effect_path;
 
+	os_file_watch_destroy(filter->file_watch);
+	mask_filter_set_reload(filter, NULL);
+
 	if (filter->image_file)
 		bfree(filter->image_file);
 	filter->image_file = bstrdup(path);
+	filter->file_watch = os_file_watch_create(
+		path, mask_filter_file_changed, filter);
 
 	if (srgb)
 		vec4_from_rgba_srgb(&filter->color, color);
@@ -217,6 +261,7 @@ static void *mask_filter_create(obs_data_t *settings, obs_source_t *context)
 	struct mask_filter_data *filter =
 		bzalloc(sizeof(struct mask_filter_data));
 	filter->context = context;
+	pthread_mutex_init(&filter->reload_mutex, NULL);
 
 	obs_source_update(context, settings);
 	return filter;
@@ -226,6 +271,10 @@ static void mask_filter_destroy(void *data)
 {
 	struct mask_filter_data *filter = data;
 
+	os_file_watch_destroy(filter->file_watch);
+	mask_filter_set_reload(filter, NULL);
+	pthread_mutex_destroy(&filter->reload_mutex);
+
 	if (filter->image_file)
 		bfree(filter->image_file);
 
@@ -240,16 +289,11 @@ static void mask_filter_destroy(void *data)
 static void mask_filter_tick(void *data, float seconds)
 {
 	struct mask_filter_data *filter = data;
-	filter->update_time_elapsed += seconds;
 
-	if (filter->update_time_elapsed >= 1.0f) {
-		time_t t = get_modified_timestamp(filter->image_file);
-		filter->update_time_elapsed = 0.0f;
+	UNUSED_PARAMETER(seconds);
 
-		if (filter->image_file_timestamp != t) {
-			mask_filter_image_load(filter);
-		}
-	}
+	if (os_atomic_load_bool(&filter->reload_ready))
+		mask_filter_apply_reload(filter);
 
 	if (filter->image.is_animated_gif) {
 		uint64_t cur_time = obs_get_video_frame_time();
@@ -24,11 +24,14 @@ target_sources(
           net-if.h
           null-output.c
           rtmp-helpers.h
+          rtmp-linux.c
           rtmp-stream.c
           rtmp-stream.h
           rtmp-windows.c
           rtmp-av1.c
           rtmp-av1.h
+          rtmp-abr.c
+          rtmp-abr.h
           utils.h
           librtmp/amf.c
           librtmp/amf.h
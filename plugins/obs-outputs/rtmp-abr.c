@@ -0,0 +1,345 @@
+#include "rtmp-abr.h"
+
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+/* The lowest RTT is the minimum of the current and the previous bucket,
+ * so it follows route changes within 10-20 seconds. */
+#define RTT_BUCKET_NS (10ULL * NSEC_PER_SEC)
+
+/* Congestion is judged on the lowest queueing delay and backlog of the
+ * current and the previous bucket, i.e. on what stays queued for 1.5-3
+ * seconds.  Keyframes cause bursts that drain again within that time,
+ * a link that can not keep up never drains. */
+#define STANDING_BUCKET_NS (1500ULL * NSEC_PER_MSEC)
+#define STANDING_WINDOW_NS (2ULL * STANDING_BUCKET_NS)
+
+#define BACKLOG_HIGH_MS 400.0
+#define BACKLOG_LOW_MS 100.0
+#define BACKLOG_SEVERE_MS 1500.0
+#define SEVERE_INTERVAL_NS (1ULL * NSEC_PER_SEC)
+
+#define PROBE_NS (4ULL * NSEC_PER_SEC)
+#define PROBE_INTERVAL_NS (1ULL * NSEC_PER_SEC)
+#define MIN_PROBE_BACKOFF_NS (4ULL * NSEC_PER_SEC)
+#define MAX_PROBE_BACKOFF_NS (64ULL * NSEC_PER_SEC)
+
+/* share of the measured delivery rate used after a decrease, the rest
+ * drains the backlog */
+#define HEADROOM 0.9
+#define DRAIN_HEADROOM 0.75
+
+#define MIN_BITRATE 50
+#define BITRATE_STEP 50
+
+static inline double min_d(double a, double b)
+{
+	return a < b ? a : b;
+}
+
+static inline double max_d(double a, double b)
+{
+	return a > b ? a : b;
+}
+
+/* queueing delay above which the link counts as congested */
+static inline double queue_delay_high(const struct rtmp_abr *abr)
+{
+	return 40.0 + abr->min_rtt_ms / 4.0;
+}
+
+static inline double queue_delay_low(const struct rtmp_abr *abr)
+{
+	return queue_delay_high(abr) / 2.0;
+}
+
+static inline uint64_t srtt_ns(const struct rtmp_abr *abr)
+{
+	return (uint64_t)(abr->srtt_ms * (double)NSEC_PER_MSEC);
+}
+
+void rtmp_abr_init(struct rtmp_abr *abr, long max_kbps, long audio_kbps,
+		   uint64_t ts)
+{
+	*abr = (struct rtmp_abr){0};
+	abr->max_kbps = max_kbps;
+	abr->min_kbps = max_kbps < MIN_BITRATE ? max_kbps : MIN_BITRATE;
+	abr->audio_kbps = audio_kbps;
+	abr->cur_kbps = max_kbps;
+	abr->state = RTMP_ABR_STEADY;
+	abr->probe_backoff = MIN_PROBE_BACKOFF_NS;
+	abr->next_probe = ts;
+}
+
+static void update_standing(struct rtmp_abr *abr, uint64_t ts)
+{
+	if (ts - abr->standing_bucket_ts >= STANDING_BUCKET_NS) {
+		abr->queue_bucket_ms[1] = abr->queue_bucket_ms[0];
+		abr->backlog_bucket_ms[1] = abr->backlog_bucket_ms[0];
+		abr->queue_bucket_ms[0] = abr->queue_delay_ms;
+		abr->backlog_bucket_ms[0] = abr->backlog_ms;
+		abr->standing_bucket_ts = ts;
+	} else {
+		abr->queue_bucket_ms[0] =
+			min_d(abr->queue_bucket_ms[0], abr->queue_delay_ms);
+		abr->backlog_bucket_ms[0] =
+			min_d(abr->backlog_bucket_ms[0], abr->backlog_ms);
+	}
+
+	abr->standing_queue_ms =
+		min_d(abr->queue_bucket_ms[0], abr->queue_bucket_ms[1]);
+	abr->standing_backlog_ms =
+		min_d(abr->backlog_bucket_ms[0], abr->backlog_bucket_ms[1]);
+}
+
+static void update_estimates(struct rtmp_abr *abr,
+			     const struct rtmp_abr_sample *sample)
+{
+	const double rtt_ms = (double)sample->rtt_us / 1000.0;
+	const double total_kbps = (double)(abr->cur_kbps + abr->audio_kbps);
+
+	if (!abr->have_sample) {
+		abr->srtt_ms = rtt_ms;
+		abr->rtt_bucket_ms[0] = rtt_ms;
+		abr->rtt_bucket_ms[1] = rtt_ms;
+		abr->rtt_bucket_ts = sample->ts;
+		abr->standing_bucket_ts = sample->ts;
+		abr->delivery_kbps = total_kbps;
+
+	} else if (sample->ts > abr->last_ts) {
+		const double dt_ms = (double)(sample->ts - abr->last_ts) /
+				     (double)NSEC_PER_MSEC;
+		const double acked =
+			(double)(sample->acked_bytes - abr->last_acked);
+
+		abr->srtt_ms += (rtt_ms - abr->srtt_ms) / 4.0;
+		abr->delivery_kbps +=
+			(acked * 8.0 / dt_ms - abr->delivery_kbps) / 4.0;
+	}
+
+	if (sample->ts - abr->rtt_bucket_ts >= RTT_BUCKET_NS) {
+		abr->rtt_bucket_ms[1] = abr->rtt_bucket_ms[0];
+		abr->rtt_bucket_ms[0] = rtt_ms;
+		abr->rtt_bucket_ts = sample->ts;
+	} else if (rtt_ms < abr->rtt_bucket_ms[0]) {
+		abr->rtt_bucket_ms[0] = rtt_ms;
+	}
+
+	abr->min_rtt_ms = min_d(abr->rtt_bucket_ms[0], abr->rtt_bucket_ms[1]);
+	abr->queue_delay_ms = max_d(abr->srtt_ms - abr->min_rtt_ms, 0.0);
+	abr->backlog_ms = (double)sample->backlog_bytes * 8.0 / total_kbps;
+	abr->cwnd_kbps = abr->srtt_ms > 0.0 ? (double)sample->cwnd_bytes *
+						      8.0 / abr->srtt_ms
+					    : 0.0;
+
+	update_standing(abr, sample->ts);
+
+	abr->last_ts = sample->ts;
+	abr->last_acked = sample->acked_bytes;
+	abr->have_sample = true;
+}
+
+static void set_bitrate(struct rtmp_abr *abr, long kbps)
+{
+	if (kbps > abr->max_kbps)
+		kbps = abr->max_kbps;
+	if (kbps < abr->min_kbps)
+		kbps = abr->min_kbps;
+	abr->cur_kbps = kbps;
+}
+
+/* waits for the queues to drain, at least long enough for the standing
+ * estimates to only cover the new bitrate */
+static void enter_drain(struct rtmp_abr *abr, uint64_t ts)
+{
+	uint64_t drain = srtt_ns(abr) * 4;
+	if (drain < STANDING_WINDOW_NS)
+		drain = STANDING_WINDOW_NS;
+
+	abr->state = RTMP_ABR_DRAIN;
+	abr->state_start = ts;
+	abr->state_end = ts + drain;
+	abr->drain_queue_ms = abr->queue_delay_ms;
+	abr->drain_backlog_ms = abr->backlog_ms;
+}
+
+/* what the link delivers while congested, less some headroom to drain
+ * the queues */
+static long capacity_kbps(const struct rtmp_abr *abr)
+{
+	double headroom = abr->backlog_ms > BACKLOG_HIGH_MS ? DRAIN_HEADROOM
+							    : HEADROOM;
+	double capacity = abr->delivery_kbps;
+
+	if (abr->cwnd_kbps > 0.0 && abr->cwnd_kbps < capacity)
+		capacity = abr->cwnd_kbps;
+
+	return (long)(capacity * headroom) - abr->audio_kbps;
+}
+
+/* Lowers the bitrate to the link's capacity, and by at least 10% so that
+ * the queues drain. */
+static void decrease(struct rtmp_abr *abr, uint64_t ts)
+{
+	long kbps = capacity_kbps(abr);
+	long limit = abr->cur_kbps * 9 / 10;
+
+	if (kbps > limit)
+		kbps = limit;
+
+	abr->ceiling_kbps = abr->cur_kbps;
+	abr->ceiling_retry = ts + abr->probe_backoff;
+
+	set_bitrate(abr, kbps / BITRATE_STEP * BITRATE_STEP);
+	abr->decreases++;
+	enter_drain(abr, ts);
+}
+
+/* Goes back to the bitrate before the probe, or lower if the link got
+ * slower in the meantime. */
+static void fail_probe(struct rtmp_abr *abr, uint64_t ts, bool congested)
+{
+	long kbps = abr->probe_base_kbps;
+
+	/* wait twice as long before going past this bitrate again */
+	abr->probe_backoff *= 2;
+	if (abr->probe_backoff > MAX_PROBE_BACKOFF_NS)
+		abr->probe_backoff = MAX_PROBE_BACKOFF_NS;
+
+	abr->ceiling_kbps = abr->cur_kbps;
+	abr->ceiling_retry = ts + abr->probe_backoff;
+
+	if (congested) {
+		long capacity = capacity_kbps(abr);
+		if (capacity < kbps)
+			kbps = capacity / BITRATE_STEP * BITRATE_STEP;
+	}
+
+	set_bitrate(abr, kbps);
+	abr->failed_probes++;
+	enter_drain(abr, ts);
+}
+
+static void finish_probe(struct rtmp_abr *abr, uint64_t ts)
+{
+	/* past the bitrate that failed before, the link got faster */
+	if (abr->ceiling_kbps && abr->cur_kbps >= abr->ceiling_kbps) {
+		abr->ceiling_kbps = 0;
+		abr->probe_backoff /= 2;
+		if (abr->probe_backoff < MIN_PROBE_BACKOFF_NS)
+			abr->probe_backoff = MIN_PROBE_BACKOFF_NS;
+	}
+
+	abr->state = RTMP_ABR_STEADY;
+	abr->next_probe = ts + PROBE_INTERVAL_NS;
+}
+
+/* Raises the bitrate by a tenth of the maximum.  Below the bitrate that
+ * last caused congestion it halves the distance instead, and only goes
+ * past it once the backoff has passed. */
+static void probe(struct rtmp_abr *abr, uint64_t ts)
+{
+	long step = abr->max_kbps / 10;
+	long min_step = abr->max_kbps / 40;
+
+	if (min_step < BITRATE_STEP)
+		min_step = BITRATE_STEP;
+	if (step < min_step)
+		step = min_step;
+
+	if (abr->ceiling_kbps && abr->cur_kbps + step >= abr->ceiling_kbps) {
+		long half = (abr->ceiling_kbps - abr->cur_kbps) / 2;
+
+		if (half >= min_step) {
+			step = half;
+		} else if (ts < abr->ceiling_retry) {
+			abr->next_probe = abr->ceiling_retry;
+			return;
+		}
+	}
+
+	abr->probe_base_kbps = abr->cur_kbps;
+	set_bitrate(abr, abr->cur_kbps + step);
+
+	abr->state = RTMP_ABR_PROBE;
+	abr->state_start = ts;
+	abr->state_end = ts + PROBE_NS + srtt_ns(abr) * 2;
+	abr->probes++;
+}
+
+bool rtmp_abr_update(struct rtmp_abr *abr,
+		     const struct rtmp_abr_sample *sample)
+{
+	const long prev_kbps = abr->cur_kbps;
+	const uint64_t ts = sample->ts;
+	bool cwnd_limited;
+	bool congested;
+	bool clear;
+
+	update_estimates(abr, sample);
+
+	cwnd_limited = sample->cwnd_bytes &&
+		       sample->unacked_bytes >= sample->cwnd_bytes / 10 * 9;
+
+	/* hysteresis: congestion starts above the high thresholds and only
+	 * ends below the low ones */
+	congested = abr->standing_queue_ms > queue_delay_high(abr) ||
+		    abr->standing_backlog_ms > BACKLOG_HIGH_MS ||
+		    (cwnd_limited && abr->standing_backlog_ms > BACKLOG_LOW_MS) ||
+		    abr->backlog_ms >= BACKLOG_SEVERE_MS;
+	clear = abr->standing_queue_ms < queue_delay_low(abr) &&
+		abr->standing_backlog_ms < BACKLOG_LOW_MS;
+
+	switch (abr->state) {
+	case RTMP_ABR_PROBE:
+		/* once the standing estimates only cover the probe, it is
+		 * held to the low thresholds: the link had no trouble with
+		 * the previous bitrate */
+		if (congested ||
+		    (ts - abr->state_start >= STANDING_WINDOW_NS && !clear))
+			fail_probe(abr, ts, congested);
+		else if (ts >= abr->state_end)
+			finish_probe(abr, ts);
+		break;
+
+	case RTMP_ABR_DRAIN:
+		/* still far above the capacity */
+		if (abr->backlog_ms >= BACKLOG_SEVERE_MS &&
+		    ts - abr->state_start >= SEVERE_INTERVAL_NS &&
+		    capacity_kbps(abr) < abr->cur_kbps * 9 / 10) {
+			decrease(abr, ts);
+			break;
+		}
+
+		if (ts < abr->state_end)
+			break;
+
+		if (clear) {
+			abr->state = RTMP_ABR_STEADY;
+			abr->next_probe = ts + PROBE_INTERVAL_NS;
+
+		} else if (congested &&
+			   abr->standing_backlog_ms >= abr->drain_backlog_ms &&
+			   abr->standing_queue_ms >=
+				   abr->drain_queue_ms * 0.9) {
+			/* no progress since the last decrease */
+			decrease(abr, ts);
+
+		} else {
+			abr->state_end = ts + STANDING_BUCKET_NS;
+			abr->drain_queue_ms = abr->standing_queue_ms;
+			abr->drain_backlog_ms = abr->standing_backlog_ms;
+		}
+		break;
+
+	case RTMP_ABR_STEADY:
+		if (congested)
+			decrease(abr, ts);
+		else if (clear && abr->cur_kbps < abr->max_kbps &&
+			 ts >= abr->next_probe)
+			probe(abr, ts);
+		break;
+	}
+
+	return abr->cur_kbps != prev_kbps;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Network aware controller for the dynamic bitrate option.
+ *
+ * Rather than waiting for packets to pile up in the output's queue, the
+ * controller looks at the TCP connection: the smoothed RTT against the
+ * lowest RTT seen recently (the queueing delay at the bottleneck), the
+ * data waiting to be sent, and the rate at which the peer acknowledges
+ * data.  Decreases go straight to the measured delivery rate.  Increases
+ * are probes that are only kept if the queueing delay stays low.  Every
+ * failed probe doubles the time until the next one, so the bitrate does
+ * not oscillate around the link capacity.
+ *
+ * The controller does no I/O and only uses the timestamps it is given,
+ * so it can be driven by recorded or simulated samples.
+ */
+
+struct rtmp_abr_sample {
+	uint64_t ts;            /* ns */
+	uint32_t rtt_us;        /* smoothed RTT as reported by the kernel */
+	uint32_t cwnd_bytes;    /* congestion window */
+	uint32_t unacked_bytes; /* data in flight */
+	uint64_t acked_bytes;   /* total data acknowledged by the peer */
+	uint64_t backlog_bytes; /* data waiting to be sent */
+};
+
+enum rtmp_abr_state {
+	RTMP_ABR_STEADY,
+	RTMP_ABR_DRAIN,
+	RTMP_ABR_PROBE,
+};
+
+struct rtmp_abr {
+	long max_kbps; /* the configured video bitrate */
+	long min_kbps;
+	long audio_kbps;
+	long cur_kbps;
+
+	enum rtmp_abr_state state;
+	uint64_t state_start;
+	uint64_t state_end;
+	uint64_t next_probe;
+	uint64_t probe_backoff;
+	long probe_base_kbps;
+	long ceiling_kbps; /* last bitrate that caused congestion */
+	uint64_t ceiling_retry;
+	double drain_queue_ms;
+	double drain_backlog_ms;
+
+	/* estimates */
+	bool have_sample;
+	uint64_t last_ts;
+	uint64_t last_acked;
+	double srtt_ms;
+	double min_rtt_ms;
+	double rtt_bucket_ms[2];
+	uint64_t rtt_bucket_ts;
+	double delivery_kbps;
+	double queue_delay_ms;
+	double backlog_ms;
+	double cwnd_kbps;
+
+	/* lowest queueing delay and backlog over the last few seconds */
+	double queue_bucket_ms[2];
+	double backlog_bucket_ms[2];
+	uint64_t standing_bucket_ts;
+	double standing_queue_ms;
+	double standing_backlog_ms;
+
+	/* statistics */
+	uint32_t decreases;
+	uint32_t probes;
+	uint32_t failed_probes;
+};
+
+extern void rtmp_abr_init(struct rtmp_abr *abr, long max_kbps,
+			  long audio_kbps, uint64_t ts);
+
+/* Feeds a new sample, returns true if cur_kbps changed. */
+extern bool rtmp_abr_update(struct rtmp_abr *abr,
+			    const struct rtmp_abr_sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,324 @@
+#ifdef __linux__
+#include "rtmp-stream.h"
+
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/sockios.h>
+#include <unistd.h>
+
+/* how often TCP_INFO is sampled for the frame drop / bitrate logic */
+#define TCP_STATS_INTERVAL_NS (100ULL * 1000000ULL)
+
+static void fatal_sock_shutdown(struct rtmp_stream *stream)
+{
+	close(stream->rtmp.m_sb.sb_socket);
+	stream->rtmp.m_sb.sb_socket = -1;
+	stream->write_buf_len = 0;
+	os_event_signal(stream->buffer_space_available_event);
+}
+
+static bool set_events(struct rtmp_stream *stream, int epfd, uint32_t events)
+{
+	struct epoll_event ev = {.events = events, .data.fd = 0};
+	int sock = stream->rtmp.m_sb.sb_socket;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, sock, &ev) != 0) {
+		blog(LOG_ERROR,
+		     "socket_thread_linux: Aborting due to "
+		     "epoll_ctl failure, %d",
+		     errno);
+		fatal_sock_shutdown(stream);
+		return false;
+	}
+
+	return true;
+}
+
+static bool socket_read(struct rtmp_stream *stream)
+{
+	char discard[16384];
+
+	for (;;) {
+		ssize_t ret = recv(stream->rtmp.m_sb.sb_socket, discard,
+				   sizeof(discard), 0);
+		if (ret > 0)
+			continue;
+		if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+
+		int err_code = ret == 0 ? 0 : errno;
+		blog(LOG_ERROR,
+		     "socket_thread_linux: Socket error, recv() returned "
+		     "%d, errno %d",
+		     (int)ret, err_code);
+		stream->rtmp.last_error_code = err_code;
+		fatal_sock_shutdown(stream);
+		return false;
+	}
+}
+
+/* Samples the RTT and the amount of data the kernel has not sent yet.
+ * Together with the write buffer this is the real send backlog, which
+ * the bitrate logic would otherwise not see.  With dynamic bitrate the
+ * samples also drive the bitrate controller. */
+static void update_tcp_stats(struct rtmp_stream *stream, uint64_t bytes_sent)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+	struct tcp_info info;
+	socklen_t size = sizeof(info);
+	int unsent = 0;
+	int queued = 0;
+
+	if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &size) != 0)
+		return;
+
+	os_atomic_set_long(&stream->tcp_rtt_ms, (long)(info.tcpi_rtt / 1000));
+
+	if (ioctl(sock, SIOCOUTQNSD, &unsent) == 0)
+		os_atomic_set_long(&stream->tcp_unsent_bytes, (long)unsent);
+
+	/* SIOCOUTQ counts everything the peer has not acknowledged yet */
+	if (!stream->abr_enabled || ioctl(sock, SIOCOUTQ, &queued) != 0)
+		return;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+	size_t buffered = stream->write_buf_len;
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	struct rtmp_abr_sample sample = {
+		.ts = os_gettime_ns(),
+		.rtt_us = info.tcpi_rtt,
+		.cwnd_bytes = info.tcpi_snd_cwnd * info.tcpi_snd_mss,
+		.unacked_bytes = info.tcpi_unacked * info.tcpi_snd_mss,
+		.acked_bytes = bytes_sent - (uint64_t)queued,
+		.backlog_bytes = buffered + (size_t)unsent,
+	};
+
+	if (rtmp_abr_update(&stream->abr, &sample))
+		os_atomic_set_long(&stream->abr_bitrate,
+				   stream->abr.cur_kbps);
+}
+
+enum data_ret { RET_BREAK, RET_FATAL, RET_CONTINUE };
+
+static enum data_ret write_data(struct rtmp_stream *stream, bool *can_write,
+				uint64_t *bytes_sent)
+{
+	ssize_t ret;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+
+	if (!stream->write_buf_len) {
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		return RET_BREAK;
+	}
+
+	/* the buffered data is written straight out of the write buffer */
+	ret = RTMPSockBuf_Send(&stream->rtmp.m_sb,
+			       (const char *)stream->write_buf,
+			       (int)stream->write_buf_len);
+
+	if (ret > 0) {
+		if (stream->write_buf_len - ret)
+			memmove(stream->write_buf, stream->write_buf + ret,
+				stream->write_buf_len - ret);
+		stream->write_buf_len -= ret;
+		*bytes_sent += (uint64_t)ret;
+
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		os_event_signal(stream->buffer_space_available_event);
+		return RET_CONTINUE;
+	}
+
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		*can_write = false;
+		return RET_BREAK;
+	}
+
+	/* connection closed, or connection was aborted / socket closed /
+	 * etc, that's a fatal error. */
+	int err_code = ret == 0 ? 0 : errno;
+	blog(LOG_ERROR,
+	     "socket_thread_linux: Socket error, send() returned %d, "
+	     "errno %d",
+	     (int)ret, err_code);
+
+	stream->rtmp.last_error_code = err_code;
+	fatal_sock_shutdown(stream);
+	return RET_FATAL;
+}
+
+static inline void socket_thread_linux_internal(struct rtmp_stream *stream)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+	bool can_write = true;
+	uint32_t events = EPOLLIN | EPOLLRDHUP;
+	uint64_t bytes_sent = 0;
+	uint64_t last_stats = 0;
+	int epfd;
+
+	/* Keep the kernel's unsent data small so the backlog builds up in
+	 * the write buffer instead, where the congestion and bitrate logic
+	 * can see it: ~250ms of data, ~50ms in low latency mode. */
+	int lowat = (int)stream->write_buf_size /
+		    (stream->low_latency_mode ? 20 : 4);
+	if (setsockopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat,
+		       sizeof(lowat)) != 0)
+		blog(LOG_WARNING,
+		     "socket_thread_linux: Failed to set "
+		     "TCP_NOTSENT_LOWAT, errno %d",
+		     errno);
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd == -1) {
+		blog(LOG_ERROR,
+		     "socket_thread_linux: Aborting due to "
+		     "epoll_create1 failure, %d",
+		     errno);
+		fatal_sock_shutdown(stream);
+		return;
+	}
+
+	struct epoll_event sock_ev = {.events = events, .data.fd = 0};
+	struct epoll_event wake_ev = {.events = EPOLLIN, .data.fd = 1};
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &sock_ev) != 0 ||
+	    epoll_ctl(epfd, EPOLL_CTL_ADD, stream->wake_fd, &wake_ev) != 0) {
+		blog(LOG_ERROR,
+		     "socket_thread_linux: Aborting due to "
+		     "epoll_ctl failure, %d",
+		     errno);
+		fatal_sock_shutdown(stream);
+		goto done;
+	}
+
+	for (;;) {
+		if (os_event_try(stream->send_thread_signaled_exit) != EAGAIN) {
+			pthread_mutex_lock(&stream->write_buf_mutex);
+			if (stream->write_buf_len == 0) {
+				pthread_mutex_unlock(&stream->write_buf_mutex);
+				os_event_reset(
+					stream->send_thread_signaled_exit);
+				break;
+			}
+
+			pthread_mutex_unlock(&stream->write_buf_mutex);
+		}
+
+		if (can_write) {
+			for (;;) {
+				enum data_ret ret = write_data(stream, &can_write,
+							       &bytes_sent);
+
+				if (ret == RET_FATAL)
+					goto done;
+				if (ret == RET_BREAK)
+					break;
+			}
+		}
+
+		/* only wait for the socket to become writable while data is
+		 * held back by it */
+		uint32_t new_events = EPOLLIN | EPOLLRDHUP |
+				      (can_write ? 0 : EPOLLOUT);
+		if (new_events != events) {
+			if (!set_events(stream, epfd, new_events))
+				goto done;
+			events = new_events;
+		}
+
+		struct epoll_event ready[2];
+		int count = epoll_wait(epfd, ready, 2, 100);
+		if (count == -1 && errno != EINTR) {
+			blog(LOG_ERROR,
+			     "socket_thread_linux: Aborting due to "
+			     "epoll_wait failure, %d",
+			     errno);
+			fatal_sock_shutdown(stream);
+			goto done;
+		}
+
+		for (int i = 0; i < count; i++) {
+			if (ready[i].data.fd == 1) {
+				uint64_t val;
+				if (read(stream->wake_fd, &val, sizeof(val)) <
+				    0) {
+					/* already cleared */
+				}
+				continue;
+			}
+
+			if (ready[i].events & (EPOLLERR | EPOLLHUP)) {
+				int err_code = 0;
+				socklen_t size = sizeof(err_code);
+				getsockopt(sock, SOL_SOCKET, SO_ERROR,
+					   &err_code, &size);
+
+				blog(LOG_ERROR,
+				     "socket_thread_linux: Aborting due to "
+				     "socket error %d, %d bytes lost",
+				     err_code, (int)stream->write_buf_len);
+				stream->rtmp.last_error_code = err_code;
+				fatal_sock_shutdown(stream);
+				goto done;
+			}
+
+			if (ready[i].events & (EPOLLIN | EPOLLRDHUP)) {
+				if (!socket_read(stream))
+					goto done;
+			}
+
+			if (ready[i].events & EPOLLOUT)
+				can_write = true;
+		}
+
+		uint64_t now = os_gettime_ns();
+		if (now - last_stats >= TCP_STATS_INTERVAL_NS) {
+			update_tcp_stats(stream, bytes_sent);
+			last_stats = now;
+		}
+	}
+
+	blog(LOG_INFO, "socket_thread_linux: Normal exit");
+
+done:
+	close(epfd);
+}
+
+void *socket_thread_linux(void *data)
+{
+	struct rtmp_stream *stream = data;
+
+	os_set_thread_name("rtmp-stream: socket_thread");
+	socket_thread_linux_internal(stream);
+	return NULL;
+}
+
+void socket_thread_linux_wake(struct rtmp_stream *stream)
+{
+	uint64_t val = 1;
+
+	if (stream->wake_fd != -1 &&
+	    write(stream->wake_fd, &val, sizeof(val)) < 0) {
+		/* the counter is saturated, the thread wakes anyway */
+	}
+}
+
+bool socket_thread_linux_init(struct rtmp_stream *stream)
+{
+	if (stream->wake_fd == -1)
+		stream->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return stream->wake_fd != -1;
+}
+
+void socket_thread_linux_free(struct rtmp_stream *stream)
+{
+	if (stream->wake_fd != -1) {
+		close(stream->wake_fd);
+		stream->wake_fd = -1;
+	}
+}
+#endif
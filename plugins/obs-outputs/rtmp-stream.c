@@ -44,6 +44,10 @@
 #define MIN_ESTIMATE_DURATION_MS 1000
 #define MAX_ESTIMATE_DURATION_MS 2000
 
+/* delay between attempts to reconnect the output's own connection while
+ * additional destinations keep streaming */
+#define MIRRORS_ONLY_RETRY_SEC 10
+
 static const char *rtmp_stream_getname(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -98,10 +102,48 @@ static inline bool disconnected(struct rtmp_stream *stream)
 	return os_atomic_load_bool(&stream->disconnected);
 }
 
+static inline bool is_mirror(struct rtmp_stream *stream)
+{
+	return stream->parent != NULL;
+}
+
+static bool mirrors_streaming(struct rtmp_stream *stream)
+{
+	for (size_t i = 0; i < stream->mirrors.num; i++) {
+		struct rtmp_stream *mirror = stream->mirrors.array[i];
+
+		if (connecting(mirror) ||
+		    (active(mirror) && !disconnected(mirror)))
+			return true;
+	}
+
+	return false;
+}
+
+/* a failing additional destination does not stop the output */
+static void signal_stop(struct rtmp_stream *stream, int code)
+{
+	if (is_mirror(stream)) {
+		if (code != OBS_OUTPUT_SUCCESS)
+			warn("Additional destination %s stopped: %d",
+			     stream->path.array, code);
+		return;
+	}
+
+	/* libobs takes over from here, including reconnecting */
+	os_atomic_set_bool(&stream->mirrors_only, false);
+	obs_output_signal_stop(stream->output, code);
+}
+
+static void destroy_mirrors(struct rtmp_stream *stream);
+
 static void rtmp_stream_destroy(void *data)
 {
 	struct rtmp_stream *stream = data;
 
+	if (stream->retry_event)
+		os_event_signal(stream->retry_event);
+
 	if (stopping(stream) && !connecting(stream)) {
 		pthread_join(stream->send_thread, NULL);
 
@@ -114,11 +156,15 @@ static void rtmp_stream_destroy(void *data)
 
 		if (active(stream)) {
 			os_sem_post(stream->send_sem);
-			obs_output_end_data_capture(stream->output);
+			if (!is_mirror(stream))
+				obs_output_end_data_capture(stream->output);
 			pthread_join(stream->send_thread, NULL);
 		}
 	}
 
+	/* after the output's own threads, which may still look at them */
+	destroy_mirrors(stream);
+
 	RTMP_TLS_Free(&stream->rtmp);
 	free_packets(stream);
 	dstr_free(&stream->path);
@@ -141,10 +187,15 @@ static void rtmp_stream_destroy(void *data)
 	os_event_destroy(stream->buffer_has_data_event);
 	os_event_destroy(stream->socket_available_event);
 	os_event_destroy(stream->send_thread_signaled_exit);
+	os_event_destroy(stream->retry_event);
 	pthread_mutex_destroy(&stream->write_buf_mutex);
+#ifdef __linux__
+	socket_thread_linux_free(stream);
+#endif
 
 	if (stream->write_buf)
 		bfree(stream->write_buf);
+	da_free(stream->mirrors);
 	bfree(stream);
 }
 
@@ -152,6 +203,7 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 {
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
+	stream->wake_fd = -1;
 	pthread_mutex_init_value(&stream->packets_mutex);
 
 	RTMP_LogSetCallback(log_rtmp);
@@ -192,6 +244,10 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 		warn("Failed to initialize socket exit event");
 		goto fail;
 	}
+	if (os_event_init(&stream->retry_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		warn("Failed to initialize reconnect event");
+		goto fail;
+	}
 
 	UNUSED_PARAMETER(settings);
 	return stream;
@@ -201,6 +257,31 @@ fail:
 	return NULL;
 }
 
+/* Additional destinations are never waited for here, their threads are
+ * joined in destroy_mirrors.  One that is still connecting or waiting for
+ * its first keyframe would never see a packet past the stop timestamp once
+ * the parent stops capturing, so it stops right away. */
+static void stop_mirror(struct rtmp_stream *mirror, uint64_t ts)
+{
+	if (stopping(mirror) && ts != 0)
+		return;
+
+	if (connecting(mirror) ||
+	    os_atomic_load_bool(&mirror->waiting_keyframe))
+		ts = 0;
+
+	mirror->stop_ts = ts / 1000ULL;
+
+	if (ts)
+		mirror->shutdown_timeout_ts =
+			ts +
+			(uint64_t)mirror->max_shutdown_time_sec * 1000000000ULL;
+
+	os_event_signal(mirror->stop_event);
+	if (ts == 0 && active(mirror))
+		os_sem_post(mirror->send_sem);
+}
+
 static void rtmp_stream_stop(void *data, uint64_t ts)
 {
 	struct rtmp_stream *stream = data;
@@ -208,9 +289,17 @@ static void rtmp_stream_stop(void *data, uint64_t ts)
 	if (stopping(stream) && ts != 0)
 		return;
 
+	for (size_t i = 0; i < stream->mirrors.num; i++)
+		stop_mirror(stream->mirrors.array[i], ts);
+
+	/* wakes a connect thread waiting to reconnect, see wait_to_retry */
+	os_event_signal(stream->retry_event);
+
 	if (connecting(stream))
 		pthread_join(stream->connect_thread, NULL);
 
+	os_atomic_set_bool(&stream->mirrors_only, false);
+
 	stream->stop_ts = ts / 1000ULL;
 
 	if (ts)
@@ -223,7 +312,7 @@ static void rtmp_stream_stop(void *data, uint64_t ts)
 		if (stream->stop_ts == 0)
 			os_sem_post(stream->send_sem);
 	} else {
-		obs_output_signal_stop(stream->output, OBS_OUTPUT_SUCCESS);
+		signal_stop(stream, OBS_OUTPUT_SUCCESS);
 	}
 }
 
@@ -381,6 +470,9 @@ retry_send:
 	pthread_mutex_unlock(&stream->write_buf_mutex);
 
 	os_event_signal(stream->buffer_has_data_event);
+#ifdef __linux__
+	socket_thread_linux_wake(stream);
+#endif
 
 	return len;
 }
@@ -442,6 +534,56 @@ static int send_packet(struct rtmp_stream *stream,
 	return ret;
 }
 
+#define FLV_TAG_HEADER_SIZE 11
+
+/* FLV tags store the lower 24 bits of the timestamp at offset 4, followed by
+ * the upper 8 bits */
+static void shift_tag_timestamp(uint8_t *tag, int32_t shift)
+{
+	int32_t time_ms = (int32_t)(((uint32_t)(tag[7] & 0x7F) << 24) |
+				    ((uint32_t)tag[4] << 16) |
+				    ((uint32_t)tag[5] << 8) | tag[6]);
+
+	/* audio queued just before the first keyframe */
+	time_ms = time_ms > shift ? time_ms - shift : 0;
+
+	tag[4] = (uint8_t)(time_ms >> 16);
+	tag[5] = (uint8_t)(time_ms >> 8);
+	tag[6] = (uint8_t)time_ms;
+	tag[7] = (uint8_t)((time_ms >> 24) & 0x7F);
+}
+
+/* sends a packet already serialized to an FLV tag by serialize_packet */
+static int send_serialized_packet(struct rtmp_stream *stream,
+				  struct encoder_packet *packet)
+{
+	size_t size = packet->size;
+	int ret;
+
+	if (handle_socket_read(stream)) {
+		obs_encoder_packet_release(packet);
+		return -1;
+	}
+
+#ifdef TEST_FRAMEDROPS
+	droptest_cap_data_rate(stream, size);
+#endif
+
+	if (stream->tag_ts_shift && size >= FLV_TAG_HEADER_SIZE) {
+		uint8_t *data = bmemdup(packet->data, size);
+		shift_tag_timestamp(data, stream->tag_ts_shift);
+		ret = RTMP_Write(&stream->rtmp, (char *)data, (int)size, 0);
+		bfree(data);
+	} else {
+		ret = RTMP_Write(&stream->rtmp, (char *)packet->data, (int)size,
+				 0);
+	}
+	obs_encoder_packet_release(packet);
+
+	stream->total_bytes_sent += size;
+	return ret;
+}
+
 static int send_packet_ex(struct rtmp_stream *stream,
 			  struct encoder_packet *packet, bool is_header,
 			  bool is_footer, size_t idx)
@@ -581,7 +723,7 @@ static void set_output_error(struct rtmp_stream *stream)
 		obs_output_set_last_error(stream->output, msg);
 }
 
-static void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
+void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back)
 {
 	struct dbr_frame front;
 	uint64_t dur;
@@ -629,6 +771,9 @@ static void log_sndbuf_size(struct rtmp_stream *stream)
 	}
 }
 
+static bool keep_mirrors_streaming(struct rtmp_stream *stream);
+static void start_reconnect(struct rtmp_stream *stream);
+
 static void *send_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
@@ -639,6 +784,8 @@ static void *send_thread(void *data)
 	log_sndbuf_size(stream);
 #endif
 
+	const bool dbr_measure = stream->dbr_send_measure;
+
 	while (os_sem_wait(stream->send_sem) == 0) {
 		struct encoder_packet packet;
 		struct dbr_frame dbr_frame;
@@ -664,29 +811,17 @@ static void *send_thread(void *data)
 			}
 		}
 
-		if (stream->dbr_enabled) {
+		if (dbr_measure) {
 			dbr_frame.send_beg = os_gettime_ns();
 			dbr_frame.size = packet.size;
 		}
 
-		int sent;
-		if (packet.type == OBS_ENCODER_VIDEO &&
-		    (stream->video_codec[packet.track_idx] != CODEC_H264 ||
-		     (stream->video_codec[packet.track_idx] == CODEC_H264 &&
-		      packet.track_idx != 0))) {
-			sent = send_packet_ex(stream, &packet, false, false,
-					      packet.track_idx);
-		} else {
-			sent = send_packet(stream, &packet, false,
-					   packet.track_idx);
-		}
-
-		if (sent < 0) {
+		if (send_serialized_packet(stream, &packet) < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
 		}
 
-		if (stream->dbr_enabled) {
+		if (dbr_measure) {
 			dbr_frame.send_end = os_gettime_ns();
 
 			pthread_mutex_lock(&stream->dbr_mutex);
@@ -714,6 +849,9 @@ static void *send_thread(void *data)
 	if (stream->new_socket_loop) {
 		os_event_signal(stream->send_thread_signaled_exit);
 		os_event_signal(stream->buffer_has_data_event);
+#ifdef __linux__
+		socket_thread_linux_wake(stream);
+#endif
 		pthread_join(stream->socket_thread, NULL);
 		stream->socket_thread_active = false;
 		stream->rtmp.m_bCustomSend = false;
@@ -723,6 +861,11 @@ static void *send_thread(void *data)
 
 	RTMP_Close(&stream->rtmp);
 
+	if (stream->abr_enabled)
+		info("Dynamic bitrate: %u decreases, %u probes, %u failed",
+		     stream->abr.decreases, stream->abr.probes,
+		     stream->abr.failed_probes);
+
 	/* reset bitrate on stop */
 	if (stream->dbr_enabled) {
 		if (stream->dbr_cur_bitrate != stream->dbr_orig_bitrate) {
@@ -731,12 +874,24 @@ static void *send_thread(void *data)
 		}
 	}
 
+	if (is_mirror(stream))
+		info("Sent %" PRIu64 " bytes to %s, dropped %d frames",
+		     stream->total_bytes_sent, stream->path.array,
+		     stream->dropped_frames);
+
+	bool reconnect = false;
+
 	if (!stopping(stream)) {
-		pthread_detach(stream->send_thread);
-		obs_output_signal_stop(stream->output, OBS_OUTPUT_DISCONNECTED);
+		/* additional destinations are always joined */
+		if (!is_mirror(stream))
+			pthread_detach(stream->send_thread);
+
+		reconnect = keep_mirrors_streaming(stream);
+		if (!reconnect)
+			signal_stop(stream, OBS_OUTPUT_DISCONNECTED);
 	} else if (encode_error) {
-		obs_output_signal_stop(stream->output, OBS_OUTPUT_ENCODE_ERROR);
-	} else {
+		signal_stop(stream, OBS_OUTPUT_ENCODE_ERROR);
+	} else if (!is_mirror(stream)) {
 		obs_output_end_data_capture(stream->output);
 	}
 
@@ -745,6 +900,10 @@ static void *send_thread(void *data)
 	os_atomic_set_bool(&stream->active, false);
 	stream->sent_headers = false;
 
+	/* only once the state of the old connection has been reset */
+	if (reconnect)
+		start_reconnect(stream);
+
 	return NULL;
 }
 
@@ -1012,12 +1171,23 @@ static int init_send(struct rtmp_stream *stream)
 
 	reset_semaphore(stream);
 
+	/* decided before the send thread starts, which reads it.  with the
+	 * new socket loop on Linux the socket thread drives the bitrate from
+	 * the TCP statistics instead. */
+#ifdef __linux__
+	stream->dbr_send_measure = stream->dbr_enabled &&
+				   !stream->new_socket_loop;
+#else
+	stream->dbr_send_measure = stream->dbr_enabled;
+#endif
+
 	ret = pthread_create(&stream->send_thread, NULL, send_thread, stream);
 	if (ret != 0) {
 		RTMP_Close(&stream->rtmp);
 		warn("Failed to create send thread");
 		return OBS_OUTPUT_ERROR;
 	}
+	stream->send_thread_started = true;
 
 	if (stream->new_socket_loop) {
 		int one = 1;
@@ -1089,13 +1259,33 @@ static int init_send(struct rtmp_stream *stream)
 		stream->write_buf_size = ideal_buffer_size;
 		stream->write_buf = bmalloc(ideal_buffer_size);
 
-#ifndef _WIN32
-		warn("New socket loop not supported on this platform");
-		return OBS_OUTPUT_ERROR;
-#else
+#if defined(_WIN32)
 		ret = pthread_create(&stream->socket_thread, NULL,
 				     socket_thread_windows, stream);
+#elif defined(__linux__)
+		if (!socket_thread_linux_init(stream)) {
+			warn("Failed to create socket thread wake event");
+			return OBS_OUTPUT_ERROR;
+		}
+
+		/* the socket thread drives the bitrate from the TCP
+		 * statistics instead of the packet queue */
+		stream->abr_enabled = stream->dbr_enabled;
+		if (stream->abr_enabled) {
+			rtmp_abr_init(&stream->abr, stream->dbr_orig_bitrate,
+				      stream->audio_bitrate, os_gettime_ns());
+			os_atomic_set_long(&stream->abr_bitrate,
+					   stream->dbr_orig_bitrate);
+		}
+
+		ret = pthread_create(&stream->socket_thread, NULL,
+				     socket_thread_linux, stream);
+#else
+		warn("New socket loop not supported on this platform");
+		return OBS_OUTPUT_ERROR;
+#endif
 
+#if defined(_WIN32) || defined(__linux__)
 		if (ret != 0) {
 			RTMP_Close(&stream->rtmp);
 			warn("Failed to create socket thread");
@@ -1129,7 +1319,13 @@ static int init_send(struct rtmp_stream *stream)
 		return OBS_OUTPUT_DISCONNECTED;
 	}
 
-	obs_output_begin_data_capture(stream->output, 0);
+	if (os_atomic_load_bool(&stream->mirrors_only)) {
+		/* data capture never stopped */
+		os_atomic_set_bool(&stream->mirrors_only, false);
+		info("Reconnected to %s", stream->path.array);
+	} else if (!is_mirror(stream)) {
+		obs_output_begin_data_capture(stream->output, 0);
+	}
 
 	return OBS_OUTPUT_SUCCESS;
 }
@@ -1285,7 +1481,7 @@ static int try_connect(struct rtmp_stream *stream)
 
 static bool init_connect(struct rtmp_stream *stream)
 {
-	obs_service_t *service;
+	obs_service_t *service = NULL;
 	obs_data_t *settings;
 	const char *bind_ip;
 	const char *ip_family;
@@ -1299,30 +1495,48 @@ static bool init_connect(struct rtmp_stream *stream)
 
 	free_packets(stream);
 
-	service = obs_output_get_service(stream->output);
-	if (!service)
-		return false;
+	/* additional destinations bring their own connection info */
+	if (!is_mirror(stream)) {
+		service = obs_output_get_service(stream->output);
+		if (!service)
+			return false;
+	}
 
 	os_atomic_set_bool(&stream->disconnected, false);
 	os_atomic_set_bool(&stream->encode_error, false);
 	stream->total_bytes_sent = 0;
 	stream->dropped_frames = 0;
 	stream->min_priority = 0;
-	stream->got_first_video = false;
+	stream->tag_ts_shift = 0;
+
+	/* packets kept flowing to the additional destinations while the
+	 * output reconnects, so it joins them at the next keyframe */
+	if (os_atomic_load_bool(&stream->mirrors_only)) {
+		os_atomic_set_bool(&stream->waiting_keyframe, true);
+	} else {
+		os_atomic_set_bool(&stream->waiting_keyframe,
+				   is_mirror(stream));
+		stream->got_first_video = false;
+	}
+
+	os_atomic_set_long(&stream->tcp_rtt_ms, 0);
+	os_atomic_set_long(&stream->tcp_unsent_bytes, 0);
 
 	settings = obs_output_get_settings(stream->output);
-	dstr_copy(&stream->path,
-		  obs_service_get_connect_info(
-			  service, OBS_SERVICE_CONNECT_INFO_SERVER_URL));
-	dstr_copy(&stream->key,
-		  obs_service_get_connect_info(
-			  service, OBS_SERVICE_CONNECT_INFO_STREAM_KEY));
-	dstr_copy(&stream->username,
-		  obs_service_get_connect_info(
-			  service, OBS_SERVICE_CONNECT_INFO_USERNAME));
-	dstr_copy(&stream->password,
-		  obs_service_get_connect_info(
-			  service, OBS_SERVICE_CONNECT_INFO_PASSWORD));
+	if (service) {
+		dstr_copy(&stream->path,
+			  obs_service_get_connect_info(
+				  service, OBS_SERVICE_CONNECT_INFO_SERVER_URL));
+		dstr_copy(&stream->key,
+			  obs_service_get_connect_info(
+				  service, OBS_SERVICE_CONNECT_INFO_STREAM_KEY));
+		dstr_copy(&stream->username,
+			  obs_service_get_connect_info(
+				  service, OBS_SERVICE_CONNECT_INFO_USERNAME));
+		dstr_copy(&stream->password,
+			  obs_service_get_connect_info(
+				  service, OBS_SERVICE_CONNECT_INFO_PASSWORD));
+	}
 	dstr_depad(&stream->path);
 	dstr_depad(&stream->key);
 	drop_b = (int64_t)obs_data_get_int(settings, OPT_DROP_THRESHOLD);
@@ -1353,6 +1567,7 @@ static bool init_connect(struct rtmp_stream *stream)
 	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
 	stream->dbr_inc_timeout = 0;
 	stream->dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
+	stream->abr_enabled = false;
 
 	caps = obs_encoder_get_caps(venc);
 	if ((caps & OBS_ENCODER_CAP_DYN_BITRATE) == 0) {
@@ -1365,6 +1580,12 @@ static bool init_connect(struct rtmp_stream *stream)
 		stream->dbr_enabled = false;
 	}
 
+	/* the encoders are shared, only the output's own connection may
+	 * change their bitrate */
+	if (is_mirror(stream)) {
+		stream->dbr_enabled = false;
+	}
+
 	if (stream->dbr_enabled) {
 		info("Dynamic bitrate enabled.  Dropped frames begone!");
 	}
@@ -1393,7 +1614,7 @@ static bool init_connect(struct rtmp_stream *stream)
 		stream->addrlen_hint = len;
 	}
 
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__linux__)
 	stream->new_socket_loop =
 		obs_data_get_bool(settings, OPT_NEWSOCKETLOOP_ENABLED);
 	stream->low_latency_mode =
@@ -1414,16 +1635,41 @@ static bool init_connect(struct rtmp_stream *stream)
 	return true;
 }
 
+/* Waits before the next attempt to reconnect the output's own connection
+ * while additional destinations keep streaming.  Returns false once they
+ * have stopped or the output is being stopped. */
+static bool wait_to_retry(struct rtmp_stream *stream)
+{
+	if (!os_atomic_load_bool(&stream->mirrors_only))
+		return false;
+
+	if (mirrors_streaming(stream)) {
+		info("Reconnecting to %s in %d seconds", stream->path.array,
+		     MIRRORS_ONLY_RETRY_SEC);
+		if (os_event_timedwait(stream->retry_event,
+				       MIRRORS_ONLY_RETRY_SEC * 1000) ==
+		    ETIMEDOUT)
+			return true;
+	}
+
+	os_atomic_set_bool(&stream->mirrors_only, false);
+	return false;
+}
+
 static void *connect_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
-	int ret;
+	bool reconnecting = os_atomic_load_bool(&stream->mirrors_only);
+	int ret = OBS_OUTPUT_DISCONNECTED;
 
 	os_set_thread_name("rtmp-stream: connect_thread");
 
+	if (reconnecting && !wait_to_retry(stream))
+		goto finish;
+
 	if (!init_connect(stream)) {
-		obs_output_signal_stop(stream->output, OBS_OUTPUT_BAD_PATH);
-		return NULL;
+		ret = OBS_OUTPUT_BAD_PATH;
+		goto finish;
 	}
 
 	// HDR streaming disabled for AV1
@@ -1437,27 +1683,178 @@ static void *connect_thread(void *data)
 
 			if (info->colorspace == VIDEO_CS_2100_HLG ||
 			    info->colorspace == VIDEO_CS_2100_PQ) {
-				obs_output_signal_stop(stream->output,
-						       OBS_OUTPUT_HDR_DISABLED);
-				return NULL;
+				ret = OBS_OUTPUT_HDR_DISABLED;
+				goto finish;
 			}
 		}
 	}
 
 	ret = try_connect(stream);
+	while (ret != OBS_OUTPUT_SUCCESS && wait_to_retry(stream))
+		ret = try_connect(stream);
+
+	/* libobs carries on reconnecting once the destinations stopped */
+	if (reconnecting && ret != OBS_OUTPUT_SUCCESS)
+		ret = OBS_OUTPUT_DISCONNECTED;
 
+finish:
+	/* a stop requested meanwhile is signaled by rtmp_stream_stop, which
+	 * also joins this thread */
 	if (ret != OBS_OUTPUT_SUCCESS) {
-		obs_output_signal_stop(stream->output, ret);
 		info("Connection to %s failed: %d", stream->path.array, ret);
+		if (os_event_try(stream->retry_event) == EAGAIN)
+			signal_stop(stream, ret);
 	}
 
-	if (!stopping(stream))
+	/* an additional destination stopped while connecting has nothing
+	 * to send, see stop_mirror */
+	if (is_mirror(stream)) {
+		if (ret == OBS_OUTPUT_SUCCESS && stopping(stream))
+			os_sem_post(stream->send_sem);
+	} else if (!stopping(stream) &&
+		   os_event_try(stream->retry_event) == EAGAIN) {
 		pthread_detach(stream->connect_thread);
+	}
 
 	os_atomic_set_bool(&stream->connecting, false);
 	return NULL;
 }
 
+/* Called on the send thread once the output's own connection dropped.  If
+ * additional destinations are still streaming, data capture goes on for
+ * them and the connection is retried here instead of by libobs, which
+ * would stop capturing until it is back. */
+static bool keep_mirrors_streaming(struct rtmp_stream *stream)
+{
+	if (is_mirror(stream) || !mirrors_streaming(stream) ||
+	    os_event_try(stream->retry_event) != EAGAIN)
+		return false;
+
+	warn("Lost connection to %s, additional destinations keep "
+	     "streaming while it reconnects",
+	     stream->path.array);
+	os_atomic_set_bool(&stream->mirrors_only, true);
+	return true;
+}
+
+static void start_reconnect(struct rtmp_stream *stream)
+{
+	os_atomic_set_bool(&stream->connecting, true);
+	if (pthread_create(&stream->connect_thread, NULL, connect_thread,
+			   stream) != 0) {
+		os_atomic_set_bool(&stream->connecting, false);
+		signal_stop(stream, OBS_OUTPUT_DISCONNECTED);
+	}
+}
+
+/* The parent no longer feeds packets at this point, so nothing may wait for
+ * one.  The connect and send threads of additional destinations are never
+ * detached. */
+static void destroy_mirror(struct rtmp_stream *mirror)
+{
+	mirror->stop_ts = 0;
+	os_event_signal(mirror->stop_event);
+	pthread_join(mirror->connect_thread, NULL);
+
+	if (mirror->send_thread_started) {
+		os_sem_post(mirror->send_sem);
+		pthread_join(mirror->send_thread, NULL);
+		mirror->send_thread_started = false;
+	}
+
+	os_event_reset(mirror->stop_event);
+	rtmp_stream_destroy(mirror);
+}
+
+static void destroy_mirrors(struct rtmp_stream *stream)
+{
+	for (size_t i = 0; i < stream->mirrors.num; i++)
+		destroy_mirror(stream->mirrors.array[i]);
+	da_resize(stream->mirrors, 0);
+}
+
+static void start_mirror(struct rtmp_stream *stream, obs_data_t *dest)
+{
+	const char *server = obs_data_get_string(dest, "server");
+	struct rtmp_stream *mirror;
+
+	if (!server || !*server)
+		return;
+
+	mirror = rtmp_stream_create(NULL, stream->output);
+	if (!mirror)
+		return;
+
+	mirror->parent = stream;
+	dstr_copy(&mirror->path, server);
+	dstr_copy(&mirror->key, obs_data_get_string(dest, "key"));
+	dstr_copy(&mirror->username, obs_data_get_string(dest, "username"));
+	dstr_copy(&mirror->password, obs_data_get_string(dest, "password"));
+
+	os_atomic_set_bool(&mirror->connecting, true);
+	if (pthread_create(&mirror->connect_thread, NULL, connect_thread,
+			   mirror) != 0) {
+		os_atomic_set_bool(&mirror->connecting, false);
+		rtmp_stream_destroy(mirror);
+		return;
+	}
+
+	da_push_back(stream->mirrors, &mirror);
+}
+
+static void start_mirrors(struct rtmp_stream *stream)
+{
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	obs_data_array_t *dests =
+		obs_data_get_array(settings, OPT_EXTRA_DESTINATIONS);
+	size_t count = obs_data_array_count(dests);
+
+	destroy_mirrors(stream);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *dest = obs_data_array_item(dests, i);
+		start_mirror(stream, dest);
+		obs_data_release(dest);
+	}
+
+	if (stream->mirrors.num)
+		info("Fanning out to %zu additional destination(s)",
+		     stream->mirrors.num);
+
+	obs_data_array_release(dests);
+	obs_data_release(settings);
+}
+
+/* Reconnects destinations that have stopped and leaves the others be.  The
+ * output only gets here when its data capture stopped, so none of them is
+ * fed packets meanwhile. */
+static void restart_stopped_mirrors(struct rtmp_stream *stream)
+{
+	for (size_t i = stream->mirrors.num; i > 0; i--) {
+		struct rtmp_stream *mirror = stream->mirrors.array[i - 1];
+
+		if (connecting(mirror) ||
+		    (active(mirror) && !disconnected(mirror)))
+			continue;
+
+		pthread_join(mirror->connect_thread, NULL);
+		if (mirror->send_thread_started) {
+			os_sem_post(mirror->send_sem);
+			pthread_join(mirror->send_thread, NULL);
+			mirror->send_thread_started = false;
+		}
+		os_event_reset(mirror->stop_event);
+
+		os_atomic_set_bool(&mirror->connecting, true);
+		if (pthread_create(&mirror->connect_thread, NULL,
+				   connect_thread, mirror) != 0) {
+			os_atomic_set_bool(&mirror->connecting, false);
+			rtmp_stream_destroy(mirror);
+			da_erase(stream->mirrors, i - 1);
+		}
+	}
+}
+
 static bool rtmp_stream_start(void *data)
 {
 	struct rtmp_stream *stream = data;
@@ -1467,6 +1864,15 @@ static bool rtmp_stream_start(void *data)
 	if (!obs_output_initialize_encoders(stream->output, 0))
 		return false;
 
+	os_event_reset(stream->retry_event);
+
+	/* destinations keep their own connections while libobs reconnects
+	 * the output */
+	if (obs_output_reconnecting(stream->output))
+		restart_stopped_mirrors(stream);
+	else
+		start_mirrors(stream);
+
 	os_atomic_set_bool(&stream->connecting, true);
 	return pthread_create(&stream->connect_thread, NULL, connect_thread,
 			      stream) == 0;
@@ -1638,6 +2044,47 @@ static void dbr_inc_bitrate(struct rtmp_stream *stream)
 	}
 }
 
+/* applies the bitrate chosen by the socket thread */
+static void abr_set_bitrate(struct rtmp_stream *stream)
+{
+	long bitrate = os_atomic_load_long(&stream->abr_bitrate);
+
+	if (bitrate == stream->dbr_cur_bitrate)
+		return;
+
+	info("bitrate %s to: %ld, rtt: %ld ms",
+	     bitrate < stream->dbr_cur_bitrate ? "decreased" : "increased",
+	     bitrate, os_atomic_load_long(&stream->tcp_rtt_ms));
+	stream->dbr_cur_bitrate = bitrate;
+	dbr_set_bitrate(stream);
+}
+
+/* With the socket thread, sent packets wait in the write buffer and in the
+ * kernel's send queue rather than in the packet queue.  Returns how long
+ * that backlog takes to send at the current bitrate. */
+static int64_t socket_backlog_usec(struct rtmp_stream *stream)
+{
+#ifdef __linux__
+	long kbps = stream->dbr_enabled ? stream->dbr_cur_bitrate
+					: stream->dbr_orig_bitrate;
+	size_t bytes;
+
+	kbps += stream->audio_bitrate;
+	if (!stream->socket_thread_active || kbps <= 0)
+		return 0;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+	bytes = stream->write_buf_len;
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	bytes += (size_t)os_atomic_load_long(&stream->tcp_unsent_bytes);
+	return (int64_t)bytes * 8000 / kbps;
+#else
+	UNUSED_PARAMETER(stream);
+	return 0;
+#endif
+}
+
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 {
 	struct encoder_packet first;
@@ -1650,7 +2097,9 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 					 : stream->drop_threshold_usec;
 
 	if (!pframes && stream->dbr_enabled) {
-		if (stream->dbr_inc_timeout) {
+		if (stream->abr_enabled) {
+			abr_set_bitrate(stream);
+		} else if (stream->dbr_inc_timeout) {
 			uint64_t t = os_gettime_ns();
 
 			if (t >= stream->dbr_inc_timeout) {
@@ -1661,18 +2110,24 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		}
 	}
 
-	if (num_packets < 5) {
+	int64_t backlog_usec = socket_backlog_usec(stream);
+
+	if (num_packets < 5 && !backlog_usec) {
 		if (!pframes)
 			stream->congestion = 0.0f;
 		return;
 	}
 
-	if (!find_first_video_packet(stream, &first))
-		return;
-
 	/* if the amount of time stored in the buffered packets waiting to be
 	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	if (num_packets >= 5 && find_first_video_packet(stream, &first))
+		buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	else if (backlog_usec)
+		buffer_duration_usec = 0;
+	else
+		return;
+
+	buffer_duration_usec += backlog_usec;
 
 	if (!pframes) {
 		stream->congestion =
@@ -1686,7 +2141,7 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 	if (stream->dbr_enabled) {
 		bool bitrate_changed = false;
 
-		if (pframes) {
+		if (pframes || stream->abr_enabled) {
 			return;
 		}
 
@@ -1697,8 +2152,10 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		}
 
 		if (bitrate_changed) {
-			debug("buffer_duration_msec: %" PRId64,
-			      buffer_duration_usec / 1000);
+			debug("buffer_duration_msec: %" PRId64
+			      ", rtt: %ld ms",
+			      buffer_duration_usec / 1000,
+			      os_atomic_load_long(&stream->tcp_rtt_ms));
 			dbr_set_bitrate(stream);
 		}
 		return;
@@ -1729,19 +2186,118 @@ static bool add_video_packet(struct rtmp_stream *stream,
 	return add_packet(stream, packet);
 }
 
+/* Muxes a packet to an FLV tag once, so that every destination can share
+ * the result.  The tag keeps the packet's timing and priority fields for
+ * frame dropping. */
+static void serialize_packet(struct rtmp_stream *stream,
+			     struct encoder_packet *dst,
+			     struct encoder_packet *src)
+{
+	struct encoder_packet tag = *src;
+	size_t idx = src->track_idx;
+	uint8_t *data;
+	size_t size;
+
+	if (src->type == OBS_ENCODER_VIDEO &&
+	    (stream->video_codec[idx] != CODEC_H264 || idx != 0)) {
+		flv_packet_frames(src, stream->video_codec[idx],
+				  stream->start_dts_offset, &data, &size, idx);
+	} else if (idx > 0) {
+		flv_additional_packet_mux(src, stream->start_dts_offset, &data,
+					  &size, false, idx);
+	} else {
+		flv_packet_mux(src, stream->start_dts_offset, &data, &size,
+			       false);
+	}
+
+	tag.data = data;
+	tag.size = size;
+	obs_encoder_packet_create_instance(dst, &tag);
+
+	bfree(data);
+	obs_encoder_packet_release(src);
+}
+
+/* Destinations that connect while packets are already flowing start at the
+ * next keyframe, with the timestamps of the tags, which were muxed relative
+ * to base_offset, moved back to start there.  Returns false until then. */
+static bool join_at_keyframe(struct rtmp_stream *dest,
+			     struct encoder_packet *tag, int64_t base_offset)
+{
+	if (!os_atomic_load_bool(&dest->waiting_keyframe))
+		return true;
+	if (tag->type != OBS_ENCODER_VIDEO || !tag->keyframe)
+		return false;
+
+	int64_t keyframe_ms = get_ms_time(tag, tag->dts);
+
+	/* the output itself keeps the offset its tags are muxed with */
+	if (is_mirror(dest))
+		dest->start_dts_offset = keyframe_ms;
+	dest->tag_ts_shift = (int32_t)(keyframe_ms - base_offset);
+	os_atomic_set_bool(&dest->waiting_keyframe, false);
+	return true;
+}
+
+static void mirror_packet(struct rtmp_stream *mirror,
+			  struct encoder_packet *tag)
+{
+	struct encoder_packet packet;
+	bool added_packet = false;
+
+	if (disconnected(mirror) || !active(mirror))
+		return;
+
+	if (!join_at_keyframe(mirror, tag, mirror->parent->start_dts_offset))
+		return;
+
+	obs_encoder_packet_ref(&packet, tag);
+
+	pthread_mutex_lock(&mirror->packets_mutex);
+
+	if (!disconnected(mirror)) {
+		added_packet = (packet.type == OBS_ENCODER_VIDEO)
+				       ? add_video_packet(mirror, &packet)
+				       : add_packet(mirror, &packet);
+	}
+
+	pthread_mutex_unlock(&mirror->packets_mutex);
+
+	if (added_packet)
+		os_sem_post(mirror->send_sem);
+	else
+		obs_encoder_packet_release(&packet);
+}
+
 static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 {
 	struct rtmp_stream *stream = data;
 	struct encoder_packet new_packet;
+	struct encoder_packet tag;
 	bool added_packet = false;
 
-	if (disconnected(stream) || !active(stream))
+	/* while the output reconnects on its own, the additional
+	 * destinations are still fed */
+	bool own = !disconnected(stream) && active(stream);
+	bool mirrors_only = os_atomic_load_bool(&stream->mirrors_only);
+	if (!own && !mirrors_only)
 		return;
 
 	/* encoder fail */
 	if (!packet) {
+		for (size_t i = 0; i < stream->mirrors.num; i++) {
+			struct rtmp_stream *mirror = stream->mirrors.array[i];
+			os_atomic_set_bool(&mirror->encode_error, true);
+			os_sem_post(mirror->send_sem);
+		}
+
 		os_atomic_set_bool(&stream->encode_error, true);
 		os_sem_post(stream->send_sem);
+
+		if (mirrors_only) {
+			os_event_signal(stream->retry_event);
+			signal_stop(stream, OBS_OUTPUT_ENCODE_ERROR);
+		}
 		return;
 	}
 
@@ -1776,12 +2332,23 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 		obs_encoder_packet_ref(&new_packet, packet);
 	}
 
+	serialize_packet(stream, &tag, &new_packet);
+
+	for (size_t i = 0; i < stream->mirrors.num; i++)
+		mirror_packet(stream->mirrors.array[i], &tag);
+
+	/* after reconnecting, the output rejoins at a keyframe */
+	if (!own || !join_at_keyframe(stream, &tag, stream->start_dts_offset)) {
+		obs_encoder_packet_release(&tag);
+		return;
+	}
+
 	pthread_mutex_lock(&stream->packets_mutex);
 
 	if (!disconnected(stream)) {
 		added_packet = (packet->type == OBS_ENCODER_VIDEO)
-				       ? add_video_packet(stream, &new_packet)
-				       : add_packet(stream, &new_packet);
+				       ? add_video_packet(stream, &tag)
+				       : add_packet(stream, &tag);
 	}
 
 	pthread_mutex_unlock(&stream->packets_mutex);
@@ -1789,7 +2356,7 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 	if (added_packet)
 		os_sem_post(stream->send_sem);
 	else
-		obs_encoder_packet_release(&new_packet);
+		obs_encoder_packet_release(&tag);
 }
 
 static void rtmp_stream_defaults(obs_data_t *defaults)
@@ -1798,7 +2365,7 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
 	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__linux__)
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
 #endif
@@ -1843,7 +2410,7 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 	}
 	netif_saddr_data_free(&addrs);
 
-#ifdef _WIN32
+#if defined(_WIN32) || defined(__linux__)
 	obs_properties_add_bool(props, OPT_NEWSOCKETLOOP_ENABLED,
 				obs_module_text("RTMPStream.NewSocketLoop"));
 	obs_properties_add_bool(props, OPT_LOWLATENCY_ENABLED,
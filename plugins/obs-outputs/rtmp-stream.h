@@ -1,6 +1,7 @@
 #include <obs-module.h>
 #include <util/platform.h>
 #include <util/deque.h>
+#include <util/darray.h>
 #include <util/dstr.h>
 #include <util/threading.h>
 #include <inttypes.h>
@@ -8,6 +9,7 @@
 #include "librtmp/log.h"
 #include "flv-mux.h"
 #include "net-if.h"
+#include "rtmp-abr.h"
 
 #ifdef _WIN32
 #include <Iphlpapi.h>
@@ -32,6 +34,7 @@
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
 #define OPT_LOWLATENCY_ENABLED "low_latency_mode_enabled"
 #define OPT_METADATA_MULTITRACK "metadata_multitrack"
+#define OPT_EXTRA_DESTINATIONS "extra_destinations"
 
 //#define TEST_FRAMEDROPS
 //#define TEST_FRAMEDROPS_WITH_BITRATE_SHORTCUTS
@@ -113,6 +116,9 @@ struct rtmp_stream {
 	long dbr_cur_bitrate;
 	long dbr_inc_bitrate;
 	bool dbr_enabled;
+	/* whether the send thread measures throughput for dynamic bitrate,
+	 * set before it starts */
+	bool dbr_send_measure;
 
 	enum video_id_t video_codec[MAX_OUTPUT_VIDEO_ENCODERS];
 
@@ -131,10 +137,47 @@ struct rtmp_stream {
 	os_event_t *buffer_has_data_event;
 	os_event_t *socket_available_event;
 	os_event_t *send_thread_signaled_exit;
+
+	/* socket thread wakeup (eventfd) and TCP_INFO samples, Linux only */
+	int wake_fd;
+	volatile long tcp_rtt_ms;
+	volatile long tcp_unsent_bytes;
+
+	/* dynamic bitrate driven by the TCP statistics, the controller is
+	 * only used by the socket thread */
+	bool abr_enabled;
+	struct rtmp_abr abr;
+	volatile long abr_bitrate;
+
+	/* Additional destinations receiving the same serialized FLV tags.
+	 * Each one is a stream of its own with its own connection, queue and
+	 * frame drop state, but has no say over the output itself. */
+	DARRAY(struct rtmp_stream *) mirrors;
+	struct rtmp_stream *parent;
+	volatile bool waiting_keyframe;
+	bool send_thread_started;
+
+	/* the output's own connection dropped while additional destinations
+	 * were still streaming.  data capture goes on for them, and the
+	 * connection is retried here rather than by libobs until they stop.
+	 * retry_event cuts the wait between attempts short on stop. */
+	volatile bool mirrors_only;
+	os_event_t *retry_event;
+
+	/* a destination starts at its first keyframe, the parent's tag
+	 * timestamps are moved back by this many milliseconds */
+	int32_t tag_ts_shift;
 };
 
+void dbr_add_frame(struct rtmp_stream *stream, struct dbr_frame *back);
+
 #ifdef _WIN32
 void *socket_thread_windows(void *data);
+#elif defined(__linux__)
+void *socket_thread_linux(void *data);
+void socket_thread_linux_wake(struct rtmp_stream *stream);
+bool socket_thread_linux_init(struct rtmp_stream *stream);
+void socket_thread_linux_free(struct rtmp_stream *stream);
 #endif
 
 /* Adapted from FFmpeg's libavutil/pixfmt.h
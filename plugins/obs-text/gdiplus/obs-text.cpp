@@ -647,6 +647,8 @@ void TextSource::RenderText()
 		gs_texture_set_image(tex, bits.get(), size.cx * 4, false);
 		obs_leave_graphics();
 	}
+
+	obs_source_mark_dirty(source);
 }
 
 const char *TextSource::GetMainString(const char *str)
@@ -1132,7 +1134,8 @@ bool obs_module_load(void)
 	si.id = "text_gdiplus";
 	si.type = OBS_SOURCE_TYPE_INPUT;
 	si.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			  OBS_SOURCE_CAP_OBSOLETE | OBS_SOURCE_SRGB;
+			  OBS_SOURCE_CAP_OBSOLETE | OBS_SOURCE_SRGB |
+			  OBS_SOURCE_STATIC_CONTENT;
 	si.get_properties = get_properties;
 	si.icon_type = OBS_ICON_TYPE_TEXT;
 
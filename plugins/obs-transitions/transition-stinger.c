@@ -20,6 +20,13 @@ struct stinger_info {
 	obs_source_t *media_source;
 	obs_source_t *matte_source;
 
+	/* settings the media sources were created with */
+	struct dstr media_path;
+	struct dstr matte_path;
+	bool media_hw_decode;
+	bool media_preload;
+	bool media_is_track_matte;
+
 	uint64_t duration_ns;
 	uint64_t duration_frames;
 	uint64_t transition_point_ns;
@@ -64,13 +71,10 @@ static float mix_b_fade_in_out(void *data, float t);
 static float mix_a_cross_fade(void *data, float t);
 static float mix_b_cross_fade(void *data, float t);
 
-static void stinger_update(void *data, obs_data_t *settings)
+static void stinger_create_media_source(struct stinger_info *s,
+					const char *path, bool hw_decode,
+					bool preload)
 {
-	struct stinger_info *s = data;
-	const char *path = obs_data_get_string(settings, "path");
-	bool hw_decode = obs_data_get_bool(settings, "hw_decode");
-	bool preload = obs_data_get_bool(settings, "preload");
-
 	obs_data_t *media_settings = obs_data_create();
 	obs_data_set_string(media_settings, "local_file", path);
 	obs_data_set_bool(media_settings, "hw_decode", hw_decode);
@@ -89,6 +93,50 @@ static void stinger_update(void *data, obs_data_t *settings)
 	dstr_free(&name);
 	obs_data_release(media_settings);
 
+	dstr_copy(&s->media_path, path);
+	s->media_is_track_matte = s->track_matte_enabled;
+}
+
+static void stinger_create_matte_source(struct stinger_info *s,
+					const char *tm_path, bool preload)
+{
+	if (s->matte_source) {
+		obs_source_release(s->matte_source);
+		s->matte_source = NULL;
+	}
+
+	dstr_copy(&s->matte_path, tm_path);
+
+	if (!tm_path || !*tm_path)
+		return;
+
+	obs_data_t *tm_media_settings = obs_data_create();
+	obs_data_set_string(tm_media_settings, "local_file", tm_path);
+	obs_data_set_bool(tm_media_settings, "looping", false);
+	obs_data_set_bool(tm_media_settings, "full_decode", preload);
+
+	s->matte_source = obs_source_create_private("ffmpeg_source", NULL,
+						    tm_media_settings);
+	obs_data_release(tm_media_settings);
+
+	// no need to output sound from the matte video
+	obs_source_set_muted(s->matte_source, true);
+}
+
+static inline bool path_changed(const struct dstr *old_path,
+				const char *new_path)
+{
+	const char *old_str = old_path->array ? old_path->array : "";
+	return strcmp(old_str, new_path ? new_path : "") != 0;
+}
+
+static void stinger_update(void *data, obs_data_t *settings)
+{
+	struct stinger_info *s = data;
+	const char *path = obs_data_get_string(settings, "path");
+	bool hw_decode = obs_data_get_bool(settings, "hw_decode");
+	bool preload = obs_data_get_bool(settings, "preload");
+
 	int64_t point = obs_data_get_int(settings, "transition_point");
 
 	s->transition_point_is_frame = obs_data_get_int(settings, "tp_type") ==
@@ -113,27 +161,29 @@ static void stinger_update(void *data, obs_data_t *settings)
 	s->do_texrender = s->track_matte_enabled &&
 			  s->matte_layout < MATTE_LAYOUT_SEPARATE_FILE;
 
-	if (s->matte_source) {
-		obs_source_release(s->matte_source);
-		s->matte_source = NULL;
-	}
-
+	const char *tm_path = NULL;
 	if (s->track_matte_enabled &&
-	    s->matte_layout == MATTE_LAYOUT_SEPARATE_FILE) {
-		const char *tm_path =
-			obs_data_get_string(settings, "track_matte_path");
+	    s->matte_layout == MATTE_LAYOUT_SEPARATE_FILE)
+		tm_path = obs_data_get_string(settings, "track_matte_path");
 
-		obs_data_t *tm_media_settings = obs_data_create();
-		obs_data_set_string(tm_media_settings, "local_file", tm_path);
-		obs_data_set_bool(tm_media_settings, "looping", false);
+	/* A preloaded stinger and its matte are decoded once when their media
+	 * sources are created and then play from memory, so only recreate
+	 * them if a setting they were created with changed.  The decoded
+	 * frames are freed with the transition, when the scene collection is
+	 * unloaded. */
+	bool decode_changed = hw_decode != s->media_hw_decode ||
+			      preload != s->media_preload;
 
-		s->matte_source = obs_source_create_private(
-			"ffmpeg_source", NULL, tm_media_settings);
-		obs_data_release(tm_media_settings);
+	if (!s->media_source || decode_changed ||
+	    path_changed(&s->media_path, path) ||
+	    s->track_matte_enabled != s->media_is_track_matte)
+		stinger_create_media_source(s, path, hw_decode, preload);
 
-		// no need to output sound from the matte video
-		obs_source_set_muted(s->matte_source, true);
-	}
+	if (decode_changed || path_changed(&s->matte_path, tm_path))
+		stinger_create_matte_source(s, tm_path, preload);
+
+	s->media_hw_decode = hw_decode;
+	s->media_preload = preload;
 
 	s->monitoring_type =
 		(int)obs_data_get_int(settings, "audio_monitoring");
@@ -215,6 +265,8 @@ static void stinger_destroy(void *data)
 	struct stinger_info *s = data;
 	obs_source_release(s->media_source);
 	obs_source_release(s->matte_source);
+	dstr_free(&s->media_path);
+	dstr_free(&s->matte_path);
 
 	obs_enter_graphics();
 
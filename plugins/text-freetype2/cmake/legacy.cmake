@@ -12,8 +12,16 @@ find_package(Freetype REQUIRED)
 add_library(text-freetype2 MODULE)
 add_library(OBS::text-freetype2 ALIAS text-freetype2)
 
-target_sources(text-freetype2 PRIVATE find-font.h obs-convenience.c text-functionality.c text-freetype2.c
-                                      obs-convenience.h text-freetype2.h)
+target_sources(
+  text-freetype2
+  PRIVATE find-font.h
+          font-cache.c
+          font-cache.h
+          obs-convenience.c
+          text-functionality.c
+          text-freetype2.c
+          obs-convenience.h
+          text-freetype2.h)
 
 target_link_libraries(text-freetype2 PRIVATE OBS::libobs Freetype::Freetype)
 
@@ -0,0 +1,358 @@
+/******************************************************************************
+Copyright (C) 2014 by Nibbles
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/bmem.h>
+#include "font-cache.h"
+
+extern FT_Library ft2_lib;
+extern uint32_t texbuf_w, texbuf_h;
+
+static pthread_mutex_t fonts_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ft2_font *first_font = NULL;
+
+/* shelves are only reused for glyphs at least this tall relative to them */
+#define SHELF_WASTE_DIV 4
+
+static struct ft2_font *find_font(const char *path, FT_Long index,
+				  uint16_t size, FT_Render_Mode render_mode)
+{
+	struct ft2_font *font = first_font;
+
+	while (font) {
+		if (font->index == index && font->size == size &&
+		    font->render_mode == render_mode &&
+		    strcmp(font->path, path) == 0)
+			return font;
+
+		font = font->next;
+	}
+
+	return NULL;
+}
+
+struct ft2_font *ft2_font_acquire(const char *path, FT_Long index,
+				  uint16_t size, FT_Render_Mode render_mode)
+{
+	struct ft2_font *font;
+	FT_Face face;
+
+	if (!path)
+		return NULL;
+
+	/* faces are created and destroyed under the lock as well, the
+	 * library must not be used from several threads at once */
+	pthread_mutex_lock(&fonts_mutex);
+
+	font = find_font(path, index, size, render_mode);
+	if (font) {
+		font->refs++;
+		goto unlock;
+	}
+
+	if (FT_New_Face(ft2_lib, path, index, &face) != 0)
+		goto unlock;
+
+	FT_Set_Pixel_Sizes(face, 0, size);
+	FT_Select_Charmap(face, FT_ENCODING_UNICODE);
+
+	font = bzalloc(sizeof(*font));
+	font->refs = 1;
+	font->path = bstrdup(path);
+	font->index = index;
+	font->size = size;
+	font->render_mode = render_mode;
+	font->face = face;
+	font->texbuf = bzalloc((size_t)texbuf_w * texbuf_h);
+	font->dirty_x = texbuf_w;
+	font->dirty_y = texbuf_h;
+	pthread_mutex_init(&font->mutex, NULL);
+
+	font->next = first_font;
+	font->prev_next = &first_font;
+	if (first_font)
+		first_font->prev_next = &font->next;
+	first_font = font;
+
+unlock:
+	pthread_mutex_unlock(&fonts_mutex);
+	return font;
+}
+
+void ft2_font_release(struct ft2_font *font)
+{
+	if (!font)
+		return;
+
+	pthread_mutex_lock(&fonts_mutex);
+
+	if (--font->refs > 0) {
+		pthread_mutex_unlock(&fonts_mutex);
+		return;
+	}
+
+	*font->prev_next = font->next;
+	if (font->next)
+		font->next->prev_next = font->prev_next;
+
+	FT_Done_Face(font->face);
+	pthread_mutex_unlock(&fonts_mutex);
+
+	for (uint32_t i = 0; i < num_cache_slots; i++)
+		bfree(font->glyphs[i]);
+
+	obs_enter_graphics();
+	gs_texture_destroy(font->tex);
+	obs_leave_graphics();
+
+	pthread_mutex_destroy(&font->mutex);
+	da_free(font->shelves);
+	bfree(font->texbuf);
+	bfree(font->path);
+	bfree(font);
+}
+
+void ft2_font_load_glyph(struct ft2_font *font, FT_UInt glyph_index)
+{
+	const FT_Int32 load_mode = font->render_mode == FT_RENDER_MODE_MONO
+					   ? FT_LOAD_TARGET_MONO
+					   : FT_LOAD_DEFAULT;
+	FT_Load_Glyph(font->face, glyph_index, load_mode);
+}
+
+static inline void mark_dirty(struct ft2_font *font, uint32_t x, uint32_t y,
+			      uint32_t w, uint32_t h)
+{
+	if (x < font->dirty_x)
+		font->dirty_x = x;
+	if (y < font->dirty_y)
+		font->dirty_y = y;
+	if (x + w > font->dirty_x2)
+		font->dirty_x2 = x + w;
+	if (y + h > font->dirty_y2)
+		font->dirty_y2 = y + h;
+}
+
+static void evict_shelf(struct ft2_font *font, uint32_t idx)
+{
+	struct atlas_shelf *shelf = font->shelves.array + idx;
+
+	for (uint32_t i = 0; i < num_cache_slots; i++) {
+		struct glyph_info *glyph = font->glyphs[i];
+		if (glyph && glyph->shelf == idx) {
+			bfree(glyph);
+			font->glyphs[i] = NULL;
+		}
+	}
+
+	memset(font->texbuf + (size_t)shelf->y * texbuf_w, 0,
+	       (size_t)shelf->h * texbuf_w);
+	mark_dirty(font, 0, shelf->y, texbuf_w, shelf->h);
+	shelf->x = 0;
+}
+
+/* finds room for a glyph: the tightest shelf with space left, then a new
+ * shelf, then the least recently used shelf no source references */
+static int alloc_glyph(struct ft2_font *font, uint32_t g_w, uint32_t g_h)
+{
+	struct atlas_shelf *shelves = font->shelves.array;
+	const size_t count = font->shelves.num;
+	int best = -1;
+
+	if (g_w >= texbuf_w || g_h >= texbuf_h)
+		return -1;
+
+	for (size_t i = 0; i < count; i++) {
+		if (shelves[i].h < g_h ||
+		    shelves[i].h - g_h > shelves[i].h / SHELF_WASTE_DIV)
+			continue;
+		if (shelves[i].x + g_w >= texbuf_w)
+			continue;
+		if (best == -1 || shelves[i].h < shelves[best].h)
+			best = (int)i;
+	}
+
+	if (best != -1)
+		return best;
+
+	if (font->next_shelf_y + g_h < texbuf_h) {
+		struct atlas_shelf *shelf = da_push_back_new(font->shelves);
+		shelf->y = font->next_shelf_y;
+		shelf->h = g_h;
+		font->next_shelf_y += g_h + 1;
+		return (int)(font->shelves.num - 1);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (shelves[i].h < g_h || shelves[i].x + g_w >= texbuf_w)
+			continue;
+		if (best == -1 || shelves[i].h < shelves[best].h)
+			best = (int)i;
+	}
+
+	if (best != -1)
+		return best;
+
+	for (size_t i = 0; i < count; i++) {
+		if (shelves[i].refs || shelves[i].h < g_h)
+			continue;
+		if (best == -1 ||
+		    shelves[i].last_used < shelves[best].last_used)
+			best = (int)i;
+	}
+
+	if (best != -1)
+		evict_shelf(font, (uint32_t)best);
+	return best;
+}
+
+static inline uint8_t get_pixel_value(const unsigned char *buf_row,
+				      FT_Render_Mode render_mode,
+				      const uint32_t x)
+{
+	if (render_mode == FT_RENDER_MODE_NORMAL) {
+		return buf_row[x];
+	}
+
+	const uint32_t byte_index = x / 8;
+	const uint8_t bit_index = x % 8;
+	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
+	return pixel_set ? 255 : 0;
+}
+
+static void rasterize(struct ft2_font *font, FT_GlyphSlot slot,
+		      const uint32_t dx, const uint32_t dy)
+{
+	/**
+	 * The pitch's absolute value is the number of bytes taken by one bitmap
+	 * row, including padding.
+	 *
+	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
+	 */
+	const int pitch = abs(slot->bitmap.pitch);
+
+	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
+		const uint32_t row_start = y * pitch;
+		const uint32_t row = (dy + y) * texbuf_w;
+
+		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
+			const uint32_t row_pixel_position = dx + x;
+			const uint8_t pixel_value =
+				get_pixel_value(&slot->bitmap.buffer[row_start],
+						font->render_mode, x);
+			font->texbuf[row_pixel_position + row] = pixel_value;
+		}
+	}
+}
+
+struct glyph_info *ft2_font_cache_glyph(struct ft2_font *font,
+					FT_UInt glyph_index)
+{
+	FT_GlyphSlot slot = font->face->glyph;
+	struct glyph_info *glyph;
+	struct atlas_shelf *shelf;
+	int idx;
+
+	if (glyph_index >= num_cache_slots)
+		return NULL;
+	if (font->glyphs[glyph_index])
+		return font->glyphs[glyph_index];
+
+	ft2_font_load_glyph(font, glyph_index);
+	FT_Render_Glyph(slot, font->render_mode);
+
+	const uint32_t g_w = slot->bitmap.width;
+	const uint32_t g_h = slot->bitmap.rows;
+
+	idx = alloc_glyph(font, g_w, g_h);
+	if (idx == -1)
+		return NULL;
+
+	shelf = font->shelves.array + idx;
+
+	glyph = bzalloc(sizeof(struct glyph_info));
+	glyph->u = (float)shelf->x / (float)texbuf_w;
+	glyph->u2 = (float)(shelf->x + g_w) / (float)texbuf_w;
+	glyph->v = (float)shelf->y / (float)texbuf_h;
+	glyph->v2 = (float)(shelf->y + g_h) / (float)texbuf_h;
+	glyph->w = g_w;
+	glyph->h = g_h;
+	glyph->yoff = slot->bitmap_top;
+	glyph->xoff = slot->bitmap_left;
+	glyph->xadv = slot->advance.x >> 6;
+	glyph->shelf = (uint32_t)idx;
+
+	rasterize(font, slot, shelf->x, shelf->y);
+	mark_dirty(font, shelf->x, shelf->y, g_w, g_h);
+
+	shelf->x += g_w + 1;
+	shelf->last_used = font->pass;
+
+	font->glyphs[glyph_index] = glyph;
+	return glyph;
+}
+
+void ft2_font_ref_glyph(struct ft2_font *font, struct glyph_info *glyph)
+{
+	struct atlas_shelf *shelf = font->shelves.array + glyph->shelf;
+
+	glyph->refs++;
+	shelf->refs++;
+	shelf->last_used = font->pass;
+}
+
+void ft2_font_unref_glyph(struct ft2_font *font, FT_UInt glyph_index)
+{
+	struct glyph_info *glyph = font->glyphs[glyph_index];
+	if (!glyph || !glyph->refs)
+		return;
+
+	glyph->refs--;
+	font->shelves.array[glyph->shelf].refs--;
+}
+
+void ft2_font_upload(struct ft2_font *font)
+{
+	const uint32_t x = font->dirty_x;
+	const uint32_t y = font->dirty_y;
+	bool updated = false;
+
+	if (font->tex && (x >= font->dirty_x2 || y >= font->dirty_y2))
+		return;
+
+	obs_enter_graphics();
+
+	if (font->tex) {
+		updated = gs_texture_set_image_region(
+			font->tex, font->texbuf + (size_t)y * texbuf_w + x,
+			texbuf_w, x, y, font->dirty_x2 - x,
+			font->dirty_y2 - y);
+	}
+
+	if (!updated) {
+		gs_texture_destroy(font->tex);
+		font->tex = gs_texture_create(texbuf_w, texbuf_h, GS_A8, 1,
+					      (const uint8_t **)&font->texbuf,
+					      0);
+	}
+
+	obs_leave_graphics();
+
+	font->dirty_x = texbuf_w;
+	font->dirty_y = texbuf_h;
+	font->dirty_x2 = 0;
+	font->dirty_y2 = 0;
+}
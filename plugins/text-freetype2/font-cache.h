@@ -0,0 +1,91 @@
+/******************************************************************************
+Copyright (C) 2014 by Nibbles
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#define num_cache_slots 65535
+
+struct glyph_info {
+	float u, v, u2, v2;
+	int32_t w, h, xoff, yoff;
+	FT_Pos xadv;
+
+	/* atlas bookkeeping, protected by the font mutex */
+	uint32_t shelf;
+	uint32_t refs;
+	uint64_t pass;
+};
+
+/* a row of the atlas, glyphs are evicted a whole row at a time */
+struct atlas_shelf {
+	uint32_t y, h;
+	uint32_t x; /* start of the free space */
+	uint32_t refs;
+	uint64_t last_used;
+};
+
+/* A font face at one size and render mode, shared by all text sources that
+ * use it, along with the atlas its glyphs are rendered into.  Glyphs that
+ * no source references are evicted when the atlas is full, least recently
+ * used first. */
+struct ft2_font {
+	struct ft2_font *next;
+	struct ft2_font **prev_next;
+	long refs;
+
+	char *path;
+	FT_Long index;
+	uint16_t size;
+	FT_Render_Mode render_mode;
+
+	pthread_mutex_t mutex; /* protects everything below and the face */
+	FT_Face face;
+	struct glyph_info *glyphs[num_cache_slots];
+	uint64_t pass;
+
+	uint8_t *texbuf;
+	gs_texture_t *tex;
+	DARRAY(struct atlas_shelf) shelves;
+	uint32_t next_shelf_y;
+	uint32_t dirty_x, dirty_y, dirty_x2, dirty_y2;
+};
+
+extern struct ft2_font *ft2_font_acquire(const char *path, FT_Long index,
+					 uint16_t size,
+					 FT_Render_Mode render_mode);
+extern void ft2_font_release(struct ft2_font *font);
+
+/* the following must be called with the font mutex locked */
+
+extern void ft2_font_load_glyph(struct ft2_font *font, FT_UInt glyph_index);
+
+/* Renders a glyph into the atlas, returns NULL if it does not fit */
+extern struct glyph_info *ft2_font_cache_glyph(struct ft2_font *font,
+					       FT_UInt glyph_index);
+
+extern void ft2_font_ref_glyph(struct ft2_font *font,
+			       struct glyph_info *glyph);
+extern void ft2_font_unref_glyph(struct ft2_font *font, FT_UInt glyph_index);
+
+/* Uploads the part of the atlas that changed to the texture */
+extern void ft2_font_upload(struct ft2_font *font);
@@ -19,7 +19,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/platform.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 #include "find-font.h"
@@ -39,7 +38,7 @@ static struct obs_source_info freetype2_source_info_v1 = {
 	.id = "text_ft2_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_STATIC_CONTENT,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create,
 	.destroy = ft2_source_destroy,
@@ -61,7 +60,7 @@ static struct obs_source_info freetype2_source_info_v2 = {
 #ifdef _WIN32
 			OBS_SOURCE_DEPRECATED |
 #endif
-			OBS_SOURCE_CUSTOM_DRAW,
+			OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_STATIC_CONTENT,
 	.get_name = ft2_source_get_name,
 	.create = ft2_source_create,
 	.destroy = ft2_source_destroy,
@@ -220,17 +219,12 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	ft2_set_file_watch(srcdata, NULL);
+	pthread_mutex_destroy(&srcdata->text_mutex);
 
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	release_glyphs(srcdata);
+	ft2_font_release(srcdata->font);
+	srcdata->font = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -238,17 +232,11 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -269,7 +257,7 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata == NULL)
 		return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL)
+	if (!srcdata->font || !srcdata->font->tex || !srcdata->vbuf)
 		return;
 	if (srcdata->text == NULL || *srcdata->text == 0)
 		return;
@@ -280,7 +268,7 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata->drop_shadow)
 		draw_drop_shadow(srcdata);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->font->tex, srcdata->draw_effect,
 			(uint32_t)wcslen(srcdata->text) * 6, true);
 
 	UNUSED_PARAMETER(effect);
@@ -289,35 +277,75 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 static void ft2_video_tick(void *data, float seconds)
 {
 	struct ft2_source *srcdata = data;
+	wchar_t *text;
+
 	if (srcdata == NULL)
 		return;
-	if (!srcdata->from_file || !srcdata->text_file)
-		return;
 
-	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
-		srcdata->last_checked = os_gettime_ns();
-
-		if (srcdata->update_file) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata,
-						    srcdata->text_file);
-			cache_glyphs(srcdata, srcdata->text);
-			set_up_vertex_buffer(srcdata);
-			srcdata->update_file = false;
-		}
+	pthread_mutex_lock(&srcdata->text_mutex);
+	text = srcdata->loaded_text;
+	srcdata->loaded_text = NULL;
+	pthread_mutex_unlock(&srcdata->text_mutex);
 
-		if (srcdata->m_timestamp != t) {
-			srcdata->m_timestamp = t;
-			srcdata->update_file = true;
-		}
+	if (!text)
+		return;
+
+	/* only rebuild when the text actually changed */
+	if (srcdata->text && wcscmp(srcdata->text, text) == 0) {
+		bfree(text);
+		return;
 	}
 
+	bfree(srcdata->text);
+	srcdata->text = text;
+
+	cache_glyphs(srcdata, srcdata->text);
+	set_up_vertex_buffer(srcdata);
+
 	UNUSED_PARAMETER(seconds);
 }
 
+/* called from the file watch thread, the text is swapped in on the next
+ * tick */
+static void ft2_text_file_changed(void *data, const char *path)
+{
+	struct ft2_file_watch *watch = data;
+	struct ft2_source *srcdata = watch->srcdata;
+	bool *failed = &watch->load_failed;
+	wchar_t *text = watch->log_mode
+				? read_from_end(path, watch->log_lines, failed)
+				: load_text_from_file(path, failed);
+	if (!text)
+		return;
+
+	pthread_mutex_lock(&srcdata->text_mutex);
+	bfree(srcdata->loaded_text);
+	srcdata->loaded_text = text;
+	pthread_mutex_unlock(&srcdata->text_mutex);
+}
+
+static void ft2_set_file_watch(struct ft2_source *srcdata, const char *path)
+{
+	os_file_watch_destroy(srcdata->file_watch);
+
+	/* the settings may change while the callback runs, so it works
+	 * with a copy of them that is only replaced without a watch */
+	srcdata->watch_data.srcdata = srcdata;
+	srcdata->watch_data.log_mode = srcdata->log_mode;
+	srcdata->watch_data.log_lines = srcdata->log_lines;
+	srcdata->watch_data.load_failed = false;
+
+	srcdata->file_watch =
+		path ? os_file_watch_create(path, ft2_text_file_changed,
+					    &srcdata->watch_data)
+		     : NULL;
+
+	pthread_mutex_lock(&srcdata->text_mutex);
+	bfree(srcdata->loaded_text);
+	srcdata->loaded_text = NULL;
+	pthread_mutex_unlock(&srcdata->text_mutex);
+}
+
 static bool init_font(struct ft2_source *srcdata)
 {
 	FT_Long index;
@@ -327,12 +355,12 @@ static bool init_font(struct ft2_source *srcdata)
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	release_glyphs(srcdata);
+	ft2_font_release(srcdata->font);
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	srcdata->font = ft2_font_acquire(path, index, srcdata->font_size,
+					 get_render_mode(srcdata));
+	return srcdata->font != NULL;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -406,8 +434,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (ft2_lib == NULL)
 		goto error;
 
-	const size_t texbuf_size = (size_t)texbuf_w * (size_t)texbuf_h;
-
 	if (srcdata->draw_effect == NULL) {
 		char *effect_file = NULL;
 		char *error_string = NULL;
@@ -431,13 +457,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 
 	const bool new_aa_setting = obs_data_get_bool(settings, "antialiasing");
 	const bool aa_changed = srcdata->antialiasing != new_aa_setting;
-	if (aa_changed) {
-		srcdata->antialiasing = new_aa_setting;
-		if (srcdata->texbuf != NULL) {
-			memset(srcdata->texbuf, 0, texbuf_size);
-		}
-		cache_standard_glyphs(srcdata);
-	}
+	srcdata->antialiasing = new_aa_setting;
 
 	srcdata->file_load_failed = false;
 	srcdata->from_file = from_file;
@@ -446,7 +466,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 		if (strcmp(font_name, srcdata->font_name) == 0 &&
 		    strcmp(font_style, srcdata->font_style) == 0 &&
 		    font_flags == srcdata->font_flags &&
-		    font_size == srcdata->font_size)
+		    font_size == srcdata->font_size && !aa_changed)
 			goto skip_font_load;
 
 		bfree(srcdata->font_name);
@@ -462,23 +482,13 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	srcdata->font_size = font_size;
 	srcdata->font_flags = font_flags;
 
-	if (!init_font(srcdata) || srcdata->font_face == NULL) {
+	if (!init_font(srcdata)) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s",
 		     srcdata->font_name);
 		goto error;
-	} else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size);
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
 	}
 
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_size);
-
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
+	cache_standard_glyphs(srcdata);
 
 skip_font_load:
 	if (from_file) {
@@ -487,6 +497,8 @@ skip_font_load:
 		if (!tmp || !*tmp || !os_file_exists(tmp)) {
 			const char *emptystr = " ";
 
+			ft2_set_file_watch(srcdata, NULL);
+
 			bfree(srcdata->text);
 			srcdata->text = NULL;
 
@@ -505,14 +517,22 @@ skip_font_load:
 			bfree(srcdata->text_file);
 
 			srcdata->text_file = bstrdup(tmp);
-			if (chat_log_mode)
-				read_from_end(srcdata, tmp);
-			else
-				load_text_from_file(srcdata, tmp);
-			srcdata->last_checked = os_gettime_ns();
+			ft2_set_file_watch(srcdata, tmp);
+
+			bool *failed = &srcdata->file_load_failed;
+			wchar_t *text =
+				chat_log_mode
+					? read_from_end(tmp, log_lines, failed)
+					: load_text_from_file(tmp, failed);
+			if (text) {
+				bfree(srcdata->text);
+				srcdata->text = text;
+			}
 		}
 	} else {
 		const char *tmp = obs_data_get_string(settings, "text");
+
+		ft2_set_file_watch(srcdata, NULL);
 		if (!tmp)
 			goto error;
 
@@ -524,7 +544,7 @@ skip_font_load:
 		os_utf8_to_wcs_ptr(tmp, strlen(tmp), &srcdata->text);
 	}
 
-	if (srcdata->font_face) {
+	if (srcdata->font) {
 		cache_glyphs(srcdata, srcdata->text);
 		set_up_vertex_buffer(srcdata);
 	}
@@ -545,6 +565,7 @@ static void *ft2_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct ft2_source *srcdata = bzalloc(sizeof(struct ft2_source));
 	srcdata->src = source;
+	pthread_mutex_init(&srcdata->text_mutex, NULL);
 
 	init_plugin();
 
@@ -18,15 +18,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <obs-module.h>
+#include <util/file-watch.h>
+#include <util/threading.h>
 #include <ft2build.h>
+#include "font-cache.h"
 
-#define num_cache_slots 65535
-#define src_glyph srcdata->cacheglyphs[glyph_index]
+#define src_glyph srcdata->font->glyphs[glyph_index]
 
-struct glyph_info {
-	float u, v, u2, v2;
-	int32_t w, h, xoff, yoff;
-	FT_Pos xadv;
+typedef DARRAY(FT_UInt) glyph_index_array_t;
+
+struct ft2_source;
+
+struct ft2_file_watch {
+	struct ft2_source *srcdata;
+	bool log_mode;
+	uint32_t log_lines;
+	bool load_failed;
 };
 
 struct ft2_source {
@@ -40,25 +47,30 @@ struct ft2_source {
 	bool antialiasing;
 	char *text_file;
 	wchar_t *text;
-	time_t m_timestamp;
-	bool update_file;
-	uint64_t last_checked;
+
+	/* text loaded from the file by the file watch callback, which only
+	 * uses the settings the watch was created with */
+	os_file_watch_t *file_watch;
+	struct ft2_file_watch watch_data;
+	pthread_mutex_t text_mutex;
+	wchar_t *loaded_text;
 
 	uint32_t cx, cy, max_h, custom_width;
 	uint32_t outline_width;
-	uint32_t texbuf_x, texbuf_y;
 	uint32_t color[2];
 
 	int32_t cur_scroll, scroll_speed;
 
-	gs_texture_t *tex;
-
-	struct glyph_info *cacheglyphs[num_cache_slots];
+	struct ft2_font *font;
 
-	FT_Face font_face;
+	/* glyphs of the text, referenced so that they stay in the atlas.
+	 * the previous text's glyphs are kept until the vertex buffer is
+	 * rebuilt. */
+	glyph_index_array_t glyph_refs;
+	glyph_index_array_t prev_glyph_refs;
 
-	uint8_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	uint32_t vbuf_verts;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -75,6 +87,7 @@ static void ft2_source_destroy(void *data);
 static void ft2_source_update(void *data, obs_data_t *settings);
 static void ft2_source_render(void *data, gs_effect_t *effect);
 static void ft2_video_tick(void *data, float seconds);
+static void ft2_set_file_watch(struct ft2_source *srcdata, const char *path);
 
 void draw_outlines(struct ft2_source *srcdata);
 void draw_drop_shadow(struct ft2_source *srcdata);
@@ -93,12 +106,14 @@ static obs_missing_files_t *ft2_missing_files(void *data);
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata);
 
-time_t get_modified_timestamp(char *filename);
-void load_text_from_file(struct ft2_source *srcdata, const char *filename);
-void read_from_end(struct ft2_source *srcdata, const char *filename);
+wchar_t *load_text_from_file(const char *filename, bool *load_failed);
+wchar_t *read_from_end(const char *filename, uint32_t log_lines,
+		       bool *load_failed);
 
+FT_Render_Mode get_render_mode(struct ft2_source *srcdata);
 void cache_standard_glyphs(struct ft2_source *srcdata);
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs);
+void release_glyphs(struct ft2_source *srcdata);
 
 void set_up_vertex_buffer(struct ft2_source *srcdata);
 void fill_vertex_buffer(struct ft2_source *srcdata);
@@ -19,15 +19,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/platform.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 
 float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 		     0.0f,  2.0f, 0.0f, 2.0f,  -2.0f, 0.0f, -2.0f, 0.0f};
 
-extern uint32_t texbuf_w, texbuf_h;
-
 void draw_outlines(struct ft2_source *srcdata)
 {
 	if (!srcdata->text)
@@ -37,7 +34,7 @@ void draw_outlines(struct ft2_source *srcdata)
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1],
 				      0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
+		draw_uv_vbuffer(srcdata->vbuf, srcdata->font->tex,
 				srcdata->draw_effect,
 				(uint32_t)wcslen(srcdata->text) * 6, false);
 	}
@@ -52,7 +49,7 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect,
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->font->tex, srcdata->draw_effect,
 			(uint32_t)wcslen(srcdata->text) * 6, false);
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -62,32 +59,36 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 {
 	FT_UInt glyph_index = 0;
 	uint32_t x = 0, space_pos = 0, word_width = 0;
+	uint32_t num_verts;
 	size_t len;
 
-	if (!srcdata->text)
+	if (!srcdata->text || !srcdata->font)
 		return;
 
+	obs_source_mark_dirty(srcdata->src);
+
+	pthread_mutex_lock(&srcdata->font->mutex);
+
 	if (srcdata->custom_width >= 100)
 		srcdata->cx = srcdata->custom_width;
 	else
 		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
 	srcdata->cy = srcdata->max_h;
 
+	if (*srcdata->text == 0)
+		goto done;
+
 	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
 
-	if (*srcdata->text == 0) {
-		obs_leave_graphics();
-		return;
+	/* the vertex buffer is reused while the text fits */
+	num_verts = (uint32_t)wcslen(srcdata->text) * 6;
+	if (srcdata->vbuf_verts < num_verts ||
+	    srcdata->vbuf_verts / 4 > num_verts) {
+		gs_vertexbuffer_destroy(srcdata->vbuf);
+		srcdata->vbuf = create_uv_vbuffer(num_verts, true);
+		srcdata->vbuf_verts = srcdata->vbuf ? num_verts : 0;
 	}
 
-	srcdata->vbuf =
-		create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
-
 	if (srcdata->custom_width <= 100)
 		goto skip_word_wrap;
 	if (!srcdata->word_wrap)
@@ -119,7 +120,7 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 			space_pos = i;
 	next_char:;
 		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
+			FT_Get_Char_Index(srcdata->font->face, srcdata->text[i]);
 		if (src_glyph)
 			word_width += src_glyph->xadv;
 	eos_skip:;
@@ -129,6 +130,15 @@ skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
 	gs_vertexbuffer_flush(srcdata->vbuf);
 	obs_leave_graphics();
+
+done:
+	/* nothing draws the glyphs of the previous text anymore */
+	for (size_t i = 0; i < srcdata->prev_glyph_refs.num; i++)
+		ft2_font_unref_glyph(srcdata->font,
+				     srcdata->prev_glyph_refs.array[i]);
+	da_resize(srcdata->prev_glyph_refs, 0);
+
+	pthread_mutex_unlock(&srcdata->font->mutex);
 }
 
 void fill_vertex_buffer(struct ft2_source *srcdata)
@@ -169,7 +179,7 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 			goto skip_glyph;
 
 		glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, srcdata->text[i]);
+			FT_Get_Char_Index(srcdata->font->face, srcdata->text[i]);
 		if (src_glyph == NULL)
 			goto skip_glyph;
 
@@ -198,185 +208,132 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	skip_glyph:;
 	}
 
+	/* clear what is left over from a longer text */
+	if (cur_glyph * 6 < vdata->num) {
+		const size_t left = vdata->num - cur_glyph * 6;
+		memset(vdata->points + cur_glyph * 6, 0,
+		       left * sizeof(struct vec3));
+	}
+
 	srcdata->cy = max_y;
 }
 
 void cache_standard_glyphs(struct ft2_source *srcdata)
 {
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	const wchar_t *standard = L"abcdefghijklmnopqrstuvwxyz"
+				  L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
+				  L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0";
+	struct ft2_font *font = srcdata->font;
 
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
-
-	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
-			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
-			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
-}
+	if (!font)
+		return;
 
-FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
-{
-	return srcdata->antialiasing ? FT_RENDER_MODE_NORMAL
-				     : FT_RENDER_MODE_MONO;
-}
+	/* cached for the line height, but not referenced */
+	pthread_mutex_lock(&font->mutex);
+	font->pass++;
 
-void load_glyph(struct ft2_source *srcdata, const FT_UInt glyph_index,
-		const FT_Render_Mode render_mode)
-{
-	const FT_Int32 load_mode = render_mode == FT_RENDER_MODE_MONO
-					   ? FT_LOAD_TARGET_MONO
-					   : FT_LOAD_DEFAULT;
-	FT_Load_Glyph(srcdata->font_face, glyph_index, load_mode);
-}
-
-struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx,
-			      const uint32_t dy, const uint32_t g_w,
-			      const uint32_t g_h)
-{
-	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
-	glyph->u = (float)dx / (float)texbuf_w;
-	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-	glyph->v = (float)dy / (float)texbuf_h;
-	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-	glyph->w = g_w;
-	glyph->h = g_h;
-	glyph->yoff = slot->bitmap_top;
-	glyph->xoff = slot->bitmap_left;
-	glyph->xadv = slot->advance.x >> 6;
-
-	return glyph;
-}
+	for (size_t i = 0; standard[i]; i++) {
+		const FT_UInt glyph_index =
+			FT_Get_Char_Index(font->face, standard[i]);
+		struct glyph_info *glyph =
+			ft2_font_cache_glyph(font, glyph_index);
 
-uint8_t get_pixel_value(const unsigned char *buf_row,
-			FT_Render_Mode render_mode, const uint32_t x)
-{
-	if (render_mode == FT_RENDER_MODE_NORMAL) {
-		return buf_row[x];
+		if (glyph && srcdata->max_h < (uint32_t)glyph->h)
+			srcdata->max_h = glyph->h;
 	}
 
-	const uint32_t byte_index = x / 8;
-	const uint8_t bit_index = x % 8;
-	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
-	return pixel_set ? 255 : 0;
+	ft2_font_upload(font);
+	pthread_mutex_unlock(&font->mutex);
 }
 
-void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot,
-	       const FT_Render_Mode render_mode, const uint32_t dx,
-	       const uint32_t dy)
+FT_Render_Mode get_render_mode(struct ft2_source *srcdata)
 {
-	/**
-	 * The pitch's absolute value is the number of bytes taken by one bitmap
-	 * row, including padding.
-	 *
-	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
-	 */
-	const int pitch = abs(slot->bitmap.pitch);
-
-	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
-		const uint32_t row_start = y * pitch;
-		const uint32_t row = (dy + y) * texbuf_w;
-
-		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
-			const uint32_t row_pixel_position = dx + x;
-			const uint8_t pixel_value =
-				get_pixel_value(&slot->bitmap.buffer[row_start],
-						render_mode, x);
-			srcdata->texbuf[row_pixel_position + row] = pixel_value;
-		}
-	}
+	return srcdata->antialiasing ? FT_RENDER_MODE_NORMAL
+				     : FT_RENDER_MODE_MONO;
 }
 
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
 {
-	if (!srcdata->font_face || !cache_glyphs)
-		return;
+	struct ft2_font *font = srcdata->font;
+	glyph_index_array_t refs = {0};
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
-
-	uint32_t dx = srcdata->texbuf_x;
-	uint32_t dy = srcdata->texbuf_y;
+	if (!font || !cache_glyphs)
+		return;
 
-	int32_t cached_glyphs = 0;
 	const size_t len = wcslen(cache_glyphs);
 
-	const FT_Render_Mode render_mode = get_render_mode(srcdata);
+	pthread_mutex_lock(&font->mutex);
+	const uint64_t pass = ++font->pass;
 
+	/* glyphs that are already cached are referenced first, so that they
+	 * cannot be evicted to make room for the new ones */
 	for (size_t i = 0; i < len; i++) {
 		const FT_UInt glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
+			FT_Get_Char_Index(font->face, cache_glyphs[i]);
+		struct glyph_info *glyph = src_glyph;
 
-		if (src_glyph != NULL) {
+		if (!glyph || glyph->pass == pass)
 			continue;
-		}
-
-		load_glyph(srcdata, glyph_index, render_mode);
-		FT_Render_Glyph(slot, render_mode);
 
-		const uint32_t g_w = slot->bitmap.width;
-		const uint32_t g_h = slot->bitmap.rows;
+		ft2_font_ref_glyph(font, glyph);
+		glyph->pass = pass;
+		da_push_back(refs, &glyph_index);
+	}
 
-		if (srcdata->max_h < g_h) {
-			srcdata->max_h = g_h;
-		}
+	for (size_t i = 0; i < len; i++) {
+		const FT_UInt glyph_index =
+			FT_Get_Char_Index(font->face, cache_glyphs[i]);
+		struct glyph_info *glyph = src_glyph;
 
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
-		}
+		if (glyph && glyph->pass == pass)
+			goto update_height;
 
-		if (dy + g_h >= texbuf_h) {
+		glyph = ft2_font_cache_glyph(font, glyph_index);
+		if (!glyph) {
 			blog(LOG_WARNING,
 			     "Out of space trying to render glyphs");
 			break;
 		}
 
-		src_glyph = init_glyph(slot, dx, dy, g_w, g_h);
-		rasterize(srcdata, slot, render_mode, dx, dy);
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
+		ft2_font_ref_glyph(font, glyph);
+		glyph->pass = pass;
+		da_push_back(refs, &glyph_index);
 
-		cached_glyphs++;
+	update_height:
+		if (srcdata->max_h < (uint32_t)glyph->h)
+			srcdata->max_h = glyph->h;
 	}
 
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
+	ft2_font_upload(font);
 
-	if (cached_glyphs > 0) {
+	/* the previous glyphs are released once the vertex buffer no
+	 * longer uses them */
+	for (size_t i = 0; i < srcdata->prev_glyph_refs.num; i++)
+		ft2_font_unref_glyph(font, srcdata->prev_glyph_refs.array[i]);
+	da_free(srcdata->prev_glyph_refs);
+	da_move(srcdata->prev_glyph_refs, srcdata->glyph_refs);
+	da_move(srcdata->glyph_refs, refs);
 
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(
-			texbuf_w, texbuf_h, GS_A8, 1,
-			(const uint8_t **)&srcdata->texbuf, 0);
-
-		obs_leave_graphics();
-	}
+	pthread_mutex_unlock(&font->mutex);
 }
 
-time_t get_modified_timestamp(char *filename)
+void release_glyphs(struct ft2_source *srcdata)
 {
-	struct stat stats;
-
-	// stat is apparently terrifying and horrible, but we only call it once
-	// every second at most.
-	if (os_stat(filename, &stats) != 0)
-		return -1;
+	struct ft2_font *font = srcdata->font;
+
+	if (font) {
+		pthread_mutex_lock(&font->mutex);
+		for (size_t i = 0; i < srcdata->glyph_refs.num; i++)
+			ft2_font_unref_glyph(font,
+					     srcdata->glyph_refs.array[i]);
+		for (size_t i = 0; i < srcdata->prev_glyph_refs.num; i++)
+			ft2_font_unref_glyph(font,
+					     srcdata->prev_glyph_refs.array[i]);
+		pthread_mutex_unlock(&font->mutex);
+	}
 
-	return stats.st_mtime;
+	da_free(srcdata->glyph_refs);
+	da_free(srcdata->prev_glyph_refs);
 }
 
 static void remove_cr(wchar_t *source)
@@ -390,21 +347,22 @@ static void remove_cr(wchar_t *source)
 	source[j] = '\0';
 }
 
-void load_text_from_file(struct ft2_source *srcdata, const char *filename)
+wchar_t *load_text_from_file(const char *filename, bool *load_failed)
 {
 	FILE *tmp_file = NULL;
 	uint32_t filesize = 0;
 	char *tmp_read = NULL;
+	wchar_t *text;
 	uint16_t header = 0;
 	size_t bytes_read;
 
 	tmp_file = os_fopen(filename, "rb");
 	if (tmp_file == NULL) {
-		if (!srcdata->file_load_failed) {
+		if (!*load_failed) {
 			blog(LOG_WARNING, "Failed to open file %s", filename);
-			srcdata->file_load_failed = true;
+			*load_failed = true;
 		}
-		return;
+		return NULL;
 	}
 	fseek(tmp_file, 0, SEEK_END);
 	filesize = (uint32_t)ftell(tmp_file);
@@ -413,17 +371,13 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 
 	if (bytes_read == 2 && header == 0xFEFF) {
 		// File is already in UTF-16 format
-		if (srcdata->text != NULL) {
-			bfree(srcdata->text);
-			srcdata->text = NULL;
-		}
-		srcdata->text = bzalloc(filesize);
-		bytes_read = fread(srcdata->text, filesize - 2, 1, tmp_file);
+		text = bzalloc(filesize);
+		bytes_read = fread(text, filesize - 2, 1, tmp_file);
 
 		bfree(tmp_read);
 		fclose(tmp_file);
 
-		return;
+		return text;
 	}
 
 	fseek(tmp_file, 0, SEEK_SET);
@@ -432,23 +386,22 @@ void load_text_from_file(struct ft2_source *srcdata, const char *filename)
 	bytes_read = fread(tmp_read, filesize, 1, tmp_file);
 	fclose(tmp_file);
 
-	if (srcdata->text != NULL) {
-		bfree(srcdata->text);
-		srcdata->text = NULL;
-	}
-	srcdata->text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
-	os_utf8_to_wcs(tmp_read, strlen(tmp_read), srcdata->text,
+	text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
+	os_utf8_to_wcs(tmp_read, strlen(tmp_read), text,
 		       (strlen(tmp_read) + 1));
 
-	remove_cr(srcdata->text);
+	remove_cr(text);
 	bfree(tmp_read);
+	return text;
 }
 
-void read_from_end(struct ft2_source *srcdata, const char *filename)
+wchar_t *read_from_end(const char *filename, uint32_t log_lines,
+		       bool *load_failed)
 {
 	FILE *tmp_file = NULL;
-	uint32_t filesize = 0, cur_pos = 0, log_lines = 0;
+	uint32_t filesize = 0, cur_pos = 0;
 	char *tmp_read = NULL;
+	wchar_t *text;
 	uint16_t value = 0, line_breaks = 0;
 	size_t bytes_read;
 	char bvalue;
@@ -457,11 +410,11 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 
 	tmp_file = fopen(filename, "rb");
 	if (tmp_file == NULL) {
-		if (!srcdata->file_load_failed) {
+		if (!*load_failed) {
 			blog(LOG_WARNING, "Failed to open file %s", filename);
-			srcdata->file_load_failed = true;
+			*load_failed = true;
 		}
-		return;
+		return NULL;
 	}
 	bytes_read = fread(&value, 1, 2, tmp_file);
 
@@ -471,7 +424,6 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	fseek(tmp_file, 0, SEEK_END);
 	filesize = (uint32_t)ftell(tmp_file);
 	cur_pos = filesize;
-	log_lines = srcdata->log_lines;
 
 	while (line_breaks <= log_lines && cur_pos != 0) {
 		if (!utf16)
@@ -497,35 +449,27 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	fseek(tmp_file, cur_pos, SEEK_SET);
 
 	if (utf16) {
-		if (srcdata->text != NULL) {
-			bfree(srcdata->text);
-			srcdata->text = NULL;
-		}
-		srcdata->text = bzalloc(filesize - cur_pos);
-		bytes_read =
-			fread(srcdata->text, (filesize - cur_pos), 1, tmp_file);
+		text = bzalloc(filesize - cur_pos);
+		bytes_read = fread(text, (filesize - cur_pos), 1, tmp_file);
 
-		remove_cr(srcdata->text);
+		remove_cr(text);
 		bfree(tmp_read);
 		fclose(tmp_file);
 
-		return;
+		return text;
 	}
 
 	tmp_read = bzalloc((filesize - cur_pos) + 1);
 	bytes_read = fread(tmp_read, filesize - cur_pos, 1, tmp_file);
 	fclose(tmp_file);
 
-	if (srcdata->text != NULL) {
-		bfree(srcdata->text);
-		srcdata->text = NULL;
-	}
-	srcdata->text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
-	os_utf8_to_wcs(tmp_read, strlen(tmp_read), srcdata->text,
+	text = bzalloc((strlen(tmp_read) + 1) * sizeof(wchar_t));
+	os_utf8_to_wcs(tmp_read, strlen(tmp_read), text,
 		       (strlen(tmp_read) + 1));
 
-	remove_cr(srcdata->text);
+	remove_cr(text);
 	bfree(tmp_read);
+	return text;
 }
 
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
@@ -534,12 +478,12 @@ uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 		return 0;
 	}
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
+	FT_GlyphSlot slot = srcdata->font->face->glyph;
 	uint32_t w = 0, max_w = 0;
 	const size_t len = wcslen(text);
 	for (size_t i = 0; i < len; i++) {
 		const FT_UInt glyph_index =
-			FT_Get_Char_Index(srcdata->font_face, text[i]);
+			FT_Get_Char_Index(srcdata->font->face, text[i]);
 
 		if (text[i] == L'\n')
 			w = 0;
@@ -548,8 +492,8 @@ uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 				// Use the cached values.
 				w += src_glyph->xadv;
 			} else {
-				load_glyph(srcdata, glyph_index,
-					   get_render_mode(srcdata));
+				ft2_font_load_glyph(srcdata->font,
+						    glyph_index);
 				w += slot->advance.x >> 6;
 			}
 			if (w > max_w)
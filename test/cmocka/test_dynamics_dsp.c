@@ -0,0 +1,283 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <math.h>
+#include <cmocka.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/audio-math.h>
+
+#include "dynamics-dsp.h"
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+#define FRAMES (SAMPLE_RATE * 4)
+#define BLOCK 480
+
+/* deterministic test signal: decaying sine bursts over noise, so the
+ * envelope sweeps from silence up to full scale */
+static void generate_audio(float *data[CHANNELS], size_t frames)
+{
+	uint32_t seed = 0x12345678;
+
+	for (size_t i = 0; i < frames; i++) {
+		const float t = (float)i / SAMPLE_RATE;
+		const float burst = expf(-8.0f * fmodf(t, 0.5f));
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			seed = seed * 1664525u + 1013904223u;
+			const float noise =
+				((float)(seed >> 8) / (float)(1 << 24)) - 0.5f;
+			data[c][i] = burst * sinf(t * 440.0f * (float)(c + 1) *
+						  6.2831853f) +
+				     0.001f * noise;
+		}
+	}
+}
+
+static void alloc_audio(float *data[CHANNELS], size_t frames)
+{
+	for (size_t c = 0; c < CHANNELS; c++)
+		data[c] = bmalloc(frames * sizeof(float));
+}
+
+static void free_audio(float *data[CHANNELS])
+{
+	for (size_t c = 0; c < CHANNELS; c++)
+		bfree(data[c]);
+}
+
+/* the loops the filters used before sharing the dynamics module */
+static void ref_peak_envelope(float *env_buf, float *const *samples,
+			      size_t channels, size_t frames, float *envelope,
+			      float attack_gain, float release_gain)
+{
+	memset(env_buf, 0, frames * sizeof(env_buf[0]));
+	for (size_t chan = 0; chan < channels; ++chan) {
+		float env = *envelope;
+		for (size_t i = 0; i < frames; ++i) {
+			const float env_in = fabsf(samples[chan][i]);
+			if (env < env_in) {
+				env = env_in + attack_gain * (env - env_in);
+			} else {
+				env = env_in + release_gain * (env - env_in);
+			}
+			env_buf[i] = fmaxf(env_buf[i], env);
+		}
+	}
+	*envelope = env_buf[frames - 1];
+}
+
+static void ref_compress(float *const *samples, size_t channels,
+			 const float *env_buf, size_t frames, float threshold,
+			 float slope, float output_gain)
+{
+	for (size_t i = 0; i < frames; ++i) {
+		const float env_db = mul_to_db(env_buf[i]);
+		float gain = slope * (threshold - env_db);
+		gain = db_to_mul(fminf(0, gain));
+
+		for (size_t c = 0; c < channels; ++c)
+			samples[c][i] *= gain * output_gain;
+	}
+}
+
+static void fast_log2_accuracy_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	double max_err = 0.0;
+
+	/* every mantissa bucket from -140 dB to +24 dB */
+	for (float x = 1e-7f; x < 16.0f; x *= 1.0001f) {
+		const double err = fabs(dyn_fast_log2(x) - log2((double)x));
+		max_err = fmax(max_err, err);
+	}
+
+	print_message("fast log2 max abs error: %g\n", max_err);
+	assert_true(max_err < 2e-5);
+
+	/* silence has to map to a very low level rather than -inf/NaN */
+	assert_true(dyn_fast_mul_to_db(0.0f) < -700.0f);
+}
+
+static void fast_exp2_accuracy_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	double max_err = 0.0;
+
+	for (float x = -100.0f; x < 100.0f; x += 0.001f) {
+		const double ref = exp2((double)x);
+		const double err = fabs(dyn_fast_exp2(x) - ref) / ref;
+		max_err = fmax(max_err, err);
+	}
+
+	print_message("fast exp2 max rel error: %g\n", max_err);
+	assert_true(max_err < 5e-7);
+
+	/* very low levels clamp instead of producing denormals */
+	assert_true(dyn_fast_db_to_mul(-1e6f) > 0.0f);
+	assert_true(isnormal(dyn_fast_db_to_mul(-1e6f)));
+}
+
+static void vector_matches_scalar_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	float buf[37];
+	float ref[37];
+
+	for (size_t i = 0; i < 37; i++)
+		buf[i] = ref[i] = 1e-6f * powf(1.6f, (float)i);
+
+	dyn_mul_to_db(buf, 37);
+	for (size_t i = 0; i < 37; i++)
+		assert_true(fabsf(buf[i] - dyn_fast_mul_to_db(ref[i])) < 1e-4f);
+
+	dyn_db_to_mul(buf, 37, 1.0f);
+	for (size_t i = 0; i < 37; i++)
+		assert_true(fabsf(buf[i] - ref[i]) < 1e-4f * ref[i]);
+}
+
+static void envelope_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	float *audio[CHANNELS];
+	float *env = bmalloc(BLOCK * sizeof(float));
+	float *ref = bmalloc(BLOCK * sizeof(float));
+	float envelope = 0.0f;
+	float ref_envelope = 0.0f;
+
+	alloc_audio(audio, FRAMES);
+	generate_audio(audio, FRAMES);
+
+	for (size_t pos = 0; pos < FRAMES; pos += BLOCK) {
+		float *block[CHANNELS] = {audio[0] + pos, audio[1] + pos};
+
+		dyn_peak_envelope(env, block, CHANNELS, BLOCK, &envelope,
+				  0.9f, 0.999f);
+		ref_peak_envelope(ref, block, CHANNELS, BLOCK, &ref_envelope,
+				  0.9f, 0.999f);
+
+		for (size_t i = 0; i < BLOCK; i++)
+			assert_true(fabsf(env[i] - ref[i]) <= 1e-6f);
+	}
+
+	bfree(env);
+	bfree(ref);
+	free_audio(audio);
+}
+
+static void compression_accuracy_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const float threshold = -18.0f;
+	const float slope = 1.0f - 1.0f / 10.0f;
+	const float output_gain = db_to_mul(6.0f);
+
+	float *audio[CHANNELS];
+	float *ref_audio[CHANNELS];
+	float *env = bmalloc(FRAMES * sizeof(float));
+	float *gain = bmalloc(FRAMES * sizeof(float));
+	float envelope = 0.0f;
+	double max_err_db = 0.0;
+
+	alloc_audio(audio, FRAMES);
+	alloc_audio(ref_audio, FRAMES);
+	generate_audio(audio, FRAMES);
+	generate_audio(ref_audio, FRAMES);
+
+	dyn_peak_envelope(env, audio, CHANNELS, FRAMES, &envelope, 0.99f,
+			  0.9999f);
+	memcpy(gain, env, FRAMES * sizeof(float));
+
+	dyn_compress_gain(gain, FRAMES, threshold, slope, output_gain);
+	dyn_apply_gain(audio, CHANNELS, gain, FRAMES);
+	ref_compress(ref_audio, CHANNELS, env, FRAMES, threshold, slope,
+		     output_gain);
+
+	for (size_t c = 0; c < CHANNELS; c++) {
+		for (size_t i = 0; i < FRAMES; i++) {
+			if (fabsf(ref_audio[c][i]) < 1e-6f)
+				continue;
+
+			const double err = fabs(
+				20.0 * log10(fabs(audio[c][i] /
+						  ref_audio[c][i])));
+			max_err_db = fmax(max_err_db, err);
+		}
+	}
+
+	print_message("compression max gain error: %g dB\n", max_err_db);
+	assert_true(max_err_db < 1e-3);
+
+	bfree(env);
+	bfree(gain);
+	free_audio(audio);
+	free_audio(ref_audio);
+}
+
+static void compression_throughput_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	float *audio[CHANNELS];
+	float *env = bmalloc(BLOCK * sizeof(float));
+	float envelope = 0.0f;
+	uint64_t ref_ns = 0;
+	uint64_t fast_ns = 0;
+
+	alloc_audio(audio, FRAMES);
+	generate_audio(audio, FRAMES);
+
+	for (size_t pos = 0; pos < FRAMES; pos += BLOCK) {
+		float *block[CHANNELS] = {audio[0] + pos, audio[1] + pos};
+		uint64_t start = os_gettime_ns();
+
+		ref_peak_envelope(env, block, CHANNELS, BLOCK, &envelope,
+				  0.99f, 0.9999f);
+		ref_compress(block, CHANNELS, env, BLOCK, -18.0f, 0.9f, 1.0f);
+		ref_ns += os_gettime_ns() - start;
+	}
+
+	generate_audio(audio, FRAMES);
+	envelope = 0.0f;
+
+	for (size_t pos = 0; pos < FRAMES; pos += BLOCK) {
+		float *block[CHANNELS] = {audio[0] + pos, audio[1] + pos};
+		uint64_t start = os_gettime_ns();
+
+		dyn_peak_envelope(env, block, CHANNELS, BLOCK, &envelope,
+				  0.99f, 0.9999f);
+		dyn_compress_gain(env, BLOCK, -18.0f, 0.9f, 1.0f);
+		dyn_apply_gain(block, CHANNELS, env, BLOCK);
+		fast_ns += os_gettime_ns() - start;
+	}
+
+	/* timings depend on the machine, so they are only reported */
+	print_message("compressor, %d s of %d ch audio: "
+		      "reference %.3f ms, shared dsp %.3f ms\n",
+		      FRAMES / SAMPLE_RATE, CHANNELS, (double)ref_ns / 1e6,
+		      (double)fast_ns / 1e6);
+
+	bfree(env);
+	free_audio(audio);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(fast_log2_accuracy_test),
+		cmocka_unit_test(fast_exp2_accuracy_test),
+		cmocka_unit_test(vector_matches_scalar_test),
+		cmocka_unit_test(envelope_test),
+		cmocka_unit_test(compression_accuracy_test),
+		cmocka_unit_test(compression_throughput_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
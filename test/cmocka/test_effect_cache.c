@@ -0,0 +1,141 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdio.h>
+
+#include <graphics/graphics.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+
+/*
+ * Benchmarks effect parsing on the null renderer.  Every effect shipped with
+ * libobs is parsed once from its own path, then created again from a
+ * different path in the same directory, which is served by the content
+ * cache.  Both times are printed so they can be compared between builds.
+ */
+
+static const char *effect_names[] = {
+	"area.effect",
+	"bicubic_scale.effect",
+	"bilinear_lowres_scale.effect",
+	"color.effect",
+	"default.effect",
+	"default_rect.effect",
+	"deinterlace_blend.effect",
+	"deinterlace_blend_2x.effect",
+	"deinterlace_discard.effect",
+	"deinterlace_discard_2x.effect",
+	"deinterlace_linear.effect",
+	"deinterlace_linear_2x.effect",
+	"deinterlace_yadif.effect",
+	"deinterlace_yadif_2x.effect",
+	"format_conversion.effect",
+	"lanczos_scale.effect",
+	"opaque.effect",
+	"premultiplied_alpha.effect",
+	"repeat.effect",
+	"solid.effect",
+};
+
+#define NUM_EFFECTS (sizeof(effect_names) / sizeof(effect_names[0]))
+
+static void parse_benchmark_test(void **state)
+{
+	uint64_t parse_ns = 0;
+	uint64_t cached_ns = 0;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < NUM_EFFECTS; i++) {
+		struct dstr path = {0};
+		struct dstr alias = {0};
+		gs_effect_t *effect;
+		gs_effect_t *shared;
+		char *source;
+		uint64_t t;
+
+		dstr_printf(&path, "%s/%s", LIBOBS_DATA_DIR, effect_names[i]);
+		dstr_printf(&alias, "%s/copy_of_%s", LIBOBS_DATA_DIR,
+			    effect_names[i]);
+
+		source = os_quick_read_utf8_file(path.array);
+		assert_non_null(source);
+
+		t = os_gettime_ns();
+		effect = gs_effect_create_from_file(path.array, NULL);
+		parse_ns += os_gettime_ns() - t;
+		assert_non_null(effect);
+
+		t = os_gettime_ns();
+		shared = gs_effect_create(source, alias.array, NULL);
+		cached_ns += os_gettime_ns() - t;
+		assert_ptr_equal(effect, shared);
+
+		bfree(source);
+		dstr_free(&alias);
+		dstr_free(&path);
+	}
+
+	printf("Parsed %zu effects in %.3f ms, cached lookups took %.3f ms\n",
+	       NUM_EFFECTS, (double)parse_ns / 1000000.0,
+	       (double)cached_ns / 1000000.0);
+}
+
+static void same_size_test(void **state)
+{
+	const char *first = "uniform float4x4 ViewProj;\n"
+			    "uniform float4 color_a;\n";
+	const char *second = "uniform float4x4 ViewProj;\n"
+			     "uniform float4 color_b;\n";
+	gs_effect_t *a;
+	gs_effect_t *b;
+
+	UNUSED_PARAMETER(state);
+
+	/* same directory and size, different contents */
+	a = gs_effect_create(first, "dir/a.effect", NULL);
+	b = gs_effect_create(second, "dir/b.effect", NULL);
+	assert_non_null(a);
+	assert_non_null(b);
+	assert_ptr_not_equal(a, b);
+	assert_non_null(gs_effect_get_param_by_name(b, "color_b"));
+
+	/* same contents in another directory */
+	b = gs_effect_create(first, "other/a.effect", NULL);
+	assert_ptr_not_equal(a, b);
+
+	/* same contents in the same directory */
+	b = gs_effect_create(first, "dir/c.effect", NULL);
+	assert_ptr_equal(a, b);
+}
+
+static int setup(void **state)
+{
+	graphics_t *graphics = NULL;
+
+	if (gs_create(&graphics, NULL_RENDERER_MODULE, 0) != GS_SUCCESS)
+		return -1;
+
+	gs_enter_context(graphics);
+	*state = graphics;
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	gs_leave_context();
+	gs_destroy(*state);
+	return 0;
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(parse_benchmark_test),
+		cmocka_unit_test(same_size_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
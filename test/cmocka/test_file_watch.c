@@ -0,0 +1,161 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/file-watch.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+
+/*
+ * Checks that file watches report changes once the file was left alone,
+ * including files that are replaced by renaming another file over them.
+ * Files are polled once a second where inotify is not available, so the
+ * waits are generous.
+ */
+
+#define TEST_DIR "file_watch_test"
+#define TEST_FILE TEST_DIR "/watched.txt"
+#define TEST_TEMP_FILE TEST_DIR "/watched.txt.tmp"
+
+#define WAIT_MS 5000
+
+struct watch_data {
+	volatile long changes;
+	struct dstr path;
+};
+
+static void file_changed(void *param, const char *path)
+{
+	struct watch_data *data = param;
+
+	dstr_copy(&data->path, path);
+	os_atomic_inc_long(&data->changes);
+}
+
+static bool wait_for_changes(struct watch_data *data, long changes)
+{
+	for (int i = 0; i < WAIT_MS / 10; i++) {
+		if (os_atomic_load_long(&data->changes) >= changes)
+			return true;
+		os_sleep_ms(10);
+	}
+
+	return false;
+}
+
+static void debounce_test(void **state)
+{
+	struct watch_data data = {0};
+	os_file_watch_t *watch;
+	struct dstr text = {0};
+
+	UNUSED_PARAMETER(state);
+
+	assert_true(os_quick_write_utf8_file(TEST_FILE, "0", 1, false));
+	watch = os_file_watch_create(TEST_FILE, file_changed, &data);
+	assert_non_null(watch);
+
+	/* writes that follow each other closely are reported once */
+	for (int i = 1; i <= 5; i++) {
+		dstr_catf(&text, "%d", i);
+		assert_true(os_quick_write_utf8_file(TEST_FILE, text.array,
+						     text.len, false));
+		os_sleep_ms(20);
+	}
+
+	assert_true(wait_for_changes(&data, 1));
+	os_sleep_ms(1500);
+	assert_int_equal(os_atomic_load_long(&data.changes), 1);
+	assert_string_equal(data.path.array, TEST_FILE);
+
+	/* and a file that is left alone is not reported again */
+	os_sleep_ms(1500);
+	assert_int_equal(os_atomic_load_long(&data.changes), 1);
+
+	os_file_watch_destroy(watch);
+	dstr_free(&data.path);
+	dstr_free(&text);
+}
+
+static void rename_test(void **state)
+{
+	struct watch_data data = {0};
+	os_file_watch_t *watch;
+
+	UNUSED_PARAMETER(state);
+
+	assert_true(os_quick_write_utf8_file(TEST_FILE, "first", 5, false));
+	watch = os_file_watch_create(TEST_FILE, file_changed, &data);
+	assert_non_null(watch);
+
+	/* editors save files by renaming a new file over them */
+	assert_true(os_quick_write_utf8_file(TEST_TEMP_FILE, "second file",
+					     11, false));
+	assert_int_equal(os_rename(TEST_TEMP_FILE, TEST_FILE), 0);
+	assert_true(wait_for_changes(&data, 1));
+
+	/* which keeps the new file watched */
+	os_sleep_ms(500);
+	assert_true(os_quick_write_utf8_file(TEST_TEMP_FILE, "third", 5,
+					     false));
+	assert_int_equal(os_rename(TEST_TEMP_FILE, TEST_FILE), 0);
+	assert_true(wait_for_changes(&data, 2));
+
+	/* files that are removed are reported as well */
+	os_sleep_ms(500);
+	assert_int_equal(os_unlink(TEST_FILE), 0);
+	assert_true(wait_for_changes(&data, 3));
+
+	os_file_watch_destroy(watch);
+	dstr_free(&data.path);
+}
+
+static void destroy_test(void **state)
+{
+	struct watch_data data = {0};
+	os_file_watch_t *watch;
+
+	UNUSED_PARAMETER(state);
+
+	assert_true(os_quick_write_utf8_file(TEST_FILE, "first", 5, false));
+	watch = os_file_watch_create(TEST_FILE, file_changed, &data);
+	assert_non_null(watch);
+
+	/* changes that are still being debounced are dropped */
+	assert_true(os_quick_write_utf8_file(TEST_FILE, "second", 6, false));
+	os_file_watch_destroy(watch);
+
+	os_sleep_ms(1500);
+	assert_int_equal(os_atomic_load_long(&data.changes), 0);
+	dstr_free(&data.path);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+	return os_mkdirs(TEST_DIR) == MKDIR_ERROR ? -1 : 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	os_unlink(TEST_TEMP_FILE);
+	os_unlink(TEST_FILE);
+	os_rmdir(TEST_DIR);
+	return 0;
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(debounce_test),
+		cmocka_unit_test(rename_test),
+		cmocka_unit_test(destroy_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
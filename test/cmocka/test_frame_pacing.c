@@ -0,0 +1,249 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "obs-source-pacing.h"
+
+/*
+ * Plays a model of a media thread against a model of the render loop and
+ * measures the frame cadence of async sources that are paced by the render
+ * clock.  The media thread outputs each frame some time ahead of its
+ * timestamp, late by a random amount of scheduling jitter, and every render
+ * picks frames with async_frames_due(), the helper that ready_async_frame()
+ * uses in the render clock mode.  Render times are exact, so the latencies
+ * are the ones of the model: how long after its timestamp a frame is first
+ * picked, not including the time it takes to render or display it.  The
+ * simulation is deterministic.
+ */
+
+#define SIM_SECONDS 60
+#define START_NS 1000000000ULL
+
+struct pacing_case {
+	uint32_t media_fps_num;
+	uint32_t media_fps_den;
+	uint32_t render_fps_num;
+	uint32_t render_fps_den;
+	uint64_t ahead_ns;  /* how early the media thread outputs frames */
+	uint64_t jitter_ns; /* maximum scheduling delay of the media thread */
+	uint64_t phase_ns;  /* offset of the media clock to the render clock */
+};
+
+struct pacing_stats {
+	uint32_t renders;
+	uint32_t shown;
+	uint32_t repeats; /* renders that showed the previous frame again */
+	uint32_t drops;   /* frames that were due but never shown */
+	uint32_t early;   /* frames shown before their timestamp */
+	uint64_t max_latency_ns;
+};
+
+static inline uint64_t frame_time(uint64_t idx, uint32_t num, uint32_t den)
+{
+	return idx * 1000000000ULL * den / num;
+}
+
+static void run_pacing(const struct pacing_case *pc,
+		       struct pacing_stats *stats)
+{
+	const uint64_t num_renders =
+		(uint64_t)SIM_SECONDS * pc->render_fps_num / pc->render_fps_den;
+	const uint64_t num_frames =
+		(uint64_t)SIM_SECONDS * pc->media_fps_num / pc->media_fps_den +
+		2;
+	const uint64_t render_interval =
+		frame_time(1, pc->render_fps_num, pc->render_fps_den);
+
+	struct obs_source_frame *frames =
+		calloc(num_frames, sizeof(struct obs_source_frame));
+	struct obs_source_frame **queue =
+		calloc(num_frames, sizeof(struct obs_source_frame *));
+	uint64_t *arrival = calloc(num_frames, sizeof(uint64_t));
+	uint64_t last_arrival = 0;
+	uint32_t seed = 0x2545f491;
+
+	for (uint64_t i = 0; i < num_frames; i++) {
+		uint64_t ts = START_NS + pc->phase_ns +
+			      frame_time(i, pc->media_fps_num,
+					 pc->media_fps_den);
+
+		seed = seed * 1664525u + 1013904223u;
+		arrival[i] = ts - pc->ahead_ns +
+			     pc->jitter_ns * (seed >> 16) / 65536;
+
+		/* the media thread outputs its frames in order */
+		if (arrival[i] < last_arrival)
+			arrival[i] = last_arrival;
+		last_arrival = arrival[i];
+
+		frames[i].timestamp = ts;
+	}
+
+	size_t next_frame = 0;
+	size_t head = 0;
+	size_t tail = 0;
+	bool showing = false;
+
+	*stats = (struct pacing_stats){0};
+
+	for (uint64_t j = 0; j < num_renders; j++) {
+		uint64_t render_ts =
+			START_NS +
+			frame_time(j, pc->render_fps_num, pc->render_fps_den);
+
+		while (next_frame < num_frames &&
+		       arrival[next_frame] <= render_ts)
+			queue[tail++] = &frames[next_frame++];
+
+		size_t due =
+			async_frames_due(queue + head, tail - head, render_ts);
+
+		stats->renders++;
+
+		if (!due) {
+			if (showing)
+				stats->repeats++;
+			continue;
+		}
+
+		struct obs_source_frame *frame = queue[head + due - 1];
+		uint64_t latency;
+
+		if (frame->timestamp > render_ts) {
+			stats->early++;
+			latency = 0;
+		} else {
+			latency = render_ts - frame->timestamp;
+		}
+
+		if (latency > stats->max_latency_ns)
+			stats->max_latency_ns = latency;
+
+		stats->drops += (uint32_t)(due - 1);
+		stats->shown++;
+		head += due;
+		showing = true;
+	}
+
+	print_message("  %u/%u on %u/%u, %llu ms ahead: %u renders, %u shown, "
+		      "%u repeats, %u drops, max model latency %.2f ms "
+		      "(%.2f frames)\n",
+		      pc->media_fps_num, pc->media_fps_den, pc->render_fps_num,
+		      pc->render_fps_den,
+		      (unsigned long long)(pc->ahead_ns / 1000000),
+		      stats->renders, stats->shown, stats->repeats,
+		      stats->drops, stats->max_latency_ns / 1000000.0,
+		      (double)stats->max_latency_ns / render_interval);
+
+	free(arrival);
+	free(queue);
+	free(frames);
+}
+
+/* 59.94 fps media on 60 fps video needs one repeated frame every 1001
+ * renders, and nothing else */
+static void ntsc_on_60_test(void **state)
+{
+	const struct pacing_case pc = {60000, 1001, 60, 1, 50000000, 8000000,
+				       3000000};
+	struct pacing_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	run_pacing(&pc, &stats);
+
+	assert_int_equal(stats.early, 0);
+	assert_int_equal(stats.drops, 0);
+	assert_in_range(stats.repeats, 3, 4);
+	assert_true(stats.max_latency_ns < 1000000000ULL / 60);
+}
+
+/* media at the video frame rate shows every frame exactly once */
+static void matching_rate_test(void **state)
+{
+	const struct pacing_case pc = {60, 1, 60, 1, 50000000, 8000000,
+				       5000000};
+	struct pacing_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	run_pacing(&pc, &stats);
+
+	assert_int_equal(stats.early, 0);
+	assert_int_equal(stats.drops, 0);
+	assert_int_equal(stats.repeats, 0);
+	assert_true(stats.max_latency_ns < 1000000000ULL / 60);
+}
+
+/* 60 fps media on 59.94 fps video needs one dropped frame every 1000
+ * frames, and nothing else */
+static void fast_media_test(void **state)
+{
+	const struct pacing_case pc = {60, 1, 60000, 1001, 50000000, 8000000,
+				       3000000};
+	struct pacing_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	run_pacing(&pc, &stats);
+
+	assert_int_equal(stats.early, 0);
+	assert_int_equal(stats.repeats, 0);
+	assert_in_range(stats.drops, 3, 4);
+	assert_true(stats.max_latency_ns < 1000000000ULL * 1001 / 60000);
+}
+
+/* 30 fps media on 60 fps video shows every frame twice */
+static void half_rate_test(void **state)
+{
+	const struct pacing_case pc = {30, 1, 60, 1, 50000000, 8000000,
+				       7000000};
+	struct pacing_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	run_pacing(&pc, &stats);
+
+	assert_int_equal(stats.early, 0);
+	assert_int_equal(stats.drops, 0);
+	assert_in_range(stats.repeats, stats.shown - 1, stats.shown);
+	assert_true(stats.max_latency_ns < 1000000000ULL / 60);
+}
+
+/* without decoding ahead, frames that arrive after the render they were due
+ * at are shown a frame late, which repeats the previous frame and then drops
+ * one */
+static void late_delivery_test(void **state)
+{
+	const struct pacing_case ahead = {60000, 1001, 60, 1, 50000000,
+					  8000000, 3000000};
+	struct pacing_case late = ahead;
+	struct pacing_stats ahead_stats;
+	struct pacing_stats late_stats;
+
+	UNUSED_PARAMETER(state);
+
+	late.ahead_ns = 0;
+
+	run_pacing(&ahead, &ahead_stats);
+	run_pacing(&late, &late_stats);
+
+	assert_true(late_stats.drops > 10 * (ahead_stats.drops + 1));
+	assert_true(late_stats.repeats > 10 * ahead_stats.repeats);
+	assert_true(late_stats.max_latency_ns > ahead_stats.max_latency_ns);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(ntsc_on_60_test),
+		cmocka_unit_test(matching_rate_test),
+		cmocka_unit_test(fast_media_test),
+		cmocka_unit_test(half_rate_test),
+		cmocka_unit_test(late_delivery_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
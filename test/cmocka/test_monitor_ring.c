@@ -0,0 +1,94 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "monitor-ring.h"
+
+/*
+ * Checks the ring that hands monitored audio to the pulse writer thread.
+ * Reads that cross the wrap point must return whole samples in order, both
+ * when they are copied out and when they are mixed into the bus.
+ */
+
+#define CHANNELS 2
+#define FRAME_SIZE (CHANNELS * sizeof(float))
+#define RING_FRAMES 10
+
+static void fill_frames(float *data, size_t frames, float first)
+{
+	for (size_t i = 0; i < frames * CHANNELS; i++)
+		data[i] = first + (float)i;
+}
+
+static void wrap_test(void **state)
+{
+	struct monitor_ring ring;
+	float in[RING_FRAMES * CHANNELS];
+	float out[RING_FRAMES * CHANNELS];
+
+	UNUSED_PARAMETER(state);
+
+	ring_init(&ring, RING_FRAMES, FRAME_SIZE);
+
+	/* the wrap point is a whole number of frames in */
+	assert_int_equal(ring.capacity % FRAME_SIZE, 0);
+
+	for (int pass = 0; pass < 2; pass++) {
+		const bool mix = pass == 1;
+
+		/* move the read position close to the end */
+		fill_frames(in, 7, 1000.0f);
+		assert_true(ring_write(&ring, (uint8_t *)in, 7 * FRAME_SIZE));
+		ring_read(&ring, (uint8_t *)out, 7 * FRAME_SIZE, false);
+
+		/* then write and read six frames across the wrap point */
+		fill_frames(in, 6, 1.0f);
+		assert_true(ring_write(&ring, (uint8_t *)in, 6 * FRAME_SIZE));
+		assert_int_equal(ring_size(&ring), 6 * FRAME_SIZE);
+
+		for (size_t i = 0; i < 6 * CHANNELS; i++)
+			out[i] = mix ? 0.5f : 0.0f;
+
+		ring_read(&ring, (uint8_t *)out, 6 * FRAME_SIZE, mix);
+		assert_int_equal(ring_size(&ring), 0);
+
+		for (size_t i = 0; i < 6 * CHANNELS; i++) {
+			const float expected = in[i] + (mix ? 0.5f : 0.0f);
+			assert_true(out[i] == expected);
+		}
+	}
+
+	ring_free(&ring);
+}
+
+static void full_test(void **state)
+{
+	struct monitor_ring ring;
+	float in[RING_FRAMES * CHANNELS];
+
+	UNUSED_PARAMETER(state);
+
+	ring_init(&ring, RING_FRAMES, FRAME_SIZE);
+	fill_frames(in, RING_FRAMES, 0.0f);
+
+	/* the ring holds as many frames as it was created for */
+	assert_true(ring_write(&ring, (uint8_t *)in, 6 * FRAME_SIZE));
+	assert_true(ring_write(&ring, (uint8_t *)in, 4 * FRAME_SIZE));
+	assert_false(ring_write(&ring, (uint8_t *)in, FRAME_SIZE));
+	assert_int_equal(ring.dropped, 1);
+	assert_int_equal(ring.peak, RING_FRAMES * FRAME_SIZE);
+
+	ring_free(&ring);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(wrap_test),
+		cmocka_unit_test(full_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,215 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <graphics/graphics.h>
+#include <graphics/vec4.h>
+
+/*
+ * Runs the graphics API against the null renderer.  Clears, copies and
+ * stages are carried out on the CPU, so the contents of render targets can
+ * be checked exactly, and effects have to parse and bind as they would on
+ * the OpenGL renderer.
+ */
+
+static const char *draw_effect =
+	"uniform float4x4 ViewProj;\n"
+	"uniform texture2d image;\n"
+	"sampler_state def_sampler {\n"
+	"  Filter = Linear;\n"
+	"  AddressU = Clamp;\n"
+	"  AddressV = Clamp;\n"
+	"};\n"
+	"struct VertInOut {\n"
+	"  float4 pos : POSITION;\n"
+	"  float2 uv : TEXCOORD0;\n"
+	"};\n"
+	"VertInOut VSDefault(VertInOut vert_in)\n"
+	"{\n"
+	"  VertInOut vert_out;\n"
+	"  vert_out.pos = mul(float4(vert_in.pos.xyz, 1.0), ViewProj);\n"
+	"  vert_out.uv = vert_in.uv;\n"
+	"  return vert_out;\n"
+	"}\n"
+	"float4 PSDraw(VertInOut vert_in) : TARGET\n"
+	"{\n"
+	"  return image.Sample(def_sampler, vert_in.uv);\n"
+	"}\n"
+	"technique Draw\n"
+	"{\n"
+	"  pass\n"
+	"  {\n"
+	"    vertex_shader = VSDefault(vert_in);\n"
+	"    pixel_shader = PSDraw(vert_in);\n"
+	"  }\n"
+	"}\n";
+
+static uint32_t read_pixel(gs_texture_t *tex, uint32_t x, uint32_t y)
+{
+	gs_stagesurf_t *stage = gs_stagesurface_create(
+		gs_texture_get_width(tex), gs_texture_get_height(tex),
+		gs_texture_get_color_format(tex));
+	uint32_t pixel = 0;
+	uint32_t linesize;
+	uint8_t *data;
+
+	gs_stage_texture(stage, tex);
+	if (gs_stagesurface_map(stage, &data, &linesize)) {
+		pixel = *(uint32_t *)(data + y * linesize + x * 4);
+		gs_stagesurface_unmap(stage);
+	}
+
+	gs_stagesurface_destroy(stage);
+	return pixel;
+}
+
+static void clear_test(void **state)
+{
+	gs_texture_t *target =
+		gs_texture_create(16, 16, GS_BGRA, 1, NULL, GS_RENDER_TARGET);
+	struct vec4 color;
+
+	UNUSED_PARAMETER(state);
+
+	vec4_set(&color, 1.0f, 0.0f, 0.0f, 1.0f);
+	gs_set_render_target(target, NULL);
+	gs_clear(GS_CLEAR_COLOR, &color, 1.0f, 0);
+
+	vec4_set(&color, 0.0f, 0.0f, 1.0f, 1.0f);
+	gs_set_scissor_rect(&(struct gs_rect){4, 4, 8, 8});
+	gs_clear(GS_CLEAR_COLOR, &color, 1.0f, 0);
+	gs_set_scissor_rect(NULL);
+	gs_set_render_target(NULL, NULL);
+
+	assert_int_equal(read_pixel(target, 0, 0), 0xFFFF0000);
+	assert_int_equal(read_pixel(target, 4, 4), 0xFF0000FF);
+	assert_int_equal(read_pixel(target, 11, 11), 0xFF0000FF);
+	assert_int_equal(read_pixel(target, 12, 12), 0xFFFF0000);
+
+	gs_texture_destroy(target);
+}
+
+static void copy_region_test(void **state)
+{
+	uint32_t pixels[4 * 4];
+	const uint8_t *data = (const uint8_t *)pixels;
+	gs_texture_t *src;
+	gs_texture_t *dst;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < 4 * 4; i++)
+		pixels[i] = 0xFF000000 | (uint32_t)i;
+
+	src = gs_texture_create(4, 4, GS_BGRA, 1, &data, 0);
+	dst = gs_texture_create(8, 8, GS_BGRA, 1, NULL, GS_RENDER_TARGET);
+
+	gs_copy_texture_region(dst, 2, 3, src, 1, 1, 2, 2);
+
+	assert_int_equal(read_pixel(dst, 2, 3), 0xFF000005);
+	assert_int_equal(read_pixel(dst, 3, 4), 0xFF00000A);
+	assert_int_equal(read_pixel(dst, 4, 3), 0);
+
+	gs_texture_destroy(src);
+	gs_texture_destroy(dst);
+}
+
+static void set_image_region_test(void **state)
+{
+	uint32_t pixels[2 * 3];
+	gs_texture_t *tex;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < 2 * 3; i++)
+		pixels[i] = 0xFF000000 | (uint32_t)i;
+
+	tex = gs_texture_create(8, 8, GS_BGRA, 1, NULL, GS_DYNAMIC);
+
+	/* rows of the source are three pixels apart */
+	assert_true(gs_texture_set_image_region(
+		tex, (const uint8_t *)pixels, 3 * 4, 5, 6, 2, 2));
+
+	assert_int_equal(read_pixel(tex, 5, 6), 0xFF000000);
+	assert_int_equal(read_pixel(tex, 6, 6), 0xFF000001);
+	assert_int_equal(read_pixel(tex, 5, 7), 0xFF000003);
+	assert_int_equal(read_pixel(tex, 6, 7), 0xFF000004);
+	assert_int_equal(read_pixel(tex, 4, 6), 0);
+	assert_int_equal(read_pixel(tex, 7, 7), 0);
+
+	assert_false(gs_texture_set_image_region(
+		tex, (const uint8_t *)pixels, 3 * 4, 7, 6, 2, 2));
+
+	gs_texture_destroy(tex);
+}
+
+static void effect_draw_test(void **state)
+{
+	uint32_t pixel = 0xFF00FF00;
+	const uint8_t *data = (const uint8_t *)&pixel;
+	char *errors = NULL;
+	gs_effect_t *effect;
+	gs_texture_t *tex;
+	gs_texture_t *target;
+	size_t passes = 0;
+
+	UNUSED_PARAMETER(state);
+
+	effect = gs_effect_create(draw_effect, "draw.effect", &errors);
+	assert_non_null(effect);
+	assert_null(errors);
+
+	tex = gs_texture_create(1, 1, GS_BGRA, 1, &data, 0);
+	target = gs_texture_create(4, 4, GS_BGRA, 1, NULL, GS_RENDER_TARGET);
+
+	gs_set_render_target(target, NULL);
+	gs_set_viewport(0, 0, 4, 4);
+	gs_ortho(0.0f, 4.0f, 0.0f, 4.0f, -100.0f, 100.0f);
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+			      tex);
+	while (gs_effect_loop(effect, "Draw")) {
+		gs_draw_sprite(tex, 0, 4, 4);
+		passes++;
+	}
+
+	gs_set_render_target(NULL, NULL);
+	assert_int_equal(passes, 1);
+
+	gs_texture_destroy(target);
+	gs_texture_destroy(tex);
+	gs_effect_destroy(effect);
+}
+
+static int setup(void **state)
+{
+	graphics_t *graphics = NULL;
+
+	if (gs_create(&graphics, NULL_RENDERER_MODULE, 0) != GS_SUCCESS)
+		return -1;
+
+	gs_enter_context(graphics);
+	*state = graphics;
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	gs_leave_context();
+	gs_destroy(*state);
+	return 0;
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(clear_test),
+		cmocka_unit_test(copy_region_test),
+		cmocka_unit_test(set_image_region_test),
+		cmocka_unit_test(effect_draw_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,337 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/c99defs.h>
+
+#include "rtmp-abr.h"
+
+/*
+ * Replays link capacity traces through a simulated TCP connection and
+ * checks how the bitrate controller reacts.  The simulation is
+ * deterministic: a fluid model of the sender's backlog, the bottleneck
+ * queue and its capacity, sampled every 100 ms like the socket thread
+ * samples TCP_INFO.
+ */
+
+#define TICK_MS 10
+#define SAMPLE_MS 100
+#define KEYFRAME_MS 2000
+#define KEYFRAME_SHARE 0.15
+#define AUDIO_KBPS 160
+#define MAX_KBPS 6000
+
+struct link_segment {
+	uint32_t duration_ms;
+	uint32_t kbps;
+};
+
+struct link_trace {
+	const struct link_segment *segments;
+	size_t count;
+	uint32_t base_rtt_ms;
+	uint32_t buffer_bytes; /* bottleneck queue size */
+};
+
+struct link_stats {
+	uint32_t changes;
+	double max_quiet_ms;  /* longest time without a bitrate change */
+	double sent_kbps;     /* average bitrate set by the controller */
+	double goodput_ratio; /* delivered / min(capacity, bitrate) */
+	double max_backlog_ms;
+	double avg_queue_ms;
+};
+
+struct link_sim {
+	const struct link_trace *trace;
+	struct rtmp_abr abr;
+	uint64_t t_ms;
+	uint32_t seed;
+
+	double backlog; /* bytes waiting in the sender */
+	double queue;   /* bytes waiting at the bottleneck */
+	uint64_t acked;
+
+	/* accumulated over the current stats window */
+	uint32_t changes;
+	uint64_t last_change_ms;
+	double max_quiet_ms;
+	uint64_t ticks;
+	double bitrate_sum;
+	double delivered_sum;
+	double possible_sum;
+	double queue_ms_sum;
+	double max_backlog_ms;
+};
+
+static const struct link_segment clean[] = {{60000, 10000}};
+
+static const struct link_segment step[] = {
+	{30000, 8000},
+	{60000, 2500},
+	{90000, 8000},
+};
+
+static const struct link_segment below_max[] = {{300000, 4000}};
+
+/* throughput of a mobile uplink, one sample every 2-5 seconds */
+static const struct link_segment mobile[] = {
+	{4000, 7200}, {3000, 6100}, {5000, 4800}, {2000, 3900}, {3000, 4400},
+	{4000, 5600}, {5000, 8300}, {3000, 9100}, {2000, 6700}, {4000, 3100},
+	{3000, 2200}, {2000, 1600}, {4000, 2800}, {5000, 4300}, {3000, 5200},
+	{4000, 6900}, {2000, 7700}, {3000, 5400}, {5000, 3600}, {4000, 2900},
+	{3000, 3300}, {2000, 4700}, {4000, 6200}, {5000, 7400}, {3000, 8800},
+	{4000, 6300}, {2000, 4100}, {3000, 3000}, {5000, 3800}, {4000, 5100},
+};
+
+#define TRACE(segments, rtt, buffer) \
+	{segments, sizeof(segments) / sizeof(segments[0]), rtt, buffer}
+
+static uint32_t capacity_kbps(const struct link_trace *trace, uint64_t t_ms)
+{
+	for (size_t i = 0; i < trace->count; i++) {
+		if (t_ms < trace->segments[i].duration_ms)
+			return trace->segments[i].kbps;
+		t_ms -= trace->segments[i].duration_ms;
+	}
+
+	return trace->segments[trace->count - 1].kbps;
+}
+
+static uint64_t trace_duration_ms(const struct link_trace *trace)
+{
+	uint64_t duration = 0;
+	for (size_t i = 0; i < trace->count; i++)
+		duration += trace->segments[i].duration_ms;
+	return duration;
+}
+
+static void sim_init(struct link_sim *sim, const struct link_trace *trace)
+{
+	*sim = (struct link_sim){0};
+	sim->trace = trace;
+	sim->seed = 0x2545f491;
+	rtmp_abr_init(&sim->abr, MAX_KBPS, AUDIO_KBPS, 0);
+}
+
+static void sim_reset_stats(struct link_sim *sim)
+{
+	sim->changes = 0;
+	sim->last_change_ms = sim->t_ms;
+	sim->max_quiet_ms = 0.0;
+	sim->ticks = 0;
+	sim->bitrate_sum = 0.0;
+	sim->delivered_sum = 0.0;
+	sim->possible_sum = 0.0;
+	sim->queue_ms_sum = 0.0;
+	sim->max_backlog_ms = 0.0;
+}
+
+static void sim_update_quiet(struct link_sim *sim)
+{
+	double quiet_ms = (double)(sim->t_ms - sim->last_change_ms);
+
+	if (quiet_ms > sim->max_quiet_ms)
+		sim->max_quiet_ms = quiet_ms;
+	sim->last_change_ms = sim->t_ms;
+}
+
+static void sim_sample(struct link_sim *sim, double cap_kbps)
+{
+	const double bdp = cap_kbps * sim->trace->base_rtt_ms / 8.0;
+	double rtt_ms = sim->trace->base_rtt_ms + sim->queue * 8.0 / cap_kbps;
+
+	sim->seed = sim->seed * 1664525u + 1013904223u;
+	rtt_ms += (double)(sim->seed >> 24) / 64.0; /* 0-4 ms of jitter */
+
+	struct rtmp_abr_sample sample = {
+		.ts = sim->t_ms * 1000000ULL,
+		.rtt_us = (uint32_t)(rtt_ms * 1000.0),
+		.cwnd_bytes = (uint32_t)(sim->trace->buffer_bytes + bdp),
+		.unacked_bytes = (uint32_t)(sim->queue + bdp),
+		.acked_bytes = sim->acked,
+		.backlog_bytes = (uint64_t)sim->backlog,
+	};
+
+	if (rtmp_abr_update(&sim->abr, &sample)) {
+		sim_update_quiet(sim);
+		sim->changes++;
+	}
+}
+
+static void sim_tick(struct link_sim *sim)
+{
+	const double cap_kbps = capacity_kbps(sim->trace, sim->t_ms);
+	const double video = sim->abr.cur_kbps * TICK_MS / 8.0;
+	const double audio = AUDIO_KBPS * TICK_MS / 8.0;
+	double produced = audio + video * (1.0 - KEYFRAME_SHARE);
+	double moved;
+	double delivered;
+
+	if (sim->t_ms % KEYFRAME_MS == 0)
+		produced += video * KEYFRAME_SHARE * KEYFRAME_MS / TICK_MS;
+
+	/* the sender fills the bottleneck queue, the rest waits in the
+	 * write buffer and the socket */
+	sim->backlog += produced;
+	moved = sim->trace->buffer_bytes - sim->queue;
+	if (moved > sim->backlog)
+		moved = sim->backlog;
+	sim->backlog -= moved;
+	sim->queue += moved;
+
+	delivered = cap_kbps * TICK_MS / 8.0;
+	if (delivered > sim->queue)
+		delivered = sim->queue;
+	sim->queue -= delivered;
+	sim->acked += (uint64_t)delivered;
+
+	const double rate_kbps = sim->abr.cur_kbps + AUDIO_KBPS;
+	const double backlog_ms = sim->backlog * 8.0 / rate_kbps;
+
+	sim->ticks++;
+	sim->bitrate_sum += sim->abr.cur_kbps;
+	sim->delivered_sum += delivered;
+	sim->possible_sum += (cap_kbps < rate_kbps ? cap_kbps : rate_kbps) *
+			     TICK_MS / 8.0;
+	sim->queue_ms_sum += sim->queue * 8.0 / cap_kbps;
+	if (backlog_ms > sim->max_backlog_ms)
+		sim->max_backlog_ms = backlog_ms;
+
+	sim->t_ms += TICK_MS;
+	if (sim->t_ms % SAMPLE_MS == 0)
+		sim_sample(sim, cap_kbps);
+}
+
+/* runs the simulation until end_ms, the stats cover start_ms to end_ms */
+static void sim_run(struct link_sim *sim, uint64_t start_ms, uint64_t end_ms,
+		    struct link_stats *stats)
+{
+	while (sim->t_ms < start_ms)
+		sim_tick(sim);
+
+	sim_reset_stats(sim);
+
+	while (sim->t_ms < end_ms)
+		sim_tick(sim);
+
+	sim_update_quiet(sim);
+
+	stats->changes = sim->changes;
+	stats->max_quiet_ms = sim->max_quiet_ms;
+	stats->sent_kbps = sim->bitrate_sum / (double)sim->ticks;
+	stats->goodput_ratio = sim->delivered_sum / sim->possible_sum;
+	stats->max_backlog_ms = sim->max_backlog_ms;
+	stats->avg_queue_ms = sim->queue_ms_sum / (double)sim->ticks;
+
+	print_message("  %6.1f-%6.1f s: %2u changes, quiet %5.1f s, "
+		      "%5.0f kbps, goodput %.2f, max backlog %4.0f ms, "
+		      "queue %4.0f ms\n",
+		      start_ms / 1000.0, end_ms / 1000.0, stats->changes,
+		      stats->max_quiet_ms / 1000.0, stats->sent_kbps,
+		      stats->goodput_ratio, stats->max_backlog_ms,
+		      stats->avg_queue_ms);
+}
+
+/* a link with room to spare must never be touched */
+static void clean_link_test(void **state)
+{
+	const struct link_trace trace = TRACE(clean, 30, 256 * 1024);
+	struct link_sim sim;
+	struct link_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, &trace);
+	sim_run(&sim, 0, trace_duration_ms(&trace), &stats);
+
+	assert_int_equal(stats.changes, 0);
+	assert_int_equal(sim.abr.cur_kbps, MAX_KBPS);
+	assert_true(stats.max_backlog_ms < 100.0);
+}
+
+static void step_down_test(void **state)
+{
+	const struct link_trace trace = TRACE(step, 40, 128 * 1024);
+	struct link_sim sim;
+	struct link_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, &trace);
+	sim_run(&sim, 0, 30000, &stats);
+	assert_int_equal(stats.changes, 0);
+
+	/* reacts within a few seconds of the capacity drop */
+	sim_run(&sim, 30000, 35000, &stats);
+	assert_true(sim.abr.cur_kbps + AUDIO_KBPS <= 2500);
+	assert_true(stats.max_backlog_ms < 3000.0);
+
+	/* then settles close to the capacity with a short queue */
+	sim_run(&sim, 45000, 90000, &stats);
+	assert_true(stats.sent_kbps >= (2500 - AUDIO_KBPS) * 0.7);
+	assert_true(stats.goodput_ratio >= 0.95);
+	assert_true(stats.avg_queue_ms < 200.0);
+	assert_true(stats.changes <= 8);
+
+	/* and climbs back once the link recovers */
+	sim_run(&sim, 90000, 180000, &stats);
+	assert_int_equal(sim.abr.cur_kbps, MAX_KBPS);
+}
+
+/* a link slower than the configured bitrate: the probes above the
+ * capacity have to become rare instead of oscillating */
+static void no_oscillation_test(void **state)
+{
+	const struct link_trace trace = TRACE(below_max, 60, 256 * 1024);
+	struct link_sim sim;
+	struct link_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, &trace);
+	sim_run(&sim, 0, 30000, &stats);
+	assert_true(sim.abr.cur_kbps + AUDIO_KBPS <= 4000);
+
+	/* Once the backoff is at its maximum of 64 seconds, the probe past
+	 * the capacity and the smaller probes after it come as one burst of
+	 * at most 8 changes, and the bitrate is left alone in between.  The
+	 * window covers the end of the first burst and at most three more. */
+	sim_run(&sim, 60000, 300000, &stats);
+	assert_true(stats.max_quiet_ms >= 55000.0);
+	assert_true(stats.changes <= 4 * 8);
+	assert_true(stats.sent_kbps >= (4000 - AUDIO_KBPS) * 0.75);
+	assert_true(stats.goodput_ratio >= 0.95);
+	assert_true(stats.max_backlog_ms < 1500.0);
+	assert_true(sim.abr.failed_probes >= 1);
+}
+
+static void mobile_link_test(void **state)
+{
+	const struct link_trace trace = TRACE(mobile, 70, 192 * 1024);
+	struct link_sim sim;
+	struct link_stats stats;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, &trace);
+	sim_run(&sim, 0, trace_duration_ms(&trace), &stats);
+
+	assert_true(stats.goodput_ratio >= 0.6);
+	assert_true(stats.max_backlog_ms < 2500.0);
+	assert_true(sim.abr.decreases >= 1);
+	assert_true(sim.abr.probes >= 1);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(clean_link_test),
+		cmocka_unit_test(step_down_test),
+		cmocka_unit_test(no_oscillation_test),
+		cmocka_unit_test(mobile_link_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}